@@ -0,0 +1,310 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Lz4.cpp"
+#include "MappedFile.cpp"
+
+// Asset packs, .qpak: every file under res/ and shaders/ in one file that is mapped once,
+// instead of an open / read / close per texture, font and shader at startup. Built by
+// AssetPackBuild.cpp.
+//
+// A header, the table of contents, the names, then the entries, each 64 byte aligned (a
+// .qtex in a pack stays aligned for the GPU). The table is sorted by the names' hash for a
+// binary search. Entries are stored as they are, or LZ4 compressed when the builder was
+// asked to and it saves at least an eighth (shaders, PPM / BMP images, the font; PNGs are
+// compressed already).
+//
+// Loading code calls open_asset with the path it always used: "../res/textures/x.png" is
+// looked up as "res/textures/x.png" in the mounted packs, and read from disk when no pack
+// has it, so programs run with or without a pack. Stored entries are a span into the
+// mapping, nothing is copied; compressed ones are decompressed into the AssetData.
+//
+//   mount_asset_pack("../res/resources.qpak");     // once at startup, before any loading
+//   AssetData font;
+//   if (open_asset("../res/digital_7_mono.ttf", font)) use(font.data(), font.size());
+
+enum class AssetCodec : uint32_t
+{
+    None = 0,
+    LZ4  = 1,
+};
+
+struct AssetPackHeader
+{
+    char     magic[4];         // "QPAK"
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t namesSize;        // the names follow the entries, not terminated
+};
+
+struct AssetPackEntry
+{
+    uint64_t offset;           // from the start of the pack
+    uint64_t size;             // as stored
+    uint64_t rawSize;          // decompressed
+    uint32_t nameOffset;       // into the names
+    uint32_t nameLength;
+    uint32_t hash;             // asset_hash of the name
+    uint32_t codec;            // AssetCodec
+};
+
+struct AssetPack
+{
+    MappedFile file;
+    const AssetPackHeader *header;
+    const AssetPackEntry *entries;
+    const char *names;
+};
+
+// the bytes of one asset, valid while the AssetData and the pack it came from are
+struct AssetData
+{
+    const uint8_t *bytes = nullptr;
+    size_t length = 0;
+    MappedFile file;                    // when read from disk
+    std::vector<uint8_t> decompressed;  // when the entry is compressed
+
+    const uint8_t *data() const { return bytes; }
+    size_t size() const { return length; }
+
+    void close()
+    {
+        file.close();
+        std::vector<uint8_t>().swap(decompressed);
+        bytes = nullptr;
+        length = 0;
+    }
+};
+
+static const uint32_t kAssetPackVersion = 1;
+
+// FNV-1a
+static uint32_t asset_hash(const char *name, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i)
+        hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+    return hash;
+}
+
+// the name of path in a pack: relative to the repository, "../res/x" and "./res/x" are "res/x"
+static const char *asset_name(const char *path)
+{
+    for (;;)
+    {
+        if (path[0] == '.' && (path[1] == '/' || path[1] == '\\'))
+            path += 2;
+        else if (path[0] == '.' && path[1] == '.' && (path[2] == '/' || path[2] == '\\'))
+            path += 3;
+        else
+            return path;
+    }
+}
+
+static bool open_asset_pack(const char *path, AssetPack &pack)
+{
+    if (!pack.file.open(path) || pack.file.size() < sizeof(AssetPackHeader))
+        return false;
+    const uint8_t *base = pack.file.data();
+    size_t size = pack.file.size();
+    pack.header = (const AssetPackHeader *)base;
+    pack.entries = (const AssetPackEntry *)(base + sizeof(AssetPackHeader));
+    pack.names = (const char *)(pack.entries + pack.header->entryCount);
+
+    const AssetPackHeader &header = *pack.header;
+    if (memcmp(header.magic, "QPAK", 4) != 0 || header.version != kAssetPackVersion ||
+        header.entryCount > (size - sizeof(AssetPackHeader)) / sizeof(AssetPackEntry) ||
+        header.namesSize > size - sizeof(AssetPackHeader) - header.entryCount * sizeof(AssetPackEntry))
+    {
+        pack.file.close();
+        return false;
+    }
+    for (uint32_t i = 0; i < header.entryCount; ++i)
+    {
+        const AssetPackEntry &entry = pack.entries[i];
+        if (entry.offset > size || entry.size > size - entry.offset || entry.nameOffset > header.namesSize ||
+            entry.nameLength > header.namesSize - entry.nameOffset || entry.codec > (uint32_t)AssetCodec::LZ4 ||
+            (entry.codec == (uint32_t)AssetCodec::None && entry.size != entry.rawSize))
+        {
+            pack.file.close();
+            return false;
+        }
+    }
+    return true;
+}
+
+static const AssetPackEntry *find_asset(const AssetPack &pack, const char *name)
+{
+    size_t length = strlen(name);
+    uint32_t hash = asset_hash(name, length);
+    const AssetPackEntry *end = pack.entries + pack.header->entryCount;
+    const AssetPackEntry *entry = std::lower_bound(pack.entries, end, hash,
+                                                   [](const AssetPackEntry &e, uint32_t h) { return e.hash < h; });
+    for (; entry != end && entry->hash == hash; ++entry)
+        if (entry->nameLength == length && memcmp(pack.names + entry->nameOffset, name, length) == 0)
+            return entry;
+    return nullptr;
+}
+
+static bool read_asset(const AssetPack &pack, const AssetPackEntry &entry, AssetData &out)
+{
+    const uint8_t *stored = pack.file.data() + entry.offset;
+    if (entry.codec == (uint32_t)AssetCodec::None)
+    {
+        out.bytes = stored;
+        out.length = (size_t)entry.size;
+        return true;
+    }
+    out.decompressed.resize((size_t)entry.rawSize);
+    if (!lz4_decompress(stored, (size_t)entry.size, out.decompressed.data(), out.decompressed.size()))
+    {
+        fprintf(stderr, "Corrupt asset %.*s\n", (int)entry.nameLength, pack.names + entry.nameOffset);
+        return false;
+    }
+    out.bytes = out.decompressed.data();
+    out.length = out.decompressed.size();
+    return true;
+}
+
+// searched by open_asset, first mounted first. Not synchronised: mount and unmount while
+// nothing is loading.
+static std::vector<std::unique_ptr<AssetPack>> &mounted_asset_packs()
+{
+    static std::vector<std::unique_ptr<AssetPack>> packs;
+    return packs;
+}
+
+bool mount_asset_pack(const char *path)
+{
+    std::unique_ptr<AssetPack> pack(new AssetPack());
+    if (!open_asset_pack(path, *pack))
+        return false;
+    mounted_asset_packs().push_back(std::move(pack));
+    return true;
+}
+
+void unmount_asset_packs()
+{
+    mounted_asset_packs().clear();
+}
+
+// path from the mounted packs, or from disk when none has it
+bool open_asset(const char *path, AssetData &out)
+{
+    const char *name = asset_name(path);
+    for (const std::unique_ptr<AssetPack> &pack : mounted_asset_packs())
+        if (const AssetPackEntry *entry = find_asset(*pack, name))
+            return read_asset(*pack, *entry, out);
+
+    if (!out.file.open(path))
+        return false;
+    out.bytes = out.file.data();
+    out.length = out.file.size();
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------
+// building
+
+struct AssetPackSource
+{
+    std::string name;          // in the pack, "res/textures/x.png"
+    std::string path;          // on disk
+};
+
+struct AssetPackStats
+{
+    size_t entries = 0;
+    size_t compressed = 0;     // entries stored as LZ4
+    size_t rawBytes = 0;
+    size_t packBytes = 0;
+};
+
+// reads every source and writes the pack; compress tries LZ4 on each entry
+bool write_asset_pack(const char *path, const std::vector<AssetPackSource> &sources, bool compress, AssetPackStats *stats = nullptr)
+{
+    std::vector<AssetPackSource> sorted(sources);
+    std::sort(sorted.begin(), sorted.end(), [](const AssetPackSource &a, const AssetPackSource &b) { return a.name < b.name; });
+    // a file given twice goes in once
+    sorted.erase(std::unique(sorted.begin(), sorted.end(), [](const AssetPackSource &a, const AssetPackSource &b) { return a.name == b.name; }),
+                 sorted.end());
+
+    AssetPackHeader header;
+    memcpy(header.magic, "QPAK", 4);
+    header.version = kAssetPackVersion;
+    header.entryCount = (uint32_t)sorted.size();
+    header.namesSize = 0;
+    std::vector<AssetPackEntry> entries(sorted.size());
+    std::string names;
+    for (size_t i = 0; i < sorted.size(); ++i)
+    {
+        entries[i].nameOffset = (uint32_t)names.size();
+        entries[i].nameLength = (uint32_t)sorted[i].name.size();
+        entries[i].hash = asset_hash(sorted[i].name.data(), sorted[i].name.size());
+        names += sorted[i].name;
+    }
+    header.namesSize = (uint32_t)names.size();
+
+    // data in name order, so a directory's files are together
+    std::vector<uint8_t> data(sizeof(header) + sizeof(AssetPackEntry) * entries.size() + names.size());
+    std::vector<uint8_t> packed;
+    AssetPackStats total;
+    for (size_t i = 0; i < sorted.size(); ++i)
+    {
+        MappedFile file;
+        if (!file.open(sorted[i].path.c_str()))
+        {
+            fprintf(stderr, "Can't read %s\n", sorted[i].path.c_str());
+            return false;
+        }
+        data.resize((data.size() + 63) & ~(size_t)63);
+
+        AssetPackEntry &entry = entries[i];
+        entry.offset = data.size();
+        entry.rawSize = file.size();
+        entry.codec = (uint32_t)AssetCodec::None;
+        const uint8_t *stored = file.data();
+        size_t storedSize = file.size();
+        if (compress)
+        {
+            packed.resize(lz4_bound(file.size()));
+            packed.resize(lz4_compress(file.data(), file.size(), packed.data()));
+            if (packed.size() <= file.size() - file.size() / 8)
+            {
+                entry.codec = (uint32_t)AssetCodec::LZ4;
+                stored = packed.data();
+                storedSize = packed.size();
+                total.compressed++;
+            }
+        }
+        entry.size = storedSize;
+        data.insert(data.end(), stored, stored + storedSize);
+        total.rawBytes += file.size();
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const AssetPackEntry &a, const AssetPackEntry &b) { return a.hash < b.hash; });
+    memcpy(data.data(), &header, sizeof(header));
+    if (!entries.empty())
+        memcpy(data.data() + sizeof(header), entries.data(), sizeof(AssetPackEntry) * entries.size());
+    if (!names.empty())
+        memcpy(data.data() + sizeof(header) + sizeof(AssetPackEntry) * entries.size(), names.data(), names.size());
+
+    FILE *out = fopen(path, "wb");
+    if (!out)
+        return false;
+    bool written = fwrite(data.data(), 1, data.size(), out) == data.size();
+    written = fclose(out) == 0 && written;
+
+    total.entries = entries.size();
+    total.packBytes = data.size();
+    if (stats)
+        *stats = total;
+    return written;
+}
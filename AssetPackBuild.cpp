@@ -0,0 +1,66 @@
+// Asset pack builder: puts directories and files into one .qpak (AssetPack.cpp), named
+// by their path relative to the repository, which is what open_asset looks up.
+//
+//   AssetPackBuild [--lz4] <output.qpak> <directories or files...>
+//   AssetPackBuild --lz4 ../res/resources.qpak ../res ../shaders
+//
+// With --lz4 entries that shrink by at least an eighth are stored compressed. Empty files
+// and other packs are left out.
+
+#include "AssetPack.cpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+static void addSource(std::vector<AssetPackSource> &sources, const std::filesystem::path &file, const std::string &name)
+{
+    std::error_code error;
+    if (file.extension() == ".qpak" || std::filesystem::file_size(file, error) == 0 || error)
+        return;
+    sources.push_back({ name, file.string() });
+}
+
+int main(int argc, char **argv)
+{
+    bool lz4 = argc > 1 && strcmp(argv[1], "--lz4") == 0;
+    int first = lz4 ? 2 : 1;
+    if (argc < first + 2)
+    {
+        fprintf(stderr, "usage: AssetPackBuild [--lz4] <output.qpak> <directories or files...>\n");
+        return 1;
+    }
+    const char *output = argv[first];
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<AssetPackSource> sources;
+    for (int i = first + 1; i < argc; ++i)
+    {
+        std::filesystem::path root(argv[i]);
+        std::string rootName = asset_name(root.generic_string().c_str());
+        if (!std::filesystem::is_directory(root))
+        {
+            addSource(sources, root, rootName);
+            continue;
+        }
+        while (!rootName.empty() && rootName.back() == '/')
+            rootName.pop_back();
+        for (const auto &entry : std::filesystem::recursive_directory_iterator(root))
+            if (entry.is_regular_file())
+                addSource(sources, entry.path(), rootName + "/" + std::filesystem::relative(entry.path(), root).generic_string());
+    }
+
+    AssetPackStats stats;
+    if (!write_asset_pack(output, sources, lz4, &stats))
+    {
+        fprintf(stderr, "Can't write %s\n", output);
+        return 1;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("%s: %zu assets, %zu LZ4, %.1f MB -> %.1f MB, %.1f ms\n", output, stats.entries, stats.compressed,
+           stats.rawBytes / 1048576.0, stats.packBytes / 1048576.0, ms);
+    return 0;
+}
@@ -0,0 +1,524 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BC_DECODE_SSE2 1
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+// BC1 (DXT1) and BC3 (DXT5) block compression, for the texture baker.
+//
+// A block is 4x4 texels. Colors are fit with the principal axis of the block in RGB:
+// the endpoints are where the texels' projections on it start and end, quantized to
+// 565, and every texel takes the nearest of the 4 palette colors. One least squares
+// pass then refits the endpoints to those indices, kept when it lowers the error. BC3
+// adds an alpha block with the alpha range split into 8 levels. Blocks always use the 4
+// color mode, so BC1 is for opaque images.
+//
+//   std::vector<uint8_t> blocks;
+//   compress_bc_image(rgba, w, h, hasAlpha, blocks);
+
+// bytes of one w x h image, blocks padded to whole 4x4s
+static size_t bc_image_size(int w, int h, bool bc3)
+{
+    return (size_t)((w + 3) / 4) * ((h + 3) / 4) * (bc3 ? 16 : 8);
+}
+
+static uint16_t bc_pack565(float r, float g, float b)
+{
+    auto q = [](float v, int max) { return (int)std::min(std::max(v * max / 255.0f + 0.5f, 0.0f), (float)max); };
+    return (uint16_t)(q(r, 31) << 11 | q(g, 63) << 5 | q(b, 31));
+}
+
+static void bc_unpack565(uint16_t c, int rgb[3])
+{
+    int r = c >> 11, g = c >> 5 & 63, b = c & 31;
+    rgb[0] = r << 3 | r >> 2;
+    rgb[1] = g << 2 | g >> 4;
+    rgb[2] = b << 3 | b >> 2;
+}
+
+// nearest of the 4 palette colors for every texel (2 bits each), returns the squared error
+static int bc_fit_indices(const uint8_t *texels, uint16_t c0, uint16_t c1, uint32_t &indices)
+{
+    int palette[4][3];
+    bc_unpack565(c0, palette[0]);
+    bc_unpack565(c1, palette[1]);
+    for (int c = 0; c < 3; ++c)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    indices = 0;
+    int total = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        int best = 0, bestError = 1 << 30;
+        for (int p = 0; p < 4; ++p)
+        {
+            int dr = texels[i * 4] - palette[p][0], dg = texels[i * 4 + 1] - palette[p][1], db = texels[i * 4 + 2] - palette[p][2];
+            int error = dr * dr + dg * dg + db * db;
+            if (error < bestError)
+            {
+                bestError = error;
+                best = p;
+            }
+        }
+        indices |= (uint32_t)best << (i * 2);
+        total += bestError;
+    }
+    return total;
+}
+
+// 16 RGBA texels to the 8 byte color block
+static void bc_encode_colors(const uint8_t *texels, uint8_t *out)
+{
+    float mean[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; ++i)
+        for (int c = 0; c < 3; ++c)
+            mean[c] += texels[i * 4 + c];
+    for (float &m : mean)
+        m /= 16.0f;
+
+    float cov[6] = { 0, 0, 0, 0, 0, 0 }; // rr rg rb gg gb bb
+    for (int i = 0; i < 16; ++i)
+    {
+        float r = texels[i * 4] - mean[0], g = texels[i * 4 + 1] - mean[1], b = texels[i * 4 + 2] - mean[2];
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+
+    // principal axis by power iteration
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 8; ++iteration)
+    {
+        float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        float length = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+        if (length < 1e-6f)
+            break;
+        axis[0] = x / length;
+        axis[1] = y / length;
+        axis[2] = z / length;
+    }
+
+    float lo = 1e30f, hi = -1e30f;
+    for (int i = 0; i < 16; ++i)
+    {
+        float t = (texels[i * 4] - mean[0]) * axis[0] + (texels[i * 4 + 1] - mean[1]) * axis[1] + (texels[i * 4 + 2] - mean[2]) * axis[2];
+        lo = std::min(lo, t);
+        hi = std::max(hi, t);
+    }
+    float norm = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    if (norm > 0.0f)
+    {
+        lo /= norm;
+        hi /= norm;
+    }
+
+    uint16_t c0 = bc_pack565(mean[0] + axis[0] * hi, mean[1] + axis[1] * hi, mean[2] + axis[2] * hi);
+    uint16_t c1 = bc_pack565(mean[0] + axis[0] * lo, mean[1] + axis[1] * lo, mean[2] + axis[2] * lo);
+    uint32_t indices;
+    int error = bc_fit_indices(texels, c0, c1, indices);
+
+    // one least squares pass: the endpoints that best reproduce the texels with these indices
+    if (error > 0 && c0 != c1)
+    {
+        static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+        float aa = 0, ab = 0, bb = 0, ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+        for (int i = 0; i < 16; ++i)
+        {
+            float a = weights[indices >> (i * 2) & 3], b = 1.0f - a;
+            aa += a * a; ab += a * b; bb += b * b;
+            for (int c = 0; c < 3; ++c)
+            {
+                ax[c] += a * texels[i * 4 + c];
+                bx[c] += b * texels[i * 4 + c];
+            }
+        }
+        float det = aa * bb - ab * ab;
+        if (std::fabs(det) > 1e-6f)
+        {
+            float e0[3], e1[3];
+            for (int c = 0; c < 3; ++c)
+            {
+                e0[c] = (ax[c] * bb - bx[c] * ab) / det;
+                e1[c] = (bx[c] * aa - ax[c] * ab) / det;
+            }
+            uint16_t r0 = bc_pack565(e0[0], e0[1], e0[2]), r1 = bc_pack565(e1[0], e1[1], e1[2]);
+            uint32_t refined;
+            int refinedError = bc_fit_indices(texels, r0, r1, refined);
+            if (refinedError < error)
+            {
+                c0 = r0;
+                c1 = r1;
+                indices = refined;
+            }
+        }
+    }
+
+    // c0 > c1 selects the 4 color mode, swapping the endpoints swaps indices 0/1 and 2/3
+    if (c0 < c1)
+    {
+        std::swap(c0, c1);
+        indices ^= 0x55555555;
+    }
+    else if (c0 == c1)
+    {
+        indices = 0;
+    }
+
+    out[0] = (uint8_t)c0; out[1] = (uint8_t)(c0 >> 8);
+    out[2] = (uint8_t)c1; out[3] = (uint8_t)(c1 >> 8);
+    memcpy(out + 4, &indices, 4);
+}
+
+// 16 RGBA texels to the 8 byte BC3 alpha block
+static void bc_encode_alpha(const uint8_t *texels, uint8_t *out)
+{
+    int a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; ++i)
+    {
+        a0 = std::max(a0, (int)texels[i * 4 + 3]);
+        a1 = std::min(a1, (int)texels[i * 4 + 3]);
+    }
+
+    uint64_t indices = 0;
+    if (a0 != a1)
+    {
+        // a0 > a1: 0 is a0, 1 is a1, 2..7 go from a0 to a1
+        int levels[8] = { a0, a1 };
+        for (int l = 1; l < 7; ++l)
+            levels[l + 1] = ((7 - l) * a0 + l * a1) / 7;
+
+        for (int i = 0; i < 16; ++i)
+        {
+            int a = texels[i * 4 + 3], best = 0, bestError = 256;
+            for (int l = 0; l < 8; ++l)
+            {
+                int error = std::abs(a - levels[l]);
+                if (error < bestError)
+                {
+                    bestError = error;
+                    best = l;
+                }
+            }
+            indices |= (uint64_t)best << (i * 3);
+        }
+    }
+
+    out[0] = (uint8_t)a0;
+    out[1] = (uint8_t)a1;
+    for (int b = 0; b < 6; ++b)
+        out[2 + b] = (uint8_t)(indices >> (b * 8));
+}
+
+// rgba is w x h RGBA8, blocks are appended to out. Edge blocks repeat the last row and column.
+static void compress_bc_image(const uint8_t *rgba, int w, int h, bool bc3, std::vector<uint8_t> &out)
+{
+    size_t start = out.size();
+    out.resize(start + bc_image_size(w, h, bc3));
+    uint8_t *dst = out.data() + start;
+
+    uint8_t texels[64];
+    for (int by = 0; by < h; by += 4)
+    {
+        for (int bx = 0; bx < w; bx += 4)
+        {
+            for (int y = 0; y < 4; ++y)
+                for (int x = 0; x < 4; ++x)
+                    memcpy(&texels[(y * 4 + x) * 4], &rgba[((size_t)std::min(by + y, h - 1) * w + std::min(bx + x, w - 1)) * 4], 4);
+
+            if (bc3)
+            {
+                bc_encode_alpha(texels, dst);
+                dst += 8;
+            }
+            bc_encode_colors(texels, dst);
+            dst += 8;
+        }
+    }
+}
+
+// Decoding BC1-BC5 to RGBA8, for DDS/KTX files when the GL has no S3TC (CompressedTexture.cpp).
+//
+// Blocks follow the S3TC and RGTC specs: BC1 uses the 3 color mode with transparent black
+// when c0 <= c1, BC2 and BC3 colors are always 4 color, BC4 goes to red and BC5 to red and
+// green, like sampling a GL_RED / GL_RG texture. Interpolated values round down the same
+// way bc_fit_indices does, so decoding what compress_bc_image wrote gives what it measured;
+// the specs leave that rounding open and GPUs can be 1 off.
+//
+// decode_bc_image picks the SSE path where the compiler targets it (SSE2 selects palette
+// colors with compare masks, SSSE3 with one pshufb per row, both driven by a table indexed
+// by the row's index byte), decode_bc_image_scalar is the
+// reference the SIMD paths have to match bit for bit.
+//
+//   std::vector<uint8_t> rgba((size_t)w * h * 4);
+//   decode_bc_image(BcFormat::BC3, blocks, w, h, rgba.data());
+
+enum class BcFormat
+{
+    BC1, // DXT1
+    BC2, // DXT3
+    BC3, // DXT5
+    BC4, // RGTC1, red
+    BC5, // RGTC2, red green
+};
+
+static int bc_block_bytes(BcFormat format)
+{
+    return format == BcFormat::BC1 || format == BcFormat::BC4 ? 8 : 16;
+}
+
+static size_t bc_image_size(int w, int h, BcFormat format)
+{
+    return (size_t)((w + 3) / 4) * ((h + 3) / 4) * bc_block_bytes(format);
+}
+
+// the 4 RGBA colors of a color block; fourColor false lets c0 <= c1 pick the 3 color mode
+static void bc_color_palette(const uint8_t *block, bool fourColor, uint8_t palette[16])
+{
+    uint16_t c0 = (uint16_t)(block[0] | block[1] << 8), c1 = (uint16_t)(block[2] | block[3] << 8);
+    int p0[3], p1[3];
+    bc_unpack565(c0, p0);
+    bc_unpack565(c1, p1);
+    for (int c = 0; c < 3; ++c)
+    {
+        palette[c] = (uint8_t)p0[c];
+        palette[4 + c] = (uint8_t)p1[c];
+        if (fourColor || c0 > c1)
+        {
+            palette[8 + c] = (uint8_t)((2 * p0[c] + p1[c]) / 3);
+            palette[12 + c] = (uint8_t)((p0[c] + 2 * p1[c]) / 3);
+        }
+        else
+        {
+            palette[8 + c] = (uint8_t)((p0[c] + p1[c]) / 2);
+            palette[12 + c] = 0;
+        }
+    }
+    palette[3] = palette[7] = palette[11] = 255;
+    palette[15] = fourColor || c0 > c1 ? 255 : 0;
+}
+
+// the 16 values of a BC3 alpha / BC4 block
+static void bc_decode_alpha_block(const uint8_t *block, uint8_t out[16])
+{
+    int a0 = block[0], a1 = block[1];
+    uint8_t levels[8] = { (uint8_t)a0, (uint8_t)a1 };
+    if (a0 > a1)
+    {
+        for (int l = 1; l < 7; ++l)
+            levels[l + 1] = (uint8_t)(((7 - l) * a0 + l * a1) / 7);
+    }
+    else
+    {
+        for (int l = 1; l < 5; ++l)
+            levels[l + 1] = (uint8_t)(((5 - l) * a0 + l * a1) / 5);
+        levels[6] = 0;
+        levels[7] = 255;
+    }
+
+    uint64_t indices = 0;
+    for (int b = 0; b < 6; ++b)
+        indices |= (uint64_t)block[2 + b] << (b * 8);
+    for (int i = 0; i < 16; ++i)
+        out[i] = levels[indices >> (i * 3) & 7];
+}
+
+// the alpha (BC2, BC3) or red / green (BC4, BC5) of a block, 16 values per channel;
+// returns how many channels
+static int bc_decode_channels(BcFormat format, const uint8_t *block, uint8_t channels[2][16])
+{
+    switch (format)
+    {
+    case BcFormat::BC2:
+        for (int i = 0; i < 16; ++i)
+            channels[0][i] = (uint8_t)((block[i / 2] >> (i & 1) * 4 & 15) * 17);
+        return 1;
+    case BcFormat::BC3:
+    case BcFormat::BC4:
+        bc_decode_alpha_block(block, channels[0]);
+        return 1;
+    case BcFormat::BC5:
+        bc_decode_alpha_block(block, channels[0]);
+        bc_decode_alpha_block(block + 8, channels[1]);
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+// one block to 4 rows of 4 RGBA texels, stride bytes apart
+static void bc_decode_block_scalar(BcFormat format, const uint8_t *block, uint8_t *out, size_t stride)
+{
+    uint8_t channels[2][16];
+    int count = bc_decode_channels(format, block, channels);
+
+    if (format == BcFormat::BC4 || format == BcFormat::BC5)
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            uint8_t *texel = out + (i / 4) * stride + (i % 4) * 4;
+            texel[0] = channels[0][i];
+            texel[1] = count == 2 ? channels[1][i] : 0;
+            texel[2] = 0;
+            texel[3] = 255;
+        }
+        return;
+    }
+
+    const uint8_t *colors = format == BcFormat::BC1 ? block : block + 8;
+    uint8_t palette[16];
+    bc_color_palette(colors, format != BcFormat::BC1, palette);
+    uint32_t indices = (uint32_t)(colors[4] | colors[5] << 8 | colors[6] << 16 | (uint32_t)colors[7] << 24);
+    for (int i = 0; i < 16; ++i)
+    {
+        uint8_t *texel = out + (i / 4) * stride + (i % 4) * 4;
+        memcpy(texel, &palette[(indices >> (i * 2) & 3) * 4], 4);
+        if (count)
+            texel[3] = channels[0][i];
+    }
+}
+
+#ifdef BC_DECODE_SSE2
+
+// the palette entry of every texel of a row, by its index byte, as byte offsets into the
+// 16 byte palette: a pshufb control for SSSE3, SSE2 compares its lanes with each entry's
+struct BcRowTable
+{
+    alignas(16) uint8_t rows[256][16];
+
+    BcRowTable()
+    {
+        for (int row = 0; row < 256; ++row)
+            for (int texel = 0; texel < 4; ++texel)
+                for (int byte = 0; byte < 4; ++byte)
+                    rows[row][texel * 4 + byte] = (uint8_t)((row >> (texel * 2) & 3) * 4 + byte);
+    }
+};
+static const BcRowTable bcRowTable;
+
+// the color rows selected from the palette, the alpha / red / green channels merged in
+static void bc_decode_block_sse2(BcFormat format, const uint8_t *block, uint8_t *out, size_t stride)
+{
+    // BC2's 4 bit alphas are split into nibbles below, the others decode like the scalar path
+    uint8_t channels[2][16];
+    int count = format == BcFormat::BC2 ? 1 : bc_decode_channels(format, block, channels);
+
+    if (format == BcFormat::BC4 || format == BcFormat::BC5)
+    {
+        // r g 0 255: interleave the channels with zeros, then the bytes with 0 / 255 pairs
+        const __m128i zero = _mm_setzero_si128();
+        __m128i red = _mm_loadu_si128((const __m128i*)channels[0]);
+        __m128i green = count == 2 ? _mm_loadu_si128((const __m128i*)channels[1]) : zero;
+        __m128i ba = _mm_set1_epi16((short)0xFF00);
+        __m128i rg0 = _mm_unpacklo_epi8(red, green), rg1 = _mm_unpackhi_epi8(red, green);
+        _mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi16(rg0, ba));
+        _mm_storeu_si128((__m128i*)(out + stride), _mm_unpackhi_epi16(rg0, ba));
+        _mm_storeu_si128((__m128i*)(out + stride * 2), _mm_unpacklo_epi16(rg1, ba));
+        _mm_storeu_si128((__m128i*)(out + stride * 3), _mm_unpackhi_epi16(rg1, ba));
+        return;
+    }
+
+    const uint8_t *colors = format == BcFormat::BC1 ? block : block + 8;
+    alignas(16) uint8_t palette[16];
+    bc_color_palette(colors, format != BcFormat::BC1, palette);
+    __m128i paletteVector = _mm_load_si128((const __m128i*)palette);
+
+#ifndef __SSSE3__
+    __m128i entries[4] = {
+        _mm_shuffle_epi32(paletteVector, 0x00), _mm_shuffle_epi32(paletteVector, 0x55),
+        _mm_shuffle_epi32(paletteVector, 0xAA), _mm_shuffle_epi32(paletteVector, 0xFF),
+    };
+#endif
+
+    // alpha goes in byte 3 of every texel: interleaving with zeros twice puts it at the top
+    const __m128i rgbMask = _mm_set1_epi32(0x00FFFFFF);
+    __m128i alpha = _mm_setzero_si128();
+    if (format == BcFormat::BC2)
+    {
+        const __m128i nibble = _mm_set1_epi8(15);
+        __m128i packed = _mm_loadl_epi64((const __m128i*)block);
+        alpha = _mm_unpacklo_epi8(_mm_and_si128(packed, nibble), _mm_and_si128(_mm_srli_epi16(packed, 4), nibble));
+        alpha = _mm_or_si128(alpha, _mm_slli_epi16(alpha, 4));   // * 17, no carries out of the bytes
+    }
+    else if (count)
+    {
+        alpha = _mm_loadu_si128((const __m128i*)channels[0]);
+    }
+    __m128i alpha16[2] = { _mm_unpacklo_epi8(_mm_setzero_si128(), alpha), _mm_unpackhi_epi8(_mm_setzero_si128(), alpha) };
+
+    for (int y = 0; y < 4; ++y)
+    {
+        int rowIndices = colors[4 + y];
+        __m128i offsets = _mm_load_si128((const __m128i*)bcRowTable.rows[rowIndices]);
+#ifdef __SSSE3__
+        __m128i row = _mm_shuffle_epi8(paletteVector, offsets);
+#else
+        __m128i row = _mm_and_si128(_mm_cmpeq_epi32(offsets, _mm_set1_epi32(0x03020100)), entries[0]);
+        row = _mm_or_si128(row, _mm_and_si128(_mm_cmpeq_epi32(offsets, _mm_set1_epi32(0x07060504)), entries[1]));
+        row = _mm_or_si128(row, _mm_and_si128(_mm_cmpeq_epi32(offsets, _mm_set1_epi32(0x0B0A0908)), entries[2]));
+        row = _mm_or_si128(row, _mm_and_si128(_mm_cmpeq_epi32(offsets, _mm_set1_epi32(0x0F0E0D0C)), entries[3]));
+#endif
+        if (count)
+        {
+            __m128i a = y & 1 ? _mm_unpackhi_epi16(_mm_setzero_si128(), alpha16[y / 2]) : _mm_unpacklo_epi16(_mm_setzero_si128(), alpha16[y / 2]);
+            row = _mm_or_si128(_mm_and_si128(row, rgbMask), a);
+        }
+        _mm_storeu_si128((__m128i*)(out + y * stride), row);
+    }
+}
+
+#endif
+
+static void bc_decode_image_with(void (*decodeBlock)(BcFormat, const uint8_t*, uint8_t*, size_t),
+                                 BcFormat format, const uint8_t *blocks, int w, int h, uint8_t *rgba)
+{
+    int blockBytes = bc_block_bytes(format);
+    size_t stride = (size_t)w * 4;
+    uint8_t edge[64];
+    for (int by = 0; by < h; by += 4)
+    {
+        for (int bx = 0; bx < w; bx += 4, blocks += blockBytes)
+        {
+            uint8_t *dst = rgba + by * stride + bx * 4;
+            if (bx + 4 <= w && by + 4 <= h)
+            {
+                decodeBlock(format, blocks, dst, stride);
+                continue;
+            }
+
+            // blocks over the edge decode aside, then the part inside the image is copied
+            decodeBlock(format, blocks, edge, 16);
+            int rows = std::min(4, h - by), columns = std::min(4, w - bx);
+            for (int y = 0; y < rows; ++y)
+                memcpy(dst + y * stride, edge + y * 16, columns * 4);
+        }
+    }
+}
+
+// blocks of a w x h image to w x h RGBA8
+static void decode_bc_image_scalar(BcFormat format, const uint8_t *blocks, int w, int h, uint8_t *rgba)
+{
+    bc_decode_image_with(bc_decode_block_scalar, format, blocks, w, h, rgba);
+}
+
+static void decode_bc_image(BcFormat format, const uint8_t *blocks, int w, int h, uint8_t *rgba)
+{
+#ifdef BC_DECODE_SSE2
+    bc_decode_image_with(bc_decode_block_sse2, format, blocks, w, h, rgba);
+#else
+    bc_decode_image_with(bc_decode_block_scalar, format, blocks, w, h, rgba);
+#endif
+}
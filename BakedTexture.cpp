@@ -0,0 +1,198 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "AssetPack.cpp"
+#include "BCn.cpp"
+#include "MipGenerator.cpp"
+
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// Textures baked offline (TextureBake.cpp) into a GPU ready container, .qtex: a fixed
+// header with a table of mip levels, then the levels themselves, each 64 byte aligned,
+// largest first, in the format they go to glTexImage2D / glCompressedTexImage2D. Loading
+// is mapping the file, or finding it in a mounted asset pack (AssetPack.cpp), and handing
+// the GPU pointers into it, nothing is decoded and no mipmaps are generated.
+//
+//   baking:  bake_texture(rgba, w, h, BakedFormat::BC1, bytes); save_baked_texture("x.qtex", bytes);
+//   loading: GLuint tex = UploadBakedTexture("x.qtex");  (UploadImage does this for .qtex too)
+
+enum class BakedFormat : uint32_t
+{
+    RGBA8 = 0,
+    BC1   = 1, // DXT1, opaque
+    BC3   = 2, // DXT5
+};
+
+static const int kBakedMaxMips = 16;
+
+struct BakedMip
+{
+    uint32_t offset;           // from the start of the file
+    uint32_t size;
+    uint32_t width, height;
+};
+
+struct BakedTextureHeader
+{
+    char     magic[4];         // "QTEX"
+    uint32_t version;
+    uint32_t format;           // BakedFormat
+    uint32_t width, height;
+    uint32_t mipCount;
+    uint32_t reserved[2];
+    BakedMip mips[kBakedMaxMips];
+};
+
+struct BakedTexture
+{
+    AssetData file;
+    const BakedTextureHeader *header;
+};
+
+static const uint32_t kBakedVersion = 1;
+
+static size_t baked_level_size(BakedFormat format, int w, int h)
+{
+    if (format == BakedFormat::RGBA8)
+        return (size_t)w * h * 4;
+    return bc_image_size(w, h, format == BakedFormat::BC3);
+}
+
+// rgba is w x h RGBA8; the whole mip chain goes into file, filtered as mips says
+static void bake_texture(const uint8_t *rgba, int w, int h, BakedFormat format, std::vector<uint8_t> &file,
+                         const MipOptions &mips = MipOptions())
+{
+    BakedTextureHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "QTEX", 4);
+    header.version = kBakedVersion;
+    header.format = (uint32_t)format;
+    header.width = w;
+    header.height = h;
+
+    file.assign(sizeof(header), 0);
+
+    MipChain chain;
+    generate_mips(rgba, w, h, mips, chain);
+
+    const uint8_t *level = rgba;
+    for (int mip = 0; mip < kBakedMaxMips; ++mip)
+    {
+        file.resize((file.size() + 63) & ~(size_t)63);
+
+        BakedMip &m = header.mips[mip];
+        m.offset = (uint32_t)file.size();
+        m.width = w;
+        m.height = h;
+        if (format == BakedFormat::RGBA8)
+            file.insert(file.end(), level, level + (size_t)w * h * 4);
+        else
+            compress_bc_image(level, w, h, format == BakedFormat::BC3, file);
+        m.size = (uint32_t)(file.size() - m.offset);
+        header.mipCount++;
+
+        if (mip == (int)chain.levels.size())
+            break;
+        const MipLevel &next = chain.levels[mip];
+        level = chain.data(next);
+        w = next.width;
+        h = next.height;
+    }
+
+    memcpy(file.data(), &header, sizeof(header));
+}
+
+static bool save_baked_texture(const char *path, const std::vector<uint8_t> &file)
+{
+    FILE *out = fopen(path, "wb");
+    if (!out)
+        return false;
+    bool ok = fwrite(file.data(), 1, file.size(), out) == file.size();
+    return fclose(out) == 0 && ok;
+}
+
+static bool open_baked_texture(const char *path, BakedTexture &texture)
+{
+    texture.header = nullptr;
+    if (!open_asset(path, texture.file))
+    {
+        fprintf(stderr, "Can't read baked texture: %s\n", path);
+        return false;
+    }
+
+    const BakedTextureHeader *header = (const BakedTextureHeader*)texture.file.data();
+    bool valid = texture.file.size() >= sizeof(BakedTextureHeader) && memcmp(header->magic, "QTEX", 4) == 0 &&
+                 header->version == kBakedVersion && header->format <= (uint32_t)BakedFormat::BC3 &&
+                 header->mipCount >= 1 && header->mipCount <= (uint32_t)kBakedMaxMips;
+    for (uint32_t mip = 0; valid && mip < header->mipCount; ++mip)
+    {
+        const BakedMip &m = header->mips[mip];
+        valid = (size_t)m.offset + m.size <= texture.file.size() &&
+                m.size == baked_level_size((BakedFormat)header->format, m.width, m.height);
+    }
+    if (!valid)
+    {
+        fprintf(stderr, "Not a baked texture: %s\n", path);
+        texture.file.close();
+        return false;
+    }
+
+    texture.header = header;
+    return true;
+}
+
+// (re)specifies texture with every level of the baked chain, sampler parameters are left alone
+static void upload_baked_texture(GLuint texture, const BakedTexture &baked)
+{
+    const BakedTextureHeader &header = *baked.header;
+    BakedFormat format = (BakedFormat)header.format;
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (uint32_t mip = 0; mip < header.mipCount; ++mip)
+    {
+        const BakedMip &m = header.mips[mip];
+        const uint8_t *data = baked.file.data() + m.offset;
+        if (format == BakedFormat::RGBA8)
+            glTexImage2D(GL_TEXTURE_2D, mip, GL_RGBA, m.width, m.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        else
+            glCompressedTexImage2D(GL_TEXTURE_2D, mip, format == BakedFormat::BC1 ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,
+                                   m.width, m.height, 0, m.size, data);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header.mipCount - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// same sampler state as UploadImage, 0 when the file isn't a baked texture
+uint32_t UploadBakedTexture(const char *path)
+{
+    BakedTexture baked;
+    if (!open_baked_texture(path, baked))
+        return 0;
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    upload_baked_texture(texture, baked);
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
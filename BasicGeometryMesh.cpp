@@ -21,545 +21,11 @@ using namespace glm;
 #include "shader.cpp"
 
 #include "UploadImage.cpp"
-
-class GLMeshData
-{
-public:
-	GLMeshData();
-	~GLMeshData();
-
-	void createBox(float w, float h, float l);
-	void createPlane(float base, float size, float uvScale = 1.0f);
-	void createSphere(float rad, uint32_t hSegs, uint32_t vSegs);
-    void createCone(float radius, float height, uint32_t segments);
-    void createCylinder(float radius, float height, uint32_t segments);
-    void createTrapezoid(float baseWidth, float topWidth, float height, float depth);
-    void createQuad();
-    void createCircle(float radius, uint32_t segments);
-
-	void render();
-    void renderQuad();
-	void clear();
-
-protected:
-	void createGLObjects();
-
-	GLenum primitiveType;
-	unsigned int numVertices;
-	unsigned int numPrimitives;
-
-	GLuint meshVAID;
-	GLuint meshIBID;
-	GLuint meshVBID_pos;
-	GLuint meshVBID_uv;
-	
-	std::vector<GLuint> indexData;
-	std::vector<GLfloat> posData;
-	std::vector<GLfloat> uvData;
-};
-
-
-GLMeshData::GLMeshData()
-{
-	meshVAID = meshVBID_pos = meshVBID_uv = meshIBID = 0;
-
-	numVertices = numPrimitives = 0;
-
-	primitiveType = GL_TRIANGLES;
-}
-
-GLMeshData::~GLMeshData()
-{
-	clear();
-}
-
-void GLMeshData::clear()
-{
-	if (meshVBID_pos)
-	{
-		glDeleteBuffers(1, &meshVBID_pos);
-		meshVBID_pos = 0;
-	}
-
-	if (meshVBID_uv)
-	{
-		glDeleteBuffers(1, &meshVBID_uv);
-		meshVBID_uv = 0;
-	}
-
-	if (meshIBID)
-	{
-		glDeleteBuffers(1, &meshIBID);
-		meshIBID = 0;
-	}
-
-	if (meshVAID)
-	{
-		glDeleteVertexArrays(1, &meshVAID);
-		meshVAID = 0;
-	}
-}
-
-void GLMeshData::createPlane(float base, float size, float uvScale)
-{
-	numPrimitives = 2;
-
-	posData = {
-		-size,base,-size,
-		 size,base,-size,
-		 size,base, size,
-		-size,base, size,
-	};
-
-	uvData = {
-		0.0f*uvScale, 0.0f*uvScale,
-		1.0f*uvScale, 0.0f*uvScale,
-		1.0f*uvScale, 1.0f*uvScale,
-		0.0f*uvScale, 1.0f*uvScale,
-	};
-
-	indexData = {
-		0, 1, 2,
-		2, 3, 0
-	};
-
-	createGLObjects();
-}
-
-void GLMeshData::createBox(float w, float h, float l)
-{
-	numPrimitives = 6*2;
-
-	w *= 0.5f;
-	h *= 0.5f;
-	l *= 0.5f;
-
-	// bottom face
-	posData.insert(posData.end(), { w, -h,  l}); uvData.insert(uvData.end(), {0.0f, 0.0f});
-	posData.insert(posData.end(), {-w, -h,  l}); uvData.insert(uvData.end(), {1.0f, 0.0f});
-	posData.insert(posData.end(), {-w, -h, -l}); uvData.insert(uvData.end(), {1.0f, 1.0f});
-	posData.insert(posData.end(), { w, -h, -l}); uvData.insert(uvData.end(), {0.0f, 1.0f});
-
-	// top face
-	posData.insert(posData.end(), {-w,  h,  l}); uvData.insert(uvData.end(), {0.0f, 0.0f});
-	posData.insert(posData.end(), { w,  h,  l}); uvData.insert(uvData.end(), {1.0f, 0.0f});
-	posData.insert(posData.end(), { w,  h, -l}); uvData.insert(uvData.end(), {1.0f, 1.0f});
-	posData.insert(posData.end(), {-w,  h, -l}); uvData.insert(uvData.end(), {0.0f, 1.0f});
-
-	// left face
-	posData.insert(posData.end(), {-w, -h, -l}); uvData.insert(uvData.end(), {0.0f, 0.0f});
-	posData.insert(posData.end(), {-w, -h,  l}); uvData.insert(uvData.end(), {1.0f, 0.0f});
-	posData.insert(posData.end(), {-w,  h,  l}); uvData.insert(uvData.end(), {1.0f, 1.0f});
-	posData.insert(posData.end(), {-w,  h, -l}); uvData.insert(uvData.end(), {0.0f, 1.0f});
-
-	// right face
-	posData.insert(posData.end(), { w, -h,  l}); uvData.insert(uvData.end(), {0.0f, 0.0f});
-	posData.insert(posData.end(), { w, -h, -l}); uvData.insert(uvData.end(), {1.0f, 0.0f});
-	posData.insert(posData.end(), { w,  h, -l}); uvData.insert(uvData.end(), {1.0f, 1.0f});
-	posData.insert(posData.end(), { w,  h,  l}); uvData.insert(uvData.end(), {0.0f, 1.0f});
-
-	// front face
-	posData.insert(posData.end(), {-w, -h,  l}); uvData.insert(uvData.end(), {0.0f, 0.0f});
-	posData.insert(posData.end(), { w, -h,  l}); uvData.insert(uvData.end(), {1.0f, 0.0f});
-	posData.insert(posData.end(), { w,  h,  l}); uvData.insert(uvData.end(), {1.0f, 1.0f});
-	posData.insert(posData.end(), {-w,  h,  l}); uvData.insert(uvData.end(), {0.0f, 1.0f});
-
-	// back face
-	posData.insert(posData.end(), { w, -h, -l}); uvData.insert(uvData.end(), {0.0f, 0.0f});
-	posData.insert(posData.end(), {-w, -h, -l}); uvData.insert(uvData.end(), {1.0f, 0.0f});
-	posData.insert(posData.end(), {-w,  h, -l}); uvData.insert(uvData.end(), {1.0f, 1.0f});
-	posData.insert(posData.end(), { w,  h, -l}); uvData.insert(uvData.end(), {0.0f, 1.0f});
-
-	std::vector< unsigned int > tri00;
-	std::vector< unsigned int > tri01;
-	tri00.push_back(0); tri00.push_back(1); tri00.push_back(2);
-	tri01.push_back(0); tri01.push_back(2); tri01.push_back(3);
-
-	std::vector< unsigned int > tri02;
-	std::vector< unsigned int > tri03;
-	tri02.push_back(4); tri02.push_back(5); tri02.push_back(6);
-	tri03.push_back(4); tri03.push_back(6); tri03.push_back(7);
-
-	std::vector< unsigned int > tri04;
-	std::vector< unsigned int > tri05;
-	tri04.push_back(8); tri04.push_back(9); tri04.push_back(10);
-	tri05.push_back(8); tri05.push_back(10); tri05.push_back(11);
-
-	std::vector< unsigned int > tri06;
-	std::vector< unsigned int > tri07;
-	tri06.push_back(12); tri06.push_back(13); tri06.push_back(14);
-	tri07.push_back(12); tri07.push_back(14); tri07.push_back(15);
-
-	std::vector< unsigned int > tri08;
-	std::vector< unsigned int > tri09;
-	tri08.push_back(16); tri08.push_back(17); tri08.push_back(18);
-	tri09.push_back(16); tri09.push_back(18); tri09.push_back(19);
-
-	std::vector< unsigned int > tri10;
-	std::vector< unsigned int > tri11;
-	tri10.push_back(20); tri10.push_back(21); tri10.push_back(22);
-	tri11.push_back(20); tri11.push_back(22); tri11.push_back(23);
-
-	indexData.insert(indexData.end(), tri00.begin(), tri00.end());
-	indexData.insert(indexData.end(), tri01.begin(), tri01.end());
-	indexData.insert(indexData.end(), tri02.begin(), tri02.end());
-	indexData.insert(indexData.end(), tri03.begin(), tri03.end());
-	indexData.insert(indexData.end(), tri04.begin(), tri04.end());
-	indexData.insert(indexData.end(), tri05.begin(), tri05.end());
-	indexData.insert(indexData.end(), tri06.begin(), tri06.end());
-	indexData.insert(indexData.end(), tri07.begin(), tri07.end());
-	indexData.insert(indexData.end(), tri08.begin(), tri08.end());
-	indexData.insert(indexData.end(), tri09.begin(), tri09.end());
-	indexData.insert(indexData.end(), tri10.begin(), tri10.end());
-	indexData.insert(indexData.end(), tri11.begin(), tri11.end());
-
-	createGLObjects();
-}
-
-void GLMeshData::createSphere(float rad, uint32_t hSegs, uint32_t vSegs)
-{
-	numPrimitives = hSegs * vSegs * 2;
-
-	float dphi = (float)(2.0*M_PI) / (float)(hSegs);
-	float dtheta = (float)(M_PI) / (float)(vSegs);
-
-	for (uint32_t v = 0; v <= vSegs; ++v)
-	{
-		float theta = v * dtheta;
-
-		for (uint32_t h = 0; h <= hSegs; ++h)
-		{
-			float phi = h * dphi;
-
-			float x = std::sin(theta) * std::cos(phi);
-			float y = std::cos(theta);
-			float z = std::sin(theta) * std::sin(phi);
-
-			posData.insert(posData.end(), { rad * x, rad * y, rad * z });
-			uvData.insert(uvData.end(), { 1.0f - (float)h / hSegs, (float)v / vSegs });
-		}
-	}
-
-	for (uint32_t v = 0; v < vSegs; v++)
-	{
-		for (uint32_t h = 0; h < hSegs; h++)
-		{
-			uint32_t topRight = v * (hSegs + 1) + h;
-			uint32_t topLeft = v * (hSegs + 1) + h + 1;
-			uint32_t lowerRight = (v + 1) * (hSegs + 1) + h;
-			uint32_t lowerLeft = (v + 1) * (hSegs + 1) + h + 1;
-
-			std::vector< unsigned int > tri0;
-			std::vector< unsigned int > tri1;
-
-			tri0.push_back(lowerLeft);
-			tri0.push_back(lowerRight);
-			tri0.push_back(topRight);
-
-			tri1.push_back(lowerLeft);
-			tri1.push_back(topRight);
-			tri1.push_back(topLeft);
-
-			indexData.insert(indexData.end(), tri0.begin(), tri0.end());
-			indexData.insert(indexData.end(), tri1.begin(), tri1.end());
-		}
-	}
-
-	createGLObjects();
-}
-
-void GLMeshData::createCone(float radius, float height, uint32_t segments)
-{
-    numPrimitives = segments * 2;
-
-    // Create the base circle
-    for (uint32_t i = 0; i <= segments; ++i)
-    {
-        float angle = 2.0f * M_PI * i / segments;
-        float x = radius * std::cos(angle);
-        float z = radius * std::sin(angle);
-        
-        posData.insert(posData.end(), {x, 0, z});
-        uvData.insert(uvData.end(), {(float)i / segments, 0});
-    }
-
-    // Add the apex
-    posData.insert(posData.end(), {0, height, 0});
-    uvData.insert(uvData.end(), {0.5f, 1.0f});
-
-    // Create the base triangles
-    for (uint32_t i = 0; i < segments; ++i)
-    {
-        indexData.insert(indexData.end(), {0, i + 1, i + 2});
-    }
-
-    // Create the side triangles
-    uint32_t apexIndex = segments + 1;
-    for (uint32_t i = 1; i <= segments; ++i)
-    {
-        indexData.insert(indexData.end(), {i, apexIndex, i + 1});
-    }
-
-    createGLObjects();
-}
-
-void GLMeshData::createCylinder(float radius, float height, uint32_t segments)
-{
-    numPrimitives = segments * 4;
-
-    // Create the bottom circle
-    for (uint32_t i = 0; i <= segments; ++i)
-    {
-        float angle = 2.0f * M_PI * i / segments;
-        float x = radius * std::cos(angle);
-        float z = radius * std::sin(angle);
-        
-        posData.insert(posData.end(), {x, 0, z});
-        uvData.insert(uvData.end(), {(float)i / segments, 0});
-    }
-
-    // Create the top circle
-    for (uint32_t i = 0; i <= segments; ++i)
-    {
-        float angle = 2.0f * M_PI * i / segments;
-        float x = radius * std::cos(angle);
-        float z = radius * std::sin(angle);
-        
-        posData.insert(posData.end(), {x, height, z});
-        uvData.insert(uvData.end(), {(float)i / segments, 1});
-    }
-
-    // Create the bottom triangles
-    for (uint32_t i = 0; i < segments; ++i)
-    {
-        indexData.insert(indexData.end(), {0, i + 1, i + 2});
-    }
-
-    // Create the top triangles
-    uint32_t topStart = segments + 1;
-    for (uint32_t i = 0; i < segments; ++i)
-    {
-        indexData.insert(indexData.end(), {topStart, topStart + i + 1, topStart + i + 2});
-    }
-
-    // Create the side triangles
-    for (uint32_t i = 0; i < segments; ++i)
-    {
-        uint32_t bottomLeft = i + 1;
-        uint32_t bottomRight = i + 2;
-        uint32_t topLeft = topStart + i + 1;
-        uint32_t topRight = topStart + i + 2;
-
-        indexData.insert(indexData.end(), {bottomLeft, topLeft, bottomRight});
-        indexData.insert(indexData.end(), {bottomRight, topLeft, topRight});
-    }
-    createGLObjects();
-}
-
-
-void GLMeshData::createTrapezoid(float baseWidth, float topWidth, float height, float depth)
-{
-    numPrimitives = 12;  // 6 faces, 2 triangles each
-
-    float baseHalfWidth = baseWidth / 2.0f;
-    float topHalfWidth = topWidth / 2.0f;
-    float halfDepth = depth / 2.0f;
-
-    // Bottom face
-    posData.insert(posData.end(), {-baseHalfWidth, 0, -halfDepth});
-    posData.insert(posData.end(), { baseHalfWidth, 0, -halfDepth});
-    posData.insert(posData.end(), { baseHalfWidth, 0,  halfDepth});
-    posData.insert(posData.end(), {-baseHalfWidth, 0,  halfDepth});
-
-    // Top face
-    posData.insert(posData.end(), {-topHalfWidth, height, -halfDepth});
-    posData.insert(posData.end(), { topHalfWidth, height, -halfDepth});
-    posData.insert(posData.end(), { topHalfWidth, height,  halfDepth});
-    posData.insert(posData.end(), {-topHalfWidth, height,  halfDepth});
-
-    // UV coordinates (simplified)
-    for (int i = 0; i < 8; ++i)
-    {
-        uvData.insert(uvData.end(), {(i % 2) * 1.0f, (i / 2) % 2 * 1.0f});
-    }
-
-    // Indices for all faces
-    std::vector<uint32_t> faceIndices = {
-        0, 1, 2, 2, 3, 0,  // Bottom
-        4, 5, 6, 6, 7, 4,  // Top
-        0, 4, 7, 7, 3, 0,  // Left
-        1, 5, 6, 6, 2, 1,  // Right
-        0, 1, 5, 5, 4, 0,  // Front
-        3, 2, 6, 6, 7, 3   // Back
-    };
-
-    indexData.insert(indexData.end(), faceIndices.begin(), faceIndices.end());
-
-    createGLObjects();
-}
-
-
-void GLMeshData::createCircle(float radius, uint32_t segments)
-{
-    numPrimitives = segments;
-
-    // Center vertex
-    posData.insert(posData.end(), {0.0f, 0.0f, 0.0f});
-    uvData.insert(uvData.end(), {0.5f, 0.5f});
-
-    // Create the circle vertices
-    for (uint32_t i = 0; i <= segments; ++i)
-    {
-        float angle = 2.0f * M_PI * i / segments;
-        float x = radius * std::cos(angle);
-        float y = radius * std::sin(angle);
-        
-        posData.insert(posData.end(), {x, y, 0.0f});
-        
-        // UV coordinates
-        float u = (std::cos(angle) + 1.0f) * 0.5f;
-        float v = (std::sin(angle) + 1.0f) * 0.5f;
-        uvData.insert(uvData.end(), {u, v});
-    }
-
-    // Create the triangles
-    for (uint32_t i = 1; i <= segments; ++i)
-    {
-        indexData.insert(indexData.end(), {0, i, i + 1});
-    }
-
-    createGLObjects();
-}
-
-void GLMeshData::createQuad()
-{
-#if  0
-    numPrimitives = 2;
-
-    // Vertices
-    posData = {
-        0.0f,  0.0f, 0,
-        1.0f,  0.0f, 0,
-        1.0f,  1.0f, 0,
-        0.0f,  1.0f, 0,
-    };
-
-    // UV coordinates
-    uvData = {
-        0.0f, 0.0f,
-        1.0f, 0.0f,
-        1.0f, 1.0f,
-        0.0f, 1.0f
-    };
-
-    // Indices
-    indexData = {
-        0, 1, 2,
-        2, 3, 0
-    };
-
-    createGLObjects();
-
-#else
-    float quadVertices[] = {
-        // positions   // texture coords
-         0.0f,  1.0f,  0.0f, 1.0f,
-         1.0f,  1.0f,  1.0f, 1.0f,
-         0.0f,  0.0f,  0.0f, 0.0f,
-         1.0f,  0.0f,  1.0f, 0.0f
-    };
-
-    glGenVertexArrays(1, &meshVAID);
-    glGenBuffers(1, &meshVBID_pos);
-    glBindVertexArray(meshVAID);
-    glBindBuffer(GL_ARRAY_BUFFER, meshVBID_pos);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-
-#endif  //0
-}
-
-void GLMeshData::createGLObjects()
-{
-	// create vertex buffer objects for pos, uv
-	glGenBuffers(1, &meshVBID_pos);
-	glBindBuffer(GL_ARRAY_BUFFER, meshVBID_pos);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * posData.size(), posData.data(), GL_STATIC_DRAW);
-	CHECK_GL;
-
-	glGenBuffers(1, &meshVBID_uv);
-	glBindBuffer(GL_ARRAY_BUFFER, meshVBID_uv);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * uvData.size(), uvData.data(), GL_STATIC_DRAW);
-	CHECK_GL;
-
-	// create index buffer object
-	glGenBuffers(1, &meshIBID);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshIBID);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indexData.size(), indexData.data(), GL_STATIC_DRAW);
-	CHECK_GL;
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	CHECK_GL;
-
-	// create vertex array
-	glGenVertexArrays(1, &meshVAID);
-	glBindVertexArray(meshVAID);
-	CHECK_GL;
-
-	GLuint loc_pos = 0;
-	GLuint los_uv = 1;
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshIBID);
-
-	glBindBuffer(GL_ARRAY_BUFFER, meshVBID_pos);
-	glVertexAttribPointer(loc_pos, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-	glBindBuffer(GL_ARRAY_BUFFER, meshVBID_uv);
-	glVertexAttribPointer(los_uv, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
-	CHECK_GL;
-
-	glEnableVertexAttribArray(loc_pos);
-	glEnableVertexAttribArray(los_uv);
-	CHECK_GL;
-
-	glBindVertexArray(0);
-
-	// glDisableVertexAttribArray(loc_pos);
-	// glDisableVertexAttribArray(los_uv);
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	CHECK_GL;
-}
-
-void GLMeshData::render()
-{
-	glBindVertexArray(meshVAID);
-	CHECK_GL;
-
-	glDrawElements(primitiveType, 3 * numPrimitives, GL_UNSIGNED_INT, (void*)0);
-	CHECK_GL;
-
-	glBindVertexArray(0);
-	CHECK_GL;
-}
-
-void GLMeshData::renderQuad()
-{
-	glBindVertexArray(meshVAID);
-	CHECK_GL;
-
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	CHECK_GL;
-
-	glBindVertexArray(0);
-	CHECK_GL;
-}
+#include "TextureCache.cpp"
+#include "TextureArray.cpp"
+#include "SpriteBatch.cpp"
+#include "GLMeshData.cpp"
+#include "MeshLOD.cpp"
 
 
 int g_width  = 2560/2;
@@ -569,8 +35,8 @@ int g_height = 1440/2;
 GLuint texture_crate   = -1;
 GLuint texture_checker = -1;
 
-const int num_ball_textures = 15;
-GLuint    texIds[num_ball_textures]; // 15 ball
+const int num_ball_textures = 15; // one layer each of a texture array
+const int num_balls         = 15; // the rack, ball i is layer i % num_ball_textures
 
 // camera transformation attributes
 glm::mat4 g_view_matrix;
@@ -604,6 +70,7 @@ out vec2 UV;
 
 // Values that stay constant for the whole mesh.
 uniform mat4 MVP;
+uniform vec4 uvDecode; // xy scale, zw bias, see GLMeshData::uvDecode()
 
 void main(){
 
@@ -611,7 +78,7 @@ void main(){
 	gl_Position =  MVP * vec4(vertexPosition_modelspace,1);
 	
 	// UV of the vertex. No special space for this one.
-	UV = vertexUV;
+	UV = vertexUV * uvDecode.xy + uvDecode.zw;
 }
 
 
@@ -640,6 +107,50 @@ void main(){
 
 )FRAGMENT";
 
+// Vertex shader, instanced with a texture array layer per instance
+// (shaders/TransformVertexShaderInstanced.vertexshader)
+const char* ballVertexShaderSource = R"VERTEX(
+
+#version 330 core
+
+layout(location = 0) in vec3 vertexPosition_modelspace;
+layout(location = 1) in vec2 vertexUV;
+layout(location = 3) in mat4 instanceModel;
+layout(location = 7) in float instanceLayer;
+
+out vec2 UV;
+flat out float Layer;
+
+uniform mat4 VP;
+uniform mat4 positionDecode;
+uniform vec4 uvDecode;
+
+void main(){
+	gl_Position =  VP * instanceModel * positionDecode * vec4(vertexPosition_modelspace,1);
+	UV = vertexUV * uvDecode.xy + uvDecode.zw;
+	Layer = instanceLayer;
+}
+
+)VERTEX";
+
+// Fragment shader, texture array (shaders/TextureArrayFragmentShader.fragmentshader)
+const char* ballFragmentShaderSource = R"FRAGMENT(
+
+#version 330 core
+
+in vec2 UV;
+flat in float Layer;
+
+out vec4 color;
+
+uniform sampler2DArray myTextureSampler;
+
+void main(){
+	color = texture( myTextureSampler, vec3(UV, Layer) );
+}
+
+)FRAGMENT";
+
 
 
 GLFWwindow* window;
@@ -764,14 +275,11 @@ GLuint MatrixID;
 
 glm::mat4 OrthoProjection = glm::ortho(0.0f, (float)g_width, (float)g_height, 0.0f, -1.0f, 1.0f);
 
-glm::mat4 GetQuadMatrix(float x, float y, float width, float height)
+// x, y, width, height of a 2D quad in pixels
+struct QuadRect
 {
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(x, y, 0.0f));
-    model = glm::scale(model, glm::vec3(width, height, 1.0f));
-
-    return OrthoProjection*model;
-}
+    float x, y, width, height;
+};
 
 
 int main(void)
@@ -779,6 +287,9 @@ int main(void)
 	GLuint vertex_buffer, vertex_shader, fragment_shader, program;
 	GLint mvp_location, vpos_location, vcol_location;
  
+	// res/ and shaders/ from one mapped file when the pack is built (AssetPackBuild.cpp)
+	mount_asset_pack("../res/resources.qpak");
+
 	glfwSetErrorCallback(error_callback);
  
 	if (!glfwInit())
@@ -813,29 +324,110 @@ int main(void)
     glDepthFunc(GL_LESS);
 
     uint32_t programID = create_shader_program(vertexShaderSource, fragmentShaderSource);
+    uint32_t ballProgramID = create_shader_program(ballVertexShaderSource, ballFragmentShaderSource);
 
     //glEnable(GL_CULL_FACE);
     //glFrontFace(GL_CW);
 
+    // all 3D meshes share one VAO/VBO/IBO, declared first so it outlives them
+    GeometryPool geometryPool(VertexLayout::InterleavedSnorm16, 1 << 18, 1 << 22);
+
     GLMeshData myPlane;
+    myPlane.setGeometryPool(&geometryPool);
     myPlane.createPlane(0.0f, 128.0f, 2.0f);
 
     GLMeshData myBox;
+    myBox.setGeometryPool(&geometryPool);
     myBox.createBox(4.0f, 4.0f, 4.0f);
 
-    GLMeshData mySphere;
-    mySphere.createSphere(2.0f, 32, 32);
-    texture_crate   = UploadImage("../res/textures/PresentA_ALB.png");
-    texture_checker = UploadImage("../res/textures/NumGrid_ALB.png", true); 
+    GLMeshLODChain sphereLOD;
+    sphereLOD.setLevelSetup([&geometryPool](GLMeshData &level)
+    {
+        level.setGeometryPool(&geometryPool);
+        level.setOptimizeVertexCache(true);
+    });
+    sphereLOD.createSphere(2.0f, 64, 64);
+    // textures decode on the pool, show a grey placeholder until uploaded and stream in
+    // through PBOs at most 4 MB per frame. The pool also builds their mipmaps, filtered in
+    // linear light with alpha weighting for the UI images, instead of glGenerateMipmap.
+    ThreadPool loaderPool;
+    TextureStreamer textureStreamer(4 << 20);
+    TextureLoader textureLoader(loaderPool);
+    textureLoader.setStreamer(&textureStreamer);
+    MipOptions textureMips;
+    textureMips.premultiplyAlpha = true;
+    textureLoader.setCpuMipmaps(true, textureMips);
+
+    // one texture per file, held for the whole run
+    TextureCache textureCache(256 << 20, &textureLoader);
+    std::vector<TextureCache::Handle> textureHandles;
+    auto acquireTexture = [&](const char *path)
+    {
+        textureHandles.push_back(textureCache.acquire(path));
+        return textureHandles.back().id();
+    };
+
+    texture_crate   = acquireTexture("../res/textures/PresentA_ALB.png");
+    texture_checker = acquireTexture("../res/textures/NumGrid_ALB.png");
+
+    // the balls are all 1024x512: one array, one bind and one draw for the whole rack
+    // instead of a texture and a draw per ball. Their sizes come from the file headers, the
+    // pixels and mip chains from the pool like the textures above; the rack shows the grey
+    // placeholder until every layer has streamed in.
+    TextureArrays ballTextures;
+    ballTextures.setStreamer(&textureStreamer);
     {
+        std::vector<std::string> paths;
         for (int i = 0; i < num_ball_textures; ++i)
         {
             auto num = std::string(2 - std::to_string(i + 1).length(), '0') + std::to_string(i + 1);
-            std::string src = "../res/textures/pool/pool_" + num + ".ppm";
-            texIds[i] = UploadImage(src.c_str());
+            paths.push_back("../res/textures/pool/pool_" + num + ".ppm");
         }
+        ballTextures.loadAsync(paths, loaderPool);
     }
 
+    // a triangle rack on the plane, each ball's layer is its id % num_ball_textures, as a
+    // physics actor's would be. The balls are ordered by array so each array is one run of
+    // instances, one bind and one draw; the rack doesn't move, so it's uploaded once.
+    struct BallRun
+    {
+        int     array;
+        GLsizei first, count;
+    };
+    std::vector<glm::mat4> ballTransforms;
+    std::vector<GLfloat>   ballLayers;
+    std::vector<BallRun>   ballRuns;
+    glm::vec3 rack_pos = glm::vec3(0.0f);
+    {
+        std::vector<std::pair<int, glm::mat4>> rack;
+        for (int row = 0, id = 0; row < 5; ++row)
+        {
+            for (int i = 0; i <= row && id < num_balls; ++i, ++id)
+            {
+                glm::vec3 pos = glm::vec3(1.0f + row * 3.5f, 2.0f, (i - row * 0.5f) * 4.05f);
+                if (id == num_balls / 2)
+                    rack_pos = pos;
+                if (ballTextures.layer(id % num_ball_textures).array >= 0)
+                    rack.push_back(std::make_pair(id % num_ball_textures, glm::translate(glm::mat4(1.0f), pos)));
+            }
+        }
+        std::stable_sort(rack.begin(), rack.end(), [&](const std::pair<int, glm::mat4> &a, const std::pair<int, glm::mat4> &b)
+        {
+            return ballTextures.layer(a.first).array < ballTextures.layer(b.first).array;
+        });
+        for (const auto &ball : rack)
+        {
+            const TextureArrays::Layer &layer = ballTextures.layer(ball.first);
+            if (ballRuns.empty() || ballRuns.back().array != layer.array)
+                ballRuns.push_back({ layer.array, (GLsizei)ballTransforms.size(), 0 });
+            ballRuns.back().count++;
+            ballTransforms.push_back(ball.second);
+            ballLayers.push_back((GLfloat)layer.layer);
+        }
+    }
+    InstanceBuffer ballInstances;
+    ballInstances.upload(ballTransforms.data(), (GLsizei)ballTransforms.size(), ballLayers.data());
+
     // Create and compile our GLSL program from the shaders
     
 
@@ -845,38 +437,60 @@ int main(void)
     // Get a handle for our "myTextureSampler" uniform
     GLuint TextureID = glGetUniformLocation(programID, "myTextureSampler");
 
+    // Get a handle for our "uvDecode" uniform
+    GLuint UVDecodeID = glGetUniformLocation(programID, "uvDecode");
+
+    GLuint BallVPID        = glGetUniformLocation(ballProgramID, "VP");
+    GLuint BallPosDecodeID = glGetUniformLocation(ballProgramID, "positionDecode");
+    GLuint BallUVDecodeID  = glGetUniformLocation(ballProgramID, "uvDecode");
+    GLuint BallTextureID   = glGetUniformLocation(ballProgramID, "myTextureSampler");
+
 
     double lastFPStime  = glfwGetTime();
     int    frameCounter = 0;
 
 
     GLMeshData shape;
+    shape.setGeometryPool(&geometryPool);
+    shape.setOptimizeVertexCache(true);
     shape.createCylinder(3,6,32);
 
     GLMeshData circleMesh;
     circleMesh.createCircle(1.0f, 32);  // radius = 1.0, 32 segments
 
-    GLMeshData rectangleMesh;
-    rectangleMesh.createQuad();  // width = 2.0, height = 1.0
-
     // mat4x4_ortho(projection, 0.0f, (float)width, (float)height, 0.0f, -1.0f, 1.0f);
 
     // GLuint circleImg = UploadImage("../res/textures/red-circle.png");
     // GLuint circleImg = UploadImage("../res/textures/circle.png");
-    GLuint circleImg = UploadImage("../res/textures/shoot2.png");
-    GLuint rectImg = UploadImage("../res/textures/rect_round_corner2.png");
-    GLuint exclaimImg = UploadImage("../res/textures/Exclamation_Mark.png");
+    // the 2D overlay's images share one atlas page, drawn with one bind and one draw
+    TextureAtlas uiAtlas(2048, 4);
+    int circleImg = uiAtlas.add("../res/textures/shoot2.png");
+    int rectImg = uiAtlas.add("../res/textures/rect_round_corner2.png");
+    int exclaimImg = uiAtlas.add("../res/textures/Exclamation_Mark.png");
+    uiAtlas.build(&loaderPool);
+    SpriteBatch uiBatch;
+    uiBatch.init();
+    bool firstFrame = true, texturesLoaded = false;
+    size_t maxStreamedBytes = 0;
+    double streamStallMs = 0.0;
     
     float aspect = (float)g_height/(float)g_width;
     float w = g_width  * 0.01f * aspect;
     float h = g_height * 0.01f;
 
-    auto circleMat = GetQuadMatrix(g_width - 20.f*w , g_height - 20.*h, w*20.f,h*20.f);
-    auto rectMat = GetQuadMatrix(w*1.f,h*50.f, w*20.f,h*5.f);
-    auto exclaimMark = GetQuadMatrix(w*1.f,h*20.f, w*5.f,h*5.f);
+    QuadRect circleMat = { g_width - 20.f*w, g_height - 20.f*h, w*20.f, h*20.f };
+    QuadRect rectMat = { w*1.f, h*50.f, w*20.f, h*5.f };
+    QuadRect exclaimMark = { w*1.f, h*20.f, w*5.f, h*5.f };
 
     do
     {
+        textureLoader.update();
+        ballTextures.update();
+        textureStreamer.update();
+        textureCache.trim();
+        maxStreamedBytes = std::max(maxStreamedBytes, textureStreamer.frameStats().uploadBytes);
+        streamStallMs += textureStreamer.frameStats().fenceWaitMs + textureStreamer.frameStats().submitMs;
+
         double thisFPStime = glfwGetTime();
         frameCounter++;
 
@@ -906,41 +520,55 @@ int main(void)
         computeMatricesFromInputs();
 
 
+        geometryPool.bind();
+
         // render ground plane
         {
             glm::mat4 model_matrix = glm::mat4(1.0);
-            glm::mat4 mvp_mat      = g_proj_matrix * g_view_matrix * model_matrix;
+            glm::mat4 mvp_mat      = g_proj_matrix * g_view_matrix * model_matrix * myPlane.positionDecode();
 
             glActiveTexture(GL_TEXTURE0);
             glBindTexture(GL_TEXTURE_2D, texture_checker);
             glUniform1i(TextureID, 0);
 
+            glUniform4fv(UVDecodeID, 1, glm::value_ptr(myPlane.uvDecode()));
             glUniformMatrix4fv(MatrixID, 1, GL_FALSE, glm::value_ptr(mvp_mat));
             myPlane.render();
         }
         {
-            glm::mat4 model_matrix = glm::mat4(1.0);
-            model_matrix = glm::translate(model_matrix, glm::vec3(1,10,0));
-            glm::mat4 mvp_mat      = g_proj_matrix * g_view_matrix * model_matrix;
+            // the whole rack in one instanced draw per array, the LOD of its middle ball
+            uint32_t    lod        = sphereLOD.selectLOD(rack_pos, 1.0f, g_proj_matrix, g_cam_position, float(g_height));
+            GLMeshData &mySphere   = sphereLOD.level(lod);
+            glm::mat4   vp_mat     = g_proj_matrix * g_view_matrix;
 
+            glUseProgram(ballProgramID);
             glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, texIds[0]);
-            glUniform1i(TextureID, 0);
-
-            glUniformMatrix4fv(MatrixID, 1, GL_FALSE, glm::value_ptr(mvp_mat));
-            mySphere.render();
+            glUniform1i(BallTextureID, 0);
+
+            glUniformMatrix4fv(BallVPID, 1, GL_FALSE, glm::value_ptr(vp_mat));
+            glUniformMatrix4fv(BallPosDecodeID, 1, GL_FALSE, glm::value_ptr(mySphere.positionDecode()));
+            glUniform4fv(BallUVDecodeID, 1, glm::value_ptr(mySphere.uvDecode()));
+            for (const BallRun &run : ballRuns)
+            {
+                glBindTexture(GL_TEXTURE_2D_ARRAY, ballTextures.texture(run.array));
+                mySphere.renderInstanced(ballInstances.buffer(), run.count, sizeof(glm::mat4) * run.first, ballInstances.layerBuffer());
+            }
+
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+            glUseProgram(programID);
         }
         {
 
             glm::mat4 model_matrix = glm::mat4(1.0);
             model_matrix = glm::translate(model_matrix, glm::vec3(10,10,-100));
             model_matrix = glm::scale(model_matrix, glm::vec3(2,5,10));
-            glm::mat4 mvp_mat      = g_proj_matrix * g_view_matrix * model_matrix;
+            glm::mat4 mvp_mat      = g_proj_matrix * g_view_matrix * model_matrix * myBox.positionDecode();
 
             glActiveTexture(GL_TEXTURE0);
             glBindTexture(GL_TEXTURE_2D, texture_crate);
             glUniform1i(TextureID, 0);
 
+            glUniform4fv(UVDecodeID, 1, glm::value_ptr(myBox.uvDecode()));
             glUniformMatrix4fv(MatrixID, 1, GL_FALSE, glm::value_ptr(mvp_mat));
             myBox.render();
         }
@@ -948,46 +576,28 @@ int main(void)
             glm::mat4 model_matrix = glm::mat4(1.0);
             model_matrix = glm::translate(model_matrix, glm::vec3(10,10,0));
             // model_matrix = glm::scale(model_matrix, glm::vec3(2,5,10));
-            glm::mat4 mvp_mat      = g_proj_matrix * g_view_matrix * model_matrix;
+            glm::mat4 mvp_mat      = g_proj_matrix * g_view_matrix * model_matrix * shape.positionDecode();
 
             glActiveTexture(GL_TEXTURE0);
             glBindTexture(GL_TEXTURE_2D, texture_crate);
             glUniform1i(TextureID, 0);
 
+            glUniform4fv(UVDecodeID, 1, glm::value_ptr(shape.uvDecode()));
             glUniformMatrix4fv(MatrixID, 1, GL_FALSE, glm::value_ptr(mvp_mat));
             
             shape.render();           
         }
-        {
-            // 2D
-
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
 
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, circleImg);
-            glUniform1i(TextureID, 0);
-            glUniformMatrix4fv(MatrixID, 1, GL_FALSE, glm::value_ptr(circleMat));
-            rectangleMesh.renderQuad();
-            // myPlane.render();
+        geometryPool.unbind();
 
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, rectImg);
-            glUniform1i(TextureID, 0);
-            glUniformMatrix4fv(MatrixID, 1, GL_FALSE, glm::value_ptr(rectMat));
-            rectangleMesh.renderQuad();
-
-
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, exclaimImg);
-            glUniform1i(TextureID, 0);
-            glUniformMatrix4fv(MatrixID, 1, GL_FALSE, glm::value_ptr(exclaimMark));
-            rectangleMesh.renderQuad();
+        {
+            // 2D, all from the atlas page in one draw
 
-            
+            uiBatch.add(uiAtlas, circleImg, circleMat.x, circleMat.y, circleMat.width, circleMat.height);
+            uiBatch.add(uiAtlas, rectImg, rectMat.x, rectMat.y, rectMat.width, rectMat.height);
+            uiBatch.add(uiAtlas, exclaimImg, exclaimMark.x, exclaimMark.y, exclaimMark.width, exclaimMark.height);
 
-            glDisable(GL_BLEND);
+            uiBatch.flush(glm::value_ptr(OrthoProjection));
 
         }
 
@@ -995,6 +605,24 @@ int main(void)
         // Swap buffers
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        if (firstFrame)
+        {
+            // glfwGetTime counts from glfwInit
+            printf("time to first frame: %.1f ms\n", glfwGetTime() * 1000.0);
+            firstFrame = false;
+        }
+        if (!texturesLoaded && textureLoader.done() && ballTextures.ready() && textureStreamer.idle())
+        {
+            const TextureLoader::Stats &st = textureLoader.totals();
+            const TextureArrays::Stats &balls = ballTextures.stats();
+            printf("%u textures loaded %.1f ms after start on %d threads (%.1f ms decoding), streamed at most %.1f MB per frame, %.2f ms stalled\n",
+                   st.uploaded, glfwGetTime() * 1000.0, loaderPool.threadCount(), st.decodeMs, maxStreamedBytes / 1048576.0, streamStallMs);
+            printf("ball textures: %zu layers in %zu array(s), %.1f MB, %.1f ms decoding\n",
+                   balls.images - balls.failed, balls.arrays, balls.bytes / 1048576.0, balls.decodeMs);
+            printf("texture cache: %zu textures, %.1f MB resident\n", textureCache.stats().entries, textureCache.stats().bytesResident / 1048576.0);
+            texturesLoaded = true;
+        }
     } while (glfwWindowShouldClose(window) == 0);
  
     return 0;
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "AssetPack.cpp"
+#include "BCn.cpp"
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT3_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// DDS and KTX (version 1) files with BC1-BC5 payloads, as exported by texture tools, e.g.
+// res/textures/BathroomFloor_ALB.dds.
+//
+// The file is mapped, or found in a mounted asset pack (AssetPack.cpp), and every stored
+// mip level goes to glCompressedTexImage2D as it is.
+// BC4 / BC5 are RGTC, core since GL 3.0; BC1-BC3 need EXT_texture_compression_s3tc, and
+// without it the levels are decoded on the CPU (decode_bc_image) and uploaded as RGBA8.
+// Files without stored mips stay single level (compressed formats can't glGenerateMipmap
+// everywhere, and UploadImage's sampler doesn't use mips). Cube maps, arrays, volume textures,
+// BC6H / BC7 and uncompressed pixel formats are refused.
+//
+//   GLuint floor = UploadCompressedTexture("../res/textures/BathroomFloor_ALB.dds");
+//   (UploadImage does this for .dds and .ktx too)
+
+static const int kCompressedMaxMips = 16;
+
+struct CompressedMip
+{
+    const uint8_t *data;       // into the file's bytes
+    uint32_t size;
+    uint32_t width, height;
+};
+
+struct CompressedTexture
+{
+    AssetData file;
+    BcFormat format;
+    uint32_t width, height;
+    uint32_t mipCount;
+    CompressedMip mips[kCompressedMaxMips];
+};
+
+static GLenum compressed_gl_format(BcFormat format)
+{
+    switch (format)
+    {
+    case BcFormat::BC1: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    case BcFormat::BC2: return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+    case BcFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case BcFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+    default:            return GL_COMPRESSED_RG_RGTC2;
+    }
+}
+
+static uint32_t compressed_read32(const uint8_t *p)
+{
+    return (uint32_t)(p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24);
+}
+
+// fills the mip table from the levels stored back to back at offset, false when they don't fit
+static bool compressed_chain(CompressedTexture &texture, size_t offset, uint32_t levels)
+{
+    uint32_t w = texture.width, h = texture.height;
+    texture.mipCount = 0;
+    for (uint32_t mip = 0; mip < levels && mip < (uint32_t)kCompressedMaxMips; ++mip)
+    {
+        size_t size = bc_image_size(w, h, texture.format);
+        if (offset + size > texture.file.size())
+            return false;
+
+        texture.mips[mip] = { texture.file.data() + offset, (uint32_t)size, w, h };
+        texture.mipCount++;
+        offset += size;
+        if (w == 1 && h == 1)
+            break;
+        w = std::max(w / 2, 1u);
+        h = std::max(h / 2, 1u);
+    }
+    return texture.mipCount > 0;
+}
+
+static bool parse_dds(CompressedTexture &texture)
+{
+    // "DDS ", the 124 byte DDS_HEADER, optionally the 20 byte DDS_HEADER_DXT10
+    const uint8_t *bytes = texture.file.data();
+    size_t size = texture.file.size();
+    if (size < 128 || memcmp(bytes, "DDS ", 4) != 0 || compressed_read32(bytes + 4) != 124)
+        return false;
+
+    const uint32_t DDSD_MIPMAPCOUNT = 0x20000, DDPF_FOURCC = 0x4, DDSCAPS2_CUBEMAP = 0x200, DDSCAPS2_VOLUME = 0x200000;
+    uint32_t flags = compressed_read32(bytes + 8);
+    texture.height = compressed_read32(bytes + 12);
+    texture.width = compressed_read32(bytes + 16);
+    uint32_t mipCount = flags & DDSD_MIPMAPCOUNT ? std::max(compressed_read32(bytes + 28), 1u) : 1;
+    uint32_t pixelFlags = compressed_read32(bytes + 80);
+    const uint8_t *fourCC = bytes + 84;
+    uint32_t caps2 = compressed_read32(bytes + 112);
+    if (!(pixelFlags & DDPF_FOURCC) || caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME))
+        return false;
+
+    size_t offset = 128;
+    if (memcmp(fourCC, "DXT1", 4) == 0)
+        texture.format = BcFormat::BC1;
+    else if (memcmp(fourCC, "DXT2", 4) == 0 || memcmp(fourCC, "DXT3", 4) == 0)
+        texture.format = BcFormat::BC2;
+    else if (memcmp(fourCC, "DXT4", 4) == 0 || memcmp(fourCC, "DXT5", 4) == 0)
+        texture.format = BcFormat::BC3;
+    else if (memcmp(fourCC, "ATI1", 4) == 0 || memcmp(fourCC, "BC4U", 4) == 0)
+        texture.format = BcFormat::BC4;
+    else if (memcmp(fourCC, "ATI2", 4) == 0 || memcmp(fourCC, "BC5U", 4) == 0)
+        texture.format = BcFormat::BC5;
+    else if (memcmp(fourCC, "DX10", 4) == 0 && size >= 148)
+    {
+        // DXGI_FORMAT, D3D10_RESOURCE_DIMENSION_TEXTURE2D, array size
+        uint32_t dxgiFormat = compressed_read32(bytes + 128);
+        if (compressed_read32(bytes + 132) != 3 || compressed_read32(bytes + 140) > 1)
+            return false;
+        switch (dxgiFormat)
+        {
+        case 70: case 71: case 72: texture.format = BcFormat::BC1; break;
+        case 73: case 74: case 75: texture.format = BcFormat::BC2; break;
+        case 76: case 77: case 78: texture.format = BcFormat::BC3; break;
+        case 79: case 80:          texture.format = BcFormat::BC4; break;
+        case 82: case 83:          texture.format = BcFormat::BC5; break;
+        default: return false;
+        }
+        offset = 148;
+    }
+    else
+    {
+        return false;
+    }
+
+    return texture.width && texture.height && compressed_chain(texture, offset, mipCount);
+}
+
+static bool parse_ktx(CompressedTexture &texture)
+{
+    // 12 byte identifier, 13 uint32 fields, key / value data, then per level its size and data
+    static const uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+    const uint8_t *bytes = texture.file.data();
+    size_t size = texture.file.size();
+    if (size < 64 || memcmp(bytes, identifier, 12) != 0 || compressed_read32(bytes + 12) != 0x04030201)
+        return false;
+
+    uint32_t glType = compressed_read32(bytes + 16);
+    uint32_t internalFormat = compressed_read32(bytes + 28);
+    texture.width = compressed_read32(bytes + 36);
+    texture.height = compressed_read32(bytes + 40);
+    uint32_t depth = compressed_read32(bytes + 44), arrayElements = compressed_read32(bytes + 48);
+    uint32_t faces = compressed_read32(bytes + 52), levels = std::max(compressed_read32(bytes + 56), 1u);
+    uint32_t keyValueBytes = compressed_read32(bytes + 60);
+    if (glType != 0 || depth > 1 || arrayElements > 0 || faces != 1 || !texture.width || !texture.height)
+        return false;
+
+    switch (internalFormat)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: texture.format = BcFormat::BC1; break;
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT: texture.format = BcFormat::BC2; break;
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: texture.format = BcFormat::BC3; break;
+    case GL_COMPRESSED_RED_RGTC1:          texture.format = BcFormat::BC4; break;
+    case GL_COMPRESSED_RG_RGTC2:           texture.format = BcFormat::BC5; break;
+    default: return false;
+    }
+
+    // levels are size prefixed and 4 byte aligned rather than back to back
+    size_t offset = 64 + (size_t)keyValueBytes;
+    uint32_t w = texture.width, h = texture.height;
+    texture.mipCount = 0;
+    for (uint32_t mip = 0; mip < levels && mip < (uint32_t)kCompressedMaxMips; ++mip)
+    {
+        if (offset + 4 > size)
+            return false;
+        uint32_t levelSize = compressed_read32(bytes + offset);
+        offset += 4;
+        if (levelSize != bc_image_size(w, h, texture.format) || offset + levelSize > size)
+            return false;
+
+        texture.mips[mip] = { bytes + offset, levelSize, w, h };
+        texture.mipCount++;
+        offset = (offset + levelSize + 3) & ~(size_t)3;
+        w = std::max(w / 2, 1u);
+        h = std::max(h / 2, 1u);
+    }
+    return true;
+}
+
+static bool open_compressed_texture(const char *path, CompressedTexture &texture)
+{
+    texture.mipCount = 0;
+    if (!open_asset(path, texture.file))
+    {
+        fprintf(stderr, "Can't read compressed texture: %s\n", path);
+        return false;
+    }
+    if (!parse_dds(texture) && !parse_ktx(texture))
+    {
+        fprintf(stderr, "Not a BC1-BC5 DDS or KTX texture: %s\n", path);
+        texture.file.close();
+        return false;
+    }
+    return true;
+}
+
+// whether the context takes the format as it is, asked once per format
+static bool compressed_format_supported(BcFormat format)
+{
+    if (format == BcFormat::BC4 || format == BcFormat::BC5)
+        return true;
+
+    static int s3tc = -1;
+    if (s3tc < 0)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        s3tc = 0;
+        for (GLint i = 0; i < count && !s3tc; ++i)
+        {
+            const char *name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            s3tc = name && strcmp(name, "GL_EXT_texture_compression_s3tc") == 0;
+        }
+    }
+    return s3tc == 1;
+}
+
+// (re)specifies texture with the stored levels, sampler parameters are left alone;
+// decode true forces the CPU decoder
+static void upload_compressed_texture(GLuint texture, const CompressedTexture &compressed, bool decode = false)
+{
+    decode = decode || !compressed_format_supported(compressed.format);
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    std::vector<uint8_t> rgba;
+    for (uint32_t mip = 0; mip < compressed.mipCount; ++mip)
+    {
+        const CompressedMip &m = compressed.mips[mip];
+        if (decode)
+        {
+            rgba.resize((size_t)m.width * m.height * 4);
+            decode_bc_image(compressed.format, m.data, m.width, m.height, rgba.data());
+            glTexImage2D(GL_TEXTURE_2D, mip, GL_RGBA, m.width, m.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+        }
+        else
+        {
+            glCompressedTexImage2D(GL_TEXTURE_2D, mip, compressed_gl_format(compressed.format), m.width, m.height, 0, m.size, m.data);
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, compressed.mipCount - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// same sampler state as UploadImage, 0 when the file can't be used
+uint32_t UploadCompressedTexture(const char *path)
+{
+    CompressedTexture compressed;
+    if (!open_compressed_texture(path, compressed))
+        return 0;
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    upload_compressed_texture(texture, compressed);
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
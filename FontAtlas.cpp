@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <stdio.h>
+#include <vector>
+
+#define STB_TRUETYPE_IMPLEMENTATION
+#include <stb/stb_truetype.h>
+
+#include "AssetPack.cpp"
+
+// Font baked into one texture with stbtt_BakeFontBitmap, ASCII 32..126.
+// bake_font() is CPU only (so the text benchmarks can run without a context),
+// upload_font() creates the GL texture from the baked bitmap.
+typedef struct
+{
+    GLuint texture;
+    stbtt_bakedchar cdata[96]; // ASCII 32..126 is 95 glyphs
+    int w, h;
+    float pixel_height;
+    std::vector<unsigned char> bitmap; // single channel, w * h
+} FontAtlas;
+
+// a copy of the file, out of a mounted asset pack when one has it
+bool read_file(const char *filename, std::vector<unsigned char> &data)
+{
+    AssetData file;
+    if (!open_asset(filename, file))
+        return false;
+    data.assign(file.data(), file.data() + file.size());
+    return true;
+}
+
+bool bake_font(FontAtlas &font, const char *filename, float font_height, int atlas_size = 512)
+{
+    AssetData ttf_buffer;
+    if (!open_asset(filename, ttf_buffer))
+    {
+        fprintf(stderr, "Can't read font: %s\n", filename);
+        return false;
+    }
+
+    font.texture = 0;
+    font.w = atlas_size;
+    font.h = atlas_size;
+    font.pixel_height = font_height;
+    font.bitmap.assign((size_t)font.w * font.h, 0);
+
+    // returns the first unused row, or -(chars that fit) when the atlas is too small
+    int result = stbtt_BakeFontBitmap(ttf_buffer.data(), 0, font_height, font.bitmap.data(), font.w, font.h, 32, 96, font.cdata);
+    if (result <= 0)
+        fprintf(stderr, "Font atlas %dx%d too small for %s at %.1f px, %d glyphs fit\n", font.w, font.h, filename, font_height, -result);
+    return true;
+}
+
+void upload_font(FontAtlas &font)
+{
+    glGenTextures(1, &font.texture);
+    glBindTexture(GL_TEXTURE_2D, font.texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, font.w, font.h, 0, GL_RED, GL_UNSIGNED_BYTE, font.bitmap.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
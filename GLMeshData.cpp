@@ -0,0 +1,848 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#ifndef M_PI
+#define M_PI 3.141592653589793238462
+#endif
+
+#include "shader.cpp"
+
+#include "VertexLayout.h"
+#include "GeometryPool.cpp"
+#include "MeshBuilder.cpp"
+#include "MeshOptimizer.cpp"
+#include "Meshlets.cpp"
+#include "InstanceBuffer.cpp"
+
+// A run of indices drawn with one glDrawElementsBaseVertex. 16 bit index buffers
+// of meshes with more than 65536 vertices are split into batches whose indices
+// are relative to baseVertex.
+struct IndexBatch
+{
+	uint32_t firstIndex;
+	uint32_t count;
+	GLint    baseVertex;
+};
+
+// arguments for one glMultiDrawElementsBaseVertex
+struct MultiDrawCommands
+{
+	std::vector<GLsizei>      counts;
+	std::vector<const void *> offsets;
+	std::vector<GLint>        baseVertices;
+
+	size_t size() const { return counts.size(); }
+	void clear() { counts.clear(); offsets.clear(); baseVertices.clear(); }
+};
+
+class GLMeshData
+{
+public:
+	GLMeshData();
+	~GLMeshData();
+
+	// must be called before create*()
+	void setVertexLayout(VertexLayout layout) { vertexLayout = layout; }
+	// false keeps everything on the CPU (no GL calls), used by the headless benchmarks
+	void setUploadToGL(bool upload) { uploadToGL = upload; }
+	// sub-allocate from a shared pool instead of owning a VAO/VBO/IBO, the pool's
+	// layout replaces setVertexLayout(). Pooled meshes render with the pool bound.
+	void setGeometryPool(GeometryPool *pool) { geometryPool = pool; }
+	// reorder triangles for the post-transform cache (and overdraw), then vertices
+	// for fetch locality, before upload. Results land in optimizationReport().
+	void setOptimizeVertexCache(bool optimize) { optimizeVertexCache = optimize; }
+	// split into meshlets (after the cache optimization) for cluster culling, see Meshlets.cpp
+	void setBuildMeshlets(bool build) { buildMeshlets = build; }
+
+	void createBox(float w, float h, float l);
+	void createPlane(float base, float size, float uvScale = 1.0f);
+	void createSphere(float rad, uint32_t hSegs, uint32_t vSegs);
+    void createCone(float radius, float height, uint32_t segments);
+    void createCylinder(float radius, float height, uint32_t segments);
+    void createTrapezoid(float baseWidth, float topWidth, float height, float depth);
+    void createQuad();
+    void createCircle(float radius, uint32_t segments);
+
+	void render();
+	// draws only the given index ranges (from Meshlets::cullMeshlets) in one multi-draw
+	void renderRanges(const std::vector<Meshlets::DrawRange> &ranges);
+	// one draw for instanceCount copies, model matrices read from instanceBuffer at
+	// instanceOffset bytes (see InstanceBuffer.cpp), needs the instanced vertex shader.
+	// layerBuffer holds a texture array layer per instance, 0 for none.
+	void renderInstanced(GLuint instanceBuffer, GLsizei instanceCount, GLintptr instanceOffset = 0, GLuint layerBuffer = 0);
+	void renderInstanced(const InstanceBuffer &instances) { renderInstanced(instances.buffer(), instances.count(), 0, instances.layerBuffer()); }
+    void renderQuad();
+	void clear();
+
+	VertexLayout layout() const { return vertexLayout; }
+	unsigned int vertexCount() const { return numVertices; }
+	unsigned int vertexStride() const;
+	size_t vertexBufferBytes() const { return (size_t)vertexStride() * numVertices; }
+
+	// maps the quantized position/uv range back to object space / texture space
+	glm::mat4 positionDecode() const;
+	glm::vec4 uvDecode() const { return glm::vec4(uvScale, uvBias); }
+
+	const MeshOptimizer::Report &optimizationReport() const { return optReport; }
+
+	// GL_UNSIGNED_SHORT whenever the vertex count (or batching) allows it, else GL_UNSIGNED_INT
+	GLenum indexType() const { return drawIndexType; }
+	size_t indexBufferBytes() const;
+	const std::vector<IndexBatch> &batches() const { return indexBatches; }
+	const std::vector<GLuint> &indices() const { return indexData; }
+	const std::vector<GLushort> &indices16() const { return indexData16; }
+	const std::vector<GLfloat> &positions() const { return posData; }
+
+	const std::vector<Meshlets::Meshlet> &meshlets() const { return meshletData; }
+	// ranges split along the index batches, offsets in bytes into the bound index buffer
+	void multiDrawCommands(const std::vector<Meshlets::DrawRange> &ranges, MultiDrawCommands &out) const;
+
+protected:
+	MeshBuilder::Spans appendSpans(MeshBuilder::Counts counts);
+	void createGLObjects();
+	void optimizeMesh();
+	void packVertices();
+	void buildIndexBatches();
+
+	GLenum primitiveType;
+	unsigned int numVertices;
+	unsigned int numPrimitives;
+
+	GLuint meshVAID;
+	GLuint meshIBID;
+	GLuint meshVBID_pos;
+	GLuint meshVBID_uv;
+	
+	std::vector<GLuint> indexData;
+	std::vector<GLfloat> posData;
+	std::vector<GLfloat> uvData;
+
+	VertexLayout vertexLayout;
+	bool uploadToGL;
+
+	GeometryPool *geometryPool;
+	GeometryAllocation poolAllocation;
+
+	bool optimizeVertexCache;
+	MeshOptimizer::Report optReport;
+
+	bool buildMeshlets;
+	std::vector<Meshlets::Meshlet> meshletData;
+	MultiDrawCommands multiDraw;
+
+	GLenum drawIndexType;
+	std::vector<GLushort> indexData16;
+	std::vector<IndexBatch> indexBatches;
+
+	std::vector<PackedVertex> packedData;
+	glm::vec3 posScale, posBias;
+	glm::vec2 uvScale, uvBias;
+};
+
+
+GLMeshData::GLMeshData()
+{
+	meshVAID = meshVBID_pos = meshVBID_uv = meshIBID = 0;
+
+	numVertices = numPrimitives = 0;
+
+	primitiveType = GL_TRIANGLES;
+
+	vertexLayout = VertexLayout::SeparateFloat;
+	uploadToGL = true;
+
+	geometryPool = nullptr;
+
+	optimizeVertexCache = false;
+	optReport = MeshOptimizer::Report();
+
+	buildMeshlets = false;
+
+	drawIndexType = GL_UNSIGNED_INT;
+
+	posScale = glm::vec3(1.0f); posBias = glm::vec3(0.0f);
+	uvScale  = glm::vec2(1.0f); uvBias  = glm::vec2(0.0f);
+}
+
+GLMeshData::~GLMeshData()
+{
+	clear();
+}
+
+void GLMeshData::clear()
+{
+	if (geometryPool)
+		geometryPool->free(poolAllocation);
+
+	if (meshVBID_pos)
+	{
+		glDeleteBuffers(1, &meshVBID_pos);
+		meshVBID_pos = 0;
+	}
+
+	if (meshVBID_uv)
+	{
+		glDeleteBuffers(1, &meshVBID_uv);
+		meshVBID_uv = 0;
+	}
+
+	if (meshIBID)
+	{
+		glDeleteBuffers(1, &meshIBID);
+		meshIBID = 0;
+	}
+
+	if (meshVAID)
+	{
+		glDeleteVertexArrays(1, &meshVAID);
+		meshVAID = 0;
+	}
+}
+
+void GLMeshData::createPlane(float base, float size, float uvScale)
+{
+	numPrimitives = 2;
+
+	posData = {
+		-size,base,-size,
+		 size,base,-size,
+		 size,base, size,
+		-size,base, size,
+	};
+
+	uvData = {
+		0.0f*uvScale, 0.0f*uvScale,
+		1.0f*uvScale, 0.0f*uvScale,
+		1.0f*uvScale, 1.0f*uvScale,
+		0.0f*uvScale, 1.0f*uvScale,
+	};
+
+	indexData = {
+		0, 1, 2,
+		2, 3, 0
+	};
+
+	createGLObjects();
+}
+
+void GLMeshData::createBox(float w, float h, float l)
+{
+	numPrimitives = 6*2;
+
+	w *= 0.5f;
+	h *= 0.5f;
+	l *= 0.5f;
+
+	// bottom face
+	posData.insert(posData.end(), { w, -h,  l}); uvData.insert(uvData.end(), {0.0f, 0.0f});
+	posData.insert(posData.end(), {-w, -h,  l}); uvData.insert(uvData.end(), {1.0f, 0.0f});
+	posData.insert(posData.end(), {-w, -h, -l}); uvData.insert(uvData.end(), {1.0f, 1.0f});
+	posData.insert(posData.end(), { w, -h, -l}); uvData.insert(uvData.end(), {0.0f, 1.0f});
+
+	// top face
+	posData.insert(posData.end(), {-w,  h,  l}); uvData.insert(uvData.end(), {0.0f, 0.0f});
+	posData.insert(posData.end(), { w,  h,  l}); uvData.insert(uvData.end(), {1.0f, 0.0f});
+	posData.insert(posData.end(), { w,  h, -l}); uvData.insert(uvData.end(), {1.0f, 1.0f});
+	posData.insert(posData.end(), {-w,  h, -l}); uvData.insert(uvData.end(), {0.0f, 1.0f});
+
+	// left face
+	posData.insert(posData.end(), {-w, -h, -l}); uvData.insert(uvData.end(), {0.0f, 0.0f});
+	posData.insert(posData.end(), {-w, -h,  l}); uvData.insert(uvData.end(), {1.0f, 0.0f});
+	posData.insert(posData.end(), {-w,  h,  l}); uvData.insert(uvData.end(), {1.0f, 1.0f});
+	posData.insert(posData.end(), {-w,  h, -l}); uvData.insert(uvData.end(), {0.0f, 1.0f});
+
+	// right face
+	posData.insert(posData.end(), { w, -h,  l}); uvData.insert(uvData.end(), {0.0f, 0.0f});
+	posData.insert(posData.end(), { w, -h, -l}); uvData.insert(uvData.end(), {1.0f, 0.0f});
+	posData.insert(posData.end(), { w,  h, -l}); uvData.insert(uvData.end(), {1.0f, 1.0f});
+	posData.insert(posData.end(), { w,  h,  l}); uvData.insert(uvData.end(), {0.0f, 1.0f});
+
+	// front face
+	posData.insert(posData.end(), {-w, -h,  l}); uvData.insert(uvData.end(), {0.0f, 0.0f});
+	posData.insert(posData.end(), { w, -h,  l}); uvData.insert(uvData.end(), {1.0f, 0.0f});
+	posData.insert(posData.end(), { w,  h,  l}); uvData.insert(uvData.end(), {1.0f, 1.0f});
+	posData.insert(posData.end(), {-w,  h,  l}); uvData.insert(uvData.end(), {0.0f, 1.0f});
+
+	// back face
+	posData.insert(posData.end(), { w, -h, -l}); uvData.insert(uvData.end(), {0.0f, 0.0f});
+	posData.insert(posData.end(), {-w, -h, -l}); uvData.insert(uvData.end(), {1.0f, 0.0f});
+	posData.insert(posData.end(), {-w,  h, -l}); uvData.insert(uvData.end(), {1.0f, 1.0f});
+	posData.insert(posData.end(), { w,  h, -l}); uvData.insert(uvData.end(), {0.0f, 1.0f});
+
+	std::vector< unsigned int > tri00;
+	std::vector< unsigned int > tri01;
+	tri00.push_back(0); tri00.push_back(1); tri00.push_back(2);
+	tri01.push_back(0); tri01.push_back(2); tri01.push_back(3);
+
+	std::vector< unsigned int > tri02;
+	std::vector< unsigned int > tri03;
+	tri02.push_back(4); tri02.push_back(5); tri02.push_back(6);
+	tri03.push_back(4); tri03.push_back(6); tri03.push_back(7);
+
+	std::vector< unsigned int > tri04;
+	std::vector< unsigned int > tri05;
+	tri04.push_back(8); tri04.push_back(9); tri04.push_back(10);
+	tri05.push_back(8); tri05.push_back(10); tri05.push_back(11);
+
+	std::vector< unsigned int > tri06;
+	std::vector< unsigned int > tri07;
+	tri06.push_back(12); tri06.push_back(13); tri06.push_back(14);
+	tri07.push_back(12); tri07.push_back(14); tri07.push_back(15);
+
+	std::vector< unsigned int > tri08;
+	std::vector< unsigned int > tri09;
+	tri08.push_back(16); tri08.push_back(17); tri08.push_back(18);
+	tri09.push_back(16); tri09.push_back(18); tri09.push_back(19);
+
+	std::vector< unsigned int > tri10;
+	std::vector< unsigned int > tri11;
+	tri10.push_back(20); tri10.push_back(21); tri10.push_back(22);
+	tri11.push_back(20); tri11.push_back(22); tri11.push_back(23);
+
+	indexData.insert(indexData.end(), tri00.begin(), tri00.end());
+	indexData.insert(indexData.end(), tri01.begin(), tri01.end());
+	indexData.insert(indexData.end(), tri02.begin(), tri02.end());
+	indexData.insert(indexData.end(), tri03.begin(), tri03.end());
+	indexData.insert(indexData.end(), tri04.begin(), tri04.end());
+	indexData.insert(indexData.end(), tri05.begin(), tri05.end());
+	indexData.insert(indexData.end(), tri06.begin(), tri06.end());
+	indexData.insert(indexData.end(), tri07.begin(), tri07.end());
+	indexData.insert(indexData.end(), tri08.begin(), tri08.end());
+	indexData.insert(indexData.end(), tri09.begin(), tri09.end());
+	indexData.insert(indexData.end(), tri10.begin(), tri10.end());
+	indexData.insert(indexData.end(), tri11.begin(), tri11.end());
+
+	createGLObjects();
+}
+
+void GLMeshData::createSphere(float rad, uint32_t hSegs, uint32_t vSegs)
+{
+	numPrimitives = hSegs * vSegs * 2;
+
+	MeshBuilder::writeSphere(appendSpans(MeshBuilder::sphereCounts(hSegs, vSegs)), rad, hSegs, vSegs);
+
+	createGLObjects();
+}
+
+void GLMeshData::createCone(float radius, float height, uint32_t segments)
+{
+    numPrimitives = segments * 2;
+
+    MeshBuilder::writeCone(appendSpans(MeshBuilder::coneCounts(segments)), radius, height, segments);
+
+    createGLObjects();
+}
+
+void GLMeshData::createCylinder(float radius, float height, uint32_t segments)
+{
+    numPrimitives = segments * 4;
+
+    MeshBuilder::writeCylinder(appendSpans(MeshBuilder::cylinderCounts(segments)), radius, height, segments);
+
+    createGLObjects();
+}
+
+
+void GLMeshData::createTrapezoid(float baseWidth, float topWidth, float height, float depth)
+{
+    numPrimitives = 12;  // 6 faces, 2 triangles each
+
+    float baseHalfWidth = baseWidth / 2.0f;
+    float topHalfWidth = topWidth / 2.0f;
+    float halfDepth = depth / 2.0f;
+
+    // Bottom face
+    posData.insert(posData.end(), {-baseHalfWidth, 0, -halfDepth});
+    posData.insert(posData.end(), { baseHalfWidth, 0, -halfDepth});
+    posData.insert(posData.end(), { baseHalfWidth, 0,  halfDepth});
+    posData.insert(posData.end(), {-baseHalfWidth, 0,  halfDepth});
+
+    // Top face
+    posData.insert(posData.end(), {-topHalfWidth, height, -halfDepth});
+    posData.insert(posData.end(), { topHalfWidth, height, -halfDepth});
+    posData.insert(posData.end(), { topHalfWidth, height,  halfDepth});
+    posData.insert(posData.end(), {-topHalfWidth, height,  halfDepth});
+
+    // UV coordinates (simplified)
+    for (int i = 0; i < 8; ++i)
+    {
+        uvData.insert(uvData.end(), {(i % 2) * 1.0f, (i / 2) % 2 * 1.0f});
+    }
+
+    // Indices for all faces
+    std::vector<uint32_t> faceIndices = {
+        0, 1, 2, 2, 3, 0,  // Bottom
+        4, 5, 6, 6, 7, 4,  // Top
+        0, 4, 7, 7, 3, 0,  // Left
+        1, 5, 6, 6, 2, 1,  // Right
+        0, 1, 5, 5, 4, 0,  // Front
+        3, 2, 6, 6, 7, 3   // Back
+    };
+
+    indexData.insert(indexData.end(), faceIndices.begin(), faceIndices.end());
+
+    createGLObjects();
+}
+
+
+void GLMeshData::createCircle(float radius, uint32_t segments)
+{
+    numPrimitives = segments;
+
+    MeshBuilder::writeCircle(appendSpans(MeshBuilder::circleCounts(segments)), radius, segments);
+
+    createGLObjects();
+}
+
+void GLMeshData::createQuad()
+{
+#if  0
+    numPrimitives = 2;
+
+    // Vertices
+    posData = {
+        0.0f,  0.0f, 0,
+        1.0f,  0.0f, 0,
+        1.0f,  1.0f, 0,
+        0.0f,  1.0f, 0,
+    };
+
+    // UV coordinates
+    uvData = {
+        0.0f, 0.0f,
+        1.0f, 0.0f,
+        1.0f, 1.0f,
+        0.0f, 1.0f
+    };
+
+    // Indices
+    indexData = {
+        0, 1, 2,
+        2, 3, 0
+    };
+
+    createGLObjects();
+
+#else
+    float quadVertices[] = {
+        // positions   // texture coords
+         0.0f,  1.0f,  0.0f, 1.0f,
+         1.0f,  1.0f,  1.0f, 1.0f,
+         0.0f,  0.0f,  0.0f, 0.0f,
+         1.0f,  0.0f,  1.0f, 0.0f
+    };
+
+    glGenVertexArrays(1, &meshVAID);
+    glGenBuffers(1, &meshVBID_pos);
+    glBindVertexArray(meshVAID);
+    glBindBuffer(GL_ARRAY_BUFFER, meshVBID_pos);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+#endif  //0
+}
+
+// grows the CPU arrays by exactly counts and returns where the new data goes
+MeshBuilder::Spans GLMeshData::appendSpans(MeshBuilder::Counts counts)
+{
+	size_t posBase = posData.size();
+	size_t uvBase = uvData.size();
+	size_t indexBase = indexData.size();
+
+	posData.resize(posBase + (size_t)counts.vertices * 3);
+	uvData.resize(uvBase + (size_t)counts.vertices * 2);
+	indexData.resize(indexBase + counts.indices);
+
+	return { posData.data() + posBase, uvData.data() + uvBase, indexData.data() + indexBase };
+}
+
+unsigned int GLMeshData::vertexStride() const
+{
+	if (vertexLayout == VertexLayout::SeparateFloat)
+		return sizeof(GLfloat) * 5;
+
+	return sizeof(PackedVertex);
+}
+
+glm::mat4 GLMeshData::positionDecode() const
+{
+	glm::mat4 decode = glm::mat4(1.0f);
+	decode[0][0] = posScale.x;
+	decode[1][1] = posScale.y;
+	decode[2][2] = posScale.z;
+	decode[3]    = glm::vec4(posBias, 1.0f);
+	return decode;
+}
+
+void GLMeshData::packVertices()
+{
+	// per-mesh bounds, quantized positions land in [-1, 1] and uvs in [0, 1]
+	glm::vec3 pMin( 1e30f), pMax(-1e30f);
+	glm::vec2 tMin( 1e30f), tMax(-1e30f);
+
+	for (unsigned int i = 0; i < numVertices; ++i)
+	{
+		glm::vec3 p(posData[i * 3 + 0], posData[i * 3 + 1], posData[i * 3 + 2]);
+		glm::vec2 t(uvData[i * 2 + 0], uvData[i * 2 + 1]);
+		pMin = glm::min(pMin, p); pMax = glm::max(pMax, p);
+		tMin = glm::min(tMin, t); tMax = glm::max(tMax, t);
+	}
+
+	posBias  = (pMin + pMax) * 0.5f;
+	posScale = glm::max((pMax - pMin) * 0.5f, glm::vec3(1e-20f));
+	uvBias   = tMin;
+	uvScale  = glm::max(tMax - tMin, glm::vec2(1e-20f));
+
+	packedData.resize(numVertices);
+
+	for (unsigned int i = 0; i < numVertices; ++i)
+	{
+		glm::vec3 p(posData[i * 3 + 0], posData[i * 3 + 1], posData[i * 3 + 2]);
+		glm::vec2 t(uvData[i * 2 + 0], uvData[i * 2 + 1]);
+
+		glm::vec3 np = (p - posBias) / posScale;
+		glm::vec2 nt = (t - uvBias) / uvScale;
+
+		PackedVertex &v = packedData[i];
+		for (int c = 0; c < 3; ++c)
+		{
+			if (vertexLayout == VertexLayout::InterleavedHalf)
+				v.pos[c] = glm::packHalf1x16(np[c]);
+			else
+				v.pos[c] = (uint16_t)glm::packSnorm1x16(np[c]);
+		}
+		v.pos[3] = 0;
+		v.uv[0] = glm::packUnorm1x16(nt.x);
+		v.uv[1] = glm::packUnorm1x16(nt.y);
+	}
+}
+
+void GLMeshData::optimizeMesh()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	optReport.before = MeshOptimizer::analyzeVertexCache(indexData.data(), indexData.size(), numVertices);
+
+	MeshOptimizer::optimizeVertexCache(indexData.data(), indexData.size(), numVertices);
+	MeshOptimizer::optimizeOverdraw(indexData.data(), indexData.size(), posData.data(), numVertices);
+	MeshOptimizer::optimizeVertexFetch(indexData.data(), indexData.size(), posData, uvData);
+
+	optReport.after = MeshOptimizer::analyzeVertexCache(indexData.data(), indexData.size(), numVertices);
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	optReport.milliseconds = elapsed.count();
+}
+
+size_t GLMeshData::indexBufferBytes() const
+{
+	if (drawIndexType == GL_UNSIGNED_SHORT)
+		return sizeof(GLushort) * indexData16.size();
+
+	return sizeof(GLuint) * indexData.size();
+}
+
+void GLMeshData::buildIndexBatches()
+{
+	const uint32_t maxSpan = 0xffff; // vertices addressable from one base vertex
+
+	indexData16.clear();
+	indexBatches.clear();
+
+	if (numVertices <= maxSpan + 1)
+	{
+		drawIndexType = GL_UNSIGNED_SHORT;
+		indexData16.assign(indexData.begin(), indexData.end());
+		indexBatches.push_back({ 0, (uint32_t)indexData.size(), 0 });
+		return;
+	}
+
+	// greedy: grow the batch while every vertex of it stays within maxSpan of its lowest one
+	size_t triCount = indexData.size() / 3;
+	size_t batchStart = 0;
+	GLuint lo = 0xffffffffu, hi = 0;
+
+	for (size_t t = 0; t <= triCount; ++t)
+	{
+		GLuint triLo = 0xffffffffu, triHi = 0;
+		if (t < triCount)
+		{
+			const GLuint *tri = &indexData[t * 3];
+			triLo = std::min(tri[0], std::min(tri[1], tri[2]));
+			triHi = std::max(tri[0], std::max(tri[1], tri[2]));
+
+			if (triHi - triLo > maxSpan)
+			{
+				// a single triangle no base vertex can reach, stay 32 bit
+				drawIndexType = GL_UNSIGNED_INT;
+				indexBatches.assign(1, { 0, (uint32_t)indexData.size(), 0 });
+				return;
+			}
+		}
+
+		bool fits = t < triCount && std::max(hi, triHi) - std::min(lo, triLo) <= maxSpan;
+		if (!fits && t > batchStart)
+		{
+			indexBatches.push_back({ (uint32_t)(batchStart * 3), (uint32_t)((t - batchStart) * 3), (GLint)lo });
+			batchStart = t;
+			lo = 0xffffffffu;
+			hi = 0;
+		}
+		lo = std::min(lo, triLo);
+		hi = std::max(hi, triHi);
+	}
+
+	// scattered indices would need a draw call every few triangles, 32 bit is cheaper then
+	if (indexBatches.size() > std::max<size_t>(1, triCount / 256))
+	{
+		drawIndexType = GL_UNSIGNED_INT;
+		indexBatches.assign(1, { 0, (uint32_t)indexData.size(), 0 });
+		return;
+	}
+
+	drawIndexType = GL_UNSIGNED_SHORT;
+	indexData16.resize(indexData.size());
+	for (const IndexBatch &batch : indexBatches)
+		for (uint32_t i = batch.firstIndex; i < batch.firstIndex + batch.count; ++i)
+			indexData16[i] = (GLushort)(indexData[i] - batch.baseVertex);
+}
+
+void GLMeshData::createGLObjects()
+{
+	numVertices = (unsigned int)(posData.size() / 3);
+
+	if (optimizeVertexCache)
+		optimizeMesh();
+
+	if (buildMeshlets && primitiveType == GL_TRIANGLES)
+	{
+		meshletData = Meshlets::buildMeshlets(indexData.data(), indexData.size(), posData.data(), numVertices);
+		// clusters reordered the triangles, renumber for fetch locality again
+		MeshOptimizer::optimizeVertexFetch(indexData.data(), indexData.size(), posData, uvData);
+	}
+
+	if (geometryPool)
+		vertexLayout = geometryPool->layout();
+
+	if (vertexLayout != VertexLayout::SeparateFloat)
+		packVertices();
+
+	buildIndexBatches();
+
+	const void *indexSource = drawIndexType == GL_UNSIGNED_SHORT ? (const void*)indexData16.data() : (const void*)indexData.data();
+	GLuint indexSize = drawIndexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+
+	if (geometryPool)
+	{
+		GLuint indexBytes = (GLuint)indexBufferBytes();
+		if (!geometryPool->allocate(numVertices, indexBytes, indexSize, poolAllocation))
+		{
+			std::cerr << "GeometryPool: out of space for " << numVertices << " vertices / " << indexBytes << " index bytes" << std::endl;
+			return;
+		}
+
+		if (vertexLayout == VertexLayout::SeparateFloat)
+			geometryPool->uploadVertices(poolAllocation, posData.data(), uvData.data());
+		else
+			geometryPool->uploadVertices(poolAllocation, packedData.data(), nullptr);
+		geometryPool->uploadIndices(poolAllocation, indexSource);
+		return;
+	}
+
+	if (!uploadToGL)
+		return;
+
+	if (vertexLayout == VertexLayout::SeparateFloat)
+	{
+		// create vertex buffer objects for pos, uv
+		glGenBuffers(1, &meshVBID_pos);
+		glBindBuffer(GL_ARRAY_BUFFER, meshVBID_pos);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * posData.size(), posData.data(), GL_STATIC_DRAW);
+		CHECK_GL;
+
+		glGenBuffers(1, &meshVBID_uv);
+		glBindBuffer(GL_ARRAY_BUFFER, meshVBID_uv);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * uvData.size(), uvData.data(), GL_STATIC_DRAW);
+		CHECK_GL;
+	}
+	else
+	{
+		// one interleaved stream, pos and uv share meshVBID_pos
+		glGenBuffers(1, &meshVBID_pos);
+		glBindBuffer(GL_ARRAY_BUFFER, meshVBID_pos);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(PackedVertex) * packedData.size(), packedData.data(), GL_STATIC_DRAW);
+		CHECK_GL;
+	}
+
+	// create index buffer object
+	glGenBuffers(1, &meshIBID);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshIBID);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBufferBytes(), indexSource, GL_STATIC_DRAW);
+	CHECK_GL;
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	CHECK_GL;
+
+	// create vertex array
+	glGenVertexArrays(1, &meshVAID);
+	glBindVertexArray(meshVAID);
+	CHECK_GL;
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshIBID);
+
+	setVertexLayoutAttribs(vertexLayout, meshVBID_pos, meshVBID_uv);
+
+	glBindVertexArray(0);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	CHECK_GL;
+}
+
+void GLMeshData::render()
+{
+	GLuint indexSize = drawIndexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+
+	if (geometryPool)
+	{
+		// expects geometryPool->bind(), no per-mesh VAO switch
+		if (!poolAllocation.valid())
+			return;
+
+		for (const IndexBatch &batch : indexBatches)
+		{
+			uintptr_t offset = poolAllocation.indexOffset + (uintptr_t)batch.firstIndex * indexSize;
+			glDrawElementsBaseVertex(primitiveType, batch.count, drawIndexType, (void*)offset, poolAllocation.baseVertex + batch.baseVertex);
+		}
+		CHECK_GL;
+		return;
+	}
+
+	glBindVertexArray(meshVAID);
+	CHECK_GL;
+
+	for (const IndexBatch &batch : indexBatches)
+	{
+		uintptr_t offset = (uintptr_t)batch.firstIndex * indexSize;
+		if (batch.baseVertex)
+			glDrawElementsBaseVertex(primitiveType, batch.count, drawIndexType, (void*)offset, batch.baseVertex);
+		else
+			glDrawElements(primitiveType, batch.count, drawIndexType, (void*)offset);
+	}
+	CHECK_GL;
+
+	glBindVertexArray(0);
+	CHECK_GL;
+}
+
+void GLMeshData::renderInstanced(GLuint instanceBuffer, GLsizei instanceCount, GLintptr instanceOffset, GLuint layerBuffer)
+{
+	if (instanceCount <= 0 || (geometryPool && !poolAllocation.valid()))
+		return;
+
+	GLuint indexSize = drawIndexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+	uintptr_t indexBase = geometryPool ? poolAllocation.indexOffset : 0;
+	GLint vertexBase = geometryPool ? (GLint)poolAllocation.baseVertex : 0;
+
+	// pooled meshes expect geometryPool->bind(), the instance attributes go on whichever VAO is bound
+	if (!geometryPool)
+		glBindVertexArray(meshVAID);
+	setInstanceAttribs(instanceBuffer, instanceOffset, layerBuffer);
+
+	for (const IndexBatch &batch : indexBatches)
+	{
+		uintptr_t offset = indexBase + (uintptr_t)batch.firstIndex * indexSize;
+		glDrawElementsInstancedBaseVertex(primitiveType, batch.count, drawIndexType, (void*)offset, instanceCount, vertexBase + batch.baseVertex);
+	}
+	CHECK_GL;
+
+	clearInstanceAttribs();
+	if (!geometryPool)
+		glBindVertexArray(0);
+	CHECK_GL;
+}
+
+void GLMeshData::multiDrawCommands(const std::vector<Meshlets::DrawRange> &ranges, MultiDrawCommands &out) const
+{
+	GLuint indexSize = drawIndexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+	uintptr_t indexBase = geometryPool ? poolAllocation.indexOffset : 0;
+	GLint vertexBase = geometryPool ? (GLint)poolAllocation.baseVertex : 0;
+
+	out.clear();
+
+	// ranges and batches are both sorted by firstIndex
+	size_t b = 0;
+	for (const Meshlets::DrawRange &range : ranges)
+	{
+		uint32_t begin = range.firstIndex, end = range.firstIndex + range.count;
+		while (b < indexBatches.size() && indexBatches[b].firstIndex + indexBatches[b].count <= begin)
+			b++;
+
+		for (size_t i = b; i < indexBatches.size() && indexBatches[i].firstIndex < end; ++i)
+		{
+			const IndexBatch &batch = indexBatches[i];
+			uint32_t first = std::max(begin, batch.firstIndex);
+			uint32_t last  = std::min(end, batch.firstIndex + batch.count);
+
+			out.counts.push_back((GLsizei)(last - first));
+			out.offsets.push_back((const void*)(indexBase + (uintptr_t)first * indexSize));
+			out.baseVertices.push_back(vertexBase + batch.baseVertex);
+		}
+	}
+}
+
+void GLMeshData::renderRanges(const std::vector<Meshlets::DrawRange> &ranges)
+{
+	if (geometryPool && !poolAllocation.valid())
+		return;
+
+	multiDrawCommands(ranges, multiDraw);
+	if (multiDraw.size() == 0)
+		return;
+
+	// pooled meshes expect geometryPool->bind()
+	if (!geometryPool)
+	{
+		glBindVertexArray(meshVAID);
+		CHECK_GL;
+	}
+
+	glMultiDrawElementsBaseVertex(primitiveType, multiDraw.counts.data(), drawIndexType, multiDraw.offsets.data(),
+	                              (GLsizei)multiDraw.size(), multiDraw.baseVertices.data());
+	CHECK_GL;
+
+	if (!geometryPool)
+	{
+		glBindVertexArray(0);
+		CHECK_GL;
+	}
+}
+
+void GLMeshData::renderQuad()
+{
+	glBindVertexArray(meshVAID);
+	CHECK_GL;
+
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	CHECK_GL;
+
+	glBindVertexArray(0);
+	CHECK_GL;
+}
+
+
@@ -0,0 +1,659 @@
+// Headless CPU benchmarks for the procedural geometry in GLMeshData.cpp.
+// No window or GL context is created: meshes are built with setUploadToGL(false).
+
+#include "GLMeshData.cpp"
+#include "MeshLOD.cpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+struct Generator
+{
+    std::string name;
+    std::function<void(GLMeshData &)> build;
+};
+
+static const char *layoutName(VertexLayout layout)
+{
+    switch (layout)
+    {
+        case VertexLayout::SeparateFloat:      return "float";
+        case VertexLayout::InterleavedHalf:    return "half";
+        case VertexLayout::InterleavedSnorm16: return "snorm16";
+    }
+    return "?";
+}
+
+// bytes per vertex and build time of every generator in every vertex layout
+void benchVertexLayouts()
+{
+    const Generator generators[] = {
+        {"box",            [](GLMeshData &m) { m.createBox(4.0f, 4.0f, 4.0f); }},
+        {"plane",          [](GLMeshData &m) { m.createPlane(0.0f, 128.0f, 2.0f); }},
+        {"sphere 32x32",   [](GLMeshData &m) { m.createSphere(2.0f, 32, 32); }},
+        {"sphere 512x512", [](GLMeshData &m) { m.createSphere(2.0f, 512, 512); }},
+        {"cone 256",       [](GLMeshData &m) { m.createCone(3.0f, 6.0f, 256); }},
+        {"cylinder 32",    [](GLMeshData &m) { m.createCylinder(3.0f, 6.0f, 32); }},
+        {"cylinder 4096",  [](GLMeshData &m) { m.createCylinder(3.0f, 6.0f, 4096); }},
+        {"trapezoid",      [](GLMeshData &m) { m.createTrapezoid(4.0f, 2.0f, 3.0f, 2.0f); }},
+        {"circle 256",     [](GLMeshData &m) { m.createCircle(1.0f, 256); }},
+    };
+    const VertexLayout layouts[] = {
+        VertexLayout::SeparateFloat, VertexLayout::InterleavedHalf, VertexLayout::InterleavedSnorm16
+    };
+    const int iterations = 10;
+
+    printf("== vertex layouts ==\n");
+    printf("%-16s %-8s %10s %8s %12s %10s\n", "generator", "layout", "vertices", "B/vert", "vertex KB", "build ms");
+
+    for (const Generator &gen : generators)
+    {
+        for (VertexLayout layout : layouts)
+        {
+            unsigned int vertices = 0;
+            size_t       bytes    = 0;
+            unsigned int stride   = 0;
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < iterations; ++i)
+            {
+                GLMeshData mesh;
+                mesh.setUploadToGL(false);
+                mesh.setVertexLayout(layout);
+                gen.build(mesh);
+
+                vertices = mesh.vertexCount();
+                bytes    = mesh.vertexBufferBytes();
+                stride   = mesh.vertexStride();
+            }
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+            printf("%-16s %-8s %10u %8u %12.1f %10.3f\n", gen.name.c_str(), layoutName(layout), vertices, stride,
+                   bytes / 1024.0, elapsed.count() / iterations);
+        }
+    }
+    printf("\n");
+}
+
+static void printAllocatorStats(const char *label, const RangeAllocator::Stats &s)
+{
+    printf("%-22s used %6.1f%%  live %6u  free blocks %6u  largest free %9u  fragmentation %.3f  failed %llu\n", label,
+           100.0 * s.used / s.capacity, s.liveAllocations, s.freeBlocks, s.largestFree, s.fragmentation(),
+           (unsigned long long)s.failedAllocs);
+}
+
+// GeometryPool's RangeAllocator under a mesh-like alloc/free churn, plus a headless pool fill
+void benchGeometryPool()
+{
+    printf("== geometry pool ==\n");
+
+    const uint32_t capacity = 1u << 24;
+    RangeAllocator allocator(capacity);
+
+    std::mt19937 rng(1234);
+    // mostly small meshes (boxes, low-poly spheres) with the occasional big one
+    std::lognormal_distribution<double> sizeDist(7.0, 1.5);
+    auto randomSize = [&]() { return (uint32_t)std::min(sizeDist(rng) + 4.0, (double)(capacity / 64)); };
+
+    std::vector<uint32_t> live;
+
+    // fill to ~70%
+    auto start = std::chrono::high_resolution_clock::now();
+    while (allocator.usedUnits() < capacity / 10 * 7)
+    {
+        uint32_t offset = allocator.allocate(randomSize(), 4);
+        if (offset == RangeAllocator::InvalidOffset)
+            break;
+        live.push_back(offset);
+    }
+    std::chrono::duration<double, std::milli> fillTime = std::chrono::high_resolution_clock::now() - start;
+    printf("fill: %zu allocations in %.2f ms (%.2f Mops/s)\n", live.size(), fillTime.count(), live.size() / fillTime.count() / 1000.0);
+    printAllocatorStats("after fill", allocator.stats());
+
+    // steady state churn: free a random live block, allocate a new random size
+    const int churnOps = 200000;
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < churnOps; ++i)
+    {
+        size_t victim = rng() % live.size();
+        allocator.free(live[victim]);
+        live[victim] = live.back();
+        live.pop_back();
+
+        uint32_t offset = allocator.allocate(randomSize(), 4);
+        if (offset != RangeAllocator::InvalidOffset)
+            live.push_back(offset);
+    }
+    std::chrono::duration<double, std::milli> churnTime = std::chrono::high_resolution_clock::now() - start;
+    printf("churn: %d free+alloc pairs in %.2f ms (%.2f Mops/s)\n", churnOps, churnTime.count(), 2.0 * churnOps / churnTime.count() / 1000.0);
+    printAllocatorStats("after churn", allocator.stats());
+
+    for (uint32_t offset : live)
+        allocator.free(offset);
+    printAllocatorStats("after free all", allocator.stats());
+
+    // headless scene: many generated meshes sub-allocated from one pool
+    GeometryPool pool(VertexLayout::InterleavedSnorm16, 1 << 20, 1 << 24, false);
+    std::vector<GLMeshData> meshes(2000);
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+        meshes[i].setUploadToGL(false);
+        meshes[i].setGeometryPool(&pool);
+        switch (i % 4)
+        {
+            case 0: meshes[i].createBox(1.0f, 1.0f, 1.0f); break;
+            case 1: meshes[i].createSphere(1.0f, 8 + i % 24, 8 + i % 16); break;
+            case 2: meshes[i].createCylinder(1.0f, 2.0f, 8 + i % 32); break;
+            case 3: meshes[i].createCone(1.0f, 2.0f, 8 + i % 32); break;
+        }
+    }
+    for (size_t i = 0; i < meshes.size(); i += 3)
+        meshes[i].clear();
+    printAllocatorStats("pool vertices", pool.vertexRanges().stats());
+    printAllocatorStats("pool index bytes", pool.indexRanges().stats());
+    printf("\n");
+}
+
+// the insert()-based generators as they were before MeshBuilder, kept as the reference output
+struct ReferenceMesh
+{
+    std::vector<GLuint>  indexData;
+    std::vector<GLfloat> posData;
+    std::vector<GLfloat> uvData;
+};
+
+static void referenceSphere(ReferenceMesh &m, float rad, uint32_t hSegs, uint32_t vSegs)
+{
+    float dphi = (float)(2.0*M_PI) / (float)(hSegs);
+    float dtheta = (float)(M_PI) / (float)(vSegs);
+
+    for (uint32_t v = 0; v <= vSegs; ++v)
+    {
+        float theta = v * dtheta;
+
+        for (uint32_t h = 0; h <= hSegs; ++h)
+        {
+            float phi = h * dphi;
+
+            float x = std::sin(theta) * std::cos(phi);
+            float y = std::cos(theta);
+            float z = std::sin(theta) * std::sin(phi);
+
+            m.posData.insert(m.posData.end(), { rad * x, rad * y, rad * z });
+            m.uvData.insert(m.uvData.end(), { 1.0f - (float)h / hSegs, (float)v / vSegs });
+        }
+    }
+
+    for (uint32_t v = 0; v < vSegs; v++)
+    {
+        for (uint32_t h = 0; h < hSegs; h++)
+        {
+            uint32_t topRight = v * (hSegs + 1) + h;
+            uint32_t topLeft = v * (hSegs + 1) + h + 1;
+            uint32_t lowerRight = (v + 1) * (hSegs + 1) + h;
+            uint32_t lowerLeft = (v + 1) * (hSegs + 1) + h + 1;
+
+            std::vector< unsigned int > tri0;
+            std::vector< unsigned int > tri1;
+
+            tri0.push_back(lowerLeft);
+            tri0.push_back(lowerRight);
+            tri0.push_back(topRight);
+
+            tri1.push_back(lowerLeft);
+            tri1.push_back(topRight);
+            tri1.push_back(topLeft);
+
+            m.indexData.insert(m.indexData.end(), tri0.begin(), tri0.end());
+            m.indexData.insert(m.indexData.end(), tri1.begin(), tri1.end());
+        }
+    }
+}
+
+static void referenceCone(ReferenceMesh &m, float radius, float height, uint32_t segments)
+{
+    for (uint32_t i = 0; i <= segments; ++i)
+    {
+        float angle = 2.0f * M_PI * i / segments;
+        float x = radius * std::cos(angle);
+        float z = radius * std::sin(angle);
+
+        m.posData.insert(m.posData.end(), {x, 0, z});
+        m.uvData.insert(m.uvData.end(), {(float)i / segments, 0});
+    }
+
+    m.posData.insert(m.posData.end(), {0, height, 0});
+    m.uvData.insert(m.uvData.end(), {0.5f, 1.0f});
+
+    // base fan and side indices shifted down by one, like the cylinder's
+    for (uint32_t i = 0; i < segments; ++i)
+        m.indexData.insert(m.indexData.end(), {0, i, i + 1});
+
+    uint32_t apexIndex = segments + 1;
+    for (uint32_t i = 0; i < segments; ++i)
+        m.indexData.insert(m.indexData.end(), {i, apexIndex, i + 1});
+}
+
+static void referenceCylinder(ReferenceMesh &m, float radius, float height, uint32_t segments)
+{
+    for (uint32_t i = 0; i <= segments; ++i)
+    {
+        float angle = 2.0f * M_PI * i / segments;
+        float x = radius * std::cos(angle);
+        float z = radius * std::sin(angle);
+
+        m.posData.insert(m.posData.end(), {x, 0, z});
+        m.uvData.insert(m.uvData.end(), {(float)i / segments, 0});
+    }
+
+    for (uint32_t i = 0; i <= segments; ++i)
+    {
+        float angle = 2.0f * M_PI * i / segments;
+        float x = radius * std::cos(angle);
+        float z = radius * std::sin(angle);
+
+        m.posData.insert(m.posData.end(), {x, height, z});
+        m.uvData.insert(m.uvData.end(), {(float)i / segments, 1});
+    }
+
+    // cap and side indices shifted down by one, the original ones ran a vertex past the end
+    for (uint32_t i = 0; i < segments; ++i)
+        m.indexData.insert(m.indexData.end(), {0, i, i + 1});
+
+    uint32_t topStart = segments + 1;
+    for (uint32_t i = 0; i < segments; ++i)
+        m.indexData.insert(m.indexData.end(), {topStart, topStart + i, topStart + i + 1});
+
+    for (uint32_t i = 0; i < segments; ++i)
+    {
+        uint32_t bottomLeft = i;
+        uint32_t bottomRight = i + 1;
+        uint32_t topLeft = topStart + i;
+        uint32_t topRight = topStart + i + 1;
+
+        m.indexData.insert(m.indexData.end(), {bottomLeft, topLeft, bottomRight});
+        m.indexData.insert(m.indexData.end(), {bottomRight, topLeft, topRight});
+    }
+}
+
+static void referenceCircle(ReferenceMesh &m, float radius, uint32_t segments)
+{
+    m.posData.insert(m.posData.end(), {0.0f, 0.0f, 0.0f});
+    m.uvData.insert(m.uvData.end(), {0.5f, 0.5f});
+
+    for (uint32_t i = 0; i <= segments; ++i)
+    {
+        float angle = 2.0f * M_PI * i / segments;
+        float x = radius * std::cos(angle);
+        float y = radius * std::sin(angle);
+
+        m.posData.insert(m.posData.end(), {x, y, 0.0f});
+
+        float u = (std::cos(angle) + 1.0f) * 0.5f;
+        float v = (std::sin(angle) + 1.0f) * 0.5f;
+        m.uvData.insert(m.uvData.end(), {u, v});
+    }
+
+    for (uint32_t i = 1; i <= segments; ++i)
+        m.indexData.insert(m.indexData.end(), {0, i, i + 1});
+}
+
+template <typename T>
+static bool sameBits(const std::vector<T> &a, const std::vector<T> &b)
+{
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0;
+}
+
+// reference generator vs MeshBuilder at 1 and N threads, output must match bit for bit
+void benchMeshBuilder(uint32_t bigSphereSegs)
+{
+    typedef std::function<void(ReferenceMesh &)> ReferenceFn;
+    typedef std::function<MeshBuilder::Counts()> CountsFn;
+    typedef std::function<void(const MeshBuilder::Spans &, uint32_t)> WriteFn;
+
+    struct Case
+    {
+        std::string name;
+        ReferenceFn reference;
+        CountsFn    counts;
+        WriteFn     write;
+    };
+
+    auto sphereCase = [](uint32_t segs) {
+        return Case{"sphere " + std::to_string(segs) + "x" + std::to_string(segs),
+                    [=](ReferenceMesh &m) { referenceSphere(m, 2.0f, segs, segs); },
+                    [=]() { return MeshBuilder::sphereCounts(segs, segs); },
+                    [=](const MeshBuilder::Spans &out, uint32_t threads) { MeshBuilder::writeSphere(out, 2.0f, segs, segs, threads); }};
+    };
+
+    const Case cases[] = {
+        sphereCase(32),
+        sphereCase(512),
+        sphereCase(bigSphereSegs),
+        {"cone 65536",
+         [](ReferenceMesh &m) { referenceCone(m, 3.0f, 6.0f, 65536); },
+         []() { return MeshBuilder::coneCounts(65536); },
+         [](const MeshBuilder::Spans &out, uint32_t) { MeshBuilder::writeCone(out, 3.0f, 6.0f, 65536); }},
+        {"cylinder 65536",
+         [](ReferenceMesh &m) { referenceCylinder(m, 3.0f, 6.0f, 65536); },
+         []() { return MeshBuilder::cylinderCounts(65536); },
+         [](const MeshBuilder::Spans &out, uint32_t) { MeshBuilder::writeCylinder(out, 3.0f, 6.0f, 65536); }},
+        {"circle 65536",
+         [](ReferenceMesh &m) { referenceCircle(m, 1.0f, 65536); },
+         []() { return MeshBuilder::circleCounts(65536); },
+         [](const MeshBuilder::Spans &out, uint32_t) { MeshBuilder::writeCircle(out, 1.0f, 65536); }},
+    };
+
+    std::vector<uint32_t> threadCounts = { 1 };
+    for (uint32_t threads : { std::thread::hardware_concurrency(), 8u })
+        if (threads > threadCounts.back())
+            threadCounts.push_back(threads);
+
+    printf("== mesh builder ==\n");
+    printf("%-18s %12s %12s %8s %12s %s\n", "generator", "reference ms", "builder ms", "threads", "speedup", "identical");
+
+    for (const Case &c : cases)
+    {
+        ReferenceMesh reference;
+        auto start = std::chrono::high_resolution_clock::now();
+        c.reference(reference);
+        std::chrono::duration<double, std::milli> referenceTime = std::chrono::high_resolution_clock::now() - start;
+
+        for (uint32_t threads : threadCounts)
+        {
+            ReferenceMesh built;
+            start = std::chrono::high_resolution_clock::now();
+            MeshBuilder::Counts counts = c.counts();
+            built.posData.resize((size_t)counts.vertices * 3);
+            built.uvData.resize((size_t)counts.vertices * 2);
+            built.indexData.resize(counts.indices);
+            c.write({ built.posData.data(), built.uvData.data(), built.indexData.data() }, threads);
+            std::chrono::duration<double, std::milli> builderTime = std::chrono::high_resolution_clock::now() - start;
+
+            bool identical = sameBits(reference.posData, built.posData) && sameBits(reference.uvData, built.uvData) &&
+                             sameBits(reference.indexData, built.indexData);
+
+            printf("%-18s %12.2f %12.2f %8u %11.2fx %s\n", c.name.c_str(), referenceTime.count(), builderTime.count(), threads,
+                   referenceTime.count() / builderTime.count(), identical ? "yes" : "NO");
+        }
+    }
+    printf("\n");
+}
+
+// ACMR/ATVR of the generated index order vs the optimized one, plus optimizer cost
+void benchVertexCacheOptimizer()
+{
+    const Generator generators[] = {
+        {"box",             [](GLMeshData &m) { m.createBox(4.0f, 4.0f, 4.0f); }},
+        {"sphere 64x64",    [](GLMeshData &m) { m.createSphere(2.0f, 64, 64); }},
+        {"sphere 256x256",  [](GLMeshData &m) { m.createSphere(2.0f, 256, 256); }},
+        {"sphere 1024x1024",[](GLMeshData &m) { m.createSphere(2.0f, 1024, 1024); }},
+        {"cylinder 256",    [](GLMeshData &m) { m.createCylinder(3.0f, 6.0f, 256); }},
+        {"cylinder 16384",  [](GLMeshData &m) { m.createCylinder(3.0f, 6.0f, 16384); }},
+        {"cone 4096",       [](GLMeshData &m) { m.createCone(3.0f, 6.0f, 4096); }},
+    };
+
+    printf("== vertex cache optimizer (FIFO %u) ==\n", MeshOptimizer::kAnalyzeCacheSize);
+    printf("%-18s %10s %10s %10s %10s %12s\n", "generator", "ACMR in", "ACMR out", "ATVR in", "ATVR out", "optimize ms");
+
+    for (const Generator &gen : generators)
+    {
+        GLMeshData mesh;
+        mesh.setUploadToGL(false);
+        mesh.setOptimizeVertexCache(true);
+        gen.build(mesh);
+
+        const MeshOptimizer::Report &r = mesh.optimizationReport();
+        printf("%-18s %10.3f %10.3f %10.3f %10.3f %12.2f\n", gen.name.c_str(), r.before.acmr, r.after.acmr, r.before.atvr,
+               r.after.atvr, r.milliseconds);
+    }
+    printf("\n");
+}
+
+// 16 bit index selection: the batched uint16 buffer expanded with each batch's base
+// vertex must give back exactly the 32 bit index buffer
+void benchIndexBuffers()
+{
+    const Generator generators[] = {
+        {"box",                  [](GLMeshData &m) { m.createBox(4.0f, 4.0f, 4.0f); }},
+        {"circle 32",            [](GLMeshData &m) { m.createCircle(1.0f, 32); }},
+        {"sphere 32x32",         [](GLMeshData &m) { m.createSphere(2.0f, 32, 32); }},
+        {"sphere 255x255",       [](GLMeshData &m) { m.createSphere(2.0f, 255, 255); }},
+        {"sphere 256x256",       [](GLMeshData &m) { m.createSphere(2.0f, 256, 256); }},
+        {"sphere 1024x1024",     [](GLMeshData &m) { m.createSphere(2.0f, 1024, 1024); }},
+        {"sphere 512x512 opt",   [](GLMeshData &m) { m.setOptimizeVertexCache(true); m.createSphere(2.0f, 512, 512); }},
+        {"cylinder 65536",       [](GLMeshData &m) { m.createCylinder(3.0f, 6.0f, 65536); }},
+    };
+
+    printf("== index buffers ==\n");
+    printf("%-20s %10s %8s %8s %12s %12s %s\n", "generator", "vertices", "type", "batches", "32 bit KB", "chosen KB", "equivalent");
+
+    for (const Generator &gen : generators)
+    {
+        GLMeshData mesh;
+        mesh.setUploadToGL(false);
+        gen.build(mesh);
+
+        const std::vector<GLuint> &indices = mesh.indices();
+        bool equivalent = true;
+
+        if (mesh.indexType() == GL_UNSIGNED_SHORT)
+        {
+            const std::vector<GLushort> &indices16 = mesh.indices16();
+            size_t covered = 0;
+            equivalent = indices16.size() == indices.size();
+            for (const IndexBatch &batch : mesh.batches())
+            {
+                equivalent = equivalent && batch.firstIndex == covered;
+                for (uint32_t i = batch.firstIndex; equivalent && i < batch.firstIndex + batch.count; ++i)
+                    equivalent = (GLuint)indices16[i] + (GLuint)batch.baseVertex == indices[i];
+                covered += batch.count;
+            }
+            equivalent = equivalent && covered == indices.size();
+        }
+
+        printf("%-20s %10u %8s %8zu %12.1f %12.1f %s\n", gen.name.c_str(), mesh.vertexCount(),
+               mesh.indexType() == GL_UNSIGNED_SHORT ? "uint16" : "uint32", mesh.batches().size(),
+               sizeof(GLuint) * indices.size() / 1024.0, mesh.indexBufferBytes() / 1024.0, equivalent ? "yes" : "NO");
+    }
+    printf("\n");
+}
+
+void benchMeshLOD()
+{
+    printf("== LOD chains: 10k spheres (r=2, 64x64 at LOD 0) scattered in a 200 unit cube, 1280x720, fov 45 ==\n");
+
+    GLMeshLODChain sphereLOD;
+    sphereLOD.setLevelSetup([](GLMeshData &level) { level.setUploadToGL(false); });
+    sphereLOD.createSphere(2.0f, 64, 64);
+
+    for (uint32_t lod = 0; lod < sphereLOD.levelCount(); ++lod)
+        printf("  LOD %u: %6u triangles\n", lod, sphereLOD.triangleCount(lod));
+
+    const uint32_t numSpheres = 10000;
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> coord(-100.0f, 100.0f);
+    std::vector<glm::vec3> centers(numSpheres);
+    for (glm::vec3 &c : centers)
+        c = glm::vec3(coord(rng), coord(rng), coord(rng));
+
+    const float viewportHeight = 720.0f;
+    glm::mat4 proj = glm::perspective(0.25f * float(M_PI), 1280.0f / 720.0f, 0.25f, 4000.0f);
+
+    uint64_t fullTriangles = (uint64_t)numSpheres * sphereLOD.triangleCount(0);
+    printf("  %-10s %14s %14s %7s   spheres per LOD\n", "distance", "triangles", "no LOD", "ratio");
+
+    const float distances[] = { 0.0f, 100.0f, 250.0f, 500.0f, 1000.0f, 2000.0f };
+    for (float distance : distances)
+    {
+        // camera on the +z axis, distance from the cube's near face
+        glm::vec3 camPos(0.0f, 0.0f, 100.0f + distance);
+
+        std::vector<uint32_t> perLOD(sphereLOD.levelCount(), 0);
+        uint64_t triangles = 0;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const glm::vec3 &c : centers)
+        {
+            uint32_t lod = sphereLOD.selectLOD(c, 1.0f, proj, camPos, viewportHeight);
+            perLOD[lod]++;
+            triangles += sphereLOD.triangleCount(lod);
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        printf("  %-10.0f %14llu %14llu %6.1f%%  ", distance, (unsigned long long)triangles, (unsigned long long)fullTriangles,
+               100.0 * triangles / fullTriangles);
+        for (uint32_t count : perLOD)
+            printf(" %5u", count);
+        printf("   (select %.2f ms)\n", ms);
+    }
+    printf("\n");
+}
+
+// clusters must cover the mesh with valid bounds, culled ones must really be invisible,
+// and the multi-draw commands must expand back to exactly the visible clusters
+void benchMeshlets()
+{
+    const Generator generators[] = {
+        {"sphere 64x64",       [](GLMeshData &m) { m.createSphere(2.0f, 64, 64); }},
+        {"sphere 256x256 opt", [](GLMeshData &m) { m.setOptimizeVertexCache(true); m.createSphere(2.0f, 256, 256); }},
+        {"sphere 1024x1024",   [](GLMeshData &m) { m.createSphere(2.0f, 1024, 1024); }},
+        {"cylinder 4096",      [](GLMeshData &m) { m.createCylinder(3.0f, 6.0f, 4096); }},
+    };
+
+    printf("== meshlets (max %u triangles / %u vertices), camera orbiting at 3x radius, 16 frames ==\n",
+           Meshlets::kMaxTriangles, Meshlets::kMaxVertices);
+    printf("%-20s %9s %9s %9s %9s | %9s %9s %9s %9s %9s %9s %s\n", "generator", "meshlets", "avg tris", "< 64 tris", "build ms",
+           "frustum", "backface", "visible", "tris", "draws", "cull us", "valid");
+
+    for (const Generator &gen : generators)
+    {
+        GLMeshData mesh;
+        mesh.setUploadToGL(false);
+        mesh.setBuildMeshlets(true);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        gen.build(mesh);
+        double buildMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        const std::vector<Meshlets::Meshlet> &meshlets = mesh.meshlets();
+        const std::vector<GLuint> &indices = mesh.indices();
+
+        const std::vector<GLfloat> &pos = mesh.positions();
+
+        bool valid = true;
+        uint32_t covered = 0, small = 0;
+        for (const Meshlets::Meshlet &m : meshlets)
+        {
+            valid = valid && m.firstIndex == covered;
+            covered += m.triangleCount * 3;
+            small += m.triangleCount < 64;
+        }
+        valid = valid && covered == indices.size();
+
+        glm::vec3 target = meshlets.empty() ? glm::vec3(0.0f) : meshlets[0].center;
+        float meshRadius = 0.0f;
+        {
+            glm::vec3 lo(1e30f), hi(-1e30f);
+            for (const Meshlets::Meshlet &m : meshlets)
+            {
+                lo = glm::min(lo, m.center - m.radius);
+                hi = glm::max(hi, m.center + m.radius);
+            }
+            target = (lo + hi) * 0.5f;
+            meshRadius = glm::length(hi - lo) * 0.5f;
+        }
+
+        glm::mat4 proj = glm::perspective(0.25f * float(M_PI), 16.0f / 9.0f, 0.25f, 4000.0f);
+        glm::mat4 model(1.0f);
+
+        Meshlets::CullStats total = {};
+        double cullUs = 0.0;
+        const int frames = 16;
+        std::vector<Meshlets::DrawRange> ranges;
+        MultiDrawCommands commands;
+
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            float angle = 2.0f * float(M_PI) * frame / frames;
+            glm::vec3 camPos = target + 3.0f * meshRadius * glm::vec3(std::cos(angle), 0.3f, std::sin(angle));
+            // look off-center so part of the mesh leaves the frustum
+            glm::vec3 lookAt = target + glm::vec3(0.0f, meshRadius * 0.8f, 0.0f);
+            glm::mat4 viewProj = proj * glm::lookAt(camPos, lookAt, glm::vec3(0, 1, 0));
+            Meshlets::Frustum frustum = Meshlets::extractFrustum(viewProj);
+
+            ranges.clear();
+            auto cullStart = std::chrono::high_resolution_clock::now();
+            Meshlets::CullStats stats = Meshlets::cullMeshlets(meshlets, model, frustum, camPos, ranges);
+            mesh.multiDrawCommands(ranges, commands);
+            cullUs += std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - cullStart).count();
+            total.add(stats);
+
+            // every triangle of a backface culled cluster faces away
+            std::vector<char> drawn(meshlets.size(), 0);
+            for (const Meshlets::DrawRange &r : ranges)
+                for (size_t m = 0; m < meshlets.size(); ++m)
+                    if (meshlets[m].firstIndex >= r.firstIndex && meshlets[m].firstIndex < r.firstIndex + r.count)
+                        drawn[m] = 1;
+
+            uint32_t drawnTris = 0;
+            for (size_t m = 0; m < meshlets.size(); ++m)
+            {
+                const Meshlets::Meshlet &ml = meshlets[m];
+                if (drawn[m])
+                {
+                    drawnTris += ml.triangleCount;
+                    continue;
+                }
+                if (Meshlets::sphereOutside(frustum, ml.center, ml.radius))
+                    continue;
+
+                for (uint32_t t = ml.firstIndex / 3; valid && t < ml.firstIndex / 3 + ml.triangleCount; ++t)
+                {
+                    glm::vec3 p[3];
+                    for (int k = 0; k < 3; ++k)
+                        p[k] = glm::vec3(pos[indices[t * 3 + k] * 3], pos[indices[t * 3 + k] * 3 + 1], pos[indices[t * 3 + k] * 3 + 2]);
+                    glm::vec3 n = glm::cross(p[1] - p[0], p[2] - p[0]);
+                    // allow a little slack for nearly edge-on triangles
+                    valid = glm::dot(n, p[0] - camPos) >= -1e-3f * glm::length(n) * glm::length(p[0] - camPos);
+                }
+            }
+            valid = valid && drawnTris == stats.visibleTriangles;
+
+            // commands expand to exactly the drawn indices
+            uint32_t commandIndices = 0;
+            for (size_t c = 0; c < commands.size(); ++c)
+                commandIndices += commands.counts[c];
+            valid = valid && commandIndices == stats.visibleTriangles * 3;
+        }
+
+        printf("%-20s %9zu %9.1f %9u %9.2f | %9.1f %9.1f %9.1f %9.0f %9.1f %9.1f %s\n", gen.name.c_str(), meshlets.size(),
+               meshlets.empty() ? 0.0 : (double)indices.size() / 3 / meshlets.size(), small, buildMs,
+               (double)total.frustumCulled / frames, (double)total.backfaceCulled / frames, (double)total.visible / frames,
+               (double)total.visibleTriangles / frames, (double)total.ranges / frames, cullUs / frames, valid ? "yes" : "NO");
+    }
+    printf("  (culling columns are per-frame averages)\n\n");
+}
+
+int main(int argc, char **argv)
+{
+    // GeometryBench [big sphere segments], 4096 needs ~2GB for the reference + builder copies
+    uint32_t bigSphereSegs = argc > 1 ? (uint32_t)std::atoi(argv[1]) : 2048;
+
+    benchVertexLayouts();
+    benchGeometryPool();
+    benchMeshBuilder(bigSphereSegs);
+    benchVertexCacheOptimizer();
+    benchIndexBuffers();
+    benchMeshLOD();
+    benchMeshlets();
+    return 0;
+}
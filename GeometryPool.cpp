@@ -0,0 +1,366 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <stdint.h>
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <set>
+#include <utility>
+#include <unordered_map>
+
+#include "shader.cpp"
+#include "VertexLayout.h"
+
+// Sets the pos (location 0) and uv (location 1) attribute pointers for a layout
+// on the currently bound VAO. vbo_uv is only used by VertexLayout::SeparateFloat.
+static void setVertexLayoutAttribs(VertexLayout layout, GLuint vbo_pos, GLuint vbo_uv)
+{
+	GLuint loc_pos = 0;
+	GLuint los_uv = 1;
+
+	if (layout == VertexLayout::SeparateFloat)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, vbo_pos);
+		glVertexAttribPointer(loc_pos, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo_uv);
+		glVertexAttribPointer(los_uv, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	}
+	else
+	{
+		GLenum posType = layout == VertexLayout::InterleavedHalf ? GL_HALF_FLOAT : GL_SHORT;
+		GLboolean posNormalized = layout == VertexLayout::InterleavedHalf ? GL_FALSE : GL_TRUE;
+
+		glBindBuffer(GL_ARRAY_BUFFER, vbo_pos);
+		glVertexAttribPointer(loc_pos, 3, posType, posNormalized, sizeof(PackedVertex), (void*)offsetof(PackedVertex, pos));
+		glVertexAttribPointer(los_uv, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, uv));
+	}
+	CHECK_GL;
+
+	glEnableVertexAttribArray(loc_pos);
+	glEnableVertexAttribArray(los_uv);
+	CHECK_GL;
+}
+
+
+// Best-fit free-list allocator over the unit range [0, capacity).
+// Free blocks are indexed by offset (for coalescing with neighbours on free) and by
+// size (for O(log n) best-fit). Pure CPU bookkeeping, units are whatever the owner
+// decides (vertices, bytes, ...).
+class RangeAllocator
+{
+public:
+	static const uint32_t InvalidOffset = 0xffffffffu;
+
+	struct Stats
+	{
+		uint32_t capacity;
+		uint32_t used;
+		uint32_t freeBlocks;
+		uint32_t largestFree;
+		uint32_t liveAllocations;
+		uint64_t allocCalls;
+		uint64_t freeCalls;
+		uint64_t failedAllocs;
+
+		// 0 when all free space is one block, -> 1 as it splinters
+		float fragmentation() const
+		{
+			uint32_t freeUnits = capacity - used;
+			return freeUnits ? 1.0f - (float)largestFree / (float)freeUnits : 0.0f;
+		}
+	};
+
+	explicit RangeAllocator(uint32_t capacity = 0) { reset(capacity); }
+
+	void reset(uint32_t newCapacity)
+	{
+		capacity = newCapacity;
+		used = 0;
+		allocCalls = freeCalls = failedAllocs = 0;
+		freeByOffset.clear();
+		freeBySize.clear();
+		allocations.clear();
+		if (capacity)
+			insertFree(0, capacity);
+	}
+
+	// returns the aligned offset or InvalidOffset when no block fits
+	uint32_t allocate(uint32_t size, uint32_t alignment = 1)
+	{
+		++allocCalls;
+		if (size == 0)
+			size = 1;
+		// keeping sizes a multiple of the alignment stops padding from splintering the free list
+		size = (size + alignment - 1) / alignment * alignment;
+
+		// smallest block that fits size, alignment padding can push us to the next one
+		for (auto it = freeBySize.lower_bound(std::make_pair(size, 0u)); it != freeBySize.end(); ++it)
+		{
+			uint32_t blockSize   = it->first;
+			uint32_t blockOffset = it->second;
+			uint32_t aligned     = (blockOffset + alignment - 1) / alignment * alignment;
+			uint32_t padding     = aligned - blockOffset;
+
+			if (padding + size > blockSize)
+				continue;
+
+			freeBySize.erase(it);
+			freeByOffset.erase(blockOffset);
+			if (padding)
+				insertFree(blockOffset, padding);
+			if (padding + size < blockSize)
+				insertFree(aligned + size, blockSize - padding - size);
+
+			allocations[aligned] = size;
+			used += size;
+			return aligned;
+		}
+
+		++failedAllocs;
+		return InvalidOffset;
+	}
+
+	void free(uint32_t offset)
+	{
+		auto found = allocations.find(offset);
+		if (found == allocations.end())
+			return;
+
+		++freeCalls;
+		uint32_t size = found->second;
+		allocations.erase(found);
+		used -= size;
+
+		auto next = freeByOffset.lower_bound(offset);
+		if (next != freeByOffset.end() && offset + size == next->first)
+		{
+			size += next->second;
+			freeBySize.erase(std::make_pair(next->second, next->first));
+			next = freeByOffset.erase(next);
+		}
+		if (next != freeByOffset.begin())
+		{
+			auto prev = std::prev(next);
+			if (prev->first + prev->second == offset)
+			{
+				offset = prev->first;
+				size  += prev->second;
+				freeBySize.erase(std::make_pair(prev->second, prev->first));
+				freeByOffset.erase(prev);
+			}
+		}
+		insertFree(offset, size);
+	}
+
+	uint32_t usedUnits() const { return used; }
+
+	Stats stats() const
+	{
+		Stats s;
+		s.capacity        = capacity;
+		s.used            = used;
+		s.freeBlocks      = (uint32_t)freeByOffset.size();
+		s.largestFree     = freeBySize.empty() ? 0 : freeBySize.rbegin()->first;
+		s.liveAllocations = (uint32_t)allocations.size();
+		s.allocCalls      = allocCalls;
+		s.freeCalls       = freeCalls;
+		s.failedAllocs    = failedAllocs;
+		return s;
+	}
+
+private:
+	void insertFree(uint32_t offset, uint32_t size)
+	{
+		freeByOffset[offset] = size;
+		freeBySize.insert(std::make_pair(size, offset));
+	}
+
+	uint32_t capacity;
+	uint32_t used;
+	uint64_t allocCalls, freeCalls, failedAllocs;
+
+	std::map<uint32_t, uint32_t> freeByOffset;          // offset -> size
+	std::set<std::pair<uint32_t, uint32_t>> freeBySize; // (size, offset)
+	std::unordered_map<uint32_t, uint32_t> allocations; // offset -> size
+};
+
+
+struct GeometryAllocation
+{
+	uint32_t baseVertex  = RangeAllocator::InvalidOffset; // in vertices
+	uint32_t vertexCount = 0;
+	uint32_t indexOffset = RangeAllocator::InvalidOffset; // in bytes
+	uint32_t indexBytes  = 0;
+
+	bool valid() const { return baseVertex != RangeAllocator::InvalidOffset; }
+};
+
+// A few large VBOs/IBO shared by many GLMeshData of the same VertexLayout.
+// Meshes sub-allocate a vertex range (addressed with base vertex) and an index
+// byte range, so a whole scene draws with one bound VAO.
+class GeometryPool
+{
+public:
+	GeometryPool(VertexLayout layout, uint32_t maxVertices, uint32_t maxIndexBytes, bool uploadToGL = true);
+	~GeometryPool();
+
+	bool allocate(uint32_t vertexCount, uint32_t indexBytes, uint32_t indexAlignment, GeometryAllocation &out);
+	void free(GeometryAllocation &allocation);
+
+	// vertex data is in the pool's layout: float pos/uv streams or PackedVertex
+	void uploadVertices(const GeometryAllocation &allocation, const void *posOrPacked, const void *uv);
+	void uploadIndices(const GeometryAllocation &allocation, const void *indices);
+
+	void bind();
+	void unbind();
+
+	VertexLayout layout() const { return vertexLayout; }
+	const RangeAllocator &vertexRanges() const { return vertexAllocator; }
+	const RangeAllocator &indexRanges() const { return indexAllocator; }
+
+private:
+	VertexLayout vertexLayout;
+	bool uploadToGL;
+
+	RangeAllocator vertexAllocator;
+	RangeAllocator indexAllocator;
+
+	GLuint poolVAID;
+	GLuint poolIBID;
+	GLuint poolVBID_pos;
+	GLuint poolVBID_uv;
+};
+
+
+GeometryPool::GeometryPool(VertexLayout layout, uint32_t maxVertices, uint32_t maxIndexBytes, bool upload)
+	: vertexLayout(layout), uploadToGL(upload), vertexAllocator(maxVertices), indexAllocator(maxIndexBytes)
+{
+	poolVAID = poolIBID = poolVBID_pos = poolVBID_uv = 0;
+
+	if (!uploadToGL)
+		return;
+
+	if (vertexLayout == VertexLayout::SeparateFloat)
+	{
+		glGenBuffers(1, &poolVBID_pos);
+		glBindBuffer(GL_ARRAY_BUFFER, poolVBID_pos);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 3 * maxVertices, nullptr, GL_STATIC_DRAW);
+
+		glGenBuffers(1, &poolVBID_uv);
+		glBindBuffer(GL_ARRAY_BUFFER, poolVBID_uv);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 2 * maxVertices, nullptr, GL_STATIC_DRAW);
+	}
+	else
+	{
+		glGenBuffers(1, &poolVBID_pos);
+		glBindBuffer(GL_ARRAY_BUFFER, poolVBID_pos);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(PackedVertex) * maxVertices, nullptr, GL_STATIC_DRAW);
+	}
+	CHECK_GL;
+
+	glGenBuffers(1, &poolIBID);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, poolIBID);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, maxIndexBytes, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	CHECK_GL;
+
+	glGenVertexArrays(1, &poolVAID);
+	glBindVertexArray(poolVAID);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, poolIBID);
+	setVertexLayoutAttribs(vertexLayout, poolVBID_pos, poolVBID_uv);
+	glBindVertexArray(0);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	CHECK_GL;
+}
+
+GeometryPool::~GeometryPool()
+{
+	if (poolVBID_pos)
+		glDeleteBuffers(1, &poolVBID_pos);
+	if (poolVBID_uv)
+		glDeleteBuffers(1, &poolVBID_uv);
+	if (poolIBID)
+		glDeleteBuffers(1, &poolIBID);
+	if (poolVAID)
+		glDeleteVertexArrays(1, &poolVAID);
+}
+
+bool GeometryPool::allocate(uint32_t vertexCount, uint32_t indexBytes, uint32_t indexAlignment, GeometryAllocation &out)
+{
+	uint32_t baseVertex = vertexAllocator.allocate(vertexCount);
+	if (baseVertex == RangeAllocator::InvalidOffset)
+		return false;
+
+	uint32_t indexOffset = indexAllocator.allocate(indexBytes, indexAlignment);
+	if (indexOffset == RangeAllocator::InvalidOffset)
+	{
+		vertexAllocator.free(baseVertex);
+		return false;
+	}
+
+	out.baseVertex  = baseVertex;
+	out.vertexCount = vertexCount;
+	out.indexOffset = indexOffset;
+	out.indexBytes  = indexBytes;
+	return true;
+}
+
+void GeometryPool::free(GeometryAllocation &allocation)
+{
+	if (!allocation.valid())
+		return;
+
+	vertexAllocator.free(allocation.baseVertex);
+	indexAllocator.free(allocation.indexOffset);
+	allocation = GeometryAllocation();
+}
+
+void GeometryPool::uploadVertices(const GeometryAllocation &allocation, const void *posOrPacked, const void *uv)
+{
+	if (!uploadToGL)
+		return;
+
+	if (vertexLayout == VertexLayout::SeparateFloat)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, poolVBID_pos);
+		glBufferSubData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 3 * allocation.baseVertex, sizeof(GLfloat) * 3 * allocation.vertexCount, posOrPacked);
+		glBindBuffer(GL_ARRAY_BUFFER, poolVBID_uv);
+		glBufferSubData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 2 * allocation.baseVertex, sizeof(GLfloat) * 2 * allocation.vertexCount, uv);
+	}
+	else
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, poolVBID_pos);
+		glBufferSubData(GL_ARRAY_BUFFER, sizeof(PackedVertex) * allocation.baseVertex, sizeof(PackedVertex) * allocation.vertexCount, posOrPacked);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	CHECK_GL;
+}
+
+void GeometryPool::uploadIndices(const GeometryAllocation &allocation, const void *indices)
+{
+	if (!uploadToGL)
+		return;
+
+	// the pool VAO owns the element binding, don't disturb whatever VAO is bound
+	glBindVertexArray(0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, poolIBID);
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, allocation.indexOffset, allocation.indexBytes, indices);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	CHECK_GL;
+}
+
+void GeometryPool::bind()
+{
+	glBindVertexArray(poolVAID);
+	CHECK_GL;
+}
+
+void GeometryPool::unbind()
+{
+	glBindVertexArray(0);
+	CHECK_GL;
+}
@@ -0,0 +1,909 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "FontAtlas.cpp"
+#include "ThreadPool.cpp"
+
+// Glyph atlas filled on demand. Glyphs are rasterized with stbtt_MakeGlyphBitmap
+// the first time a (font, pixel size, codepoint) is asked for, so any codepoint the
+// font has and any size work without rebaking.
+//
+// Packing is shelf based: a shelf is a row band as high as the glyph that opened it
+// (rounded to 4 texels), glyphs go left to right, a freed glyph leaves a span that later
+// glyphs of the shelf can reuse. A shelf that runs empty merges with empty neighbours and
+// is split again by the next glyph, so bands of one size can go to another. When nothing
+// fits, the least recently used glyphs are evicted until something does. Glyphs used in
+// the current frame are never evicted, their quads may already be queued.
+//
+// The atlas bitmap lives on the CPU, upload() sends only the dirty part of each shelf.
+//
+// prefetch() rasterizes a whole glyph set on a ThreadPool, each thread with its own
+// stbtt_fontinfo. Packing stays on the calling thread in request order, so the atlas
+// comes out the same for any number of threads.
+//
+// In SDF mode (setSDF) every glyph is stored once as a signed distance field made with
+// stbtt_GetGlyphSDF at a base size, whatever size is asked for, and drawn scaled by
+// glyphScale() with a shader that thresholds the distance (TextBatch does both).
+//
+// Advances and kerning come from tables built by addFont(), so layout and measure() never
+// walk the font's kern or GPOS data: a dense matrix for ASCII pairs, and a hash of glyph
+// index pairs for the rest (filled from the kern table up front, or memoized per pair for
+// GPOS fonts, which stb_truetype can't enumerate).
+//
+//   int font = cache.addFont("../res/digital_7_mono.ttf");
+//   each frame: cache.beginFrame(); glyph(font, 20.0f, 'A') ...; cache.upload(); draw
+class GlyphCache
+{
+public:
+    struct Glyph
+    {
+        uint16_t x, y, w, h;      // atlas rect, w == 0 for glyphs without pixels
+        float s0, t0, s1, t1;
+        float xoff, yoff;         // pen to the top left of the bitmap, in pixels
+        float xadvance;
+        int glyphIndex;           // in the font, for kernAdvance()
+
+        uint64_t key;
+        uint32_t lastUsed;        // frame
+        int shelf;
+        std::list<Glyph*>::iterator lru;
+    };
+
+    struct FrameStats
+    {
+        uint32_t lookups;
+        uint32_t misses;          // glyphs rasterized
+        uint32_t evictions;
+        uint32_t failed;          // didn't fit even after evicting everything allowed
+        uint32_t uploadRects;
+        size_t   uploadBytes;
+    };
+
+    // padding is left free right of and below every glyph so linear filtering never
+    // picks up a neighbour
+    GlyphCache(int atlasSize = 1024, int padding = 1);
+    ~GlyphCache();
+
+    GlyphCache(const GlyphCache &) = delete;
+    GlyphCache &operator=(const GlyphCache &) = delete;
+
+    // returns the font id, -1 when the file can't be read or isn't a font
+    int addFont(const char *filename);
+
+    struct GlyphRequest
+    {
+        int font;
+        float pixelHeight;
+        uint32_t codepoint;
+    };
+
+    // puts every glyph of the set into the atlas, rasterizing on the pool when there is
+    // one. Returns how many glyphs were rasterized.
+    size_t prefetch(const GlyphRequest *requests, size_t count, ThreadPool *pool = nullptr);
+
+    // pixelHeight is rounded to whole pixels. Returns nullptr when the glyph doesn't
+    // fit the atlas this frame. The pointer stays valid until the next beginFrame().
+    const Glyph *glyph(int font, float pixelHeight, uint32_t codepoint);
+
+    bool hasKerning(int font) const { return fonts[font]->kerning; }
+    // font units to pixels of the glyphs cached for pixelHeight (before glyphScale())
+    float fontScale(int font, float pixelHeight) const { return fonts[font]->unitScale * pixelSize(pixelHeight); }
+    // kerning between two glyphs drawn one after the other, in font units
+    int kernAdvance(int font, const Glyph &left, const Glyph &right)
+    {
+        Font &f = *fonts[font];
+        if (!f.kerning)
+            return 0;
+        uint32_t l = (uint32_t)(left.key & 0xffffffff) - 32, r = (uint32_t)(right.key & 0xffffffff) - 32;
+        if (l < 96 && r < 96)
+            return f.asciiKern[l * 96 + r];
+        return sparseKern(f, left.glyphIndex, right.glyphIndex);
+    }
+    // advance width of a line at pixelHeight, kerned, without rasterizing anything
+    float measure(int font, float pixelHeight, const char *utf8, bool kerning = true);
+
+    // advances text past one code point, malformed sequences give U+FFFD
+    static uint32_t decodeUtf8(const unsigned char *&text);
+
+    // marks a glyph returned earlier as used this frame, for users that keep glyph
+    // pointers across frames (valid while evictionCount() hasn't changed)
+    void touch(const Glyph *glyph) { markUsed(const_cast<Glyph&>(*glyph)); }
+
+    // advances the LRU clock
+    void beginFrame();
+    uint32_t currentFrame() const { return frame; }
+    // glyphs evicted since construction
+    uint64_t evictionCount() const { return totalEvictions; }
+    // creates the texture on first use, afterwards uploads the dirty sub-rectangles
+    void upload();
+    // false: upload() only does the bookkeeping, for the benchmarks without a context
+    void setUploadToGL(bool upload) { uploadToGL = upload; }
+
+    // distance fields at baseSize pixels, spread texels of distance around the outline
+    // (128 on the edge, 32 per texel for the default spread of 4). Set before the first glyph.
+    void setSDF(int baseSize = 32, int spread = 4) { sdfSize = baseSize; sdfSpread = spread; }
+    bool isSDF() const { return sdfSize > 0; }
+    // what the glyph metrics and rect are multiplied with to draw at pixelHeight
+    float glyphScale(float pixelHeight) const { return sdfSize > 0 ? pixelHeight / sdfSize : 1.0f; }
+
+    GLuint texture() const { return textureID; }
+    int size() const { return atlasSize; }
+    const std::vector<unsigned char> &bitmap() const { return pixels; }
+
+    size_t glyphCount() const { return glyphs.size(); }
+    // texels covered by cached glyphs / atlas texels
+    float occupancy() const { return (float)usedTexels / ((float)atlasSize * atlasSize); }
+    // stats of the current frame so far, and of the one before beginFrame()
+    const FrameStats &frameStats() const { return stats; }
+    const FrameStats &lastFrameStats() const { return lastStats; }
+
+private:
+    struct Font
+    {
+        AssetData data;           // the font file, stbtt_fontinfo points into it
+        stbtt_fontinfo info;
+        std::vector<stbtt_fontinfo> workerInfo; // one per ThreadPool::workerIndex() + 1
+
+        float unitScale;          // stbtt_ScaleForPixelHeight for 1 px
+        bool kerning;             // any pair kerns
+        int asciiGlyph[96];       // glyph index of 32..127
+        int16_t asciiAdvance[96]; // font units
+        int16_t asciiKern[96 * 96];
+        // (left << 32 | right) glyph indices -> font units. Holds every nonzero pair when
+        // sparseComplete, else it memoizes lookups (zeros too) up to kMaxSparsePairs.
+        std::unordered_map<uint64_t, int16_t> sparse;
+        bool sparseComplete;
+    };
+    static const size_t kMaxSparsePairs = 1 << 16;
+
+    // a glyph rasterized but not placed yet
+    struct Raster
+    {
+        int w, h;
+        int xoff, yoff;
+        float xadvance;
+        int glyphIndex;
+        std::vector<unsigned char> pixels;
+    };
+
+    struct Span
+    {
+        int x, w;
+    };
+
+    // ids are stable, a merged away shelf keeps its slot with h == 0
+    struct Shelf
+    {
+        int y, h;
+        int end;                  // x after the last allocated glyph
+        std::vector<Span> free;   // holes left by evictions, sorted by x
+        int dirtyX0, dirtyX1;     // x range to upload, empty when dirtyX0 >= dirtyX1
+    };
+
+    // ASCII glyphs already used this frame, per (font, size), so the common case skips
+    // the hash lookup. Entries can't go stale within a frame, they aren't evictable.
+    struct AsciiPage
+    {
+        uint64_t prefix;          // makeKey(font, size, 0)
+        uint32_t frame;
+        Glyph *glyphs[128];
+    };
+    static const int kAsciiPages = 4;
+
+    static uint64_t makeKey(int font, int size, uint32_t codepoint)
+    {
+        return (uint64_t)font << 48 | (uint64_t)size << 32 | codepoint;
+    }
+
+    void markUsed(Glyph &g)
+    {
+        if (g.lastUsed == frame)
+            return;
+        g.lastUsed = frame;
+        if (g.w)
+            lruList.splice(lruList.begin(), lruList, g.lru);
+    }
+
+    void buildMetrics(Font &font);
+    int sparseKern(Font &font, int left, int right);
+
+    int pixelSize(float pixelHeight) const;
+    void rasterize(const stbtt_fontinfo &info, int size, uint32_t codepoint, Raster &raster) const;
+    Glyph *insert(uint64_t key, const Raster &raster);
+
+    bool allocate(int w, int h, int &x, int &y, int &shelf);
+    bool allocateInShelf(Shelf &s, int w, int &x);
+    int addShelf(int y, int h);
+    void release(Glyph &g);
+    void mergeEmpty(int shelf);
+    bool evictFor(int w, int h, int &x, int &y, int &shelf);
+
+    int atlasSize;
+    int padding;
+    int sdfSize, sdfSpread;       // sdfSize 0: coverage bitmaps
+    std::vector<unsigned char> pixels;
+    GLuint textureID;
+    bool uploadToGL;
+    bool uploaded;                // the whole atlas went up once
+
+    std::vector<std::unique_ptr<Font>> fonts;
+    std::unordered_map<uint64_t, Glyph> glyphs;
+    std::list<Glyph*> lruList;    // glyphs with pixels, most recently used first
+    std::vector<Shelf> shelves;
+    int shelfTop;                 // y below the lowest shelf
+    size_t usedTexels;
+
+    Raster scratch;
+    AsciiPage pages[kAsciiPages];
+    int nextPage;
+
+    uint32_t frame;
+    uint64_t totalEvictions;
+    FrameStats stats;
+    FrameStats lastStats;
+};
+
+
+GlyphCache::GlyphCache(int atlasSize, int padding)
+    : atlasSize(atlasSize), padding(padding)
+{
+    sdfSize = sdfSpread = 0;
+    pixels.assign((size_t)atlasSize * atlasSize, 0);
+    textureID = 0;
+    uploadToGL = true;
+    uploaded = false;
+    shelfTop = 0;
+    usedTexels = 0;
+    frame = 1;
+    totalEvictions = 0;
+    for (AsciiPage &page : pages)
+        page.frame = 0;
+    nextPage = 0;
+    stats = lastStats = FrameStats();
+    glyphs.reserve(1024);
+}
+
+GlyphCache::~GlyphCache()
+{
+    if (textureID)
+        glDeleteTextures(1, &textureID);
+}
+
+int GlyphCache::addFont(const char *filename)
+{
+    std::unique_ptr<Font> font(new Font());
+    if (!open_asset(filename, font->data))
+    {
+        fprintf(stderr, "Can't read font: %s\n", filename);
+        return -1;
+    }
+    int offset = stbtt_GetFontOffsetForIndex(font->data.data(), 0);
+    if (offset < 0 || !stbtt_InitFont(&font->info, font->data.data(), offset))
+    {
+        fprintf(stderr, "Not a TrueType font: %s\n", filename);
+        return -1;
+    }
+
+    buildMetrics(*font);
+    fonts.push_back(std::move(font));
+    return (int)fonts.size() - 1;
+}
+
+void GlyphCache::buildMetrics(Font &font)
+{
+    const stbtt_fontinfo *info = &font.info;
+    font.unitScale = stbtt_ScaleForPixelHeight(info, 1.0f);
+
+    for (int c = 0; c < 96; ++c)
+    {
+        font.asciiGlyph[c] = stbtt_FindGlyphIndex(info, c + 32);
+        int advance, lsb;
+        stbtt_GetGlyphHMetrics(info, font.asciiGlyph[c], &advance, &lsb);
+        font.asciiAdvance[c] = (int16_t)advance;
+    }
+
+    font.kerning = false;
+    font.sparseComplete = !info->gpos;
+    memset(font.asciiKern, 0, sizeof(font.asciiKern));
+    if (!info->kern && !info->gpos)
+        return;
+
+    for (int l = 0; l < 96; ++l)
+    {
+        for (int r = 0; r < 96; ++r)
+        {
+            int kern = stbtt_GetGlyphKernAdvance(info, font.asciiGlyph[l], font.asciiGlyph[r]);
+            font.asciiKern[l * 96 + r] = (int16_t)kern;
+            font.kerning |= kern != 0;
+        }
+    }
+
+    if (font.sparseComplete)
+    {
+        int count = stbtt_GetKerningTableLength(info);
+        std::vector<stbtt_kerningentry> table(count);
+        stbtt_GetKerningTable(info, table.data(), count);
+        font.sparse.reserve(count);
+        for (const stbtt_kerningentry &e : table)
+        {
+            if (e.advance)
+                font.sparse[(uint64_t)e.glyph1 << 32 | (uint32_t)e.glyph2] = (int16_t)e.advance;
+        }
+        font.kerning |= !font.sparse.empty();
+    }
+    else
+        font.kerning = true;
+}
+
+int GlyphCache::sparseKern(Font &font, int left, int right)
+{
+    uint64_t key = (uint64_t)left << 32 | (uint32_t)right;
+    auto found = font.sparse.find(key);
+    if (found != font.sparse.end())
+        return found->second;
+    if (font.sparseComplete)
+        return 0;
+
+    int kern = stbtt_GetGlyphKernAdvance(&font.info, left, right);
+    if (font.sparse.size() < kMaxSparsePairs)
+        font.sparse.emplace(key, (int16_t)kern);
+    return kern;
+}
+
+float GlyphCache::measure(int font, float pixelHeight, const char *utf8, bool kerning)
+{
+    Font &f = *fonts[font];
+    kerning = kerning && f.kerning;
+
+    int width = 0;
+    uint32_t prev = 0;
+    int prevGlyph = -1;
+    const unsigned char *s = (const unsigned char *)utf8;
+    while (*s)
+    {
+        uint32_t cp = decodeUtf8(s);
+        if (cp < 32)
+            continue;
+
+        uint32_t c = cp - 32;
+        int g, advance;
+        if (c < 96)
+        {
+            g = f.asciiGlyph[c];
+            advance = f.asciiAdvance[c];
+        }
+        else
+        {
+            int lsb;
+            g = stbtt_FindGlyphIndex(&f.info, cp);
+            stbtt_GetGlyphHMetrics(&f.info, g, &advance, &lsb);
+        }
+
+        if (kerning && prevGlyph >= 0)
+        {
+            uint32_t p = prev - 32;
+            width += p < 96 && c < 96 ? f.asciiKern[p * 96 + c] : sparseKern(f, prevGlyph, g);
+        }
+        width += advance;
+        prev = cp;
+        prevGlyph = g;
+    }
+
+    float scale = f.unitScale * (float)pixelSize(pixelHeight);
+    return width * scale * glyphScale(pixelHeight);
+}
+
+uint32_t GlyphCache::decodeUtf8(const unsigned char *&text)
+{
+    uint32_t c = *text++;
+    if (c < 0x80)
+        return c;
+
+    int extra;
+    uint32_t min;
+    if ((c & 0xE0) == 0xC0)      { extra = 1; c &= 0x1F; min = 0x80; }
+    else if ((c & 0xF0) == 0xE0) { extra = 2; c &= 0x0F; min = 0x800; }
+    else if ((c & 0xF8) == 0xF0) { extra = 3; c &= 0x07; min = 0x10000; }
+    else
+        return 0xFFFD;
+
+    for (int i = 0; i < extra; ++i)
+    {
+        if ((*text & 0xC0) != 0x80)
+            return 0xFFFD;
+        c = c << 6 | (*text++ & 0x3F);
+    }
+    return c < min || c > 0x10FFFF ? 0xFFFD : c;
+}
+
+void GlyphCache::beginFrame()
+{
+    lastStats = stats;
+    stats = FrameStats();
+    frame++;
+}
+
+const GlyphCache::Glyph *GlyphCache::glyph(int font, float pixelHeight, uint32_t codepoint)
+{
+    stats.lookups++;
+
+    int size = pixelSize(pixelHeight);
+    uint64_t key = makeKey(font, size, codepoint);
+
+    AsciiPage *page = nullptr;
+    if (codepoint < 128)
+    {
+        uint64_t prefix = makeKey(font, size, 0);
+        for (AsciiPage &p : pages)
+        {
+            if (p.frame == frame && p.prefix == prefix)
+            {
+                page = &p;
+                break;
+            }
+        }
+        if (page && page->glyphs[codepoint])
+            return page->glyphs[codepoint];
+
+        if (!page)
+        {
+            page = &pages[nextPage];
+            nextPage = (nextPage + 1) % kAsciiPages;
+            page->prefix = prefix;
+            page->frame = frame;
+            memset(page->glyphs, 0, sizeof(page->glyphs));
+        }
+    }
+
+    auto found = glyphs.find(key);
+    if (found != glyphs.end())
+    {
+        Glyph &g = found->second;
+        markUsed(g);
+        if (page)
+            page->glyphs[codepoint] = &g;
+        return &g;
+    }
+
+    stats.misses++;
+
+    rasterize(fonts[font]->info, size, codepoint, scratch);
+    Glyph *g = insert(key, scratch);
+    if (!g)
+        return nullptr;
+
+    if (page)
+        page->glyphs[codepoint] = g;
+    return g;
+}
+
+int GlyphCache::pixelSize(float pixelHeight) const
+{
+    return sdfSize > 0 ? sdfSize : std::max(1, (int)(pixelHeight + 0.5f));
+}
+
+// CPU only and const, safe on any thread with its own stbtt_fontinfo
+void GlyphCache::rasterize(const stbtt_fontinfo &info, int size, uint32_t codepoint, Raster &raster) const
+{
+    float scale = stbtt_ScaleForPixelHeight(&info, (float)size);
+    int glyph = stbtt_FindGlyphIndex(&info, codepoint);
+    raster.glyphIndex = glyph;
+
+    int advance, lsb;
+    stbtt_GetGlyphHMetrics(&info, glyph, &advance, &lsb);
+    raster.xadvance = scale * advance;
+
+    if (sdfSize > 0)
+    {
+        int w, h, x0, y0;
+        unsigned char *sdf = stbtt_GetGlyphSDF(&info, scale, glyph, sdfSpread, 128, 128.0f / sdfSpread, &w, &h, &x0, &y0);
+        if (!sdf)
+        {
+            raster.w = raster.h = raster.xoff = raster.yoff = 0;
+            return;
+        }
+        raster.w = w;
+        raster.h = h;
+        raster.xoff = x0;
+        raster.yoff = y0;
+        raster.pixels.assign(sdf, sdf + (size_t)w * h);
+        stbtt_FreeSDF(sdf, nullptr);
+        return;
+    }
+
+    int x0, y0, x1, y1;
+    stbtt_GetGlyphBitmapBox(&info, glyph, scale, scale, &x0, &y0, &x1, &y1);
+    raster.xoff = x0;
+    raster.yoff = y0;
+    raster.w = std::max(x1 - x0, 0);
+    raster.h = std::max(y1 - y0, 0);
+    if (raster.w == 0 || raster.h == 0)
+    {
+        raster.w = raster.h = 0;
+        return;
+    }
+    raster.pixels.resize((size_t)raster.w * raster.h);
+    stbtt_MakeGlyphBitmap(&info, raster.pixels.data(), raster.w, raster.h, raster.w, scale, scale, glyph);
+}
+
+GlyphCache::Glyph *GlyphCache::insert(uint64_t key, const Raster &raster)
+{
+    int w = raster.w, h = raster.h;
+    int ax = 0, ay = 0, shelf = -1;
+    if (w > 0)
+    {
+        if (!allocate(w, h, ax, ay, shelf) && !evictFor(w, h, ax, ay, shelf))
+        {
+            stats.failed++;
+            return nullptr;
+        }
+
+        // clear the padding too, the space may have held an evicted glyph
+        int cw = std::min(w + padding, atlasSize - ax), ch = std::min(h + padding, atlasSize - ay);
+        for (int row = 0; row < ch; ++row)
+            memset(&pixels[(size_t)(ay + row) * atlasSize + ax], 0, cw);
+        for (int row = 0; row < h; ++row)
+            memcpy(&pixels[(size_t)(ay + row) * atlasSize + ax], &raster.pixels[(size_t)row * w], w);
+
+        Shelf &s = shelves[shelf];
+        s.dirtyX0 = std::min(s.dirtyX0, ax);
+        s.dirtyX1 = std::max(s.dirtyX1, ax + cw);
+        usedTexels += (size_t)w * h;
+    }
+
+    Glyph &g = glyphs[key];
+    g.x = (uint16_t)ax;
+    g.y = (uint16_t)ay;
+    g.w = (uint16_t)w;
+    g.h = (uint16_t)h;
+    float inv = 1.0f / atlasSize;
+    g.s0 = ax * inv;
+    g.t0 = ay * inv;
+    g.s1 = (ax + w) * inv;
+    g.t1 = (ay + h) * inv;
+    g.xoff = (float)raster.xoff;
+    g.yoff = (float)raster.yoff;
+    g.xadvance = raster.xadvance;
+    g.glyphIndex = raster.glyphIndex;
+    g.key = key;
+    g.lastUsed = frame;
+    g.shelf = shelf;
+    if (w)
+    {
+        lruList.push_front(&g);
+        g.lru = lruList.begin();
+    }
+    return &g;
+}
+
+size_t GlyphCache::prefetch(const GlyphRequest *requests, size_t count, ThreadPool *pool)
+{
+    // the missing glyphs, first request wins for duplicates
+    struct Pending
+    {
+        uint64_t key;
+        int font, size;
+        uint32_t codepoint;
+    };
+    std::vector<Pending> pending;
+    std::unordered_map<uint64_t, size_t> seen;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const GlyphRequest &r = requests[i];
+        int size = pixelSize(r.pixelHeight);
+        uint64_t key = makeKey(r.font, size, r.codepoint);
+
+        auto found = glyphs.find(key);
+        if (found != glyphs.end())
+        {
+            markUsed(found->second);
+            continue;
+        }
+        if (seen.emplace(key, pending.size()).second)
+            pending.push_back({ key, r.font, size, r.codepoint });
+    }
+
+    std::vector<Raster> rasters(pending.size());
+    if (pool)
+    {
+        int threads = pool->threadCount() + 1;
+        for (std::unique_ptr<Font> &font : fonts)
+        {
+            if ((int)font->workerInfo.size() >= threads)
+                continue;
+            font->workerInfo.resize(threads);
+            for (stbtt_fontinfo &info : font->workerInfo)
+                stbtt_InitFont(&info, font->data.data(), stbtt_GetFontOffsetForIndex(font->data.data(), 0));
+        }
+
+        pool->parallelFor(pending.size(), [&](size_t begin, size_t end, int worker) {
+            for (size_t i = begin; i < end; ++i)
+                rasterize(fonts[pending[i].font]->workerInfo[worker], pending[i].size, pending[i].codepoint, rasters[i]);
+        }, 16);
+    }
+    else
+    {
+        for (size_t i = 0; i < pending.size(); ++i)
+            rasterize(fonts[pending[i].font]->info, pending[i].size, pending[i].codepoint, rasters[i]);
+    }
+
+    stats.lookups += (uint32_t)count;
+    stats.misses += (uint32_t)pending.size();
+    for (size_t i = 0; i < pending.size(); ++i)
+        insert(pending[i].key, rasters[i]);
+    return pending.size();
+}
+
+
+bool GlyphCache::allocateInShelf(Shelf &s, int w, int &x)
+{
+    for (size_t i = 0; i < s.free.size(); ++i)
+    {
+        Span &span = s.free[i];
+        if (span.w >= w)
+        {
+            x = span.x;
+            span.x += w;
+            span.w -= w;
+            if (span.w == 0)
+                s.free.erase(s.free.begin() + i);
+            return true;
+        }
+    }
+
+    if (s.end + w <= atlasSize)
+    {
+        x = s.end;
+        s.end += w;
+        return true;
+    }
+    return false;
+}
+
+int GlyphCache::addShelf(int y, int h)
+{
+    Shelf s;
+    s.y = y;
+    s.h = h;
+    s.end = 0;
+    s.dirtyX0 = atlasSize;
+    s.dirtyX1 = 0;
+
+    for (size_t i = 0; i < shelves.size(); ++i)
+    {
+        if (shelves[i].h == 0)
+        {
+            shelves[i] = s;
+            return (int)i;
+        }
+    }
+    shelves.push_back(s);
+    return (int)shelves.size() - 1;
+}
+
+bool GlyphCache::allocate(int w, int h, int &x, int &y, int &shelf)
+{
+    int pw = w + padding, ph = h + padding;
+    if (pw > atlasSize || ph > atlasSize)
+        return false;
+    int height = std::min((ph + 3) & ~3, atlasSize);
+
+    // the best fitting shelf with room, wasting at most half a glyph height
+    int best = -1;
+    for (int i = 0; i < (int)shelves.size(); ++i)
+    {
+        const Shelf &s = shelves[i];
+        if (s.h < ph || s.h - ph > ph / 2)
+            continue;
+        if (best >= 0 && s.h >= shelves[best].h)
+            continue;
+
+        bool room = s.end + pw <= atlasSize;
+        for (size_t f = 0; !room && f < s.free.size(); ++f)
+            room = s.free[f].w >= pw;
+        if (room)
+            best = i;
+    }
+
+    // else cut a new shelf from the smallest empty one that is tall enough, or from
+    // the space below the shelves
+    if (best < 0)
+    {
+        int empty = -1;
+        for (int i = 0; i < (int)shelves.size(); ++i)
+            if (shelves[i].h >= ph && shelves[i].end == 0 && (empty < 0 || shelves[i].h < shelves[empty].h))
+                empty = i;
+
+        if (empty >= 0)
+        {
+            Shelf &s = shelves[empty];
+            if (s.h - height >= 4)
+            {
+                int restY = s.y + height, restH = s.h - height;
+                s.h = height;
+                if (restY + restH == shelfTop)
+                    shelfTop = restY;
+                else
+                    addShelf(restY, restH);
+            }
+            best = empty;
+        }
+        else if (shelfTop + ph <= atlasSize)
+        {
+            int top = shelfTop;
+            shelfTop = std::min(top + height, atlasSize);
+            best = addShelf(top, shelfTop - top);
+        }
+    }
+
+    if (best < 0)
+        return false;
+
+    allocateInShelf(shelves[best], pw, x);
+    y = shelves[best].y;
+    shelf = best;
+    return true;
+}
+
+// gives the glyph's span back to its shelf
+void GlyphCache::release(Glyph &g)
+{
+    Shelf &s = shelves[g.shelf];
+    Span span = { g.x, g.w + padding };
+
+    auto at = std::lower_bound(s.free.begin(), s.free.end(), span, [](const Span &a, const Span &b) { return a.x < b.x; });
+    at = s.free.insert(at, span);
+
+    // merge with the neighbours
+    if (at + 1 != s.free.end() && at->x + at->w == (at + 1)->x)
+    {
+        at->w += (at + 1)->w;
+        s.free.erase(at + 1);
+    }
+    if (at != s.free.begin() && (at - 1)->x + (at - 1)->w == at->x)
+    {
+        (at - 1)->w += at->w;
+        at = s.free.erase(at) - 1;
+    }
+    if (at->x + at->w == s.end)
+    {
+        s.end = at->x;
+        s.free.erase(at);
+    }
+
+    usedTexels -= (size_t)g.w * g.h;
+
+    if (s.end == 0)
+        mergeEmpty(g.shelf);
+}
+
+// joins an empty shelf with the empty shelves right above and below it, an empty
+// shelf at the bottom goes back to the free space below the shelves
+void GlyphCache::mergeEmpty(int shelf)
+{
+    Shelf &s = shelves[shelf];
+    s.dirtyX0 = atlasSize;
+    s.dirtyX1 = 0;
+
+    for (bool merged = true; merged; )
+    {
+        merged = false;
+        for (Shelf &other : shelves)
+        {
+            if (&other == &s || other.h == 0 || other.end != 0)
+                continue;
+
+            if (other.y == s.y + s.h)
+            {
+                s.h += other.h;
+                other.h = 0;
+                merged = true;
+            }
+            else if (other.y + other.h == s.y)
+            {
+                s.y = other.y;
+                s.h += other.h;
+                other.h = 0;
+                merged = true;
+            }
+        }
+    }
+
+    if (s.y + s.h == shelfTop)
+    {
+        shelfTop = s.y;
+        s.h = 0;
+    }
+}
+
+bool GlyphCache::evictFor(int w, int h, int &x, int &y, int &shelf)
+{
+    // oldest first, stop at the first glyph of this frame: everything after it is newer
+    while (!lruList.empty())
+    {
+        Glyph *g = lruList.back();
+        if (g->lastUsed == frame)
+            return false;
+
+        lruList.pop_back();
+        release(*g);
+        glyphs.erase(g->key);
+        stats.evictions++;
+        totalEvictions++;
+
+        if (allocate(w, h, x, y, shelf))
+            return true;
+    }
+    return false;
+}
+
+void GlyphCache::upload()
+{
+    if (!uploaded)
+    {
+        uploaded = true;
+        for (Shelf &s : shelves)
+        {
+            s.dirtyX0 = atlasSize;
+            s.dirtyX1 = 0;
+        }
+        stats.uploadRects++;
+        stats.uploadBytes += pixels.size();
+
+        if (!uploadToGL)
+            return;
+
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlasSize, atlasSize, 0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return;
+    }
+
+    bool bound = false;
+    for (Shelf &s : shelves)
+    {
+        if (s.dirtyX0 >= s.dirtyX1)
+            continue;
+
+        if (!bound && uploadToGL)
+        {
+            glBindTexture(GL_TEXTURE_2D, textureID);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, atlasSize);
+            bound = true;
+        }
+
+        int w = s.dirtyX1 - s.dirtyX0;
+        if (uploadToGL)
+            glTexSubImage2D(GL_TEXTURE_2D, 0, s.dirtyX0, s.y, w, s.h, GL_RED, GL_UNSIGNED_BYTE, &pixels[(size_t)s.y * atlasSize + s.dirtyX0]);
+
+        stats.uploadRects++;
+        stats.uploadBytes += (size_t)w * s.h;
+        s.dirtyX0 = atlasSize;
+        s.dirtyX1 = 0;
+    }
+
+    if (bound)
+    {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+}
@@ -0,0 +1,531 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <climits>
+#include <cstring>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+
+#include "AssetPack.cpp"
+#include "Inflate.cpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMAGE_DECODE_SSE2 1
+#endif
+
+// Image decoding behind UploadImage, TextureLoader, TextureCache and TextureBake: a list of
+// decoders tried in order on the file's bytes, with stb_image as the last one, so anything
+// stbi_load read before still loads. A decoder that doesn't recognise the bytes, or meets
+// a variant it doesn't handle, returns nullptr and the next one gets them.
+//
+// The built in ones are the formats in res/textures that stb_image spends time on:
+//   png  8 bit, not interlaced, gray / gray alpha / RGB / RGBA / palette. The zlib data is
+//        inflated straight from the mapped file (Inflate.cpp) into a buffer of the size the
+//        header gives, rows are unfiltered with SSE2 for 3 and 4 bytes per pixel (Paeth in
+//        16 bit lanes, like libpng). 16 bit, interlaced, sub byte and tRNS keyed gray / RGB
+//        images go to stb_image.
+//   ppm  binary P5 / P6 with maxval 255 (the pool balls), a copy out of the mapped file.
+// JPEG and the rest go to stb_image, whose JPEG IDCT and YCbCr conversion already use SSE2.
+//
+// decode_image reads files through open_asset, out of an asset pack when one is mounted.
+//
+// Pixels are malloc'd like stbi_load's, stbi_image_free releases either. Results are byte
+// for byte those of stbi_load, channel conversion included.
+//
+//   int w, h, channels;
+//   unsigned char *pixels = decode_image("../res/textures/NumGrid_ALB.png", &w, &h, &channels, 0);
+//   if (!pixels) fprintf(stderr, "%s\n", decode_image_failure());
+
+struct ImageDecoder
+{
+    const char *name;
+    // whether data looks like this decoder's format
+    bool (*accepts)(const uint8_t *data, size_t size);
+    // malloc'd pixels with desired channels (0 for the image's own), nullptr to pass
+    unsigned char *(*decode)(const uint8_t *data, size_t size, int *w, int *h, int *channels, int desired);
+};
+
+// per thread like stbi_failure_reason, which it returns when stb_image was the last to try
+static thread_local const char *decodeFailure = nullptr;
+
+static const char *decode_image_failure()
+{
+    return decodeFailure;
+}
+
+// stb_image's conversion between channel counts, luminance weighted 77 / 150 / 29
+static void image_convert(const uint8_t *src, int channels, uint8_t *dst, int desired, size_t count)
+{
+    if (channels == desired)
+    {
+        memcpy(dst, src, count * channels);
+        return;
+    }
+    for (size_t i = 0; i < count; ++i, src += channels, dst += desired)
+    {
+        uint8_t r = src[0], g = channels >= 3 ? src[1] : src[0], b = channels >= 3 ? src[2] : src[0];
+        uint8_t a = channels == 2 ? src[1] : channels == 4 ? src[3] : 255;
+        if (desired <= 2)
+        {
+            dst[0] = channels >= 3 ? (uint8_t)((r * 77 + g * 150 + b * 29) >> 8) : r;
+            if (desired == 2)
+                dst[1] = a;
+        }
+        else
+        {
+            dst[0] = r;
+            dst[1] = g;
+            dst[2] = b;
+            if (desired == 4)
+                dst[3] = a;
+        }
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+// png
+
+static uint32_t png_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static bool png_accepts(const uint8_t *data, size_t size)
+{
+    static const uint8_t signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    return size >= 8 && memcmp(data, signature, 8) == 0;
+}
+
+static int png_paeth(int a, int b, int c)
+{
+    int pa = abs(b - c), pb = abs(a - c), pc = abs(a + b - 2 * c);
+    if (pa <= pb && pa <= pc)
+        return a;
+    return pb <= pc ? b : c;
+}
+
+// reverses one row's filter from src into dst; prev is the row above, unfiltered, all zero
+// for the first row
+static void png_unfilter_scalar(int filter, const uint8_t *src, const uint8_t *prev, uint8_t *dst, size_t stride, int bpp)
+{
+    size_t x = 0;
+    switch (filter)
+    {
+    case 0: memcpy(dst, src, stride); break;
+    case 1:
+        for (; x < (size_t)bpp; ++x) dst[x] = src[x];
+        for (; x < stride; ++x) dst[x] = (uint8_t)(src[x] + dst[x - bpp]);
+        break;
+    case 2:
+        for (; x < stride; ++x) dst[x] = (uint8_t)(src[x] + prev[x]);
+        break;
+    case 3:
+        for (; x < (size_t)bpp; ++x) dst[x] = (uint8_t)(src[x] + (prev[x] >> 1));
+        for (; x < stride; ++x) dst[x] = (uint8_t)(src[x] + ((dst[x - bpp] + prev[x]) >> 1));
+        break;
+    case 4:
+        for (; x < (size_t)bpp; ++x) dst[x] = (uint8_t)(src[x] + prev[x]);
+        for (; x < stride; ++x) dst[x] = (uint8_t)(src[x] + png_paeth(dst[x - bpp], prev[x], prev[x - bpp]));
+        break;
+    }
+}
+
+#ifdef IMAGE_DECODE_SSE2
+
+static __m128i png_load4(const uint8_t *p)
+{
+    int32_t v;
+    memcpy(&v, p, 4);
+    return _mm_cvtsi32_si128(v);
+}
+
+static void png_store4(uint8_t *p, __m128i v)
+{
+    int32_t x = _mm_cvtsi128_si32(v);
+    memcpy(p, &x, 4);
+}
+
+// png_unfilter_scalar for 3 and 4 bytes per pixel. Sub, Avg and Paeth depend on the pixel
+// to the left so go one pixel per step, 4 bytes loaded and stored: for 3 the fourth byte
+// is the next pixel's, overwritten by the next step, src, prev and dst need 1 byte past
+// the row.
+static void png_unfilter_sse2(int filter, const uint8_t *src, const uint8_t *prev, uint8_t *dst, size_t stride, int bpp)
+{
+    size_t x = 0;
+    const __m128i zero = _mm_setzero_si128();
+    switch (filter)
+    {
+    case 0: memcpy(dst, src, stride); return;
+    case 2:
+        for (; x + 16 <= stride; x += 16)
+        {
+            __m128i s = _mm_loadu_si128((const __m128i *)(src + x)), b = _mm_loadu_si128((const __m128i *)(prev + x));
+            _mm_storeu_si128((__m128i *)(dst + x), _mm_add_epi8(s, b));
+        }
+        for (; x < stride; ++x) dst[x] = (uint8_t)(src[x] + prev[x]);
+        return;
+    case 1:
+    {
+        __m128i a = zero;
+        for (; x < stride; x += bpp)
+        {
+            a = _mm_add_epi8(png_load4(src + x), a);
+            png_store4(dst + x, a);
+        }
+        return;
+    }
+    case 3:
+    {
+        // floor((a + b) / 2) from the rounding up average
+        const __m128i one = _mm_set1_epi8(1);
+        __m128i a = zero;
+        for (; x < stride; x += bpp)
+        {
+            __m128i b = png_load4(prev + x);
+            __m128i average = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+            a = _mm_add_epi8(png_load4(src + x), average);
+            png_store4(dst + x, a);
+        }
+        return;
+    }
+    case 4:
+    {
+        // pa = |b - c|, pb = |a - c|, pc = |a + b - 2c|, the first of a, b, c with the least
+        __m128i a = zero, c = zero;
+        for (; x < stride; x += bpp)
+        {
+            __m128i b = _mm_unpacklo_epi8(png_load4(prev + x), zero);
+            __m128i bc = _mm_sub_epi16(b, c), ac = _mm_sub_epi16(a, c), abc = _mm_add_epi16(bc, ac);
+            __m128i pa = _mm_max_epi16(bc, _mm_sub_epi16(zero, bc));
+            __m128i pb = _mm_max_epi16(ac, _mm_sub_epi16(zero, ac));
+            __m128i pc = _mm_max_epi16(abc, _mm_sub_epi16(zero, abc));
+            __m128i least = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+            __m128i useA = _mm_cmpeq_epi16(pa, least), useB = _mm_cmpeq_epi16(pb, least);
+            __m128i predictor = _mm_or_si128(_mm_and_si128(useB, b), _mm_andnot_si128(useB, c));
+            predictor = _mm_or_si128(_mm_and_si128(useA, a), _mm_andnot_si128(useA, predictor));
+            __m128i pixel = _mm_add_epi8(png_load4(src + x), _mm_packus_epi16(predictor, predictor));
+            png_store4(dst + x, pixel);
+            a = _mm_unpacklo_epi8(pixel, zero);
+            c = b;
+        }
+        return;
+    }
+    }
+}
+
+#endif
+
+static void png_unfilter(int filter, const uint8_t *src, const uint8_t *prev, uint8_t *dst, size_t stride, int bpp)
+{
+#ifdef IMAGE_DECODE_SSE2
+    if (bpp == 3 || bpp == 4)
+    {
+        png_unfilter_sse2(filter, src, prev, dst, stride, bpp);
+        return;
+    }
+#endif
+    png_unfilter_scalar(filter, src, prev, dst, stride, bpp);
+}
+
+static unsigned char *png_decode(const uint8_t *data, size_t size, int *w, int *h, int *channels, int desired)
+{
+    const uint8_t *p = data + 8, *end = data + size;
+    uint32_t width = 0, height = 0;
+    int colorType = -1, bpp = 0;
+    uint8_t palette[256 * 4];
+    int paletteSize = 0;
+    bool paletteAlpha = false;
+    const uint8_t *idat = nullptr;
+    size_t idatSize = 0;
+    std::vector<uint8_t> joined; // the IDAT chunks back to back when there are several
+
+    for (;;)
+    {
+        if (end - p < 12)
+        {
+            decodeFailure = "png: truncated";
+            return nullptr;
+        }
+        uint32_t length = png_u32(p);
+        const uint8_t *type = p + 4, *chunk = p + 8;
+        if (length > (size_t)(end - chunk) - 4)
+        {
+            decodeFailure = "png: truncated";
+            return nullptr;
+        }
+        p = chunk + length + 4;
+
+        if (memcmp(type, "IHDR", 4) == 0)
+        {
+            if (length != 13)
+                return nullptr;
+            width = png_u32(chunk);
+            height = png_u32(chunk + 4);
+            int depth = chunk[8];
+            colorType = chunk[9];
+            // everything but 8 bit, progressive images goes to stb_image
+            if (depth != 8 || chunk[10] != 0 || chunk[11] != 0 || chunk[12] != 0)
+                return nullptr;
+            static const int kChannels[7] = { 1, 0, 3, 1, 2, 0, 4 };
+            if (colorType > 6 || !kChannels[colorType])
+                return nullptr;
+            bpp = kChannels[colorType];
+            if (!width || !height || width > (1u << 24) || height > (1u << 24))
+                return nullptr;
+        }
+        else if (colorType < 0)
+        {
+            // IHDR must come first (the iPhone CgBI chunk does, stb_image handles those)
+            return nullptr;
+        }
+        else if (memcmp(type, "PLTE", 4) == 0)
+        {
+            if (length % 3 || length > 256 * 3)
+                return nullptr;
+            paletteSize = length / 3;
+            for (int i = 0; i < paletteSize; ++i)
+            {
+                palette[i * 4 + 0] = chunk[i * 3 + 0];
+                palette[i * 4 + 1] = chunk[i * 3 + 1];
+                palette[i * 4 + 2] = chunk[i * 3 + 2];
+                palette[i * 4 + 3] = 255;
+            }
+        }
+        else if (memcmp(type, "tRNS", 4) == 0)
+        {
+            // a color key adds an alpha channel to gray / RGB, stb_image does that
+            if (colorType != 3 || !paletteSize || length > (uint32_t)paletteSize)
+                return nullptr;
+            for (uint32_t i = 0; i < length; ++i)
+                palette[i * 4 + 3] = chunk[i];
+            paletteAlpha = true;
+        }
+        else if (memcmp(type, "IDAT", 4) == 0)
+        {
+            if (!idat)
+            {
+                idat = chunk;
+                idatSize = length;
+            }
+            else
+            {
+                if (joined.empty())
+                    joined.assign(idat, idat + idatSize);
+                joined.insert(joined.end(), chunk, chunk + length);
+            }
+        }
+        else if (memcmp(type, "IEND", 4) == 0)
+        {
+            break;
+        }
+        else if (!(type[0] & 32))
+        {
+            // unknown critical chunk
+            return nullptr;
+        }
+    }
+
+    if (!idat || (colorType == 3 && !paletteSize))
+        return nullptr;
+    if (!joined.empty())
+    {
+        idat = joined.data();
+        idatSize = joined.size();
+    }
+
+    // one filter byte in front of every row
+    size_t stride = (size_t)width * bpp;
+    size_t filteredSize = height * (stride + 1);
+    uint8_t *filtered = (uint8_t *)malloc(filteredSize + 16);
+    if (!filtered)
+    {
+        decodeFailure = "png: out of memory";
+        return nullptr;
+    }
+    if (!inflate_zlib(idat, idatSize, filtered, filteredSize))
+    {
+        free(filtered);
+        decodeFailure = "png: corrupt zlib data";
+        return nullptr;
+    }
+
+    int imageChannels = colorType == 3 ? (paletteAlpha ? 4 : 3) : bpp;
+    int outChannels = desired ? desired : imageChannels;
+    size_t outStride = (size_t)width * outChannels;
+    uint8_t *out = (uint8_t *)malloc(height * outStride + 16);
+    // rows unfilter into out when they are the output, otherwise into two rows of scratch
+    bool direct = colorType != 3 && outChannels == bpp;
+    std::vector<uint8_t> rows(direct ? 0 : 2 * (stride + 16));
+    std::vector<uint8_t> zeroRow(stride + 16);
+    std::vector<uint8_t> expanded(colorType == 3 && imageChannels != outChannels ? (size_t)width * imageChannels : 0);
+    if (!out)
+    {
+        free(filtered);
+        decodeFailure = "png: out of memory";
+        return nullptr;
+    }
+
+    const uint8_t *prev = zeroRow.data();
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t *src = filtered + y * (stride + 1);
+        if (src[0] > 4)
+        {
+            free(filtered);
+            free(out);
+            decodeFailure = "png: bad filter";
+            return nullptr;
+        }
+        uint8_t *row = direct ? out + y * outStride : rows.data() + (y & 1) * (stride + 16);
+        png_unfilter(src[0], src + 1, prev, row, stride, bpp);
+        prev = row;
+        if (direct)
+            continue;
+
+        uint8_t *dst = out + y * outStride;
+        if (colorType == 3)
+        {
+            // indices past the palette read as its first entry
+            uint8_t *pixels = expanded.empty() ? dst : expanded.data();
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                const uint8_t *color = palette + (row[x] < paletteSize ? row[x] * 4 : 0);
+                memcpy(pixels + x * imageChannels, color, imageChannels);
+            }
+            if (!expanded.empty())
+                image_convert(pixels, imageChannels, dst, outChannels, width);
+        }
+        else
+        {
+            image_convert(row, bpp, dst, outChannels, width);
+        }
+    }
+    free(filtered);
+
+    *w = (int)width;
+    *h = (int)height;
+    *channels = imageChannels;
+    return out;
+}
+
+// ------------------------------------------------------------------------------------------
+// ppm
+
+static bool ppm_accepts(const uint8_t *data, size_t size)
+{
+    return size >= 2 && data[0] == 'P' && (data[1] == '5' || data[1] == '6');
+}
+
+// the next whitespace separated header number, skipping # comments
+static bool ppm_number(const uint8_t *&p, const uint8_t *end, uint32_t &value)
+{
+    for (;;)
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+            ++p;
+        if (p < end && *p == '#')
+        {
+            while (p < end && *p != '\n')
+                ++p;
+            continue;
+        }
+        break;
+    }
+    if (p == end || *p < '0' || *p > '9')
+        return false;
+    value = 0;
+    while (p < end && *p >= '0' && *p <= '9' && value < (1u << 24))
+        value = value * 10 + (*p++ - '0');
+    return value < (1u << 24);
+}
+
+static unsigned char *ppm_decode(const uint8_t *data, size_t size, int *w, int *h, int *channels, int desired)
+{
+    const uint8_t *p = data + 2, *end = data + size;
+    uint32_t width, height, maxValue;
+    if (!ppm_number(p, end, width) || !ppm_number(p, end, height) || !ppm_number(p, end, maxValue))
+        return nullptr;
+    // one whitespace byte then the pixels; 16 bit ones go to stb_image
+    if (maxValue != 255 || !width || !height || p == end)
+        return nullptr;
+    ++p;
+    int imageChannels = data[1] == '6' ? 3 : 1;
+    size_t count = (size_t)width * height;
+    if ((size_t)(end - p) < count * imageChannels)
+    {
+        decodeFailure = "ppm: truncated";
+        return nullptr;
+    }
+
+    int outChannels = desired ? desired : imageChannels;
+    uint8_t *out = (uint8_t *)malloc(count * outChannels);
+    if (!out)
+    {
+        decodeFailure = "ppm: out of memory";
+        return nullptr;
+    }
+    image_convert(p, imageChannels, out, outChannels, count);
+    *w = (int)width;
+    *h = (int)height;
+    *channels = imageChannels;
+    return out;
+}
+
+// ------------------------------------------------------------------------------------------
+
+// decoders tried before stb_image, register_image_decoder puts new ones first. Not
+// synchronised, register before loading anything.
+static std::vector<ImageDecoder> &image_decoders()
+{
+    static std::vector<ImageDecoder> decoders = {
+        { "png", png_accepts, png_decode },
+        { "ppm", ppm_accepts, ppm_decode },
+    };
+    return decoders;
+}
+
+void register_image_decoder(const ImageDecoder &decoder)
+{
+    image_decoders().insert(image_decoders().begin(), decoder);
+}
+
+// like stbi_load_from_memory, through the decoders
+static unsigned char *decode_image_memory(const uint8_t *data, size_t size, int *w, int *h, int *channels, int desired)
+{
+    if (desired < 0 || desired > 4)
+    {
+        decodeFailure = "bad channel count";
+        return nullptr;
+    }
+    for (const ImageDecoder &decoder : image_decoders())
+    {
+        if (!decoder.accepts(data, size))
+            continue;
+        if (unsigned char *pixels = decoder.decode(data, size, w, h, channels, desired))
+            return pixels;
+    }
+    if (size > INT_MAX)
+    {
+        decodeFailure = "file too large";
+        return nullptr;
+    }
+    unsigned char *pixels = stbi_load_from_memory(data, (int)size, w, h, channels, desired);
+    decodeFailure = pixels ? nullptr : stbi_failure_reason();
+    return pixels;
+}
+
+// like stbi_load, from the mounted asset packs or the mapped file (AssetPack.cpp)
+static unsigned char *decode_image(const char *path, int *w, int *h, int *channels, int desired)
+{
+    AssetData file;
+    if (!open_asset(path, file))
+    {
+        decodeFailure = "can't open file";
+        return nullptr;
+    }
+    return decode_image_memory(file.data(), file.size(), w, h, channels, desired);
+}
@@ -0,0 +1,424 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <cstring>
+
+// zlib / DEFLATE decompression into a buffer of known size, for the PNG decoder
+// (ImageDecoder.cpp), where the size of the inflated data follows from the header.
+//
+// Faster than the general purpose inflate in stb_image for that case: the output never
+// grows or moves, the bit buffer is 64 bits refilled 8 bytes at a time, literal / length
+// and distance codes up to kInflateFastBits long resolve with one table lookup that also
+// carries the base and extra bit count of lengths and distances, and matches are copied 8
+// bytes at a time. Longer codes continue from the table entry bit by bit. The adler32 at the end
+// isn't checked (neither does stb_image).
+//
+//   if (!inflate_zlib(compressed, compressedSize, out, outSize)) ...
+
+static const int kInflateFastBits = 10;
+
+// one entry of the fast table: a literal byte, a length or distance base with its extra
+// bits, the end of the block, or the first kInflateFastBits of a longer code
+struct InflateEntry
+{
+    uint16_t value;    // for kInflateLong the code so far
+    uint8_t  bits;     // code length, 0 for the longer codes
+    uint8_t  extra;    // kInflateLiteral, kInflateEnd, kInflateInvalid, kInflateLong or the extra bit count
+};
+
+static const uint8_t kInflateLiteral = 0x80, kInflateEnd = 0x81, kInflateInvalid = 0x82, kInflateLong = 0x83;
+
+struct InflateTable
+{
+    InflateEntry fast[1 << kInflateFastBits];
+    // canonical decoding of the longer codes: per length the count, first code and its
+    // index into symbols, which are in code order
+    uint16_t counts[16];
+    uint16_t firstCode[16];
+    uint16_t firstIndex[16];
+    uint16_t symbols[320];
+    const uint16_t *bases;
+    const uint8_t *extras;
+    int baseSymbol;            // first symbol that takes a base / extra (257 for lengths)
+};
+
+static const uint16_t kInflateLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                                 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t kInflateLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t kInflateDistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+                                                   513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t kInflateDistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+struct InflateBits
+{
+    const uint8_t *next, *end;
+    uint64_t bits;             // next bit in bit 0; above count, bytes from next again
+    int count;
+    int padding;               // zero bits added past the end, on top of the real ones
+
+    void refill()
+    {
+        if (end - next >= 8)
+        {
+            // whole bytes up to 56..63 bits; next only moves past the bytes that fit
+            uint64_t word;
+            memcpy(&word, next, 8);
+            bits |= word << count;
+            next += (63 - count) >> 3;
+            count |= 56;
+            return;
+        }
+        while (count <= 56)
+        {
+            if (next < end)
+                bits |= (uint64_t)*next++ << count;
+            else
+                padding += 8;
+            count += 8;
+        }
+    }
+
+    // more bits taken than the stream has
+    bool overrun() const { return count < padding; }
+
+    // count >= n, n <= 32
+    uint32_t take(int n)
+    {
+        uint32_t value = (uint32_t)(bits & ((1ull << n) - 1));
+        bits >>= n;
+        count -= n;
+        return value;
+    }
+};
+
+static uint32_t inflate_reverse(uint32_t code, int length)
+{
+    uint32_t reversed = 0;
+    for (int i = 0; i < length; ++i)
+        reversed |= (code >> i & 1) << (length - 1 - i);
+    return reversed;
+}
+
+// false for an over-subscribed code; incomplete ones are allowed like zlib does for one distance code
+static bool inflate_build(InflateTable &table, const uint8_t *lengths, int count, const uint16_t *bases, const uint8_t *extras, int baseSymbol)
+{
+    memset(table.counts, 0, sizeof(table.counts));
+    for (int i = 0; i < count; ++i)
+        table.counts[lengths[i]]++;
+    table.counts[0] = 0;
+    table.bases = bases;
+    table.extras = extras;
+    table.baseSymbol = baseSymbol;
+
+    uint16_t offsets[16];
+    int left = 1;
+    offsets[1] = 0;
+    for (int length = 1; length < 16; ++length)
+    {
+        left = left * 2 - table.counts[length];
+        if (left < 0)
+            return false;
+        if (length < 15)
+            offsets[length + 1] = offsets[length] + table.counts[length];
+    }
+    for (int i = 0; i < count; ++i)
+        if (lengths[i])
+            table.symbols[offsets[lengths[i]]++] = (uint16_t)i;
+
+    uint32_t first = 0;
+    for (int length = 1; length < 16; ++length)
+    {
+        table.firstCode[length] = (uint16_t)first;
+        table.firstIndex[length] = length == 1 ? 0 : (uint16_t)(table.firstIndex[length - 1] + table.counts[length - 1]);
+        first = (first + table.counts[length]) << 1;
+    }
+
+    for (InflateEntry &entry : table.fast)
+        entry = { 0, 0, kInflateInvalid };
+
+    // canonical codes in order; the fast table is indexed by the bit reversed code
+    uint32_t code = 0;
+    int symbolIndex = 0;
+    for (int length = 1; length < 16; ++length)
+    {
+        for (int n = 0; n < table.counts[length]; ++n, ++code, ++symbolIndex)
+        {
+            int symbol = table.symbols[symbolIndex];
+            InflateEntry entry;
+            entry.bits = (uint8_t)length;
+            if (symbol == 256 && baseSymbol == 257)
+            {
+                entry.value = 0;
+                entry.extra = kInflateEnd;
+            }
+            else if (symbol < baseSymbol)
+            {
+                entry.value = (uint16_t)symbol;
+                entry.extra = kInflateLiteral;
+            }
+            else if (symbol - baseSymbol < (baseSymbol == 257 ? 29 : 30))
+            {
+                entry.value = bases[symbol - baseSymbol];
+                entry.extra = extras[symbol - baseSymbol];
+            }
+            else
+            {
+                entry.value = 0;
+                entry.extra = kInflateInvalid;
+            }
+
+            if (length <= kInflateFastBits)
+            {
+                uint32_t reversed = inflate_reverse(code, length);
+                for (uint32_t fill = reversed; fill < (1u << kInflateFastBits); fill += 1u << length)
+                    table.fast[fill] = entry;
+            }
+            else
+            {
+                uint32_t prefix = code >> (length - kInflateFastBits);
+                table.fast[inflate_reverse(prefix, kInflateFastBits)] = { (uint16_t)prefix, 0, kInflateLong };
+            }
+        }
+        code <<= 1;
+    }
+    return true;
+}
+
+// the entry of the next code, consuming it; in must hold 15 bits
+static InflateEntry inflate_decode(InflateBits &in, const InflateTable &table)
+{
+    InflateEntry entry = table.fast[in.bits & ((1u << kInflateFastBits) - 1)];
+    if (entry.bits)
+    {
+        in.take(entry.bits);
+        return entry;
+    }
+    if (entry.extra != kInflateLong)
+        return entry;
+
+    // longer codes continue from the table's prefix one bit at a time
+    uint32_t code = entry.value;
+    in.take(kInflateFastBits);
+    for (int length = kInflateFastBits + 1; length < 16; ++length)
+    {
+        code = code << 1 | in.take(1);
+        uint32_t offset = code - table.firstCode[length];
+        if (offset < table.counts[length])
+        {
+            int symbol = table.symbols[table.firstIndex[length] + offset];
+            if (table.baseSymbol == 257 && symbol == 256)
+                return { 0, (uint8_t)length, kInflateEnd };
+            if (symbol < table.baseSymbol)
+                return { (uint16_t)symbol, (uint8_t)length, kInflateLiteral };
+            if (symbol - table.baseSymbol >= (table.baseSymbol == 257 ? 29 : 30))
+                return { 0, (uint8_t)length, kInflateInvalid };
+            return { table.bases[symbol - table.baseSymbol], (uint8_t)length, table.extras[symbol - table.baseSymbol] };
+        }
+    }
+    return { 0, 0, kInflateInvalid };
+}
+
+static bool inflate_dynamic_tables(InflateBits &in, InflateTable &lengths, InflateTable &distances)
+{
+    static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    in.refill();
+    int literalCount = (int)in.take(5) + 257, distanceCount = (int)in.take(5) + 1, codeCount = (int)in.take(4) + 4;
+    if (literalCount > 286 || distanceCount > 30)
+        return false;
+
+    uint8_t codeLengths[19] = {};
+    for (int i = 0; i < codeCount; ++i)
+    {
+        in.refill();
+        codeLengths[order[i]] = (uint8_t)in.take(3);
+    }
+    InflateTable codes;
+    if (!inflate_build(codes, codeLengths, 19, nullptr, nullptr, 19))
+        return false;
+
+    uint8_t all[286 + 30];
+    int n = 0;
+    while (n < literalCount + distanceCount)
+    {
+        in.refill();
+        InflateEntry entry = inflate_decode(in, codes);
+        if (entry.extra != kInflateLiteral)
+            return false;
+
+        int symbol = entry.value, repeat = 0;
+        uint8_t value = 0;
+        if (symbol < 16)
+        {
+            all[n++] = (uint8_t)symbol;
+            continue;
+        }
+        if (symbol == 16)
+        {
+            if (n == 0)
+                return false;
+            value = all[n - 1];
+            repeat = 3 + (int)in.take(2);
+        }
+        else if (symbol == 17)
+        {
+            repeat = 3 + (int)in.take(3);
+        }
+        else
+        {
+            repeat = 11 + (int)in.take(7);
+        }
+        if (n + repeat > literalCount + distanceCount)
+            return false;
+        memset(all + n, value, repeat);
+        n += repeat;
+    }
+    if (all[256] == 0)
+        return false;
+
+    return inflate_build(lengths, all, literalCount, kInflateLengthBase, kInflateLengthExtra, 257) &&
+           inflate_build(distances, all + literalCount, distanceCount, kInflateDistanceBase, kInflateDistanceExtra, 0);
+}
+
+static void inflate_fixed_tables(InflateTable &lengths, InflateTable &distances)
+{
+    uint8_t all[288 + 30];
+    memset(all, 8, 144);
+    memset(all + 144, 9, 112);
+    memset(all + 256, 7, 24);
+    memset(all + 280, 8, 8);
+    memset(all + 288, 5, 30);
+    inflate_build(lengths, all, 288, kInflateLengthBase, kInflateLengthExtra, 257);
+    inflate_build(distances, all + 288, 30, kInflateDistanceBase, kInflateDistanceExtra, 0);
+}
+
+// raw DEFLATE into out; true when the stream ends with exactly outSize bytes written
+static bool inflate_raw(const uint8_t *data, size_t size, uint8_t *out, size_t outSize)
+{
+    InflateBits in = { data, data + size, 0, 0, 0 };
+    uint8_t *dst = out, *dstEnd = out + outSize;
+    InflateTable lengths, distances;
+
+    for (;;)
+    {
+        in.refill();
+        bool last = in.take(1) != 0;
+        int type = (int)in.take(2);
+
+        if (type == 0)
+        {
+            // stored: byte aligned LEN, NLEN, then the bytes as they are
+            in.take(in.count & 7);
+            uint8_t header[4];
+            for (uint8_t &byte : header)
+            {
+                in.refill();
+                byte = (uint8_t)in.take(8);
+            }
+            size_t length = header[0] | header[1] << 8;
+            if ((size_t)(header[2] | header[3] << 8) != (~length & 0xFFFF) || length > (size_t)(dstEnd - dst))
+                return false;
+            // what the bit buffer holds goes first
+            while (length && in.count >= 8)
+            {
+                *dst++ = (uint8_t)in.take(8);
+                length--;
+            }
+            if (in.overrun() || (length && length > (size_t)(in.end - in.next)))
+                return false;
+            if (length)
+            {
+                // the buffer is empty, drop the bytes it saw ahead
+                in.bits = 0;
+                in.padding = 0;
+            }
+            memcpy(dst, in.next, length);
+            dst += length;
+            in.next += length;
+        }
+        else if (type == 1 || type == 2)
+        {
+            if (type == 1)
+                inflate_fixed_tables(lengths, distances);
+            else if (!inflate_dynamic_tables(in, lengths, distances))
+                return false;
+
+            for (;;)
+            {
+                // a length code with its extra bits is at most 20 bits, a distance 28
+                if (in.count < 20)
+                    in.refill();
+                InflateEntry entry = inflate_decode(in, lengths);
+                if (entry.extra == kInflateLiteral)
+                {
+                    if (dst == dstEnd)
+                        return false;
+                    *dst++ = (uint8_t)entry.value;
+                    continue;
+                }
+                if (entry.extra == kInflateEnd)
+                    break;
+                if (entry.extra == kInflateInvalid)
+                    return false;
+
+                size_t length = entry.value + in.take(entry.extra);
+                if (in.count < 28)
+                    in.refill();
+                InflateEntry distanceEntry = inflate_decode(in, distances);
+                if (distanceEntry.extra == kInflateInvalid || distanceEntry.extra == kInflateLiteral)
+                    return false;
+                size_t distance = distanceEntry.value + in.take(distanceEntry.extra);
+                if (distance > (size_t)(dst - out) || length > (size_t)(dstEnd - dst))
+                    return false;
+
+                const uint8_t *src = dst - distance;
+                if (distance >= 8 && (size_t)(dstEnd - dst) >= length + 8)
+                {
+                    // 8 bytes at a time, each chunk only reads bytes already written
+                    uint8_t *copyEnd = dst + length;
+                    do
+                    {
+                        uint64_t chunk;
+                        memcpy(&chunk, src, 8);
+                        memcpy(dst, &chunk, 8);
+                        src += 8;
+                        dst += 8;
+                    } while (dst < copyEnd);
+                    dst = copyEnd;
+                }
+                else if (distance == 1)
+                {
+                    memset(dst, *src, length);
+                    dst += length;
+                }
+                else
+                {
+                    while (length--)
+                        *dst++ = *src++;
+                }
+            }
+        }
+        else
+        {
+            return false;
+        }
+
+        if (in.overrun())
+            return false;
+        if (last)
+            return dst == dstEnd;
+    }
+}
+
+// zlib stream (2 byte header, DEFLATE, adler32) into out
+static bool inflate_zlib(const uint8_t *data, size_t size, uint8_t *out, size_t outSize)
+{
+    if (size < 2)
+        return false;
+    int cmf = data[0], flags = data[1];
+    // deflate, window up to 32K, header checksum, no preset dictionary
+    if ((cmf & 15) != 8 || (cmf >> 4) > 7 || (cmf * 256 + flags) % 31 != 0 || (flags & 32))
+        return false;
+    return inflate_raw(data + 2, size - 2, out, outSize);
+}
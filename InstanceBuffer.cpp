@@ -0,0 +1,134 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <stdint.h>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "shader.cpp"
+
+// Per-instance model matrices for GLMeshData::renderInstanced().
+// The mat4 occupies attribute locations 3..6 (one vec4 column each), advanced once
+// per instance. Locations 0/1 stay pos/uv, see setVertexLayoutAttribs().
+const GLuint kInstanceTransformLocation = 3;
+// Optional per-instance float at location 7: the layer of a GL_TEXTURE_2D_ARRAY
+// (TextureArray.cpp). Without a layer buffer the attribute is disabled and reads 0.
+const GLuint kInstanceLayerLocation = 7;
+
+// Points the instance attributes of the bound VAO at buffer + offset (bytes), and the
+// layer at the matching instance of layerBuffer when there is one. There is no base
+// instance in GL 3.3, so offset is how a draw starts mid-buffer.
+static void setInstanceAttribs(GLuint buffer, GLintptr offset, GLuint layerBuffer = 0)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	for (GLuint column = 0; column < 4; ++column)
+	{
+		GLuint loc = kInstanceTransformLocation + column;
+		glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + sizeof(glm::vec4) * column));
+		glVertexAttribDivisor(loc, 1);
+		glEnableVertexAttribArray(loc);
+	}
+	if (layerBuffer)
+	{
+		GLintptr layerOffset = offset / (GLintptr)sizeof(glm::mat4) * (GLintptr)sizeof(GLfloat);
+		glBindBuffer(GL_ARRAY_BUFFER, layerBuffer);
+		glVertexAttribPointer(kInstanceLayerLocation, 1, GL_FLOAT, GL_FALSE, sizeof(GLfloat), (void*)layerOffset);
+		glVertexAttribDivisor(kInstanceLayerLocation, 1);
+		glEnableVertexAttribArray(kInstanceLayerLocation);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	CHECK_GL;
+}
+
+// the pool VAO is shared with non-instanced draws, don't leave the divisors behind
+static void clearInstanceAttribs()
+{
+	for (GLuint column = 0; column < 4; ++column)
+	{
+		GLuint loc = kInstanceTransformLocation + column;
+		glDisableVertexAttribArray(loc);
+		glVertexAttribDivisor(loc, 0);
+	}
+	glDisableVertexAttribArray(kInstanceLayerLocation);
+	glVertexAttribDivisor(kInstanceLayerLocation, 0);
+	CHECK_GL;
+}
+
+// A GL_ARRAY_BUFFER of model matrices rewritten every frame, and with layers a second
+// one of texture array layers. upload() orphans the old storage so the driver never has
+// to wait for draws still reading it.
+class InstanceBuffer
+{
+public:
+	InstanceBuffer();
+	~InstanceBuffer();
+
+	InstanceBuffer(const InstanceBuffer &) = delete;
+	InstanceBuffer &operator=(const InstanceBuffer &) = delete;
+
+	// layers: count floats, or nullptr for draws that don't sample an array
+	void upload(const glm::mat4 *transforms, GLsizei count, const GLfloat *layers = nullptr);
+
+	GLuint buffer() const { return instanceVBID; }
+	// 0 when the last upload had no layers
+	GLuint layerBuffer() const { return hasLayers ? layerVBID : 0; }
+	GLsizei count() const { return instanceCount; }
+
+private:
+	GLuint instanceVBID, layerVBID;
+	GLsizei instanceCount;
+	GLsizeiptr capacityBytes, layerCapacityBytes;
+	bool hasLayers;
+};
+
+
+InstanceBuffer::InstanceBuffer()
+{
+	instanceVBID = layerVBID = 0;
+	instanceCount = 0;
+	capacityBytes = layerCapacityBytes = 0;
+	hasLayers = false;
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+	if (instanceVBID)
+		glDeleteBuffers(1, &instanceVBID);
+	if (layerVBID)
+		glDeleteBuffers(1, &layerVBID);
+}
+
+void InstanceBuffer::upload(const glm::mat4 *transforms, GLsizei count, const GLfloat *layers)
+{
+	if (!instanceVBID)
+		glGenBuffers(1, &instanceVBID);
+
+	GLsizeiptr bytes = sizeof(glm::mat4) * (GLsizeiptr)count;
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBID);
+	if (bytes > capacityBytes)
+		capacityBytes = std::max(bytes, capacityBytes * 2);
+
+	// orphan, then fill the fresh storage
+	glBufferData(GL_ARRAY_BUFFER, capacityBytes, nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, transforms);
+
+	hasLayers = layers != nullptr;
+	if (hasLayers)
+	{
+		if (!layerVBID)
+			glGenBuffers(1, &layerVBID);
+		GLsizeiptr layerBytes = sizeof(GLfloat) * (GLsizeiptr)count;
+		glBindBuffer(GL_ARRAY_BUFFER, layerVBID);
+		if (layerBytes > layerCapacityBytes)
+			layerCapacityBytes = std::max(layerBytes, layerCapacityBytes * 2);
+		glBufferData(GL_ARRAY_BUFFER, layerCapacityBytes, nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, layerBytes, layers);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	CHECK_GL;
+
+	instanceCount = count;
+}
@@ -0,0 +1,422 @@
+#pragma once
+
+#include <glad/gl.h>
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#define M_PI 3.141592653589793238462
+
+#include "shader.cpp"
+
+#include "UploadImage.cpp"
+#include "GLMeshData.cpp"
+#include "TextureArray.cpp"
+
+// 50k spheres and boxes, the spheres textured with the 15 pool balls (sphere i has ball
+// i % 15, like a physics actor by its id). SPACE cycles how they are drawn:
+//   per object      a glUniformMatrix4fv + glDrawElements per object, a bind per sphere
+//   instanced       GLMeshData::renderInstanced, spheres sorted by texture: 15 binds and
+//                   15 draws from one instance buffer
+//   texture array   the balls as layers of one GL_TEXTURE_2D_ARRAY, a layer per instance:
+//                   one bind and one draw for all spheres (per array, if the balls ever
+//                   came in more than one size)
+// The CPU time spent submitting draws, and the binds and draws per frame, are printed
+// once a second.
+
+int g_width  = 2560/2;
+int g_height = 1440/2;
+
+const int num_instances = 50000;
+const int num_ball_textures = 15;
+
+enum DrawMode
+{
+    DrawPerObject,
+    DrawInstanced,
+    DrawTextureArray,
+    DrawModeCount
+};
+const char *drawModeNames[DrawModeCount] = { "per object", "instanced", "texture array" };
+
+int g_mode = DrawTextureArray;
+
+
+// Vertex shader, one object per draw
+const char* vertexShaderSource = R"VERTEX(
+
+#version 330 core
+
+layout(location = 0) in vec3 vertexPosition_modelspace;
+layout(location = 1) in vec2 vertexUV;
+
+out vec2 UV;
+
+uniform mat4 MVP;
+uniform vec4 uvDecode;
+
+void main(){
+	gl_Position =  MVP * vec4(vertexPosition_modelspace,1);
+	UV = vertexUV * uvDecode.xy + uvDecode.zw;
+}
+
+)VERTEX";
+
+// Vertex shader, instanced (shaders/TransformVertexShaderInstanced.vertexshader)
+const char* instancedVertexShaderSource = R"VERTEX(
+
+#version 330 core
+
+layout(location = 0) in vec3 vertexPosition_modelspace;
+layout(location = 1) in vec2 vertexUV;
+layout(location = 3) in mat4 instanceModel;
+layout(location = 7) in float instanceLayer;
+
+out vec2 UV;
+flat out float Layer;
+
+uniform mat4 VP;
+uniform mat4 positionDecode;
+uniform vec4 uvDecode;
+
+void main(){
+	gl_Position =  VP * instanceModel * positionDecode * vec4(vertexPosition_modelspace,1);
+	UV = vertexUV * uvDecode.xy + uvDecode.zw;
+	Layer = instanceLayer;
+}
+
+)VERTEX";
+
+// Fragment shader
+const char* fragmentShaderSource = R"FRAGMENT(
+
+#version 330 core
+
+in vec2 UV;
+
+out vec4 color;
+
+uniform sampler2D myTextureSampler;
+
+void main(){
+	color = texture( myTextureSampler, UV );
+}
+
+)FRAGMENT";
+
+// Fragment shader, texture array (shaders/TextureArrayFragmentShader.fragmentshader)
+const char* arrayFragmentShaderSource = R"FRAGMENT(
+
+#version 330 core
+
+in vec2 UV;
+flat in float Layer;
+
+out vec4 color;
+
+uniform sampler2DArray myTextureSampler;
+
+void main(){
+	color = texture( myTextureSampler, vec3(UV, Layer) );
+}
+
+)FRAGMENT";
+
+
+static void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, GL_TRUE);
+
+    if (key == GLFW_KEY_SPACE && action == GLFW_PRESS)
+        g_mode = (g_mode + 1) % DrawModeCount;
+}
+
+static void error_callback(int error, const char* description)
+{
+	fprintf(stderr, "Error: %s\n", description);
+}
+
+static void framebuffer_size_callback(GLFWwindow *window, int width, int height)
+{
+    g_width  = width;
+    g_height = height;
+}
+
+
+struct Object
+{
+    glm::vec3 position;
+    glm::vec3 axis;
+    float     spin;
+};
+
+int main(void)
+{
+	// res/ and shaders/ from one mapped file when the pack is built (AssetPackBuild.cpp)
+	mount_asset_pack("../res/resources.qpak");
+
+	glfwSetErrorCallback(error_callback);
+
+	if (!glfwInit())
+        exit(EXIT_FAILURE);
+
+	GLFWwindow *window = glfwCreateWindow(g_width, g_height, "Instanced stress", NULL, NULL);
+	if (!window)
+	{
+		glfwTerminate();
+		exit(EXIT_FAILURE);
+	}
+
+	glfwSetKeyCallback(window, key_callback);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+
+	glfwMakeContextCurrent(window);
+	gladLoadGL(glfwGetProcAddress);
+	glfwSwapInterval(0);
+
+    glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+
+    GLuint programID          = create_shader_program(vertexShaderSource, fragmentShaderSource);
+    GLuint instancedProgramID = create_shader_program(instancedVertexShaderSource, fragmentShaderSource);
+    GLuint arrayProgramID     = create_shader_program(instancedVertexShaderSource, arrayFragmentShaderSource);
+
+    GLuint MatrixID     = glGetUniformLocation(programID, "MVP");
+    GLuint UVDecodeID   = glGetUniformLocation(programID, "uvDecode");
+    GLuint TextureID    = glGetUniformLocation(programID, "myTextureSampler");
+
+    GLuint VPID              = glGetUniformLocation(instancedProgramID, "VP");
+    GLuint PosDecodeID       = glGetUniformLocation(instancedProgramID, "positionDecode");
+    GLuint InstUVDecodeID    = glGetUniformLocation(instancedProgramID, "uvDecode");
+    GLuint InstTextureID     = glGetUniformLocation(instancedProgramID, "myTextureSampler");
+
+    GLuint ArrayVPID         = glGetUniformLocation(arrayProgramID, "VP");
+    GLuint ArrayPosDecodeID  = glGetUniformLocation(arrayProgramID, "positionDecode");
+    GLuint ArrayUVDecodeID   = glGetUniformLocation(arrayProgramID, "uvDecode");
+    GLuint ArrayTextureID    = glGetUniformLocation(arrayProgramID, "myTextureSampler");
+
+    GeometryPool geometryPool(VertexLayout::InterleavedSnorm16, 1 << 16, 1 << 20);
+
+    GLMeshData sphere;
+    sphere.setGeometryPool(&geometryPool);
+    sphere.setOptimizeVertexCache(true);
+    sphere.createSphere(1.0f, 16, 12);
+
+    GLMeshData box;
+    box.setGeometryPool(&geometryPool);
+    box.createBox(1.5f, 1.5f, 1.5f);
+
+    // the balls as 15 textures, and as the 15 layers of one array
+    std::vector<std::string> ballPaths;
+    GLuint ballTextures[num_ball_textures];
+    for (int i = 0; i < num_ball_textures; ++i)
+    {
+        auto num = std::string(2 - std::to_string(i + 1).length(), '0') + std::to_string(i + 1);
+        ballPaths.push_back("../res/textures/pool/pool_" + num + ".ppm");
+        ballTextures[i] = UploadImage(ballPaths.back().c_str());
+    }
+    TextureArrays ballArray;
+    ballArray.load(ballPaths);
+    GLuint boxTexture    = UploadImage("../res/textures/PresentA_ALB.png");
+
+    // half spheres, half boxes, in a 400 unit cube
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> coord(-200.0f, 200.0f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    std::vector<Object> objects(num_instances);
+    for (Object &o : objects)
+    {
+        o.position = glm::vec3(coord(rng), coord(rng), coord(rng));
+        o.axis     = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + glm::vec3(0.0f, 0.01f, 0.0f));
+        o.spin     = unit(rng) * 2.0f;
+    }
+
+    const int numSpheres = num_instances / 2;
+    std::vector<glm::mat4> transforms(num_instances);
+
+    // the spheres grouped by array with their layers, a run of instances per array; the
+    // spheres grouped by texture for DrawInstanced
+    struct ArrayRun
+    {
+        int     array;
+        GLsizei first, count;
+    };
+    std::vector<int>      arrayOrder;
+    std::vector<GLfloat>  sphereLayers;
+    std::vector<ArrayRun> arrayRuns;
+    for (size_t a = 0; a < ballArray.arrayCount(); ++a)
+    {
+        arrayRuns.push_back({ (int)a, (GLsizei)arrayOrder.size(), 0 });
+        for (int i = 0; i < numSpheres; ++i)
+        {
+            const TextureArrays::Layer &layer = ballArray.layer(i % num_ball_textures);
+            if (layer.array != (int)a)
+                continue;
+            arrayOrder.push_back(i);
+            sphereLayers.push_back((GLfloat)layer.layer);
+            arrayRuns.back().count++;
+        }
+    }
+    std::vector<glm::mat4> sortedTransforms(numSpheres);
+
+    InstanceBuffer sphereInstances;
+    InstanceBuffer boxInstances;
+
+    double submitMs = 0.0, updateMs = 0.0;
+    long long binds = 0, draws = 0;
+    int frameCounter = 0;
+    double lastReport = glfwGetTime();
+
+    do
+    {
+        double now = glfwGetTime();
+
+        glm::vec3 camPos  = glm::vec3(std::cos(now * 0.1) * 450.0, 120.0, std::sin(now * 0.1) * 450.0);
+        glm::mat4 proj    = glm::perspective(0.25f * float(M_PI), float(g_width) / float(g_height), 0.25f, 4000.0f);
+        glm::mat4 vp      = proj * glm::lookAt(camPos, glm::vec3(0.0f), glm::vec3(0, 1, 0));
+
+        // same animation work in both modes, not part of the submit time
+        auto updateStart = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < num_instances; ++i)
+        {
+            const Object &o = objects[i];
+            transforms[i] = glm::rotate(glm::translate(glm::mat4(1.0f), o.position), float(now) * o.spin, o.axis);
+        }
+        updateMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - updateStart).count();
+
+        glViewport(0, 0, g_width, g_height);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        auto submitStart = std::chrono::high_resolution_clock::now();
+
+        geometryPool.bind();
+        glActiveTexture(GL_TEXTURE0);
+
+        if (g_mode == DrawPerObject)
+        {
+            glUseProgram(programID);
+            glUniform1i(TextureID, 0);
+
+            glUniform4fv(UVDecodeID, 1, glm::value_ptr(sphere.uvDecode()));
+            glm::mat4 sphereDecode = sphere.positionDecode();
+            for (int i = 0; i < numSpheres; ++i)
+            {
+                glBindTexture(GL_TEXTURE_2D, ballTextures[i % num_ball_textures]);
+                glm::mat4 mvp = vp * transforms[i] * sphereDecode;
+                glUniformMatrix4fv(MatrixID, 1, GL_FALSE, glm::value_ptr(mvp));
+                sphere.render();
+            }
+            binds += numSpheres;
+            draws += numSpheres;
+
+            glBindTexture(GL_TEXTURE_2D, boxTexture);
+            glUniform4fv(UVDecodeID, 1, glm::value_ptr(box.uvDecode()));
+            glm::mat4 boxDecode = box.positionDecode();
+            for (int i = numSpheres; i < num_instances; ++i)
+            {
+                glm::mat4 mvp = vp * transforms[i] * boxDecode;
+                glUniformMatrix4fv(MatrixID, 1, GL_FALSE, glm::value_ptr(mvp));
+                box.render();
+            }
+            binds += 1;
+            draws += num_instances - numSpheres;
+        }
+        else
+        {
+            glUseProgram(instancedProgramID);
+            glUniformMatrix4fv(VPID, 1, GL_FALSE, glm::value_ptr(vp));
+            glUniform1i(InstTextureID, 0);
+
+            boxInstances.upload(transforms.data() + numSpheres, num_instances - numSpheres);
+            glBindTexture(GL_TEXTURE_2D, boxTexture);
+            glUniformMatrix4fv(PosDecodeID, 1, GL_FALSE, glm::value_ptr(box.positionDecode()));
+            glUniform4fv(InstUVDecodeID, 1, glm::value_ptr(box.uvDecode()));
+            box.renderInstanced(boxInstances);
+            binds += 1;
+            draws += 1;
+
+            if (g_mode == DrawInstanced)
+            {
+                // one run of instances per texture, drawn from its offset in the buffer
+                GLsizei runStart[num_ball_textures + 1];
+                GLsizei n = 0;
+                for (int t = 0; t < num_ball_textures; ++t)
+                {
+                    runStart[t] = n;
+                    for (int i = t; i < numSpheres; i += num_ball_textures)
+                        sortedTransforms[n++] = transforms[i];
+                }
+                runStart[num_ball_textures] = n;
+                sphereInstances.upload(sortedTransforms.data(), numSpheres);
+
+                glUniformMatrix4fv(PosDecodeID, 1, GL_FALSE, glm::value_ptr(sphere.positionDecode()));
+                glUniform4fv(InstUVDecodeID, 1, glm::value_ptr(sphere.uvDecode()));
+                for (int t = 0; t < num_ball_textures; ++t)
+                {
+                    glBindTexture(GL_TEXTURE_2D, ballTextures[t]);
+                    sphere.renderInstanced(sphereInstances.buffer(), runStart[t + 1] - runStart[t], sizeof(glm::mat4) * runStart[t]);
+                }
+                binds += num_ball_textures;
+                draws += num_ball_textures;
+            }
+            else
+            {
+                for (size_t n = 0; n < arrayOrder.size(); ++n)
+                    sortedTransforms[n] = transforms[arrayOrder[n]];
+                sphereInstances.upload(sortedTransforms.data(), (GLsizei)arrayOrder.size(), sphereLayers.data());
+
+                glUseProgram(arrayProgramID);
+                glUniformMatrix4fv(ArrayVPID, 1, GL_FALSE, glm::value_ptr(vp));
+                glUniform1i(ArrayTextureID, 0);
+                glUniformMatrix4fv(ArrayPosDecodeID, 1, GL_FALSE, glm::value_ptr(sphere.positionDecode()));
+                glUniform4fv(ArrayUVDecodeID, 1, glm::value_ptr(sphere.uvDecode()));
+                for (const ArrayRun &run : arrayRuns)
+                {
+                    glBindTexture(GL_TEXTURE_2D_ARRAY, ballArray.texture(run.array));
+                    sphere.renderInstanced(sphereInstances.buffer(), run.count, sizeof(glm::mat4) * run.first, sphereInstances.layerBuffer());
+                }
+                glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+                binds += arrayRuns.size();
+                draws += arrayRuns.size();
+            }
+        }
+
+        geometryPool.unbind();
+
+        submitMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - submitStart).count();
+        frameCounter++;
+
+        if (now - lastReport >= 1.0)
+        {
+            char title[256];
+            snprintf(title, sizeof(title), "%s: %d objects, %lld binds %lld draws/frame, submit %.3f ms/frame, update %.3f ms/frame, %d fps",
+                     drawModeNames[g_mode], num_instances, binds / frameCounter, draws / frameCounter,
+                     submitMs / frameCounter, updateMs / frameCounter, frameCounter);
+            printf("%s\n", title);
+            glfwSetWindowTitle(window, title);
+
+            lastReport = now;
+            submitMs = updateMs = 0.0;
+            binds = draws = 0;
+            frameCounter = 0;
+        }
+
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    } while (glfwWindowShouldClose(window) == 0);
+
+    return 0;
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <cstring>
+#include <vector>
+
+// LZ4 block format (no frame header), for the entries of asset packs (AssetPack.cpp).
+// The compressor is the greedy single hash table one of the reference implementation's
+// fast mode, the decompressor checks every length and offset against both buffers, so a
+// corrupt pack fails instead of reading or writing out of bounds.
+//
+//   std::vector<uint8_t> packed(lz4_bound(size));
+//   packed.resize(lz4_compress(data, size, packed.data()));
+//   if (!lz4_decompress(packed.data(), packed.size(), out, size)) ...
+
+static const int kLz4HashBits = 16;
+static const int kLz4MinMatch = 4;
+static const size_t kLz4LastLiterals = 5;  // the block always ends with this many literals
+static const size_t kLz4MatchLimit = 12;   // and no match starts in its last 12 bytes
+
+static size_t lz4_bound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+static uint32_t lz4_read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static uint32_t lz4_hash(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - kLz4HashBits);
+}
+
+static uint8_t *lz4_write_length(uint8_t *dst, size_t length)
+{
+    for (; length >= 255; length -= 255)
+        *dst++ = 255;
+    *dst++ = (uint8_t)length;
+    return dst;
+}
+
+static uint8_t *lz4_write_sequence(uint8_t *dst, const uint8_t *literals, size_t literalLength, size_t offset, size_t matchLength)
+{
+    uint8_t *token = dst++;
+    *token = (uint8_t)((literalLength < 15 ? literalLength : 15) << 4);
+    if (literalLength >= 15)
+        dst = lz4_write_length(dst, literalLength - 15);
+    if (literalLength)
+        memcpy(dst, literals, literalLength);
+    dst += literalLength;
+    if (!matchLength)
+        return dst;
+
+    *dst++ = (uint8_t)offset;
+    *dst++ = (uint8_t)(offset >> 8);
+    matchLength -= kLz4MinMatch;
+    *token |= (uint8_t)(matchLength < 15 ? matchLength : 15);
+    if (matchLength >= 15)
+        dst = lz4_write_length(dst, matchLength - 15);
+    return dst;
+}
+
+// dst must hold lz4_bound(size) bytes, returns the compressed size
+static size_t lz4_compress(const uint8_t *src, size_t size, uint8_t *dst)
+{
+    const uint8_t *anchor = src, *ip = src, *end = src + size;
+    uint8_t *out = dst;
+    if (size > kLz4MatchLimit)
+    {
+        std::vector<uint32_t> table((size_t)1 << kLz4HashBits, 0);
+        const uint8_t *matchLimit = end - kLz4MatchLimit, *literalLimit = end - kLz4LastLiterals;
+        while (ip < matchLimit)
+        {
+            uint32_t v = lz4_read32(ip);
+            uint32_t &slot = table[lz4_hash(v)];
+            const uint8_t *candidate = src + slot;
+            slot = (uint32_t)(ip - src);
+            if (candidate >= ip || ip - candidate > 65535 || lz4_read32(candidate) != v)
+            {
+                // skip faster through data that doesn't compress
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            while (ip > anchor && candidate > src && ip[-1] == candidate[-1])
+            {
+                --ip;
+                --candidate;
+            }
+            size_t length = kLz4MinMatch;
+            while (ip + length < literalLimit && ip[length] == candidate[length])
+                ++length;
+
+            out = lz4_write_sequence(out, anchor, ip - anchor, ip - candidate, length);
+            ip += length;
+            anchor = ip;
+            if (ip < matchLimit)
+                table[lz4_hash(lz4_read32(ip - 2))] = (uint32_t)(ip - 2 - src);
+        }
+    }
+    out = lz4_write_sequence(out, anchor, end - anchor, 0, 0);
+    return out - dst;
+}
+
+static bool lz4_read_length(const uint8_t *&src, const uint8_t *end, size_t &length)
+{
+    for (;;)
+    {
+        if (src == end)
+            return false;
+        uint8_t byte = *src++;
+        length += byte;
+        if (byte != 255)
+            return true;
+    }
+}
+
+// decompresses exactly dstSize bytes, false when the data is corrupt or doesn't fill dst
+static bool lz4_decompress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstSize)
+{
+    const uint8_t *end = src + srcSize;
+    uint8_t *out = dst, *outEnd = dst + dstSize;
+    while (src < end)
+    {
+        uint8_t token = *src++;
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !lz4_read_length(src, end, literalLength))
+            return false;
+        if (literalLength > (size_t)(end - src) || literalLength > (size_t)(outEnd - out))
+            return false;
+        // short runs as one fixed size copy where both buffers have the room
+        if (literalLength <= 16 && end - src >= 16 && outEnd - out >= 16)
+            memcpy(out, src, 16);
+        else
+            memcpy(out, src, literalLength);
+        src += literalLength;
+        out += literalLength;
+        if (src == end)
+            break;
+
+        if (end - src < 2)
+            return false;
+        size_t offset = src[0] | (size_t)src[1] << 8;
+        src += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !lz4_read_length(src, end, matchLength))
+            return false;
+        matchLength += kLz4MinMatch;
+        if (!offset || offset > (size_t)(out - dst) || matchLength > (size_t)(outEnd - out))
+            return false;
+
+        const uint8_t *match = out - offset;
+        if (offset >= 16 && matchLength + 16 <= (size_t)(outEnd - out))
+        {
+            // 16 bytes at a time, may write up to 15 past the match
+            for (size_t i = 0; i < matchLength; i += 16)
+                memcpy(out + i, match + i, 16);
+            out += matchLength;
+        }
+        else if (matchLength + 8 <= (size_t)(outEnd - out))
+        {
+            // a repeating pattern (runs of one pixel in images) repeats every multiple of
+            // its period too: the first one byte by byte, then 8 bytes from that far back
+            size_t period = offset;
+            while (period < 8)
+                period += offset;
+            size_t i = 0;
+            for (; i < period && i < matchLength; ++i)
+                out[i] = match[i];
+            for (; i < matchLength; i += 8)
+                memcpy(out + i, out + i - period, 8);
+            out += matchLength;
+        }
+        else
+        {
+            for (size_t i = 0; i < matchLength; ++i)
+                out[i] = match[i];
+            out += matchLength;
+        }
+    }
+    return out == outEnd;
+}
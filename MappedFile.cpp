@@ -0,0 +1,156 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file. Pages are read on first touch, so opening is
+// cheap whatever the size, and a file already in the page cache costs no copy at all.
+//
+//   MappedFile file;
+//   if (file.open("../res/baked/crate.qtex")) use(file.data(), file.size());
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	bool open(const char *path);
+	void close();
+
+	const uint8_t *data() const { return bytes; }
+	size_t size() const { return length; }
+	bool isOpen() const { return bytes != nullptr; }
+
+	// asks the OS to drop the file from its cache, for cold start measurements
+	static void dropFromCache(const char *path);
+
+private:
+	const uint8_t *bytes;
+	size_t length;
+#ifdef _WIN32
+	HANDLE file, mapping;
+#endif
+};
+
+
+MappedFile::MappedFile()
+{
+	bytes = nullptr;
+	length = 0;
+#ifdef _WIN32
+	file = mapping = nullptr;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char *path)
+{
+	close();
+	file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		file = nullptr;
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	bytes = mapping ? (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!bytes)
+	{
+		close();
+		return false;
+	}
+	length = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (bytes)
+		UnmapViewOfFile(bytes);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file)
+		CloseHandle(file);
+	bytes = nullptr;
+	length = 0;
+	file = mapping = nullptr;
+}
+
+void MappedFile::dropFromCache(const char *)
+{
+	// no per file equivalent without admin rights
+}
+
+#else
+
+bool MappedFile::open(const char *path)
+{
+	close();
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void *mapped = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (mapped == MAP_FAILED)
+		return false;
+
+	bytes = (const uint8_t*)mapped;
+	length = (size_t)st.st_size;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (bytes)
+		munmap((void*)bytes, length);
+	bytes = nullptr;
+	length = 0;
+}
+
+void MappedFile::dropFromCache(const char *path)
+{
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return;
+#ifdef POSIX_FADV_DONTNEED
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+	::close(fd);
+}
+
+#endif
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#ifndef M_PI
+#define M_PI 3.141592653589793238462
+#endif
+
+// Exact-size procedural mesh generation.
+// Every generator has a *Counts() function returning the vertex/index totals up front
+// and a write*() function that fills caller-provided arrays, so nothing reallocates
+// while generating. Sphere rows are independent, so big spheres are written by
+// several threads, each owning a band of rows.
+namespace MeshBuilder
+{
+
+struct Counts
+{
+	uint32_t vertices;
+	uint32_t indices;
+};
+
+// destination arrays, pos = 3 floats, uv = 2 floats per vertex
+struct Spans
+{
+	GLfloat *pos;
+	GLfloat *uv;
+	GLuint  *index;
+};
+
+// a band of rows is only worth a thread when it has this many vertices
+const uint32_t minVerticesPerThread = 1 << 16;
+
+inline uint32_t threadCountFor(uint32_t vertices, uint32_t rows)
+{
+	uint32_t hw = std::max(1u, std::thread::hardware_concurrency());
+	uint32_t byWork = std::max(1u, vertices / minVerticesPerThread);
+	return std::min(std::min(hw, byWork), std::max(1u, rows));
+}
+
+// runs fn(rowBegin, rowEnd) over [0, rows) split into numThreads contiguous bands
+template <typename RowFn>
+void forEachRowBand(uint32_t rows, uint32_t numThreads, RowFn fn)
+{
+	if (numThreads <= 1 || rows < 2)
+	{
+		fn(0u, rows);
+		return;
+	}
+
+	numThreads = std::min(numThreads, rows);
+	std::vector<std::thread> workers;
+	workers.reserve(numThreads - 1);
+
+	for (uint32_t t = 1; t < numThreads; ++t)
+	{
+		uint32_t begin = (uint32_t)((uint64_t)rows * t / numThreads);
+		uint32_t end   = (uint32_t)((uint64_t)rows * (t + 1) / numThreads);
+		workers.emplace_back(fn, begin, end);
+	}
+	fn(0u, (uint32_t)((uint64_t)rows / numThreads));
+
+	for (std::thread &worker : workers)
+		worker.join();
+}
+
+
+inline Counts sphereCounts(uint32_t hSegs, uint32_t vSegs)
+{
+	return { (hSegs + 1) * (vSegs + 1), hSegs * vSegs * 6 };
+}
+
+// writes vertex rows and quad rows [rowBegin, rowEnd) of a sphere, rows go up to vSegs (inclusive for vertices)
+inline void writeSphereRows(const Spans &out, float rad, uint32_t hSegs, uint32_t vSegs, uint32_t rowBegin, uint32_t rowEnd)
+{
+	float dphi = (float)(2.0*M_PI) / (float)(hSegs);
+	float dtheta = (float)(M_PI) / (float)(vSegs);
+
+	for (uint32_t v = rowBegin; v < rowEnd && v <= vSegs; ++v)
+	{
+		float theta = v * dtheta;
+
+		GLfloat *pos = out.pos + (size_t)v * (hSegs + 1) * 3;
+		GLfloat *uv  = out.uv  + (size_t)v * (hSegs + 1) * 2;
+
+		for (uint32_t h = 0; h <= hSegs; ++h)
+		{
+			float phi = h * dphi;
+
+			float x = std::sin(theta) * std::cos(phi);
+			float y = std::cos(theta);
+			float z = std::sin(theta) * std::sin(phi);
+
+			*pos++ = rad * x; *pos++ = rad * y; *pos++ = rad * z;
+			*uv++ = 1.0f - (float)h / hSegs; *uv++ = (float)v / vSegs;
+		}
+	}
+
+	for (uint32_t v = rowBegin; v < rowEnd && v < vSegs; v++)
+	{
+		GLuint *index = out.index + (size_t)v * hSegs * 6;
+
+		for (uint32_t h = 0; h < hSegs; h++)
+		{
+			uint32_t topRight = v * (hSegs + 1) + h;
+			uint32_t topLeft = v * (hSegs + 1) + h + 1;
+			uint32_t lowerRight = (v + 1) * (hSegs + 1) + h;
+			uint32_t lowerLeft = (v + 1) * (hSegs + 1) + h + 1;
+
+			*index++ = lowerLeft; *index++ = lowerRight; *index++ = topRight;
+			*index++ = lowerLeft; *index++ = topRight;   *index++ = topLeft;
+		}
+	}
+}
+
+// numThreads 0 picks a count from the mesh size
+inline void writeSphere(const Spans &out, float rad, uint32_t hSegs, uint32_t vSegs, uint32_t numThreads = 0)
+{
+	uint32_t rows = vSegs + 1;
+	if (numThreads == 0)
+		numThreads = threadCountFor(sphereCounts(hSegs, vSegs).vertices, rows);
+
+	forEachRowBand(rows, numThreads, [&](uint32_t rowBegin, uint32_t rowEnd)
+	{
+		writeSphereRows(out, rad, hSegs, vSegs, rowBegin, rowEnd);
+	});
+}
+
+
+inline Counts coneCounts(uint32_t segments)
+{
+	return { segments + 2, segments * 6 };
+}
+
+inline void writeCone(const Spans &out, float radius, float height, uint32_t segments)
+{
+	GLfloat *pos = out.pos;
+	GLfloat *uv = out.uv;
+	GLuint *index = out.index;
+
+	// base circle
+	for (uint32_t i = 0; i <= segments; ++i)
+	{
+		float angle = 2.0f * M_PI * i / segments;
+		float x = radius * std::cos(angle);
+		float z = radius * std::sin(angle);
+
+		*pos++ = x; *pos++ = 0; *pos++ = z;
+		*uv++ = (float)i / segments; *uv++ = 0;
+	}
+
+	// apex
+	*pos++ = 0; *pos++ = height; *pos++ = 0;
+	*uv++ = 0.5f; *uv++ = 1.0f;
+
+	// base triangles, a fan around the first rim vertex (the i == 0 one is degenerate)
+	for (uint32_t i = 0; i < segments; ++i)
+	{
+		*index++ = 0; *index++ = i; *index++ = i + 1;
+	}
+
+	// side triangles
+	uint32_t apexIndex = segments + 1;
+	for (uint32_t i = 0; i < segments; ++i)
+	{
+		*index++ = i; *index++ = apexIndex; *index++ = i + 1;
+	}
+}
+
+
+inline Counts cylinderCounts(uint32_t segments)
+{
+	return { (segments + 1) * 2, segments * 12 };
+}
+
+inline void writeCylinder(const Spans &out, float radius, float height, uint32_t segments)
+{
+	GLfloat *pos = out.pos;
+	GLfloat *uv = out.uv;
+	GLuint *index = out.index;
+
+	// bottom circle, then top circle
+	for (uint32_t ring = 0; ring < 2; ++ring)
+	{
+		for (uint32_t i = 0; i <= segments; ++i)
+		{
+			float angle = 2.0f * M_PI * i / segments;
+			float x = radius * std::cos(angle);
+			float z = radius * std::sin(angle);
+
+			*pos++ = x; *pos++ = ring ? height : 0; *pos++ = z;
+			*uv++ = (float)i / segments; *uv++ = (float)ring;
+		}
+	}
+
+	// bottom triangles, a fan around the first rim vertex (the i == 0 one is degenerate)
+	for (uint32_t i = 0; i < segments; ++i)
+	{
+		*index++ = 0; *index++ = i; *index++ = i + 1;
+	}
+
+	// top triangles
+	uint32_t topStart = segments + 1;
+	for (uint32_t i = 0; i < segments; ++i)
+	{
+		*index++ = topStart; *index++ = topStart + i; *index++ = topStart + i + 1;
+	}
+
+	// side triangles
+	for (uint32_t i = 0; i < segments; ++i)
+	{
+		uint32_t bottomLeft = i;
+		uint32_t bottomRight = i + 1;
+		uint32_t topLeft = topStart + i;
+		uint32_t topRight = topStart + i + 1;
+
+		*index++ = bottomLeft;  *index++ = topLeft; *index++ = bottomRight;
+		*index++ = bottomRight; *index++ = topLeft; *index++ = topRight;
+	}
+}
+
+
+inline Counts circleCounts(uint32_t segments)
+{
+	return { segments + 2, segments * 3 };
+}
+
+inline void writeCircle(const Spans &out, float radius, uint32_t segments)
+{
+	GLfloat *pos = out.pos;
+	GLfloat *uv = out.uv;
+	GLuint *index = out.index;
+
+	// center vertex
+	*pos++ = 0.0f; *pos++ = 0.0f; *pos++ = 0.0f;
+	*uv++ = 0.5f; *uv++ = 0.5f;
+
+	for (uint32_t i = 0; i <= segments; ++i)
+	{
+		float angle = 2.0f * M_PI * i / segments;
+		float x = radius * std::cos(angle);
+		float y = radius * std::sin(angle);
+
+		*pos++ = x; *pos++ = y; *pos++ = 0.0f;
+
+		float u = (std::cos(angle) + 1.0f) * 0.5f;
+		float v = (std::sin(angle) + 1.0f) * 0.5f;
+		*uv++ = u; *uv++ = v;
+	}
+
+	for (uint32_t i = 1; i <= segments; ++i)
+	{
+		*index++ = 0; *index++ = i; *index++ = i + 1;
+	}
+}
+
+} // namespace MeshBuilder
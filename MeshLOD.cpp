@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "GLMeshData.cpp"
+
+// Discrete LOD chain for the procedural primitives: level 0 is the requested
+// tessellation, every further level regenerates with half the segments.
+// selectLOD() picks the coarsest level whose edges still stay under
+// targetEdgePixels on screen.
+class GLMeshLODChain
+{
+public:
+	GLMeshLODChain();
+
+	// applied to every level before it is generated (layout, pool, optimizer, ...)
+	void setLevelSetup(std::function<void(GLMeshData &)> setup) { levelSetup = setup; }
+	void setTargetEdgePixels(float pixels) { targetEdgePixels = pixels; }
+
+	void createSphere(float rad, uint32_t hSegs, uint32_t vSegs, uint32_t maxLevels = 5);
+	void createCylinder(float radius, float height, uint32_t segments, uint32_t maxLevels = 5);
+
+	// center is the world position of the object, scale its uniform world scale
+	uint32_t selectLOD(const glm::vec3 &center, float scale, const glm::mat4 &proj, const glm::vec3 &camPos, float viewportHeight) const;
+
+	uint32_t levelCount() const { return (uint32_t)levels.size(); }
+	GLMeshData &level(uint32_t lod) { return *levels[lod]; }
+	uint32_t triangleCount(uint32_t lod) const { return (uint32_t)(levels[lod]->indices().size() / 3); }
+
+	void render(uint32_t lod) { levels[lod]->render(); }
+
+private:
+	GLMeshData &addLevel(uint32_t segments);
+
+	std::vector<std::unique_ptr<GLMeshData>> levels;
+	std::vector<uint32_t> levelSegments; // around the circumference
+	std::function<void(GLMeshData &)> levelSetup;
+
+	float boundingRadius;
+	float targetEdgePixels;
+};
+
+
+GLMeshLODChain::GLMeshLODChain()
+{
+	boundingRadius = 0.0f;
+	targetEdgePixels = 8.0f;
+}
+
+GLMeshData &GLMeshLODChain::addLevel(uint32_t segments)
+{
+	levels.emplace_back(new GLMeshData());
+	levelSegments.push_back(segments);
+
+	GLMeshData &mesh = *levels.back();
+	if (levelSetup)
+		levelSetup(mesh);
+	return mesh;
+}
+
+void GLMeshLODChain::createSphere(float rad, uint32_t hSegs, uint32_t vSegs, uint32_t maxLevels)
+{
+	boundingRadius = rad;
+
+	for (uint32_t lod = 0; lod < maxLevels && hSegs >= 4 && vSegs >= 2; ++lod)
+	{
+		addLevel(hSegs).createSphere(rad, hSegs, vSegs);
+		hSegs /= 2;
+		vSegs /= 2;
+	}
+}
+
+void GLMeshLODChain::createCylinder(float radius, float height, uint32_t segments, uint32_t maxLevels)
+{
+	boundingRadius = std::sqrt(radius * radius + height * height * 0.25f);
+
+	for (uint32_t lod = 0; lod < maxLevels && segments >= 4; ++lod)
+	{
+		addLevel(segments).createCylinder(radius, height, segments);
+		segments /= 2;
+	}
+}
+
+uint32_t GLMeshLODChain::selectLOD(const glm::vec3 &center, float scale, const glm::mat4 &proj, const glm::vec3 &camPos, float viewportHeight) const
+{
+	if (levels.size() < 2)
+		return 0;
+
+	float radius = boundingRadius * scale;
+	float distance = glm::length(center - camPos);
+	if (distance <= radius)
+		return 0;
+
+	// proj[1][1] = cot(fovy / 2), so this is the projected diameter in pixels
+	float screenDiameter = 2.0f * radius * proj[1][1] / distance * viewportHeight * 0.5f;
+	float neededSegments = float(M_PI) * screenDiameter / targetEdgePixels;
+
+	// coarsest level that still has enough segments
+	for (uint32_t lod = (uint32_t)levels.size() - 1; lod > 0; --lod)
+		if ((float)levelSegments[lod] >= neededSegments)
+			return lod;
+
+	return 0;
+}
@@ -0,0 +1,334 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// CPU index/vertex reordering for triangle lists.
+//   optimizeVertexCache  - Forsyth's linear-speed triangle order for the post-transform cache
+//   optimizeOverdraw     - Tipsify-style: splits the cache order into clusters and sorts them
+//                          outside-in, as long as the ACMR stays within a threshold
+//   optimizeVertexFetch  - renumbers vertices in first-use order for linear fetches
+//   analyzeVertexCache   - ACMR (transforms per triangle) and ATVR (transforms per vertex)
+//                          on a simulated FIFO cache
+namespace MeshOptimizer
+{
+
+struct CacheStats
+{
+	float acmr;
+	float atvr;
+};
+
+struct Report
+{
+	CacheStats before;
+	CacheStats after;
+	double milliseconds;
+};
+
+const uint32_t kAnalyzeCacheSize = 16; // FIFO, roughly what current GPUs behave like
+const int      kForsythCacheSize = 32; // LRU modelled by the Forsyth scoring
+
+inline CacheStats analyzeVertexCache(const GLuint *indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize = kAnalyzeCacheSize)
+{
+	std::vector<uint32_t> cacheTimestamp(vertexCount, 0);
+	uint32_t timestamp = cacheSize + 1;
+	uint32_t misses = 0;
+
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		GLuint v = indices[i];
+		// in cache if it entered within the last cacheSize misses
+		if (timestamp - cacheTimestamp[v] > cacheSize)
+		{
+			cacheTimestamp[v] = timestamp++;
+			++misses;
+		}
+	}
+
+	CacheStats stats;
+	stats.acmr = indexCount ? (float)misses / (float)(indexCount / 3) : 0.0f;
+	stats.atvr = vertexCount ? (float)misses / (float)vertexCount : 0.0f;
+	return stats;
+}
+
+
+namespace detail
+{
+	const int kMaxValenceScore = 32;
+
+	struct ScoreTables
+	{
+		float cache[kForsythCacheSize];
+		float valence[kMaxValenceScore];
+
+		ScoreTables()
+		{
+			const float lastTriScore = 0.75f;
+			const float decayPower   = 1.5f;
+			const float valenceScale = 2.0f;
+			const float valencePower = 0.5f;
+
+			for (int i = 0; i < kForsythCacheSize; ++i)
+			{
+				if (i < 3)
+					cache[i] = lastTriScore;
+				else
+					cache[i] = std::pow(1.0f - (float)(i - 3) / (kForsythCacheSize - 3), decayPower);
+			}
+
+			valence[0] = 0.0f;
+			for (int i = 1; i < kMaxValenceScore; ++i)
+				valence[i] = valenceScale * std::pow((float)i, -valencePower);
+		}
+	};
+
+	inline float vertexScore(int cachePos, uint32_t remainingValence)
+	{
+		static const ScoreTables tables;
+
+		if (remainingValence == 0)
+			return -1.0f;
+
+		float score = cachePos >= 0 ? tables.cache[cachePos] : 0.0f;
+		score += tables.valence[std::min<uint32_t>(remainingValence, kMaxValenceScore - 1)];
+		return score;
+	}
+}
+
+// reorders the triangles of indices in place
+inline void optimizeVertexCache(GLuint *indices, size_t indexCount, uint32_t vertexCount)
+{
+	size_t triCount = indexCount / 3;
+	if (triCount == 0)
+		return;
+
+	// vertex -> triangle adjacency
+	std::vector<uint32_t> valence(vertexCount, 0);
+	for (size_t i = 0; i < indexCount; ++i)
+		valence[indices[i]]++;
+
+	std::vector<uint32_t> adjOffset(vertexCount + 1, 0);
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		adjOffset[v + 1] = adjOffset[v] + valence[v];
+
+	std::vector<uint32_t> adjacency(indexCount);
+	std::vector<uint32_t> fill(adjOffset.begin(), adjOffset.end() - 1);
+	for (size_t t = 0; t < triCount; ++t)
+		for (int k = 0; k < 3; ++k)
+			adjacency[fill[indices[t * 3 + k]]++] = (uint32_t)t;
+
+	std::vector<int>   cachePos(vertexCount, -1);
+	std::vector<float> vScore(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		vScore[v] = detail::vertexScore(-1, valence[v]);
+
+	std::vector<float> tScore(triCount);
+	std::vector<char>  emitted(triCount, 0);
+	for (size_t t = 0; t < triCount; ++t)
+		tScore[t] = vScore[indices[t * 3]] + vScore[indices[t * 3 + 1]] + vScore[indices[t * 3 + 2]];
+
+	std::vector<GLuint> output(indexCount);
+	std::vector<GLuint> cache, newCache;
+	cache.reserve(kForsythCacheSize + 3);
+	newCache.reserve(kForsythCacheSize + 3);
+
+	size_t scanCursor = 0;
+	size_t bestTri = (size_t)-1;
+
+	for (size_t outTri = 0; outTri < triCount; ++outTri)
+	{
+		if (bestTri == (size_t)-1)
+		{
+			// nothing adjacent to the cache, restart at the next unemitted triangle
+			while (emitted[scanCursor])
+				scanCursor++;
+			bestTri = scanCursor;
+		}
+
+		emitted[bestTri] = 1;
+		const GLuint *tri = indices + bestTri * 3;
+		output[outTri * 3 + 0] = tri[0];
+		output[outTri * 3 + 1] = tri[1];
+		output[outTri * 3 + 2] = tri[2];
+
+		// the emitted triangle's vertices go to the front of the LRU
+		newCache.assign(tri, tri + 3);
+		for (GLuint v : cache)
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newCache.push_back(v);
+
+		// emitted triangles stay in the adjacency lists and are skipped, valence counts what's left
+		for (int k = 0; k < 3; ++k)
+			valence[tri[k]]--;
+
+		for (size_t i = 0; i < newCache.size(); ++i)
+		{
+			GLuint v = newCache[i];
+			cachePos[v] = i < (size_t)kForsythCacheSize ? (int)i : -1;
+		}
+
+		// rescore everything that was or is in the cache, and their triangles
+		float bestScore = -1e30f;
+		bestTri = (size_t)-1;
+		for (size_t i = 0; i < newCache.size(); ++i)
+		{
+			GLuint v = newCache[i];
+			float newScore = detail::vertexScore(cachePos[v], valence[v]);
+			float delta = newScore - vScore[v];
+			vScore[v] = newScore;
+
+			// fan centers (caps) touch thousands of triangles, walking them every step makes
+			// the pass quadratic. Their triangles keep a stale score and get picked up through
+			// their other, low valence vertices instead.
+			if (valence[v] >= (uint32_t)detail::kMaxValenceScore)
+				continue;
+
+			for (uint32_t a = adjOffset[v]; a < adjOffset[v + 1]; ++a)
+			{
+				uint32_t t = adjacency[a];
+				if (emitted[t])
+					continue;
+
+				tScore[t] += delta;
+				if (tScore[t] > bestScore)
+				{
+					bestScore = tScore[t];
+					bestTri = t;
+				}
+			}
+		}
+
+		if (newCache.size() > (size_t)kForsythCacheSize)
+			newCache.resize(kForsythCacheSize);
+		cache.swap(newCache);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+// reorders clusters of a cache-optimized index list so outward facing clusters come
+// first, accepted only when the resulting ACMR is at most threshold x the input ACMR
+inline void optimizeOverdraw(GLuint *indices, size_t indexCount, const GLfloat *pos, uint32_t vertexCount, float threshold = 1.05f)
+{
+	size_t triCount = indexCount / 3;
+	if (triCount < 2)
+		return;
+
+	// cluster boundaries where the simulated cache misses the whole triangle
+	std::vector<size_t> clusterStart;
+	{
+		std::vector<uint32_t> cacheTimestamp(vertexCount, 0);
+		uint32_t timestamp = kAnalyzeCacheSize + 1;
+
+		for (size_t t = 0; t < triCount; ++t)
+		{
+			int misses = 0;
+			for (int k = 0; k < 3; ++k)
+			{
+				GLuint v = indices[t * 3 + k];
+				if (timestamp - cacheTimestamp[v] > kAnalyzeCacheSize)
+				{
+					cacheTimestamp[v] = timestamp++;
+					++misses;
+				}
+			}
+			if (t == 0 || misses == 3)
+				clusterStart.push_back(t);
+		}
+	}
+	if (clusterStart.size() < 2)
+		return;
+
+	auto position = [pos](GLuint v) { return glm::vec3(pos[v * 3], pos[v * 3 + 1], pos[v * 3 + 2]); };
+
+	glm::vec3 meshCenter(0.0f);
+	for (size_t i = 0; i < indexCount; ++i)
+		meshCenter += position(indices[i]);
+	meshCenter /= (float)indexCount;
+
+	struct Cluster
+	{
+		size_t begin, end;
+		float  sortKey;
+	};
+	std::vector<Cluster> clusters(clusterStart.size());
+
+	for (size_t c = 0; c < clusterStart.size(); ++c)
+	{
+		Cluster &cluster = clusters[c];
+		cluster.begin = clusterStart[c];
+		cluster.end   = c + 1 < clusterStart.size() ? clusterStart[c + 1] : triCount;
+
+		// area weighted normal and centroid
+		glm::vec3 normal(0.0f), centroid(0.0f);
+		float area = 0.0f;
+		for (size_t t = cluster.begin; t < cluster.end; ++t)
+		{
+			glm::vec3 a = position(indices[t * 3]), b = position(indices[t * 3 + 1]), c2 = position(indices[t * 3 + 2]);
+			glm::vec3 n = glm::cross(b - a, c2 - a);
+			float triArea = glm::length(n);
+			normal   += n;
+			centroid += (a + b + c2) * (triArea / 3.0f);
+			area     += triArea;
+		}
+		centroid = area > 0.0f ? centroid / area : position(indices[cluster.begin * 3]);
+		float normalLength = glm::length(normal);
+
+		cluster.sortKey = normalLength > 0.0f ? glm::dot(centroid - meshCenter, normal / normalLength) : 0.0f;
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster &a, const Cluster &b) { return a.sortKey > b.sortKey; });
+
+	std::vector<GLuint> sorted;
+	sorted.reserve(indexCount);
+	for (const Cluster &cluster : clusters)
+		sorted.insert(sorted.end(), indices + cluster.begin * 3, indices + cluster.end * 3);
+
+	float acmrBefore = analyzeVertexCache(indices, indexCount, vertexCount).acmr;
+	float acmrAfter  = analyzeVertexCache(sorted.data(), indexCount, vertexCount).acmr;
+	if (acmrAfter <= acmrBefore * threshold)
+		std::copy(sorted.begin(), sorted.end(), indices);
+}
+
+// renumbers vertices in order of first use and permutes pos/uv to match,
+// unreferenced vertices keep their relative order at the end
+inline void optimizeVertexFetch(GLuint *indices, size_t indexCount, std::vector<GLfloat> &pos, std::vector<GLfloat> &uv)
+{
+	uint32_t vertexCount = (uint32_t)(pos.size() / 3);
+	const GLuint unassigned = 0xffffffffu;
+
+	std::vector<GLuint> remap(vertexCount, unassigned);
+	GLuint next = 0;
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		GLuint &target = remap[indices[i]];
+		if (target == unassigned)
+			target = next++;
+		indices[i] = target;
+	}
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		if (remap[v] == unassigned)
+			remap[v] = next++;
+
+	std::vector<GLfloat> newPos(pos.size()), newUV(uv.size());
+	for (uint32_t v = 0; v < vertexCount; ++v)
+	{
+		GLuint n = remap[v];
+		newPos[n * 3 + 0] = pos[v * 3 + 0];
+		newPos[n * 3 + 1] = pos[v * 3 + 1];
+		newPos[n * 3 + 2] = pos[v * 3 + 2];
+		newUV[n * 2 + 0] = uv[v * 2 + 0];
+		newUV[n * 2 + 1] = uv[v * 2 + 1];
+	}
+	pos.swap(newPos);
+	uv.swap(newUV);
+}
+
+} // namespace MeshOptimizer
@@ -0,0 +1,385 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Meshlets: small clusters of triangles with their own bounds, so big meshes can be
+// culled piece by piece on the CPU.
+//   buildMeshlets  - grows clusters of up to kMaxTriangles triangles over shared vertices
+//                    and reorders the index list so every cluster is one contiguous range
+//   cullMeshlets   - frustum (bounding sphere) and backface (normal cone) tests, visible
+//                    clusters that touch in the index list are merged into one DrawRange
+namespace Meshlets
+{
+
+const uint32_t kMaxTriangles = 128;
+const uint32_t kMaxVertices  = 128;
+
+struct Meshlet
+{
+	uint32_t firstIndex;
+	uint32_t triangleCount;
+
+	glm::vec3 center;   // bounding sphere, object space
+	float     radius;
+
+	glm::vec3 coneAxis; // average facing direction
+	float     coneCutoff; // sin of the cone half angle, 1 = cone covers everything (never backface culled)
+};
+
+// a run of indices, firstIndex/count in indices like IndexBatch
+struct DrawRange
+{
+	uint32_t firstIndex;
+	uint32_t count;
+};
+
+struct CullStats
+{
+	uint32_t meshlets;
+	uint32_t frustumCulled;
+	uint32_t backfaceCulled;
+	uint32_t visible;
+	uint32_t visibleTriangles;
+	uint32_t ranges;
+
+	void add(const CullStats &s)
+	{
+		meshlets += s.meshlets; frustumCulled += s.frustumCulled; backfaceCulled += s.backfaceCulled;
+		visible += s.visible; visibleTriangles += s.visibleTriangles; ranges += s.ranges;
+	}
+};
+
+struct Frustum
+{
+	glm::vec4 planes[6]; // xyz normal pointing inside, w distance
+};
+
+namespace detail
+{
+	// vertices of this valence and above (fan centers) don't pull in candidates,
+	// their triangles are still reached through the rim vertices
+	const uint32_t kMaxCandidateValence = 64;
+
+	inline glm::vec3 position(const GLfloat *pos, GLuint v) { return glm::vec3(pos[v * 3], pos[v * 3 + 1], pos[v * 3 + 2]); }
+
+	// Ritter's bounding sphere
+	inline void boundingSphere(const GLuint *indices, uint32_t triCount, const GLfloat *pos, glm::vec3 &center, float &radius)
+	{
+		uint32_t indexCount = triCount * 3;
+		glm::vec3 first = position(pos, indices[0]);
+
+		glm::vec3 a = first;
+		float best = -1.0f;
+		for (uint32_t i = 0; i < indexCount; ++i)
+		{
+			glm::vec3 p = position(pos, indices[i]);
+			float d = glm::dot(p - first, p - first);
+			if (d > best) { best = d; a = p; }
+		}
+
+		glm::vec3 b = a;
+		best = -1.0f;
+		for (uint32_t i = 0; i < indexCount; ++i)
+		{
+			glm::vec3 p = position(pos, indices[i]);
+			float d = glm::dot(p - a, p - a);
+			if (d > best) { best = d; b = p; }
+		}
+
+		center = (a + b) * 0.5f;
+		radius = glm::length(b - a) * 0.5f;
+
+		for (uint32_t i = 0; i < indexCount; ++i)
+		{
+			glm::vec3 p = position(pos, indices[i]);
+			float d = glm::length(p - center);
+			if (d > radius)
+			{
+				// grow just enough to enclose p
+				float newRadius = (radius + d) * 0.5f;
+				center += (p - center) * ((newRadius - radius) / d);
+				radius = newRadius;
+			}
+		}
+	}
+
+	inline void normalCone(const GLuint *indices, uint32_t triCount, const GLfloat *pos, glm::vec3 &axis, float &cutoff)
+	{
+		std::vector<glm::vec3> normals;
+		normals.reserve(triCount);
+
+		glm::vec3 sum(0.0f);
+		for (uint32_t t = 0; t < triCount; ++t)
+		{
+			glm::vec3 a = position(pos, indices[t * 3]), b = position(pos, indices[t * 3 + 1]), c = position(pos, indices[t * 3 + 2]);
+			glm::vec3 n = glm::cross(b - a, c - a);
+			float length = glm::length(n);
+			if (length <= 0.0f)
+				continue; // degenerate, can't face anywhere
+
+			normals.push_back(n / length);
+			sum += n / length;
+		}
+
+		float sumLength = glm::length(sum);
+		if (normals.empty() || sumLength <= 0.0f)
+		{
+			axis = glm::vec3(0.0f, 0.0f, 1.0f);
+			cutoff = 1.0f;
+			return;
+		}
+
+		axis = sum / sumLength;
+		float minDot = 1.0f;
+		for (const glm::vec3 &n : normals)
+			minDot = std::min(minDot, glm::dot(n, axis));
+
+		// wider than ~84 degrees is never fully back-facing in practice
+		cutoff = minDot <= 0.1f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+	}
+}
+
+// reorders the triangles of indices in place and returns the clusters, in index order
+inline std::vector<Meshlet> buildMeshlets(GLuint *indices, size_t indexCount, const GLfloat *pos, uint32_t vertexCount,
+                                          uint32_t maxVertices = kMaxVertices, uint32_t maxTriangles = kMaxTriangles)
+{
+	std::vector<Meshlet> meshlets;
+	size_t triCount = indexCount / 3;
+	if (triCount == 0)
+		return meshlets;
+
+	// vertex -> triangle adjacency, same layout as optimizeVertexCache
+	std::vector<uint32_t> valence(vertexCount, 0);
+	for (size_t i = 0; i < indexCount; ++i)
+		valence[indices[i]]++;
+
+	std::vector<uint32_t> adjOffset(vertexCount + 1, 0);
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		adjOffset[v + 1] = adjOffset[v] + valence[v];
+
+	std::vector<uint32_t> adjacency(indexCount);
+	std::vector<uint32_t> fill(adjOffset.begin(), adjOffset.end() - 1);
+	for (size_t t = 0; t < triCount; ++t)
+		for (int k = 0; k < 3; ++k)
+			adjacency[fill[indices[t * 3 + k]]++] = (uint32_t)t;
+
+	const uint32_t none = 0xffffffffu;
+	std::vector<uint32_t> liveValence(valence);             // unassigned triangles per vertex
+	std::vector<char>     assigned(triCount, 0);
+	std::vector<uint32_t> vertexMeshlet(vertexCount, none); // meshlet that already holds the vertex
+	std::vector<uint32_t> candidateMeshlet(triCount, none); // meshlet whose candidate list has the triangle
+	std::vector<uint32_t> candidates;
+
+	std::vector<GLuint> output;
+	output.reserve(indexCount);
+
+	size_t scanCursor = 0;
+	uint32_t seed = 0;
+	for (size_t emittedTris = 0; emittedTris < triCount;)
+	{
+		uint32_t id = (uint32_t)meshlets.size();
+		uint32_t clusterVertices = 0;
+		uint32_t clusterTris = 0;
+		glm::vec3 centroidSum(0.0f);
+
+		Meshlet meshlet;
+		meshlet.firstIndex = (uint32_t)output.size();
+
+		uint32_t next = seed;
+		if (assigned[next])
+		{
+			while (assigned[scanCursor])
+				scanCursor++;
+			next = (uint32_t)scanCursor;
+		}
+		candidates.clear();
+
+		while (next != none)
+		{
+			const GLuint *tri = indices + (size_t)next * 3;
+			assigned[next] = 1;
+			output.insert(output.end(), tri, tri + 3);
+			clusterTris++;
+			emittedTris++;
+
+			for (int k = 0; k < 3; ++k)
+			{
+				GLuint v = tri[k];
+				liveValence[v]--;
+				centroidSum += detail::position(pos, v);
+				if (vertexMeshlet[v] != id)
+				{
+					vertexMeshlet[v] = id;
+					clusterVertices++;
+				}
+
+				if (valence[v] >= detail::kMaxCandidateValence)
+					continue;
+
+				for (uint32_t a = adjOffset[v]; a < adjOffset[v + 1]; ++a)
+				{
+					uint32_t t = adjacency[a];
+					if (!assigned[t] && candidateMeshlet[t] != id)
+					{
+						candidateMeshlet[t] = id;
+						candidates.push_back(t);
+					}
+				}
+			}
+
+			if (clusterTris >= maxTriangles)
+				break;
+
+			// fewest new vertices first, then close to the cluster (keeps it round) and with few
+			// unassigned neighbours (fills corners instead of leaving small islands behind)
+			glm::vec3 centroid = centroidSum / (float)(clusterTris * 3);
+			next = none;
+			uint32_t bestNew = 4;
+			float bestDistance = 0.0f;
+
+			size_t keep = 0;
+			for (size_t c = 0; c < candidates.size(); ++c)
+			{
+				uint32_t t = candidates[c];
+				if (assigned[t])
+					continue;
+				candidates[keep++] = t;
+
+				const GLuint *ct = indices + (size_t)t * 3;
+				uint32_t newVertices = (vertexMeshlet[ct[0]] != id) + (vertexMeshlet[ct[1]] != id) + (vertexMeshlet[ct[2]] != id);
+				if (clusterVertices + newVertices > maxVertices || newVertices > bestNew)
+					continue;
+
+				uint32_t live = liveValence[ct[0]] + liveValence[ct[1]] + liveValence[ct[2]];
+				glm::vec3 triCenter = (detail::position(pos, ct[0]) + detail::position(pos, ct[1]) + detail::position(pos, ct[2])) / 3.0f;
+				float distance = glm::dot(triCenter - centroid, triCenter - centroid) * (float)live;
+				if (newVertices < bestNew || distance < bestDistance)
+				{
+					bestNew = newVertices;
+					bestDistance = distance;
+					next = t;
+				}
+			}
+			candidates.resize(keep);
+		}
+
+		// continue next to this cluster, at the frontier triangle with the fewest unassigned
+		// neighbours, so clusters fill corners instead of leaving small islands behind
+		seed = none;
+		uint32_t seedLive = none;
+		for (uint32_t t : candidates)
+		{
+			if (assigned[t])
+				continue;
+			const GLuint *ct = indices + (size_t)t * 3;
+			uint32_t live = liveValence[ct[0]] + liveValence[ct[1]] + liveValence[ct[2]];
+			if (live < seedLive)
+			{
+				seedLive = live;
+				seed = t;
+			}
+		}
+		if (seed == none)
+			seed = (uint32_t)scanCursor;
+
+		meshlet.triangleCount = clusterTris;
+		detail::boundingSphere(output.data() + meshlet.firstIndex, clusterTris, pos, meshlet.center, meshlet.radius);
+		detail::normalCone(output.data() + meshlet.firstIndex, clusterTris, pos, meshlet.coneAxis, meshlet.coneCutoff);
+		meshlets.push_back(meshlet);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+	return meshlets;
+}
+
+
+// planes of a view-projection matrix (Gribb/Hartmann), in the space the matrix maps from
+inline Frustum extractFrustum(const glm::mat4 &viewProj)
+{
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; ++i)
+		row[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+
+	Frustum frustum;
+	frustum.planes[0] = row[3] + row[0]; // left
+	frustum.planes[1] = row[3] - row[0]; // right
+	frustum.planes[2] = row[3] + row[1]; // bottom
+	frustum.planes[3] = row[3] - row[1]; // top
+	frustum.planes[4] = row[3] + row[2]; // near
+	frustum.planes[5] = row[3] - row[2]; // far
+
+	for (glm::vec4 &plane : frustum.planes)
+		plane /= glm::length(glm::vec3(plane));
+	return frustum;
+}
+
+inline bool sphereOutside(const Frustum &frustum, const glm::vec3 &center, float radius)
+{
+	for (const glm::vec4 &plane : frustum.planes)
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+			return true;
+	return false;
+}
+
+// true when every triangle of the cluster faces away from camPos (front = counter clockwise)
+inline bool coneBackfacing(const glm::vec3 &center, float radius, const glm::vec3 &axis, float cutoff, const glm::vec3 &camPos)
+{
+	glm::vec3 toCenter = center - camPos;
+	return glm::dot(toCenter, axis) >= cutoff * glm::length(toCenter) + radius;
+}
+
+// model may rotate, translate and scale uniformly. Visible clusters are appended to
+// ranges, neighbours in the index list share one range.
+inline CullStats cullMeshlets(const std::vector<Meshlet> &meshlets, const glm::mat4 &model, const Frustum &frustum,
+                              const glm::vec3 &camPos, std::vector<DrawRange> &ranges)
+{
+	CullStats stats = {};
+	stats.meshlets = (uint32_t)meshlets.size();
+
+	glm::mat3 rotation(model);
+	float scale = std::max(glm::length(rotation[0]), std::max(glm::length(rotation[1]), glm::length(rotation[2])));
+
+	size_t firstRange = ranges.size();
+	for (const Meshlet &meshlet : meshlets)
+	{
+		glm::vec3 center = glm::vec3(model * glm::vec4(meshlet.center, 1.0f));
+		float radius = meshlet.radius * scale;
+
+		if (sphereOutside(frustum, center, radius))
+		{
+			stats.frustumCulled++;
+			continue;
+		}
+
+		if (meshlet.coneCutoff < 1.0f)
+		{
+			glm::vec3 axis = glm::normalize(rotation * meshlet.coneAxis);
+			if (coneBackfacing(center, radius, axis, meshlet.coneCutoff, camPos))
+			{
+				stats.backfaceCulled++;
+				continue;
+			}
+		}
+
+		stats.visible++;
+		stats.visibleTriangles += meshlet.triangleCount;
+
+		uint32_t count = meshlet.triangleCount * 3;
+		if (ranges.size() > firstRange && ranges.back().firstIndex + ranges.back().count == meshlet.firstIndex)
+			ranges.back().count += count;
+		else
+			ranges.push_back({ meshlet.firstIndex, count });
+	}
+
+	stats.ranges = (uint32_t)(ranges.size() - firstRange);
+	return stats;
+}
+
+} // namespace Meshlets
@@ -0,0 +1,360 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "ThreadPool.cpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIP_SSE2 1
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Mipmap chains built on the CPU, for where glGenerateMipmap is missing, slow or filters
+// the wrong way: it averages the stored bytes, which for sRGB images (the photos, the pool
+// ball PPMs) darkens every level, and for straight alpha UI images (rect_round_corner2.png)
+// bleeds the color of invisible texels into the visible edge.
+//
+// Each level is a 2x2 box filter of the one above, odd sizes round down like GL's. With
+// srgb the bytes are decoded to linear light through a table, averaged and encoded back;
+// with premultiplyAlpha the colors are weighted by their alpha while averaging, so the
+// levels stay straight alpha (what glBlendFunc(GL_SRC_ALPHA, ...) expects) but transparent
+// texels don't contribute color. Without either the bytes are averaged as integers.
+//
+// mip_downsample picks AVX2 (table gathers, 2 texels per vector) or SSE2 as the compiler
+// targets them; mip_downsample_scalar is the reference. They apply the same float
+// operations in the same order, the results only differ where the compiler contracts the
+// scalar ones into FMAs. generate_mips spreads the rows of each level over a ThreadPool.
+//
+//   MipChain chain;
+//   generate_mips(rgba, w, h, MipOptions(), chain, &pool);
+//   for (const MipLevel &level : chain.levels) glTexImage2D(..., level.level, ..., chain.data(level));
+
+struct MipOptions
+{
+    bool srgb             = true;   // color channels are sRGB encoded, alpha never is
+    bool premultiplyAlpha = false;  // weight colors by alpha while filtering
+};
+
+struct MipLevel
+{
+    int level;                      // 1 for the first one below the image
+    int width, height;
+    size_t offset;                  // into MipChain::pixels
+};
+
+// levels 1 and below, level 0 stays the caller's image
+struct MipChain
+{
+    std::vector<uint8_t> pixels;    // RGBA8
+    std::vector<MipLevel> levels;
+
+    const uint8_t *data(const MipLevel &level) const { return pixels.data() + level.offset; }
+    size_t bytes() const { return pixels.size(); }
+};
+
+struct MipTables
+{
+    // [0, 256) sRGB byte to linear, [256, 512) byte / 255 for alpha and linear data
+    alignas(32) float toLinear[512];
+    // linear quantized to 12 bits back to the sRGB byte
+    uint8_t toSrgb[4096];
+
+    MipTables()
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            float v = i / 255.0f;
+            toLinear[i] = v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+            toLinear[256 + i] = v;
+        }
+        for (int i = 0; i < 4096; ++i)
+        {
+            float v = i / 4095.0f;
+            float s = v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+            toSrgb[i] = (uint8_t)std::min(std::max(s * 255.0f + 0.5f, 0.0f), 255.0f);
+        }
+    }
+};
+static const MipTables mipTables;
+
+// texel dimensions of level 1 below w x h
+static int mip_size(int size)
+{
+    return std::max(size / 2, 1);
+}
+
+static uint8_t mip_encode(float v, int channel, bool srgb)
+{
+    v = std::min(std::max(v, 0.0f), 1.0f);
+    if (srgb && channel < 3)
+        return mipTables.toSrgb[(int)(v * 4095.0f + 0.5f)];
+    return (uint8_t)(int)(v * 255.0f + 0.5f);
+}
+
+// one output texel from its 2x2 source texels, p0 p1 on the upper row, p2 p3 below
+static void mip_texel_scalar(const uint8_t *p0, const uint8_t *p1, const uint8_t *p2, const uint8_t *p3,
+                             uint8_t *out, const MipOptions &options)
+{
+    if (!options.srgb && !options.premultiplyAlpha)
+    {
+        for (int c = 0; c < 4; ++c)
+            out[c] = (uint8_t)((p0[c] + p1[c] + p2[c] + p3[c] + 2) >> 2);
+        return;
+    }
+
+    const uint8_t *p[4] = { p0, p1, p2, p3 };
+    float t[4][4], w[4][4];
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int c = 0; c < 4; ++c)
+            t[i][c] = mipTables.toLinear[p[i][c] + (options.srgb && c < 3 ? 0 : 256)];
+        for (int c = 0; c < 4; ++c)
+            w[i][c] = c < 3 ? t[i][c] * t[i][3] : t[i][3];
+    }
+
+    float sum[4], weighted[4];
+    for (int c = 0; c < 4; ++c)
+    {
+        sum[c] = (t[0][c] + t[1][c]) + (t[2][c] + t[3][c]);
+        weighted[c] = (w[0][c] + w[1][c]) + (w[2][c] + w[3][c]);
+    }
+
+    for (int c = 0; c < 4; ++c)
+    {
+        float v = sum[c] * 0.25f;
+        // all 4 transparent: the plain average, so bilinear filtering next to them doesn't pull in black
+        if (options.premultiplyAlpha && c < 3 && weighted[3] > 0.0f)
+            v = weighted[c] / weighted[3];
+        out[c] = mip_encode(v, c, options.srgb);
+    }
+}
+
+static void mip_row_scalar(const uint8_t *row0, const uint8_t *row1, int w, uint8_t *out, int dw, const MipOptions &options)
+{
+    for (int x = 0; x < dw; ++x)
+    {
+        int x0 = std::min(x * 2, w - 1) * 4, x1 = std::min(x * 2 + 1, w - 1) * 4;
+        mip_texel_scalar(row0 + x0, row0 + x1, row1 + x0, row1 + x1, out + x * 4, options);
+    }
+}
+
+#ifdef MIP_SSE2
+
+// encodes the RGBA floats of n texels, clamped and scaled like mip_encode
+static void mip_encode_simd(const float *values, int n, uint8_t *out, bool srgb)
+{
+    alignas(16) int32_t scaled[8];
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f);
+    const __m128 scale = srgb ? _mm_setr_ps(4095.0f, 4095.0f, 4095.0f, 255.0f) : _mm_set1_ps(255.0f);
+    for (int i = 0; i < n; ++i)
+    {
+        __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(values + i * 4), zero), one);
+        _mm_store_si128((__m128i*)(scaled + i * 4), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half)));
+    }
+    for (int i = 0; i < n * 4; ++i)
+        out[i] = srgb && (i & 3) != 3 ? mipTables.toSrgb[scaled[i]] : (uint8_t)scaled[i];
+}
+
+// averages of 2 output texels at a time as 16 bit sums, the row tail goes to the scalar path
+static void mip_row_integer_sse2(const uint8_t *row0, const uint8_t *row1, uint8_t *out, int dw)
+{
+    const __m128i zero = _mm_setzero_si128(), round = _mm_set1_epi16(2);
+    int x = 0;
+    for (; x + 2 <= dw; x += 2)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(row0 + x * 8));
+        __m128i b = _mm_loadu_si128((const __m128i*)(row1 + x * 8));
+        // 16 bit columns: texels 0 1 in lo, 2 3 in hi
+        __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+        __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+        __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+        sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+        _mm_storel_epi64((__m128i*)(out + x * 4), _mm_packus_epi16(sum, zero));
+    }
+    for (; x < dw; ++x)
+        mip_texel_scalar(row0 + x * 8, row0 + x * 8 + 4, row1 + x * 8, row1 + x * 8 + 4, out + x * 4, MipOptions{ false, false });
+}
+
+// the 4 filtered RGBA floats of one output texel, t0 t1 upper row, t2 t3 below
+static __m128 mip_filter_sse2(__m128 t0, __m128 t1, __m128 t2, __m128 t3, bool premultiplyAlpha)
+{
+    __m128 sum = _mm_add_ps(_mm_add_ps(t0, t1), _mm_add_ps(t2, t3));
+    __m128 average = _mm_mul_ps(sum, _mm_set1_ps(0.25f));
+    if (!premultiplyAlpha)
+        return average;
+
+    // colors times alpha, alpha times 1
+    const __m128 alphaOne = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+    const __m128 rgbMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    auto weigh = [&](__m128 t) {
+        __m128 alpha = _mm_shuffle_ps(t, t, _MM_SHUFFLE(3, 3, 3, 3));
+        return _mm_mul_ps(t, _mm_or_ps(_mm_and_ps(alpha, rgbMask), alphaOne));
+    };
+    __m128 weighted = _mm_add_ps(_mm_add_ps(weigh(t0), weigh(t1)), _mm_add_ps(weigh(t2), weigh(t3)));
+    __m128 alphaSum = _mm_shuffle_ps(weighted, weighted, _MM_SHUFFLE(3, 3, 3, 3));
+    __m128 color = _mm_div_ps(weighted, alphaSum);
+
+    // the weighted color where the alpha sum is positive, the average elsewhere and in alpha
+    __m128 use = _mm_and_ps(_mm_cmpgt_ps(alphaSum, _mm_setzero_ps()), rgbMask);
+    return _mm_or_ps(_mm_and_ps(use, color), _mm_andnot_ps(use, average));
+}
+
+static void mip_row_float_sse2(const uint8_t *row0, const uint8_t *row1, uint8_t *out, int dw, const MipOptions &options)
+{
+    int alphaOffset = 256, colorOffset = options.srgb ? 0 : 256;
+    const float *table = mipTables.toLinear;
+    auto load = [&](const uint8_t *p) {
+        return _mm_setr_ps(table[p[0] + colorOffset], table[p[1] + colorOffset], table[p[2] + colorOffset], table[p[3] + alphaOffset]);
+    };
+
+    alignas(16) float filtered[4];
+    for (int x = 0; x < dw; ++x)
+    {
+        const uint8_t *a = row0 + x * 8, *b = row1 + x * 8;
+        _mm_store_ps(filtered, mip_filter_sse2(load(a), load(a + 4), load(b), load(b + 4), options.premultiplyAlpha));
+        mip_encode_simd(filtered, 1, out + x * 4, options.srgb);
+    }
+}
+
+#ifdef __AVX2__
+
+// 2 output texels per 8 lane vector, the source channels fetched from the tables by gathers
+static void mip_row_float_avx2(const uint8_t *row0, const uint8_t *row1, uint8_t *out, int dw, const MipOptions &options)
+{
+    const __m256i offsets = options.srgb ? _mm256_setr_epi32(0, 0, 0, 256, 0, 0, 0, 256) : _mm256_set1_epi32(256);
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    const __m256 rgbMask = _mm256_castsi256_ps(_mm256_setr_epi32(-1, -1, -1, 0, -1, -1, -1, 0));
+    const __m256 alphaOne = _mm256_setr_ps(0, 0, 0, 1, 0, 0, 0, 1);
+    const float *table = mipTables.toLinear;
+
+    // the 2 texels at p as linear floats
+    auto load = [&](const uint8_t *p) {
+        __m256i bytes = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p));
+        return _mm256_i32gather_ps(table, _mm256_add_epi32(bytes, offsets), 4);
+    };
+    auto weigh = [&](__m256 t) {
+        __m256 alpha = _mm256_shuffle_ps(t, t, _MM_SHUFFLE(3, 3, 3, 3));
+        return _mm256_mul_ps(t, _mm256_or_ps(_mm256_and_ps(alpha, rgbMask), alphaOne));
+    };
+
+    alignas(32) float filtered[8];
+    int x = 0;
+    for (; x + 2 <= dw; x += 2)
+    {
+        // a: source texels 0 1 of row0, b: 2 3; regrouped so each 128 bit half is one output texel
+        __m256 a = load(row0 + x * 8), b = load(row0 + x * 8 + 8);
+        __m256 c = load(row1 + x * 8), d = load(row1 + x * 8 + 8);
+        __m256 t0 = _mm256_permute2f128_ps(a, b, 0x20), t1 = _mm256_permute2f128_ps(a, b, 0x31);
+        __m256 t2 = _mm256_permute2f128_ps(c, d, 0x20), t3 = _mm256_permute2f128_ps(c, d, 0x31);
+
+        __m256 sum = _mm256_add_ps(_mm256_add_ps(t0, t1), _mm256_add_ps(t2, t3));
+        __m256 result = _mm256_mul_ps(sum, quarter);
+        if (options.premultiplyAlpha)
+        {
+            __m256 weighted = _mm256_add_ps(_mm256_add_ps(weigh(t0), weigh(t1)), _mm256_add_ps(weigh(t2), weigh(t3)));
+            __m256 alphaSum = _mm256_shuffle_ps(weighted, weighted, _MM_SHUFFLE(3, 3, 3, 3));
+            __m256 use = _mm256_and_ps(_mm256_cmp_ps(alphaSum, _mm256_setzero_ps(), _CMP_GT_OQ), rgbMask);
+            result = _mm256_blendv_ps(result, _mm256_div_ps(weighted, alphaSum), use);
+        }
+        _mm256_store_ps(filtered, result);
+        mip_encode_simd(filtered, 2, out + x * 4, options.srgb);
+    }
+    if (x < dw)
+        mip_row_float_sse2(row0 + x * 8, row1 + x * 8, out + x * 4, dw - x, options);
+}
+
+#endif
+#endif
+
+// rows [rowBegin, rowEnd) of the level below src (w x h RGBA8) into dst
+static void mip_downsample_scalar(const uint8_t *src, int w, int h, uint8_t *dst, const MipOptions &options,
+                                  int rowBegin = 0, int rowEnd = -1)
+{
+    int dw = mip_size(w), dh = mip_size(h);
+    if (rowEnd < 0)
+        rowEnd = dh;
+    for (int y = rowBegin; y < rowEnd; ++y)
+    {
+        const uint8_t *row0 = src + (size_t)std::min(y * 2, h - 1) * w * 4;
+        const uint8_t *row1 = src + (size_t)std::min(y * 2 + 1, h - 1) * w * 4;
+        mip_row_scalar(row0, row1, w, dst + (size_t)y * dw * 4, dw, options);
+    }
+}
+
+static void mip_downsample(const uint8_t *src, int w, int h, uint8_t *dst, const MipOptions &options,
+                           int rowBegin = 0, int rowEnd = -1)
+{
+#ifdef MIP_SSE2
+    // one texel wide images repeat the column, which the SIMD rows don't
+    if (w < 2)
+    {
+        mip_downsample_scalar(src, w, h, dst, options, rowBegin, rowEnd);
+        return;
+    }
+
+    int dw = mip_size(w), dh = mip_size(h);
+    if (rowEnd < 0)
+        rowEnd = dh;
+    for (int y = rowBegin; y < rowEnd; ++y)
+    {
+        const uint8_t *row0 = src + (size_t)std::min(y * 2, h - 1) * w * 4;
+        const uint8_t *row1 = src + (size_t)std::min(y * 2 + 1, h - 1) * w * 4;
+        uint8_t *out = dst + (size_t)y * dw * 4;
+        if (!options.srgb && !options.premultiplyAlpha)
+            mip_row_integer_sse2(row0, row1, out, dw);
+        else
+#ifdef __AVX2__
+            mip_row_float_avx2(row0, row1, out, dw, options);
+#else
+            mip_row_float_sse2(row0, row1, out, dw, options);
+#endif
+    }
+#else
+    mip_downsample_scalar(src, w, h, dst, options, rowBegin, rowEnd);
+#endif
+}
+
+// every level below rgba (w x h RGBA8) down to 1x1 into chain. With a pool the rows of the
+// larger levels are split over its threads; not from inside one of its tasks.
+static void generate_mips(const uint8_t *rgba, int w, int h, const MipOptions &options, MipChain &chain,
+                          ThreadPool *pool = nullptr, bool scalar = false)
+{
+    chain.levels.clear();
+    size_t bytes = 0;
+    for (int lw = w, lh = h, level = 1; lw > 1 || lh > 1; ++level)
+    {
+        lw = mip_size(lw);
+        lh = mip_size(lh);
+        chain.levels.push_back({ level, lw, lh, bytes });
+        bytes += (size_t)lw * lh * 4;
+    }
+    chain.pixels.resize(bytes);
+
+    const uint8_t *src = rgba;
+    for (const MipLevel &level : chain.levels)
+    {
+        uint8_t *dst = chain.pixels.data() + level.offset;
+        auto rows = [&](size_t begin, size_t end, int) {
+            if (scalar)
+                mip_downsample_scalar(src, w, h, dst, options, (int)begin, (int)end);
+            else
+                mip_downsample(src, w, h, dst, options, (int)begin, (int)end);
+        };
+
+        // below ~64K texels a level isn't worth waking the workers for
+        if (pool && (size_t)level.width * level.height >= 65536)
+            pool->parallelFor(level.height, rows, 16);
+        else
+            rows(0, level.height, 0);
+
+        src = dst;
+        w = level.width;
+        h = level.height;
+    }
+}
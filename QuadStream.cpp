@@ -0,0 +1,139 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <stdint.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "shader.cpp"
+#include "StreamBuffer.cpp"
+
+// The GL side of TextBatch and SpriteBatch: runs of quads, 4 vertices each (vec4 position
+// and texture coordinates, then an RGBA8 color), streamed through a StreamBuffer and drawn
+// with glDrawElements from one index buffer that serves every quad, grown as runs get
+// longer.
+//
+//   quads.init(1 << 20, 1024, sizeof(SpriteVertex), offsetof(SpriteVertex, color));
+//   each frame: quads.beginFrame();
+//               per run: if (quads.stream(vertices, count)) { bind program and texture; quads.draw(count); }
+//               quads.endFrame();
+class QuadStream
+{
+public:
+    QuadStream();
+    ~QuadStream();
+
+    QuadStream(const QuadStream &) = delete;
+    QuadStream &operator=(const QuadStream &) = delete;
+
+    // quads: the index buffer's first size
+    void init(GLsizeiptr streamBytesPerFrame, uint32_t quads, GLsizei vertexStride, GLintptr vertexColorOffset);
+
+    void beginFrame() { vertexStream->beginFrame(); }
+    void endFrame();
+    // copies quads * 4 vertices into this frame's region and leaves the VAO bound, pointing
+    // at them; false when they don't fit the region
+    bool stream(const void *vertices, uint32_t quads);
+    // the quads of the last stream()
+    void draw(uint32_t quads) { glDrawElements(GL_TRIANGLES, quads * 6, GL_UNSIGNED_INT, 0); }
+
+    const StreamBuffer *streamBuffer() const { return vertexStream; }
+
+private:
+    void ensureIndices(uint32_t quads);
+
+    GLuint vao, ibo;
+    uint32_t iboQuads;
+    GLsizei stride;
+    GLintptr colorOffset;
+    StreamBuffer *vertexStream;
+};
+
+
+QuadStream::QuadStream()
+{
+    vao = ibo = 0;
+    iboQuads = 0;
+    stride = 0;
+    colorOffset = 0;
+    vertexStream = nullptr;
+}
+
+QuadStream::~QuadStream()
+{
+    delete vertexStream;
+    if (ibo)
+        glDeleteBuffers(1, &ibo);
+    if (vao)
+        glDeleteVertexArrays(1, &vao);
+}
+
+void QuadStream::init(GLsizeiptr streamBytesPerFrame, uint32_t quads, GLsizei vertexStride, GLintptr vertexColorOffset)
+{
+    stride = vertexStride;
+    colorOffset = vertexColorOffset;
+    vertexStream = new StreamBuffer(streamBytesPerFrame);
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &ibo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    CHECK_GL;
+
+    ensureIndices(quads);
+}
+
+void QuadStream::ensureIndices(uint32_t quads)
+{
+    if (quads <= iboQuads)
+        return;
+
+    iboQuads = std::max(quads, iboQuads * 2);
+
+    std::vector<GLuint> indices((size_t)iboQuads * 6);
+    for (uint32_t i = 0; i < iboQuads; ++i)
+    {
+        GLuint v = i * 4;
+        GLuint *quad = &indices[(size_t)i * 6];
+        quad[0] = v; quad[1] = v + 1; quad[2] = v + 2;
+        quad[3] = v; quad[4] = v + 2; quad[5] = v + 3;
+    }
+
+    // the element binding is VAO state
+    glBindVertexArray(vao);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices.size(), indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    CHECK_GL;
+}
+
+bool QuadStream::stream(const void *vertices, uint32_t quads)
+{
+    GLsizeiptr bytes = (GLsizeiptr)stride * quads * 4;
+    GLintptr offset;
+    void *dst = vertexStream->allocate(bytes, stride, offset);
+    if (!dst)
+        return false;
+    memcpy(dst, vertices, bytes);
+    vertexStream->commit();
+
+    ensureIndices(quads);
+    glBindVertexArray(vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertexStream->buffer());
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)(offset + colorOffset));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+void QuadStream::endFrame()
+{
+    glBindVertexArray(0);
+    vertexStream->endFrame();
+}
@@ -7,15 +7,46 @@
 
 #include "shader.cpp"
 #include "UploadImage.cpp"
+#include "StreamBuffer.cpp"
+#include "SpriteBatch.cpp"
 
 #include <iostream>
 
+// The UI drawn either as one quad per image, each with its own texture, uniforms and
+// draw, or from a TextureAtlas page through a SpriteBatch: one bind and one draw. SPACE
+// switches, binds and draws per frame are printed once a second.
+
 int screenWidth = 2560/2, screenHeight = 1440/2;
 
 GLuint quadVAO = 0;
 GLuint quadVBO;
 GLuint shaderProgram;
-GLuint texture;
+
+bool g_batched = true;
+
+// the UI images, their own textures for the per quad path and their atlas sprites
+const char *uiImages[] = {
+    "../res/textures/shoot.png",
+    "../res/textures/shoot2.png",
+    "../res/textures/rect_round_corner2.png",
+    "../res/textures/Exclamation_Mark.png",
+};
+const int numUiImages = sizeof(uiImages) / sizeof(uiImages[0]);
+GLuint uiTextures[numUiImages];
+int uiSprites[numUiImages];
+TextureAtlas *uiAtlas;
+SpriteBatch *uiBatch;
+
+// per-quad uniforms are written into a stream buffer and bound as a uniform block range
+StreamBuffer *spriteStream;
+GLint uniformAlignment = 256;
+GLint textureSamplerLoc;
+
+struct SpriteUniforms
+{
+    glm::mat4 uModel;
+    glm::mat4 uProjection;
+};
 
 
 // Vertex shader
@@ -27,8 +58,11 @@ layout (location = 1) in vec2 aTexCoords;
 
 out vec2 TexCoords;
 
-uniform mat4 uModel;
-uniform mat4 uProjection;
+layout(std140) uniform SpriteBlock
+{
+    mat4 uModel;
+    mat4 uProjection;
+};
 
 void main()
 {
@@ -81,12 +115,30 @@ void initQuad() {
     // Compile and link shaders here to create shaderProgram
     // ...
     shaderProgram = create_shader_program(vertexShaderSource, fragmentShaderSource);
+    glUniformBlockBinding(shaderProgram, glGetUniformBlockIndex(shaderProgram, "SpriteBlock"), 0);
+    textureSamplerLoc = glGetUniformLocation(shaderProgram, "textureSampler");
+
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+    spriteStream = new StreamBuffer(1 << 16);
+
+    // Load textures, once on their own and once packed into a page (padding 4, so the
+    // page has mips down to level 2)
+    uiAtlas = new TextureAtlas(2048, 4);
+    for (int i = 0; i < numUiImages; ++i)
+    {
+        uiTextures[i] = UploadImage(uiImages[i]);
+        uiSprites[i] = uiAtlas->add(uiImages[i]);
+    }
+    uiAtlas->build();
+    const TextureAtlas::Stats &st = uiAtlas->stats();
+    std::cout << "UI atlas: " << st.sprites - st.failed << " sprites in " << st.pages << " page(s), "
+              << st.efficiency() * 100.0 << "% filled, " << st.packMs << " ms packing" << '\n';
 
-    // Load texture
-    texture = UploadImage("../res/textures/shoot.png");
+    uiBatch = new SpriteBatch();
+    uiBatch->init();
 }
 
-void drawUIQuad(float x, float y, float width, float height)
+void drawUIQuad(GLuint texture, float x, float y, float width, float height)
 {
     glUseProgram(shaderProgram);
 
@@ -95,15 +147,18 @@ void drawUIQuad(float x, float y, float width, float height)
     uModel = glm::translate(uModel, glm::vec3(x, y, 0.0f));
     uModel = glm::scale(uModel, glm::vec3(width, height, 1.0f));
 
-    GLint modelLoc = glGetUniformLocation(shaderProgram, "uModel");
-    GLint projectionLoc = glGetUniformLocation(shaderProgram, "uProjection");
-
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(uModel));
-    glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(uProjection));
+    GLintptr offset;
+    SpriteUniforms *uniforms = (SpriteUniforms*)spriteStream->allocate(sizeof(SpriteUniforms), uniformAlignment, offset);
+    if (!uniforms)
+        return;
+    uniforms->uModel = uModel;
+    uniforms->uProjection = uProjection;
+    spriteStream->commit();
+    glBindBufferRange(GL_UNIFORM_BUFFER, 0, spriteStream->buffer(), offset, sizeof(SpriteUniforms));
 
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, texture);
-    glUniform1i(glGetUniformLocation(shaderProgram, "textureSampler"), 0);
+    glUniform1i(textureSamplerLoc, 0);
 
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -119,12 +174,45 @@ void drawUIQuad(float x, float y, float width, float height)
 
 
 
+struct UiQuad
+{
+    int image;
+    float x, y, width, height;
+};
+
+// returns the draws it made, each with its own bind
+int drawUI(const UiQuad *quads, int count)
+{
+    if (!g_batched)
+    {
+        for (int i = 0; i < count; ++i)
+            drawUIQuad(uiTextures[quads[i].image], quads[i].x, quads[i].y, quads[i].width, quads[i].height);
+        return count;
+    }
+
+    glm::mat4 uProjection = glm::ortho(0.0f, (float)screenWidth, (float)screenHeight, 0.0f, -1.0f, 1.0f);
+    for (int i = 0; i < count; ++i)
+        uiBatch->add(*uiAtlas, uiSprites[quads[i].image], quads[i].x, quads[i].y, quads[i].width, quads[i].height);
+    uiBatch->flush(glm::value_ptr(uProjection));
+    return (int)uiBatch->stats().drawCalls;
+}
+
+static void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+    if (key == GLFW_KEY_SPACE && action == GLFW_PRESS)
+        g_batched = !g_batched;
+}
+
+
 GLFWwindow* window;
 
 
 int main(void)
 {	
  
+	// res/ and shaders/ from one mapped file when the pack is built (AssetPackBuild.cpp)
+	mount_asset_pack("../res/resources.qpak");
+
 	if (!glfwInit())
     {
         std::cout << "EXIT_FAILURE" << '\n';
@@ -140,6 +228,7 @@ int main(void)
 	}
  
  
+	glfwSetKeyCallback(window, key_callback);
 	glfwMakeContextCurrent(window);
 	gladLoadGL(glfwGetProcAddress);
 	glfwSwapInterval(1);
@@ -153,11 +242,41 @@ int main(void)
     glViewport(0, 0, screenWidth, screenHeight);
 
     initQuad();
+
+    // the layout of BasicGeometryMesh's 2D overlay, and the old single quad
+    float w = screenWidth * 0.01f * (float)screenHeight / (float)screenWidth;
+    float h = screenHeight * 0.01f;
+    const UiQuad quads[] = {
+        { 0, 0.0f, 0.0f, 100.0f, 100.0f },
+        { 1, screenWidth - 20.0f * w, screenHeight - 20.0f * h, 20.0f * w, 20.0f * h },
+        { 2, w, 50.0f * h, 20.0f * w, 5.0f * h },
+        { 3, w, 20.0f * h, 5.0f * w, 5.0f * h },
+    };
+    const int numQuads = sizeof(quads) / sizeof(quads[0]);
+
+    double lastReport = glfwGetTime();
+    int frameCounter = 0;
+    long long draws = 0;
     do
     {
-        
+        spriteStream->beginFrame();
+
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        drawUIQuad(0,0, 100,100);
+        draws += drawUI(quads, numQuads);
+
+        spriteStream->endFrame();
+        if (spriteStream->frameStats().fenceWaits)
+            std::cout << "sprite stream: waited " << spriteStream->frameStats().waitMs << " ms on a fence" << '\n';
+
+        frameCounter++;
+        if (glfwGetTime() - lastReport >= 1.0)
+        {
+            std::cout << (g_batched ? "atlas batch: " : "per quad: ") << numQuads << " quads, "
+                      << draws / frameCounter << " texture binds and draws/frame" << '\n';
+            lastReport = glfwGetTime();
+            frameCounter = 0;
+            draws = 0;
+        }
             
         // Swap buffers
         glfwSwapBuffers(window);
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <stdint.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "shader.cpp"
+#include "QuadStream.cpp"
+#include "TextureAtlas.cpp"
+
+// Collects the textured quads of a frame (UI sprites) and draws them with one
+// glDrawElements per texture, like TextBatch does for text. Sprites from a TextureAtlas
+// share their page's texture, so a UI packed into one page is one bind and one draw
+// instead of a bind and a draw per quad. Quads are drawn in the order they were added
+// within a texture, the textures in the order they were first used.
+//
+// add() only generates vertices on the CPU (usable without a GL context), init() creates
+// the GL side and flush() uploads through a StreamBuffer and draws (QuadStream.cpp, shared
+// with TextBatch).
+//
+//   batch.init();
+//   each frame: batch.add(atlas, sprite, x, y, w, h) ... batch.flush(projection);
+
+struct SpriteVertex
+{
+    float x, y;
+    float s, t;
+    uint32_t color; // RGBA8
+};
+
+class SpriteBatch
+{
+public:
+    struct Stats
+    {
+        uint32_t drawCalls;
+        uint32_t textureBinds;
+        uint32_t sprites;
+        uint32_t droppedSprites; // didn't fit the stream buffer
+    };
+
+    SpriteBatch();
+    ~SpriteBatch();
+
+    SpriteBatch(const SpriteBatch &) = delete;
+    SpriteBatch &operator=(const SpriteBatch &) = delete;
+
+    // x, y is the top left corner in the projection's units, uv is u0, v0, u1, v1 with
+    // v0 at the top
+    void add(GLuint texture, const glm::vec4 &uv, float x, float y, float w, float h, const glm::vec4 &color = glm::vec4(1.0f));
+    // sprites that weren't packed are skipped
+    void add(const TextureAtlas &atlas, int sprite, float x, float y, float w, float h, const glm::vec4 &color = glm::vec4(1.0f));
+    // drops everything added since the last flush
+    void clear();
+
+    size_t spriteCount() const;
+    // vertices queued for a texture (4 per sprite), for the benchmarks
+    const SpriteVertex *vertices(GLuint texture, size_t &count) const;
+
+    void init(GLsizeiptr streamBytesPerFrame = 1 << 20);
+    // draws and clears; projection is a column major 4x4
+    void flush(const GLfloat *projection);
+
+    const Stats &stats() const { return lastStats; }
+
+private:
+    // one per texture
+    struct TextureRun
+    {
+        GLuint texture;
+        std::vector<SpriteVertex> vertices; // only grows, used counts the live ones
+        size_t used;
+    };
+
+    TextureRun &runFor(GLuint texture);
+    static uint32_t packColor(const glm::vec4 &color);
+
+    std::vector<TextureRun> runs;
+    size_t lastRun;
+
+    GLuint program;
+    GLint projectionLoc, spriteLoc;
+    QuadStream quads;
+
+    Stats lastStats;
+};
+
+
+static const char *spriteBatchVertexShader = R"VERTEX(
+    #version 330 core
+    layout (location = 0) in vec4 vertex; // <vec2 pos, vec2 tex>
+    layout (location = 1) in vec4 vertexColor;
+    out vec2 TexCoords;
+    out vec4 Color;
+    uniform mat4 projection;
+    void main() {
+        gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
+        TexCoords = vertex.zw;
+        Color = vertexColor;
+    }
+)VERTEX";
+
+static const char *spriteBatchFragmentShader = R"FRAGMENT(
+    #version 330 core
+    in vec2 TexCoords;
+    in vec4 Color;
+    out vec4 color;
+    uniform sampler2D sprite;
+    void main() {
+        color = Color * texture(sprite, TexCoords);
+    }
+)FRAGMENT";
+
+
+SpriteBatch::SpriteBatch()
+{
+    lastRun = 0;
+    program = 0;
+    projectionLoc = spriteLoc = -1;
+    lastStats = Stats();
+}
+
+SpriteBatch::~SpriteBatch()
+{
+    if (program)
+        glDeleteProgram(program);
+}
+
+SpriteBatch::TextureRun &SpriteBatch::runFor(GLuint texture)
+{
+    if (lastRun < runs.size() && runs[lastRun].texture == texture)
+        return runs[lastRun];
+
+    for (size_t i = 0; i < runs.size(); ++i)
+    {
+        if (runs[i].texture == texture)
+        {
+            lastRun = i;
+            return runs[i];
+        }
+    }
+
+    runs.emplace_back();
+    TextureRun &run = runs.back();
+    run.texture = texture;
+    run.used = 0;
+
+    lastRun = runs.size() - 1;
+    return run;
+}
+
+uint32_t SpriteBatch::packColor(const glm::vec4 &color)
+{
+    auto channel = [](float c) { return (uint32_t)(std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f); };
+    return channel(color.r) | channel(color.g) << 8 | channel(color.b) << 16 | channel(color.a) << 24;
+}
+
+void SpriteBatch::add(GLuint texture, const glm::vec4 &uv, float x, float y, float w, float h, const glm::vec4 &color)
+{
+    TextureRun &run = runFor(texture);
+    if (run.used + 4 > run.vertices.size())
+        run.vertices.resize(std::max(run.used + 4, run.vertices.size() * 2));
+
+    uint32_t c = packColor(color);
+    SpriteVertex *v = run.vertices.data() + run.used;
+    v[0] = { x,     y,     uv.x, uv.y, c };
+    v[1] = { x,     y + h, uv.x, uv.w, c };
+    v[2] = { x + w, y + h, uv.z, uv.w, c };
+    v[3] = { x + w, y,     uv.z, uv.y, c };
+    run.used += 4;
+}
+
+void SpriteBatch::add(const TextureAtlas &atlas, int sprite, float x, float y, float w, float h, const glm::vec4 &color)
+{
+    const TextureAtlas::Sprite &s = atlas.sprite(sprite);
+    if (s.page < 0)
+        return;
+    add(atlas.page(s.page), s.uv, x, y, w, h, color);
+}
+
+void SpriteBatch::clear()
+{
+    for (TextureRun &run : runs)
+        run.used = 0;
+}
+
+size_t SpriteBatch::spriteCount() const
+{
+    size_t sprites = 0;
+    for (const TextureRun &run : runs)
+        sprites += run.used / 4;
+    return sprites;
+}
+
+const SpriteVertex *SpriteBatch::vertices(GLuint texture, size_t &count) const
+{
+    for (const TextureRun &run : runs)
+    {
+        if (run.texture == texture)
+        {
+            count = run.used;
+            return run.vertices.data();
+        }
+    }
+    count = 0;
+    return nullptr;
+}
+
+void SpriteBatch::init(GLsizeiptr streamBytesPerFrame)
+{
+    program       = create_shader_program(spriteBatchVertexShader, spriteBatchFragmentShader);
+    projectionLoc = glGetUniformLocation(program, "projection");
+    spriteLoc     = glGetUniformLocation(program, "sprite");
+
+    quads.init(streamBytesPerFrame, 1024, sizeof(SpriteVertex), offsetof(SpriteVertex, color));
+}
+
+void SpriteBatch::flush(const GLfloat *projection)
+{
+    Stats stats = Stats();
+
+    quads.beginFrame();
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glActiveTexture(GL_TEXTURE0);
+    glUseProgram(program);
+    glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, projection);
+    glUniform1i(spriteLoc, 0);
+
+    for (TextureRun &run : runs)
+    {
+        uint32_t sprites = (uint32_t)(run.used / 4);
+        if (sprites == 0)
+            continue;
+
+        if (!quads.stream(run.vertices.data(), sprites))
+        {
+            stats.droppedSprites += sprites;
+            continue;
+        }
+
+        glBindTexture(GL_TEXTURE_2D, run.texture);
+        quads.draw(sprites);
+
+        stats.textureBinds++;
+        stats.drawCalls++;
+        stats.sprites += sprites;
+    }
+    CHECK_GL;
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_BLEND);
+
+    quads.endFrame();
+
+    lastStats = stats;
+    clear();
+}
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <stdint.h>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#include "shader.cpp"
+
+// Ring buffer for data rewritten every frame (dynamic vertices, per-draw uniforms).
+//
+// Persistent mode (GL 4.4 / ARB_buffer_storage): one buffer, mapped once, split into
+// kFrames regions. A frame writes only its own region, endFrame() fences it and
+// beginFrame() waits on the fence of the region it is about to reuse, which normally
+// is long signalled. Those waits are the stalls reported in frameStats().
+//
+// Orphan mode (everything else): writes go to a CPU copy of one region, commit()
+// uploads what was written since the last commit with glBufferSubData, beginFrame()
+// orphans the storage so the driver does the renaming.
+//
+// Usage per frame: beginFrame(), then for each draw allocate() + write + commit()
+// before the draw that reads it, endFrame() after the last draw. offsets are in
+// bytes into buffer(), the buffer name never changes. The buffer can be bound as
+// anything (vertices, indices, uniforms), uploads go through GL_COPY_WRITE_BUFFER
+// so no binding of the caller is disturbed.
+class StreamBuffer
+{
+public:
+	static const int kFrames = 3;
+	// regions start at multiples of this, the largest GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	// the spec allows, so an offset aligned inside a region is aligned in the buffer
+	static const GLsizeiptr kRegionAlignment = 256;
+
+	enum class Mode { PersistentMapped, Orphaning };
+
+	struct FrameStats
+	{
+		uint32_t   fenceWaits;   // fences not yet signalled when the region came round
+		double     waitMs;       // CPU time blocked on them
+		GLsizeiptr bytesWritten;
+		uint32_t   overflows;    // allocations that didn't fit the frame region
+	};
+
+	// persistent mapping is used when allowed and supported
+	StreamBuffer(GLsizeiptr bytesPerFrame, bool allowPersistent = true);
+	~StreamBuffer();
+
+	StreamBuffer(const StreamBuffer &) = delete;
+	StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+	void beginFrame();
+	void endFrame();
+
+	// returns where to write bytes, offset receives the buffer offset, nullptr when the
+	// frame's region is full; offset is a multiple of alignment when alignment divides
+	// kRegionAlignment (uniform offsets), otherwise only the position in the region is
+	void *allocate(GLsizeiptr bytes, GLsizeiptr alignment, GLintptr &offset);
+	// makes everything allocated so far visible to the GPU (a no-op when persistent)
+	void commit();
+
+	GLuint buffer() const { return bufferID; }
+	Mode mode() const { return bufferMode; }
+	GLsizeiptr capacityPerFrame() const { return regionBytes; }
+
+	// stats of the last finished frame
+	const FrameStats &frameStats() const { return lastStats; }
+	uint64_t totalFenceWaits() const { return totalWaits; }
+
+	static bool persistentMappingSupported();
+
+private:
+	GLuint bufferID;
+	Mode bufferMode;
+
+	GLsizeiptr regionBytes;
+	int region;
+	GLsizeiptr head;         // write position inside the region
+	GLsizeiptr committed;    // orphan mode: head at the last commit()
+
+	uint8_t *mapped;         // persistent mode, whole buffer
+	std::vector<uint8_t> shadow; // orphan mode, one region
+
+	GLsync fences[kFrames];
+
+	FrameStats stats;
+	FrameStats lastStats;
+	uint64_t totalWaits;
+};
+
+
+bool StreamBuffer::persistentMappingSupported()
+{
+#ifdef GL_MAP_PERSISTENT_BIT
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	if (major > 4 || (major == 4 && minor >= 4))
+		return true;
+
+	GLint numExtensions = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+	for (GLint i = 0; i < numExtensions; ++i)
+	{
+		const char *name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (name && std::strcmp(name, "GL_ARB_buffer_storage") == 0)
+			return true;
+	}
+#endif
+	return false;
+}
+
+StreamBuffer::StreamBuffer(GLsizeiptr bytesPerFrame, bool allowPersistent)
+{
+	regionBytes = (bytesPerFrame + kRegionAlignment - 1) / kRegionAlignment * kRegionAlignment;
+	region = 0;
+	head = committed = 0;
+	mapped = nullptr;
+	for (GLsync &fence : fences)
+		fence = 0;
+
+	stats = lastStats = FrameStats();
+	totalWaits = 0;
+
+	bufferMode = allowPersistent && persistentMappingSupported() ? Mode::PersistentMapped : Mode::Orphaning;
+
+	glGenBuffers(1, &bufferID);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, bufferID);
+
+#ifdef GL_MAP_PERSISTENT_BIT
+	if (bufferMode == Mode::PersistentMapped)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, regionBytes * kFrames, nullptr, flags);
+		mapped = (uint8_t*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, regionBytes * kFrames, flags);
+		if (!mapped)
+		{
+			// storage is immutable now, start over with a plain buffer
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			glDeleteBuffers(1, &bufferID);
+			glGenBuffers(1, &bufferID);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, bufferID);
+			bufferMode = Mode::Orphaning;
+		}
+	}
+#endif
+
+	if (bufferMode == Mode::Orphaning)
+	{
+		glBufferData(GL_COPY_WRITE_BUFFER, regionBytes, nullptr, GL_STREAM_DRAW);
+		shadow.resize(regionBytes);
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	CHECK_GL;
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	for (GLsync &fence : fences)
+		if (fence)
+			glDeleteSync(fence);
+
+	if (mapped)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, bufferID);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	if (bufferID)
+		glDeleteBuffers(1, &bufferID);
+}
+
+void StreamBuffer::beginFrame()
+{
+	stats = FrameStats();
+	head = committed = 0;
+
+	if (bufferMode == Mode::Orphaning)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, bufferID);
+		glBufferData(GL_COPY_WRITE_BUFFER, regionBytes, nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		return;
+	}
+
+	region = (region + 1) % kFrames;
+
+	GLsync &fence = fences[region];
+	if (!fence)
+		return;
+
+	if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+	{
+		stats.fenceWaits++;
+		totalWaits++;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		while (glClientWaitSync(fence, flags, 1000000) == GL_TIMEOUT_EXPIRED)
+			flags = 0;
+		std::chrono::duration<double, std::milli> waited = std::chrono::high_resolution_clock::now() - start;
+		stats.waitMs += waited.count();
+	}
+
+	glDeleteSync(fence);
+	fence = 0;
+}
+
+void StreamBuffer::endFrame()
+{
+	commit();
+
+	if (bufferMode == Mode::PersistentMapped)
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	stats.bytesWritten = head;
+	lastStats = stats;
+}
+
+void *StreamBuffer::allocate(GLsizeiptr bytes, GLsizeiptr alignment, GLintptr &offset)
+{
+	GLsizeiptr start = alignment > 1 ? (head + alignment - 1) / alignment * alignment : head;
+	if (start + bytes > regionBytes)
+	{
+		stats.overflows++;
+		return nullptr;
+	}
+	head = start + bytes;
+
+	if (bufferMode == Mode::PersistentMapped)
+	{
+		offset = region * regionBytes + start;
+		return mapped + offset;
+	}
+
+	offset = start;
+	return shadow.data() + start;
+}
+
+void StreamBuffer::commit()
+{
+	if (bufferMode != Mode::Orphaning || head == committed)
+		return;
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, bufferID);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, committed, head - committed, shadow.data() + committed);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	committed = head;
+}
@@ -0,0 +1,723 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "shader.cpp"
+#include "FontAtlas.cpp"
+#include "GlyphCache.cpp"
+#include "QuadStream.cpp"
+
+// Collects every string of a frame and draws them with one glDrawElements per font.
+// add() only generates vertices on the CPU (usable without a GL context), init()
+// creates the GL side and flush() uploads through a StreamBuffer and draws (QuadStream.cpp).
+//
+//   batch.init();
+//   each frame: batch.add(font, "text", x, y, scale, r, g, b) ... batch.flush(projection);
+//
+// Text added from a GlyphCache is UTF-8 and rasterized at the asked pixel size,
+// flush() uploads the cache's dirty rectangles before drawing. An SDF cache is drawn
+// with its own shader, its glyphs are scaled to the asked size. With a TextLayoutCache
+// set, unchanged strings reuse their quads from earlier frames.
+
+struct TextVertex
+{
+    float x, y;
+    float s, t;
+    uint32_t color; // RGBA8
+};
+
+// Strings laid out from a GlyphCache, keyed by (string hash, cache, font, size), so
+// static labels skip the glyph lookups and quad math. An entry holds the quads at pen
+// (0, 0) and the glyphs they use. It is reused as long as the glyph cache hasn't evicted
+// anything since the entry was built, else the string is laid out again. Entries not
+// used for maxAge frames (at least 1) are dropped. Every clear() or sweep that frees
+// entries bumps epoch(), TextBatch forgets where it placed entries when it changes.
+class TextLayoutCache
+{
+public:
+    struct Stats
+    {
+        uint64_t hits;
+        uint64_t misses;          // laid out: new strings, hash collisions, incomplete layouts
+        uint64_t stale;           // laid out again after glyph cache evictions
+        uint64_t dropped;         // entries aged out
+        uint64_t inPlace;         // hits whose quads were already in place from the last frame
+    };
+
+    explicit TextLayoutCache(uint32_t maxAge = 120) : maxAge(std::max(maxAge, 1u)), lastSweep(0), freed(0), counters() {}
+
+    size_t entryCount() const { return entries.size(); }
+    const Stats &stats() const { return counters; }
+    void resetStats() { counters = Stats(); }
+    void clear() { entries.clear(); freed++; }
+    uint64_t epoch() const { return freed; }
+
+private:
+    friend class TextBatch;
+
+    struct Entry
+    {
+        std::string text;
+        const GlyphCache *cache;
+        int font;
+        float pixelHeight;
+        bool kerned;
+        uint64_t generation;      // cache->evictionCount() when laid out
+        uint32_t lastUsed;
+        bool valid;
+        std::vector<TextVertex> vertices;
+        std::vector<const GlyphCache::Glyph*> glyphs; // each once, to touch
+    };
+
+    static uint64_t hashKey(const GlyphCache &cache, int font, float pixelHeight, bool kerned, const char *text, size_t length)
+    {
+        // FNV-1a over the string, then the rest mixed in
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < length; ++i)
+            hash = (hash ^ (unsigned char)text[i]) * 1099511628211ull;
+
+        uint32_t size;
+        memcpy(&size, &pixelHeight, sizeof(size));
+        hash ^= ((uint64_t)(uintptr_t)&cache * 31 + (uint64_t)font) * 0x9E3779B97F4A7C15ull;
+        hash ^= (uint64_t)size << 21 | (uint64_t)kerned << 20;
+        return hash;
+    }
+
+    void sweep(uint32_t frame)
+    {
+        if (frame - lastSweep < 60)
+            return;
+        lastSweep = frame;
+
+        uint64_t dropped = counters.dropped;
+        for (auto it = entries.begin(); it != entries.end(); )
+        {
+            if (frame - it->second.lastUsed > maxAge)
+            {
+                it = entries.erase(it);
+                counters.dropped++;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        if (counters.dropped != dropped)
+            freed++;
+    }
+
+    uint32_t maxAge;
+    uint32_t lastSweep;
+    uint64_t freed;           // epoch
+    std::unordered_map<uint64_t, Entry> entries;
+    Stats counters;
+};
+
+class TextBatch
+{
+public:
+    struct Stats
+    {
+        uint32_t drawCalls;
+        uint32_t glyphs;
+        uint32_t droppedGlyphs; // didn't fit the stream buffer
+    };
+
+    TextBatch();
+    ~TextBatch();
+
+    TextBatch(const TextBatch &) = delete;
+    TextBatch &operator=(const TextBatch &) = delete;
+
+    // same placement as the old per-glyph render_text: the quad at pen (x, y) is scaled
+    // as a whole, so x and y are scaled too
+    void add(const FontAtlas &font, const char *text, float x, float y, float scale, float r, float g, float b, float a = 1.0f);
+    // pen at (x, y) in pixels, glyphs that don't fit the cache this frame are skipped.
+    // Bitmap text starts at the nearest whole pixel.
+    void add(GlyphCache &cache, int font, float pixelHeight, const char *utf8, float x, float y, float r, float g, float b, float a = 1.0f);
+
+    // nullptr turns layout caching off
+    void setLayoutCache(TextLayoutCache *cache) { layoutCache = cache; placedCache = nullptr; }
+    // kern GlyphCache text with the font's pair adjustments, on by default
+    void setKerning(bool enable) { kerning = enable; }
+    // drops everything added since the last flush
+    void clear();
+
+    size_t glyphCount() const;
+    // vertices queued for a font (4 per glyph), for the benchmarks
+    const TextVertex *vertices(const FontAtlas &font, size_t &count) const;
+    const TextVertex *vertices(const GlyphCache &cache, size_t &count) const;
+
+    void init(GLsizeiptr streamBytesPerFrame = 8 << 20);
+    // draws and clears; projection is a column major 4x4
+    void flush(const GLfloat *projection);
+
+    // multiplied with every vertex color
+    void setTint(float r, float g, float b) { tint[0] = r; tint[1] = g; tint[2] = b; }
+
+    const Stats &stats() const { return lastStats; }
+    const StreamBuffer *stream() const { return quads.streamBuffer(); }
+
+private:
+    // stbtt_bakedchar turned into what the vertex loop needs
+    struct GlyphQuad
+    {
+        float xoff, yoff, w, h;
+        float s0, t0, s1, t1;
+        float xadvance;
+    };
+
+    // one per FontAtlas or GlyphCache, i.e. per texture
+    // a layout cache entry written to a run, strings added in the same order as last
+    // frame find their quads still in the run's vertices
+    struct Placement
+    {
+        TextLayoutCache::Entry *entry; // nullptr once the layout cache freed entries
+        uint64_t generation;      // evictionCount() when written, ~0 for incomplete layouts
+        float x, y;
+        uint32_t color;
+        size_t offset;
+    };
+
+    struct FontRun
+    {
+        const FontAtlas *font;
+        GlyphCache *cache;
+        GlyphQuad glyphs[96];     // FontAtlas only
+        std::vector<TextVertex> vertices; // only grows, used counts the live ones
+        size_t used;
+        std::vector<Placement> placements, lastPlacements;
+    };
+
+    struct Program
+    {
+        GLuint id;
+        GLint projectionLoc, textColorLoc, textLoc;
+    };
+
+    static Program createProgram(const char *fragmentShader);
+
+    FontRun &runFor(const FontAtlas &font);
+    FontRun &runFor(GlyphCache &cache);
+    static uint32_t packColor(float r, float g, float b, float a);
+    // quads of a string from a GlyphCache into out (4 per glyph, room for one per byte),
+    // returns the vertex count. complete is false when a glyph didn't fit.
+    static size_t layout(GlyphCache &cache, int font, float pixelHeight, bool kerning, const char *utf8, float x, float y, uint32_t color,
+                         TextVertex *out, std::vector<const GlyphCache::Glyph*> *glyphs, bool &complete);
+    void addCached(FontRun &run, GlyphCache &cache, int font, float pixelHeight, const char *utf8, size_t length, float x, float y, uint32_t color);
+    // drops the placements when the layout cache freed entries since they were made
+    void checkPlacements(const TextLayoutCache &lc)
+    {
+        if (&lc != placedCache || lc.epoch() != placedEpoch)
+            dropPlacements(lc);
+    }
+    void dropPlacements(const TextLayoutCache &lc);
+
+    std::vector<FontRun> runs;
+    size_t lastRun;
+    TextLayoutCache *layoutCache;
+    const TextLayoutCache *placedCache; // and its epoch, what the placements point into
+    uint64_t placedEpoch;
+    bool kerning;
+
+    Program bitmapProgram, sdfProgram;
+    QuadStream quads;
+
+    float tint[3];
+    Stats lastStats;
+};
+
+
+static const char *textBatchVertexShader = R"VERTEX(
+    #version 330 core
+    layout (location = 0) in vec4 vertex; // <vec2 pos, vec2 tex>
+    layout (location = 1) in vec4 vertexColor;
+    out vec2 TexCoords;
+    out vec4 Color;
+    uniform mat4 projection;
+    void main() {
+        gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
+        TexCoords = vertex.zw;
+        Color = vertexColor;
+    }
+)VERTEX";
+
+static const char *textBatchFragmentShader = R"FRAGMENT(
+    #version 330 core
+    in vec2 TexCoords;
+    in vec4 Color;
+    out vec4 color;
+    uniform sampler2D text;
+    uniform vec3 textColor;
+    void main() {
+        vec4 sampled = vec4(1.0, 1.0, 1.0, texture(text, TexCoords).r);
+        color = vec4(textColor, 1.0) * Color * sampled;
+    }
+)FRAGMENT";
+
+// distance 128/255 is the outline, the ramp is one screen pixel wide at any scale
+static const char *textBatchSDFFragmentShader = R"FRAGMENT(
+    #version 330 core
+    in vec2 TexCoords;
+    in vec4 Color;
+    out vec4 color;
+    uniform sampler2D text;
+    uniform vec3 textColor;
+    void main() {
+        float distance = texture(text, TexCoords).r;
+        float width = max(fwidth(distance), 1.0 / 255.0) * 0.5;
+        float alpha = smoothstep(128.0 / 255.0 - width, 128.0 / 255.0 + width, distance);
+        color = vec4(textColor, 1.0) * Color * vec4(1.0, 1.0, 1.0, alpha);
+    }
+)FRAGMENT";
+
+
+TextBatch::TextBatch()
+{
+    lastRun = 0;
+    layoutCache = nullptr;
+    placedCache = nullptr;
+    placedEpoch = 0;
+    kerning = true;
+    bitmapProgram = sdfProgram = Program();
+    tint[0] = tint[1] = tint[2] = 1.0f;
+    lastStats = Stats();
+}
+
+TextBatch::~TextBatch()
+{
+    if (bitmapProgram.id)
+        glDeleteProgram(bitmapProgram.id);
+    if (sdfProgram.id)
+        glDeleteProgram(sdfProgram.id);
+}
+
+TextBatch::FontRun &TextBatch::runFor(const FontAtlas &font)
+{
+    if (lastRun < runs.size() && runs[lastRun].font == &font)
+        return runs[lastRun];
+
+    for (size_t i = 0; i < runs.size(); ++i)
+    {
+        if (runs[i].font == &font)
+        {
+            lastRun = i;
+            return runs[i];
+        }
+    }
+
+    runs.emplace_back();
+    FontRun &run = runs.back();
+    run.font = &font;
+    run.cache = nullptr;
+    run.used = 0;
+
+    float ipw = 1.0f / font.w, iph = 1.0f / font.h;
+    for (int i = 0; i < 96; ++i)
+    {
+        const stbtt_bakedchar &b = font.cdata[i];
+        GlyphQuad &q = run.glyphs[i];
+        q.xoff = b.xoff;
+        q.yoff = b.yoff;
+        q.w = (float)(b.x1 - b.x0);
+        q.h = (float)(b.y1 - b.y0);
+        q.s0 = b.x0 * ipw; q.t0 = b.y0 * iph;
+        q.s1 = b.x1 * ipw; q.t1 = b.y1 * iph;
+        q.xadvance = b.xadvance;
+    }
+
+    lastRun = runs.size() - 1;
+    return run;
+}
+
+TextBatch::FontRun &TextBatch::runFor(GlyphCache &cache)
+{
+    if (lastRun < runs.size() && runs[lastRun].cache == &cache)
+        return runs[lastRun];
+
+    for (size_t i = 0; i < runs.size(); ++i)
+    {
+        if (runs[i].cache == &cache)
+        {
+            lastRun = i;
+            return runs[i];
+        }
+    }
+
+    runs.emplace_back();
+    FontRun &run = runs.back();
+    run.font = nullptr;
+    run.cache = &cache;
+    run.used = 0;
+
+    lastRun = runs.size() - 1;
+    return run;
+}
+
+uint32_t TextBatch::packColor(float r, float g, float b, float a)
+{
+    auto channel = [](float c) { return (uint32_t)(std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f); };
+    return channel(r) | channel(g) << 8 | channel(b) << 16 | channel(a) << 24;
+}
+
+void TextBatch::add(const FontAtlas &font, const char *text, float x, float y, float scale, float r, float g, float b, float a)
+{
+    FontRun &run = runFor(font);
+    uint32_t color = packColor(r, g, b, a);
+
+    size_t length = strlen(text);
+    size_t needed = run.used + length * 4;
+    if (needed > run.vertices.size())
+        run.vertices.resize(std::max(needed, run.vertices.size() * 2));
+
+    TextVertex *v = run.vertices.data() + run.used;
+    for (const unsigned char *c = (const unsigned char*)text; *c; ++c)
+    {
+        if (*c < 32 || *c >= 128)
+            continue;
+
+        // same rounding as stbtt_GetBakedQuad(..., opengl_fillrule = 1)
+        const GlyphQuad &q = run.glyphs[*c - 32];
+        float x0 = std::floor(x + q.xoff + 0.5f);
+        float y0 = std::floor(y + q.yoff + 0.5f);
+        float x1 = (x0 + q.w) * scale;
+        float y1 = (y0 + q.h) * scale;
+        x0 *= scale;
+        y0 *= scale;
+
+        v[0] = { x0, y0, q.s0, q.t0, color };
+        v[1] = { x0, y1, q.s0, q.t1, color };
+        v[2] = { x1, y1, q.s1, q.t1, color };
+        v[3] = { x1, y0, q.s1, q.t0, color };
+        v += 4;
+
+        x += q.xadvance;
+    }
+    run.used = v - run.vertices.data();
+}
+
+size_t TextBatch::layout(GlyphCache &cache, int font, float pixelHeight, bool kerning, const char *utf8, float x, float y, uint32_t color,
+                         TextVertex *out, std::vector<const GlyphCache::Glyph*> *glyphs, bool &complete)
+{
+    // bitmaps are snapped to pixels like stbtt_GetBakedQuad, distance fields scale freely.
+    // Snapped text starts at a whole pixel and the pen runs from 0, so the same string
+    // gets the same quads anywhere (what the layout cache relies on).
+    bool snap = !cache.isSDF();
+    float scale = cache.glyphScale(pixelHeight);
+    complete = true;
+
+    // kerning is a table lookup per pair, in font units
+    float kernScale = kerning && cache.hasKerning(font) ? cache.fontScale(font, pixelHeight) * scale : 0.0f;
+    const GlyphCache::Glyph *prev = nullptr;
+
+    float originX = 0.0f, originY = 0.0f;
+    if (snap)
+    {
+        originX = std::floor(x + 0.5f);
+        originY = std::floor(y + 0.5f);
+        x = y = 0.0f;
+    }
+
+    TextVertex *v = out;
+    const unsigned char *c = (const unsigned char*)utf8;
+    while (*c)
+    {
+        uint32_t codepoint = GlyphCache::decodeUtf8(c);
+        if (codepoint < 32)
+            continue;
+
+        const GlyphCache::Glyph *q = cache.glyph(font, pixelHeight, codepoint);
+        if (!q)
+        {
+            complete = false;
+            prev = nullptr;
+            continue;
+        }
+
+        if (prev && kernScale != 0.0f)
+            x += cache.kernAdvance(font, *prev, *q) * kernScale;
+        prev = q;
+
+        if (q->w)
+        {
+            float x0, y0, x1, y1;
+            if (snap)
+            {
+                x0 = originX + std::floor(x + q->xoff + 0.5f);
+                y0 = originY + std::floor(y + q->yoff + 0.5f);
+                x1 = x0 + q->w;
+                y1 = y0 + q->h;
+            }
+            else
+            {
+                x0 = x + q->xoff * scale;
+                y0 = y + q->yoff * scale;
+                x1 = x0 + q->w * scale;
+                y1 = y0 + q->h * scale;
+            }
+
+            v[0] = { x0, y0, q->s0, q->t0, color };
+            v[1] = { x0, y1, q->s0, q->t1, color };
+            v[2] = { x1, y1, q->s1, q->t1, color };
+            v[3] = { x1, y0, q->s1, q->t0, color };
+            v += 4;
+
+            if (glyphs)
+                glyphs->push_back(q);
+        }
+
+        x += q->xadvance * scale;
+    }
+    return v - out;
+}
+
+void TextBatch::add(GlyphCache &cache, int font, float pixelHeight, const char *utf8, float x, float y, float r, float g, float b, float a)
+{
+    FontRun &run = runFor(cache);
+    uint32_t color = packColor(r, g, b, a);
+
+    // at most one glyph per byte
+    size_t length = strlen(utf8);
+    size_t needed = run.used + length * 4;
+    if (needed > run.vertices.size())
+        run.vertices.resize(std::max(needed, run.vertices.size() * 2));
+
+    if (layoutCache)
+    {
+        addCached(run, cache, font, pixelHeight, utf8, length, x, y, color);
+        return;
+    }
+
+    bool complete;
+    run.used += layout(cache, font, pixelHeight, kerning, utf8, x, y, color, run.vertices.data() + run.used, nullptr, complete);
+}
+
+void TextBatch::addCached(FontRun &run, GlyphCache &cache, int font, float pixelHeight, const char *utf8, size_t length, float x, float y, uint32_t color)
+{
+    TextLayoutCache &lc = *layoutCache;
+    uint32_t frame = cache.currentFrame();
+
+    // same origin snapping as layout()
+    if (!cache.isSDF())
+    {
+        x = std::floor(x + 0.5f);
+        y = std::floor(y + 0.5f);
+    }
+
+    checkPlacements(lc);
+
+    // the string added at this point last frame, its quads are still right when nothing
+    // was evicted since they were written
+    size_t index = run.placements.size();
+    if (index < run.lastPlacements.size())
+    {
+        const Placement &last = run.lastPlacements[index];
+        if (last.entry && last.offset == run.used && last.x == x && last.y == y && last.color == color && last.generation == cache.evictionCount())
+        {
+            TextLayoutCache::Entry &e = *last.entry;
+            if (e.valid && e.cache == &cache && e.font == font && e.pixelHeight == pixelHeight && e.kerned == kerning &&
+                e.text.size() == length && memcmp(e.text.data(), utf8, length) == 0)
+            {
+                for (const GlyphCache::Glyph *g : e.glyphs)
+                    cache.touch(g);
+                e.lastUsed = frame;
+                lc.counters.hits++;
+                lc.counters.inPlace++;
+
+                run.placements.push_back(last);
+                run.used += e.vertices.size();
+                return;
+            }
+        }
+    }
+
+    lc.sweep(frame);
+    checkPlacements(lc);
+
+    uint64_t key = TextLayoutCache::hashKey(cache, font, pixelHeight, kerning, utf8, length);
+    TextLayoutCache::Entry &e = lc.entries[key];
+
+    bool same = e.cache == &cache && e.font == font && e.pixelHeight == pixelHeight && e.kerned == kerning &&
+                e.text.size() == length && memcmp(e.text.data(), utf8, length) == 0;
+    if (same && e.valid && e.generation == cache.evictionCount())
+    {
+        // the quads still point at the right atlas texels, keep their glyphs alive
+        for (const GlyphCache::Glyph *g : e.glyphs)
+            cache.touch(g);
+        lc.counters.hits++;
+    }
+    else
+    {
+        if (same && e.valid)
+            lc.counters.stale++;
+        else
+            lc.counters.misses++;
+
+        if (!same)
+        {
+            e.text.assign(utf8, length);
+            e.cache = &cache;
+            e.font = font;
+            e.pixelHeight = pixelHeight;
+            e.kerned = kerning;
+        }
+        e.vertices.resize(length * 4);
+        e.glyphs.clear();
+
+        bool complete;
+        e.vertices.resize(layout(cache, font, pixelHeight, kerning, utf8, 0.0f, 0.0f, 0, e.vertices.data(), &e.glyphs, complete));
+        std::sort(e.glyphs.begin(), e.glyphs.end());
+        e.glyphs.erase(std::unique(e.glyphs.begin(), e.glyphs.end()), e.glyphs.end());
+
+        // glyphs evicted while laying out were none of this string's
+        e.generation = cache.evictionCount();
+        e.valid = complete;
+    }
+    e.lastUsed = frame;
+
+    run.placements.push_back({ &e, e.valid ? e.generation : ~0ull, x, y, color, run.used });
+
+    TextVertex *v = run.vertices.data() + run.used;
+    for (const TextVertex &src : e.vertices)
+        *v++ = { src.x + x, src.y + y, src.s, src.t, color };
+    run.used += e.vertices.size();
+}
+
+void TextBatch::dropPlacements(const TextLayoutCache &lc)
+{
+    // this frame's are kept as placeholders, the index of a placement is its order
+    for (FontRun &run : runs)
+    {
+        run.lastPlacements.clear();
+        for (Placement &p : run.placements)
+            p.entry = nullptr;
+    }
+    placedCache = &lc;
+    placedEpoch = lc.epoch();
+}
+
+void TextBatch::clear()
+{
+    for (FontRun &run : runs)
+    {
+        run.used = 0;
+        run.lastPlacements.swap(run.placements);
+        run.placements.clear();
+    }
+}
+
+size_t TextBatch::glyphCount() const
+{
+    size_t glyphs = 0;
+    for (const FontRun &run : runs)
+        glyphs += run.used / 4;
+    return glyphs;
+}
+
+const TextVertex *TextBatch::vertices(const FontAtlas &font, size_t &count) const
+{
+    for (const FontRun &run : runs)
+    {
+        if (run.font == &font)
+        {
+            count = run.used;
+            return run.vertices.data();
+        }
+    }
+    count = 0;
+    return nullptr;
+}
+
+const TextVertex *TextBatch::vertices(const GlyphCache &cache, size_t &count) const
+{
+    for (const FontRun &run : runs)
+    {
+        if (run.cache == &cache)
+        {
+            count = run.used;
+            return run.vertices.data();
+        }
+    }
+    count = 0;
+    return nullptr;
+}
+
+TextBatch::Program TextBatch::createProgram(const char *fragmentShader)
+{
+    Program program;
+    program.id            = create_shader_program(textBatchVertexShader, fragmentShader);
+    program.projectionLoc = glGetUniformLocation(program.id, "projection");
+    program.textColorLoc  = glGetUniformLocation(program.id, "textColor");
+    program.textLoc       = glGetUniformLocation(program.id, "text");
+    return program;
+}
+
+void TextBatch::init(GLsizeiptr streamBytesPerFrame)
+{
+    bitmapProgram = createProgram(textBatchFragmentShader);
+    sdfProgram    = createProgram(textBatchSDFFragmentShader);
+
+    quads.init(streamBytesPerFrame, 4096, sizeof(TextVertex), offsetof(TextVertex, color));
+}
+
+void TextBatch::flush(const GLfloat *projection)
+{
+    Stats stats = Stats();
+
+    quads.beginFrame();
+
+    const Program *bound = nullptr;
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glActiveTexture(GL_TEXTURE0);
+
+    for (FontRun &run : runs)
+    {
+        uint32_t glyphs = (uint32_t)(run.used / 4);
+        if (glyphs == 0)
+            continue;
+
+        if (!quads.stream(run.vertices.data(), glyphs))
+        {
+            stats.droppedGlyphs += glyphs;
+            continue;
+        }
+        if (run.cache)
+            run.cache->upload();
+
+        const Program *program = run.cache && run.cache->isSDF() ? &sdfProgram : &bitmapProgram;
+        if (program != bound)
+        {
+            glUseProgram(program->id);
+            glUniformMatrix4fv(program->projectionLoc, 1, GL_FALSE, projection);
+            glUniform3f(program->textColorLoc, tint[0], tint[1], tint[2]);
+            glUniform1i(program->textLoc, 0);
+            bound = program;
+        }
+
+        glBindTexture(GL_TEXTURE_2D, run.font ? run.font->texture : run.cache->texture());
+        quads.draw(glyphs);
+
+        stats.drawCalls++;
+        stats.glyphs += glyphs;
+    }
+    CHECK_GL;
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_BLEND);
+
+    quads.endFrame();
+
+    lastStats = stats;
+    clear();
+}
@@ -0,0 +1,678 @@
+// Headless CPU benchmarks for the text path (TextBatch.cpp, FontAtlas.cpp, GlyphCache.cpp).
+// No window or GL context is created, fonts are only baked on the CPU and the glyph
+// cache runs with setUploadToGL(false).
+// Run from the build directory like the demos, the font is ../res/digital_7_mono.ttf.
+// TextBench [glyphs per frame] [font for the rasterization and kerning benches]
+
+#include "TextBatch.cpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+static const char *font_path = "../res/digital_7_mono.ttf";
+
+struct TextLine
+{
+    std::string text;
+    float x, y;
+};
+
+// printable ASCII lines, about glyphsPerFrame glyphs in total
+static std::vector<TextLine> makeLines(size_t glyphsPerFrame, size_t lineLength)
+{
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> ch(32, 126);
+
+    std::vector<TextLine> lines(glyphsPerFrame / lineLength);
+    for (size_t i = 0; i < lines.size(); ++i)
+    {
+        lines[i].text.resize(lineLength);
+        for (char &c : lines[i].text)
+            c = (char)ch(rng);
+        lines[i].x = (float)(i % 4) * 400.0f;
+        lines[i].y = 20.0f + (float)(i / 4 % 60) * 16.0f;
+    }
+    return lines;
+}
+
+// what render_text did per glyph before batching, minus the GL calls
+static void perGlyphQuads(const FontAtlas &font, const char *text, float x, float y, float scale, std::vector<float> &out)
+{
+    while (*text)
+    {
+        unsigned char c = (unsigned char)*text;
+        if (c >= 32 && c < 128)
+        {
+            stbtt_aligned_quad q;
+            stbtt_GetBakedQuad(font.cdata, font.w, font.h, c - 32, &x, &y, &q, 1);
+
+            float vertices[4][4] = {
+                { q.x0 * scale, q.y0 * scale, q.s0, q.t0 },
+                { q.x0 * scale, q.y1 * scale, q.s0, q.t1 },
+                { q.x1 * scale, q.y1 * scale, q.s1, q.t1 },
+                { q.x1 * scale, q.y0 * scale, q.s1, q.t0 }
+            };
+            out.insert(out.end(), &vertices[0][0], &vertices[0][0] + 16);
+        }
+        ++text;
+    }
+}
+
+void benchQuadGeneration(const FontAtlas &font, size_t glyphsPerFrame, int frames)
+{
+    const size_t lineLength = 50;
+    std::vector<TextLine> lines = makeLines(glyphsPerFrame, lineLength);
+    size_t glyphs = lines.size() * lineLength;
+
+    printf("== glyph quad generation: %zu glyphs per frame (%zu strings), %d frames ==\n", glyphs, lines.size(), frames);
+    printf("%-28s %12s %14s\n", "path", "ms/frame", "Mglyphs/s");
+
+    // per glyph, the way render_text built its quads
+    std::vector<float> reference;
+    double perGlyphMs = 0.0;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        reference.clear();
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const TextLine &line : lines)
+            perGlyphQuads(font, line.text.c_str(), line.x, line.y, 1.0f, reference);
+        perGlyphMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+    perGlyphMs /= frames;
+    printf("%-28s %12.3f %14.2f\n", "stbtt_GetBakedQuad per glyph", perGlyphMs, glyphs / perGlyphMs / 1000.0);
+
+    TextBatch batch;
+    double batchMs = 0.0;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        batch.clear();
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const TextLine &line : lines)
+            batch.add(font, line.text.c_str(), line.x, line.y, 1.0f, 1.0f, 1.0f, 1.0f);
+        batchMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+    batchMs /= frames;
+    printf("%-28s %12.3f %14.2f  (%.2fx)\n", "TextBatch::add", batchMs, glyphs / batchMs / 1000.0, perGlyphMs / batchMs);
+
+    // the batch must place every glyph exactly where stb does
+    size_t count = 0;
+    const TextVertex *vertices = batch.vertices(font, count);
+    bool identical = count * 4 == reference.size();
+    for (size_t i = 0; identical && i < count; ++i)
+    {
+        const float *r = &reference[i * 4];
+        identical = vertices[i].x == r[0] && vertices[i].y == r[1] && vertices[i].s == r[2] && vertices[i].t == r[3];
+    }
+    printf("identical to stbtt_GetBakedQuad: %s, %zu KB of vertices per frame\n\n", identical ? "yes" : "NO",
+           count * sizeof(TextVertex) / 1024);
+}
+
+// same text through the baked atlas and through the glyph cache at the bake size
+void benchGlyphCacheLookup(const FontAtlas &font, size_t glyphsPerFrame, int frames)
+{
+    const size_t lineLength = 50;
+    std::vector<TextLine> lines = makeLines(glyphsPerFrame, lineLength);
+    size_t glyphs = lines.size() * lineLength;
+
+    printf("== glyph cache lookups: %zu glyphs per frame, %.0f px, %d frames ==\n", glyphs, font.pixel_height, frames);
+    printf("%-28s %12s %14s\n", "path", "ms/frame", "Mglyphs/s");
+
+    GlyphCache cache(512);
+    cache.setUploadToGL(false);
+    int fontId = cache.addFont(font_path);
+
+    TextBatch baked, cached;
+    double bakedMs = 0.0, cachedMs = 0.0;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        baked.clear();
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const TextLine &line : lines)
+            baked.add(font, line.text.c_str(), line.x, line.y, 1.0f, 1.0f, 1.0f, 1.0f);
+        bakedMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        cache.beginFrame();
+        cached.clear();
+        start = std::chrono::high_resolution_clock::now();
+        for (const TextLine &line : lines)
+            cached.add(cache, fontId, font.pixel_height, line.text.c_str(), line.x, line.y, 1.0f, 1.0f, 1.0f, 1.0f);
+        cache.upload();
+        cachedMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+    bakedMs /= frames;
+    cachedMs /= frames;
+    printf("%-28s %12.3f %14.2f\n", "baked FontAtlas", bakedMs, glyphs / bakedMs / 1000.0);
+    printf("%-28s %12.3f %14.2f\n", "GlyphCache", cachedMs, glyphs / cachedMs / 1000.0);
+
+    // the bake emits an empty quad for glyphs without pixels (space), the cache none
+    size_t bakedCount = 0, cachedCount = 0;
+    const TextVertex *a = baked.vertices(font, bakedCount);
+    const TextVertex *b = cached.vertices(cache, cachedCount);
+    size_t j = 0;
+    bool identical = true;
+    for (size_t i = 0; identical && i < bakedCount; i += 4)
+    {
+        if (a[i].x == a[i + 2].x || a[i].y == a[i + 2].y)
+            continue;
+        identical = j < cachedCount;
+        for (int k = 0; identical && k < 4; ++k)
+            identical = a[i + k].x == b[j + k].x && a[i + k].y == b[j + k].y;
+        j += 4;
+    }
+    identical = identical && j == cachedCount;
+    printf("quad positions identical to the bake: %s, %zu glyphs cached, %.2f%% of a 512x512 atlas\n\n",
+           identical ? "yes" : "NO", cache.glyphCount(), cache.occupancy() * 100.0f);
+}
+
+// text sizes drift every frame so the 512x512 atlas has to evict, checked against a
+// fresh stbtt_MakeCodepointBitmap of every glyph used in the last frame
+void benchGlyphCacheChurn(int frames)
+{
+    const int linesPerFrame = 60;
+    const size_t lineLength = 40;
+
+    printf("== glyph cache churn: %d strings per frame at 3 drifting sizes, 512x512 atlas ==\n", linesPerFrame);
+    printf("%6s %6s %10s %10s %10s %8s %10s %12s %10s\n", "frame", "sizes", "occupancy", "misses", "miss rate", "evicted", "failed", "upload KB", "ms");
+
+    GlyphCache cache(512);
+    cache.setUploadToGL(false);
+    int fontId = cache.addFont(font_path);
+
+    std::vector<TextLine> lines = makeLines(linesPerFrame * lineLength, lineLength);
+    TextBatch batch;
+
+    uint64_t lookups = 0, misses = 0, evictions = 0, failed = 0, uploadBytes = 0;
+    double totalMs = 0.0;
+    int size = 8;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        size = 8 + (frame * 2) % 20;
+
+        cache.beginFrame();
+        batch.clear();
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < linesPerFrame; ++i)
+            batch.add(cache, fontId, (float)(size + (i % 3) * 4), lines[i].text.c_str(), lines[i].x, lines[i].y, 1.0f, 1.0f, 1.0f);
+        cache.upload();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        totalMs += ms;
+
+        const GlyphCache::FrameStats &st = cache.frameStats();
+        lookups += st.lookups;
+        misses += st.misses;
+        evictions += st.evictions;
+        failed += st.failed;
+        uploadBytes += st.uploadBytes;
+
+        if (frame % 5 == 0 || frame == frames - 1)
+            printf("%6d %2d..%-3d %9.1f%% %10u %9.1f%% %8u %10u %12.1f %10.3f\n", frame, size, size + 8,
+                   cache.occupancy() * 100.0f, st.misses, 100.0 * st.misses / st.lookups, st.evictions, st.failed, st.uploadBytes / 1024.0, ms);
+    }
+    printf("total: %.2f%% miss rate, %llu evictions, %llu failed, %.1f KB uploaded per frame (full atlas %d KB), %.3f ms/frame\n",
+           100.0 * misses / lookups, (unsigned long long)evictions, (unsigned long long)failed,
+           uploadBytes / 1024.0 / frames, 512 * 512 / 1024, totalMs / frames);
+
+    // every glyph of the last frame must still hold exactly its own pixels
+    std::vector<unsigned char> ttf;
+    read_file(font_path, ttf);
+    stbtt_fontinfo info;
+    stbtt_InitFont(&info, ttf.data(), stbtt_GetFontOffsetForIndex(ttf.data(), 0));
+
+    const std::vector<unsigned char> &atlas = cache.bitmap();
+    size_t checked = 0, wrong = 0;
+    for (int i = 0; i < linesPerFrame; ++i)
+    {
+        int pixelSize = size + (i % 3) * 4;
+        float scale = stbtt_ScaleForPixelHeight(&info, (float)pixelSize);
+        for (unsigned char c : lines[i].text)
+        {
+            const GlyphCache::Glyph *g = cache.glyph(fontId, (float)pixelSize, c);
+            if (!g || !g->w)
+                continue;
+
+            std::vector<unsigned char> fresh((size_t)g->w * g->h);
+            stbtt_MakeCodepointBitmap(&info, fresh.data(), g->w, g->h, g->w, scale, scale, c);
+            for (int y = 0; y < g->h; ++y)
+                if (memcmp(&atlas[(size_t)(g->y + y) * cache.size() + g->x], &fresh[(size_t)y * g->w], g->w) != 0)
+                {
+                    wrong++;
+                    break;
+                }
+            checked++;
+        }
+    }
+    printf("last frame glyphs intact: %s (%zu checked, %zu wrong)\n", wrong ? "NO" : "yes", checked, wrong);
+
+    // what a rebake per size would cost instead
+    FontAtlas rebake;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int s = 8; s < 8 + 20; s += 2)
+        bake_font(rebake, font_path, (float)s);
+    double bakeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / 10;
+    printf("stbtt_BakeFontBitmap of ASCII for comparison: %.3f ms per size, plus a full %d KB upload\n\n", bakeMs, 512 * 512 / 1024);
+}
+
+// bilinear with texel centers at +0.5, zero outside
+static float sampleBilinear(const unsigned char *image, int w, int h, float x, float y)
+{
+    x -= 0.5f;
+    y -= 0.5f;
+    int x0 = (int)std::floor(x), y0 = (int)std::floor(y);
+    float fx = x - x0, fy = y - y0;
+
+    auto at = [&](int px, int py) -> float {
+        return px < 0 || py < 0 || px >= w || py >= h ? 0.0f : (float)image[(size_t)py * w + px];
+    };
+    float top    = at(x0, y0) * (1.0f - fx) + at(x0 + 1, y0) * fx;
+    float bottom = at(x0, y0 + 1) * (1.0f - fx) + at(x0 + 1, y0 + 1) * fx;
+    return top * (1.0f - fy) + bottom * fy;
+}
+
+static float smoothstep(float edge0, float edge1, float x)
+{
+    float t = std::min(std::max((x - edge0) / (edge1 - edge0), 0.0f), 1.0f);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+// bitmap bakes per size against one distance field atlas for all of them, plus how far
+// each drawn at a size is from a native rasterization at that size
+void benchSDF()
+{
+    const int sizes[] = { 12, 16, 20, 24, 32, 48, 64, 96 };
+    const int numSizes = sizeof(sizes) / sizeof(sizes[0]);
+    const int sdfBase = 32, sdfSpread = 4, bakedSize = 20;
+    const int repeats = 5;
+
+    printf("== bitmap vs SDF atlas, ASCII 32..126 at %d sizes ==\n", numSizes);
+
+    std::vector<unsigned char> ttf;
+    if (!read_file(font_path, ttf))
+        return;
+    stbtt_fontinfo info;
+    stbtt_InitFont(&info, ttf.data(), stbtt_GetFontOffsetForIndex(ttf.data(), 0));
+
+    // one stbtt_BakeFontBitmap per size, each in the smallest square power of two it fits
+    printf("%-8s %12s %12s %12s\n", "size", "atlas", "KB", "bake ms");
+    size_t bitmapBytes = 0;
+    double bitmapMs = 0.0;
+    stbtt_bakedchar cdata[96];
+    for (int s = 0; s < numSizes; ++s)
+    {
+        int dim = 64;
+        std::vector<unsigned char> atlas;
+        for (;; dim *= 2)
+        {
+            atlas.assign((size_t)dim * dim, 0);
+            if (stbtt_BakeFontBitmap(ttf.data(), 0, (float)sizes[s], atlas.data(), dim, dim, 32, 96, cdata) > 0)
+                break;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int r = 0; r < repeats; ++r)
+            stbtt_BakeFontBitmap(ttf.data(), 0, (float)sizes[s], atlas.data(), dim, dim, 32, 96, cdata);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / repeats;
+
+        printf("%-8d %5dx%-6d %12.1f %12.3f\n", sizes[s], dim, dim, atlas.size() / 1024.0, ms);
+        bitmapBytes += atlas.size();
+        bitmapMs += ms;
+    }
+
+    // the same glyphs through GlyphCache, all sizes in one atlas, and as distance fields
+    auto cacheASCII = [&](bool sdf, int atlasSize, int numCached, double &ms) -> const GlyphCache::FrameStats {
+        GlyphCache::FrameStats total = GlyphCache::FrameStats();
+        ms = 0.0;
+        for (int r = 0; r < repeats; ++r)
+        {
+            GlyphCache cache(atlasSize);
+            cache.setUploadToGL(false);
+            if (sdf)
+                cache.setSDF(sdfBase, sdfSpread);
+            int font = cache.addFont(font_path);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int s = 0; s < numCached; ++s)
+                for (uint32_t c = 32; c < 127; ++c)
+                    cache.glyph(font, (float)sizes[s], c);
+            ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            total = cache.frameStats();
+        }
+        ms /= repeats;
+        return total;
+    };
+
+    int bitmapDim = 256, sdfDim = 64;
+    double cacheMs = 0.0, sdfMs = 0.0;
+    while (cacheASCII(false, bitmapDim, numSizes, cacheMs).failed)
+        bitmapDim *= 2;
+    while (cacheASCII(true, sdfDim, 1, sdfMs).failed)
+        sdfDim *= 2;
+
+    printf("%-30s %12s %12s\n", "", "KB", "bake ms");
+    printf("%-30s %12.1f %12.3f\n", "8 bitmap bakes", bitmapBytes / 1024.0, bitmapMs);
+    printf("%-30s %12.1f %12.3f  (%dx%d)\n", "bitmap GlyphCache, 8 sizes", bitmapDim * bitmapDim / 1024.0, cacheMs, bitmapDim, bitmapDim);
+    printf("%-30s %12.1f %12.3f  (%dx%d, %d px base, spread %d)\n", "SDF GlyphCache, any size", sdfDim * sdfDim / 1024.0, sdfMs, sdfDim, sdfDim, sdfBase, sdfSpread);
+
+    // mean coverage error against stbtt_MakeCodepointBitmap at the drawn size: the
+    // 20 px bake scaled with bilinear filtering (the old render_text scale) and the
+    // distance field thresholded the way the SDF shader does
+    const char *sample = "AaBbgQ8@%&$#";
+    printf("%-8s %20s %20s\n", "size", "scaled 20px bitmap", "SDF");
+    for (int s = 0; s < numSizes; ++s)
+    {
+        int size = sizes[s];
+        float scale = stbtt_ScaleForPixelHeight(&info, (float)size);
+        double bitmapError = 0.0, sdfError = 0.0;
+        size_t texels = 0;
+
+        for (const char *c = sample; *c; ++c)
+        {
+            int tx0, ty0, tx1, ty1;
+            stbtt_GetCodepointBitmapBox(&info, *c, scale, scale, &tx0, &ty0, &tx1, &ty1);
+            int tw = tx1 - tx0, th = ty1 - ty0;
+            std::vector<unsigned char> native((size_t)tw * th);
+            stbtt_MakeCodepointBitmap(&info, native.data(), tw, th, tw, scale, scale, *c);
+
+            float bakedScale = stbtt_ScaleForPixelHeight(&info, (float)bakedSize);
+            int bw, bh, bx, by;
+            unsigned char *baked = stbtt_GetCodepointBitmap(&info, bakedScale, bakedScale, *c, &bw, &bh, &bx, &by);
+
+            float sdfScale = stbtt_ScaleForPixelHeight(&info, (float)sdfBase);
+            int sw, sh, sx, sy;
+            unsigned char *sdf = stbtt_GetCodepointSDF(&info, sdfScale, *c, sdfSpread, 128, 128.0f / sdfSpread, &sw, &sh, &sx, &sy);
+
+            float toBaked = (float)bakedSize / size, toSDF = (float)sdfBase / size;
+            float ramp = 0.5f * (128.0f / sdfSpread) * toSDF; // half of fwidth, in distance units
+            for (int y = 0; y < th; ++y)
+            {
+                for (int x = 0; x < tw; ++x)
+                {
+                    float gx = tx0 + x + 0.5f, gy = ty0 + y + 0.5f;
+                    float coverage = native[(size_t)y * tw + x] / 255.0f;
+
+                    float b = sampleBilinear(baked, bw, bh, gx * toBaked - bx, gy * toBaked - by) / 255.0f;
+                    float d = sampleBilinear(sdf, sw, sh, gx * toSDF - sx, gy * toSDF - sy);
+                    float a = smoothstep(128.0f - ramp, 128.0f + ramp, d);
+
+                    bitmapError += std::fabs(b - coverage);
+                    sdfError += std::fabs(a - coverage);
+                    texels++;
+                }
+            }
+            stbtt_FreeBitmap(baked, nullptr);
+            stbtt_FreeSDF(sdf, nullptr);
+        }
+        printf("%-8d %19.2f%% %19.2f%%\n", size, 100.0 * bitmapError / texels, 100.0 * sdfError / texels);
+    }
+    printf("\n");
+}
+
+// a HUD of mostly static labels, a few change every frame (counters), laid out each
+// frame or through the TextLayoutCache
+void benchLayoutCache(int labels, int changingLabels, int frames)
+{
+    printf("== layout cache: %d labels, %d change every frame, %d frames ==\n", labels, changingLabels, frames);
+
+    std::vector<std::string> text(labels);
+    std::vector<float> x(labels), y(labels);
+    std::mt19937 rng(3);
+    for (int i = 0; i < labels; ++i)
+    {
+        text[i] = "Label " + std::to_string(i) + ": " + std::to_string(rng() % 100000);
+        x[i] = (float)(i % 8) * 160.0f;
+        y[i] = 20.0f + (float)(i / 8 % 90) * 12.0f;
+    }
+
+    GlyphCache cache(512);
+    cache.setUploadToGL(false);
+    int font = cache.addFont(font_path);
+
+    TextLayoutCache layouts;
+    TextBatch direct, cached;
+    cached.setLayoutCache(&layouts);
+
+    double directMs = 0.0, cachedMs = 0.0;
+    bool identical = true;
+    size_t glyphs = 0;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        for (int i = 0; i < changingLabels; ++i)
+            text[i] = "Counter " + std::to_string(i) + ": " + std::to_string(frame * 7919 + i);
+
+        cache.beginFrame();
+        direct.clear();
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < labels; ++i)
+            direct.add(cache, font, 11.0f, text[i].c_str(), x[i], y[i], 1.0f, 1.0f, 1.0f);
+        directMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        cached.clear();
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < labels; ++i)
+            cached.add(cache, font, 11.0f, text[i].c_str(), x[i], y[i], 1.0f, 1.0f, 1.0f);
+        cachedMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        size_t a = 0, b = 0;
+        const TextVertex *va = direct.vertices(cache, a);
+        const TextVertex *vb = cached.vertices(cache, b);
+        identical = identical && a == b && memcmp(va, vb, a * sizeof(TextVertex)) == 0;
+        glyphs = a / 4;
+    }
+
+    const TextLayoutCache::Stats &st = layouts.stats();
+    printf("%-28s %12s %14s\n", "path", "ms/frame", "Mglyphs/s");
+    printf("%-28s %12.3f %14.2f\n", "laid out every frame", directMs / frames, glyphs * frames / directMs / 1000.0);
+    printf("%-28s %12.3f %14.2f  (%.2fx)\n", "TextLayoutCache", cachedMs / frames, glyphs * frames / cachedMs / 1000.0, directMs / cachedMs);
+    printf("%llu hits (%llu already in place), %llu misses, %llu stale (%.1f%% hit rate), %zu entries, %llu aged out, same vertices: %s\n\n",
+           (unsigned long long)st.hits, (unsigned long long)st.inPlace, (unsigned long long)st.misses, (unsigned long long)st.stale,
+           100.0 * st.hits / (st.hits + st.misses + st.stale), layouts.entryCount(), (unsigned long long)st.dropped,
+           identical ? "yes" : "NO");
+}
+
+// atlas build time against thread count for a glyph set of up to glyphCount glyphs:
+// every codepoint the font maps, at as many sizes from 16 px up as it takes
+void benchParallelRaster(const char *path, size_t glyphCount)
+{
+    std::vector<unsigned char> ttf;
+    if (!read_file(path, ttf))
+    {
+        fprintf(stderr, "Can't read font: %s\n", path);
+        return;
+    }
+    stbtt_fontinfo info;
+    stbtt_InitFont(&info, ttf.data(), stbtt_GetFontOffsetForIndex(ttf.data(), 0));
+
+    std::vector<uint32_t> codepoints;
+    for (uint32_t c = 32; c < 0x30000; ++c)
+        if (stbtt_FindGlyphIndex(&info, c))
+            codepoints.push_back(c);
+
+    std::vector<GlyphCache::GlyphRequest> requests;
+    std::vector<int> sizes;
+    for (int size = 16; size <= 64 && requests.size() < glyphCount; size += 4)
+    {
+        sizes.push_back(size);
+        for (uint32_t c : codepoints)
+            if (requests.size() < glyphCount)
+                requests.push_back({ 0, (float)size, c });
+    }
+
+    // square power of two atlas with some room for shelf waste
+    double area = 0.0;
+    for (const GlyphCache::GlyphRequest &r : requests)
+    {
+        float scale = stbtt_ScaleForPixelHeight(&info, r.pixelHeight);
+        int x0, y0, x1, y1;
+        stbtt_GetCodepointBitmapBox(&info, r.codepoint, scale, scale, &x0, &y0, &x1, &y1);
+        area += (double)(x1 - x0 + 1) * (y1 - y0 + 4);
+    }
+    int atlasSize = 256;
+    while ((double)atlasSize * atlasSize < area * 1.5 && atlasSize < 8192)
+        atlasSize *= 2;
+
+    printf("== parallel glyph rasterization: %zu glyphs (%zu codepoints x %zu sizes, %d..%d px), %dx%d atlas, %u hardware threads ==\n",
+           requests.size(), codepoints.size(), sizes.size(), sizes.front(), sizes.back(), atlasSize, atlasSize, std::thread::hardware_concurrency());
+    printf("%-10s %12s %10s %14s %10s\n", "threads", "build ms", "speedup", "Kglyphs/s", "same atlas");
+
+    std::vector<unsigned char> reference;
+    double serialMs = 0.0;
+    const int threadCounts[] = { 0, 1, 2, 4, 8 };
+    for (int threads : threadCounts)
+    {
+        // the pool's workers plus the calling thread rasterize
+        ThreadPool *pool = threads > 0 ? new ThreadPool(threads) : nullptr;
+
+        GlyphCache cache(atlasSize);
+        cache.setUploadToGL(false);
+        int font = cache.addFont(path);
+        (void)font;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        cache.prefetch(requests.data(), requests.size(), pool);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        delete pool;
+
+        if (threads == 0)
+        {
+            reference = cache.bitmap();
+            serialMs = ms;
+        }
+        const char *label = threads == 0 ? "serial" : nullptr;
+        char name[32];
+        if (!label)
+        {
+            snprintf(name, sizeof(name), "%d + 1", threads);
+            label = name;
+        }
+        printf("%-10s %12.2f %9.2fx %14.1f %10s", label, ms, serialMs / ms, requests.size() / ms, cache.bitmap() == reference ? "yes" : "NO");
+        if (cache.frameStats().failed)
+            printf("  (%u didn't fit)", cache.frameStats().failed);
+        printf("\n");
+    }
+    printf("\n");
+}
+
+// measure() walks the advance and kerning tables, the reference asks stb_truetype per glyph
+// and pair like a layout without tables would
+static float measureNaive(const stbtt_fontinfo &info, float pixelHeight, const char *utf8)
+{
+    int width = 0;
+    uint32_t prev = 0;
+    const unsigned char *s = (const unsigned char*)utf8;
+    while (*s)
+    {
+        uint32_t cp = GlyphCache::decodeUtf8(s);
+        if (cp < 32)
+            continue;
+        int advance, lsb;
+        stbtt_GetCodepointHMetrics(&info, cp, &advance, &lsb);
+        if (prev)
+            width += stbtt_GetCodepointKernAdvance(&info, prev, cp);
+        width += advance;
+        prev = cp;
+    }
+    return width * stbtt_ScaleForPixelHeight(&info, pixelHeight);
+}
+
+void benchKerning(const char *path, size_t glyphsPerFrame, int frames)
+{
+    std::vector<unsigned char> ttf;
+    if (!read_file(path, ttf))
+    {
+        fprintf(stderr, "Can't read font: %s\n", path);
+        return;
+    }
+    stbtt_fontinfo info;
+    stbtt_InitFont(&info, ttf.data(), stbtt_GetFontOffsetForIndex(ttf.data(), 0));
+
+    GlyphCache cache(1024);
+    cache.setUploadToGL(false);
+    int font = cache.addFont(path);
+
+    // ASCII lines plus some Latin-1 ones for the sparse table
+    std::vector<TextLine> lines = makeLines(glyphsPerFrame, 40);
+    for (size_t i = 0; i < lines.size(); i += 8)
+        lines[i].text = "\xC3\x84VAT T\xC3\xB6ne W\xC3\xA4lder \xC3\x85ngstr\xC3\xB6m Yv\xC3\xA9s L'\xC3\x89t\xC3\xA9 F\xC3\xBChrer";
+
+    printf("== kerning: %s, %s, %zu glyphs per frame, %d frames ==\n", path,
+           cache.hasKerning(font) ? (info.gpos ? "GPOS" : "kern table") : "no kerning", glyphsPerFrame, frames);
+
+    TextBatch plain, kerned;
+    plain.setKerning(false);
+    double plainMs = 0.0, kernedMs = 0.0;
+    size_t glyphs = 0, moved = 0;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        cache.beginFrame();
+        plain.clear();
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const TextLine &line : lines)
+            plain.add(cache, font, 20.0f, line.text.c_str(), line.x, line.y, 1.0f, 1.0f, 1.0f);
+        plainMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        kerned.clear();
+        start = std::chrono::high_resolution_clock::now();
+        for (const TextLine &line : lines)
+            kerned.add(cache, font, 20.0f, line.text.c_str(), line.x, line.y, 1.0f, 1.0f, 1.0f);
+        kernedMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        size_t a = 0, b = 0;
+        const TextVertex *va = plain.vertices(cache, a);
+        const TextVertex *vb = kerned.vertices(cache, b);
+        moved = 0;
+        for (size_t i = 0; i < a && i < b; i += 4)
+            moved += va[i].x != vb[i].x;
+        glyphs = a / 4;
+    }
+
+    printf("%-28s %12s %14s\n", "layout", "ms/frame", "Mglyphs/s");
+    printf("%-28s %12.3f %14.2f\n", "no kerning", plainMs / frames, glyphs * frames / plainMs / 1000.0);
+    printf("%-28s %12.3f %14.2f  (%zu of %zu glyphs moved)\n", "kerned, table lookups", kernedMs / frames, glyphs * frames / kernedMs / 1000.0, moved, glyphs);
+
+    // widths only, no glyph lookups at all
+    double tableMs = 0.0, naiveMs = 0.0, tableSum = 0.0, naiveSum = 0.0;
+    float maxError = 0.0f;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const TextLine &line : lines)
+            tableSum += cache.measure(font, 20.0f, line.text.c_str());
+        tableMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        start = std::chrono::high_resolution_clock::now();
+        for (const TextLine &line : lines)
+            naiveSum += measureNaive(info, 20.0f, line.text.c_str());
+        naiveMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+    for (const TextLine &line : lines)
+        maxError = std::max(maxError, std::fabs(cache.measure(font, 20.0f, line.text.c_str()) - measureNaive(info, 20.0f, line.text.c_str())));
+
+    printf("%-28s %12.3f %14.2f\n", "measure, stbtt per pair", naiveMs / frames, glyphs * frames / naiveMs / 1000.0);
+    printf("%-28s %12.3f %14.2f  (%.1fx)\n", "measure, tables", tableMs / frames, glyphs * frames / tableMs / 1000.0, naiveMs / tableMs);
+    printf("%.0f px of text per frame, widths differ by at most %.4f px (%.4f px in total)\n\n",
+           tableSum / frames, maxError, std::fabs(tableSum - naiveSum) / frames);
+}
+
+int main(int argc, char **argv)
+{
+    // TextBench [glyphs per frame] [font for the rasterization and kerning benches, e.g. a CJK one]
+    size_t glyphsPerFrame = argc > 1 ? (size_t)std::atoll(argv[1]) : 100000;
+    const char *rasterFont = argc > 2 ? argv[2] : font_path;
+
+    FontAtlas font;
+    if (!bake_font(font, font_path, 20.0f))
+        return 1;
+
+    benchQuadGeneration(font, glyphsPerFrame, 30);
+    benchGlyphCacheLookup(font, glyphsPerFrame, 30);
+    benchGlyphCacheChurn(60);
+    benchSDF();
+    benchLayoutCache(5000, 20, 300);
+    benchParallelRaster(rasterFont, 20000);
+    benchKerning(rasterFont, glyphsPerFrame, 30);
+    return 0;
+}
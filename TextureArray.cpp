@@ -0,0 +1,484 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ImageDecoder.cpp"
+#include "MipGenerator.cpp"
+#include "ThreadPool.cpp"
+#include "TextureStreamer.cpp"
+
+// Same sized images as the layers of GL_TEXTURE_2D_ARRAY textures, so objects that only
+// differ by texture (the 15 pool balls) draw with one bind and one instanced call, the
+// layer coming from a per instance attribute (InstanceBuffer.cpp, location 7), instead
+// of a bind and a draw each.
+//
+// Images are grouped by size in the order the sizes first appear, one array per size,
+// split when a size has more images than GL_MAX_ARRAY_TEXTURE_LAYERS. layer(i) is where
+// the i-th path ended up; images that can't be read get texture 0 and array -1. Every
+// image is RGBA8 with its mip chain built on the CPU.
+//
+// load() decodes everything (on a ThreadPool when given) and uploads before returning.
+// loadAsync() returns right away, like TextureLoader: the sizes come from the file
+// headers (stbi_info, like TextureCache), so the arrays and layer() are final on return,
+// and the images decode on the pool, at most maxDecoded at a time. update() on the GL
+// thread uploads the decoded layers, up to uploadBudget bytes per call (always at least
+// one), or hands them to a TextureStreamer. Until all layers of an array are in,
+// texture() gives a 1x1 placeholder array with one layer instead, which every layer
+// index samples since GL clamps it.
+//
+//   TextureArrays balls;
+//   balls.loadAsync(paths, pool);
+//   layers[actor] = (float)balls.layer(actorId % 15).layer;   // shader: texture(sampler2DArray, vec3(UV, layer))
+//   each frame: balls.update();
+//               glBindTexture(GL_TEXTURE_2D_ARRAY, balls.texture(balls.layer(0).array)); draw
+class TextureArrays
+{
+public:
+	struct Layer
+	{
+		GLuint texture;        // GL_TEXTURE_2D_ARRAY, 0 when the image couldn't be read
+		int array;             // for array() and texture(), -1 with texture 0
+		int layer;
+		int width, height;
+	};
+
+	struct Stats
+	{
+		size_t images;
+		size_t failed;
+		size_t arrays;
+		size_t bytes;          // all levels of all layers
+		double decodeMs;       // decoding and mip chains, wall time for load(), summed over the threads for loadAsync()
+		double uploadMs;       // GL thread
+	};
+
+	TextureArrays(size_t maxDecoded = 4, size_t uploadBudget = 8 << 20);
+	~TextureArrays();
+
+	TextureArrays(const TextureArrays &) = delete;
+	TextureArrays &operator=(const TextureArrays &) = delete;
+
+	// replaces the arrays of an earlier load, returns how many images were loaded
+	size_t load(const std::vector<std::string> &paths, const MipOptions &mips = MipOptions(), ThreadPool *pool = nullptr);
+	// GL thread, replaces the arrays of an earlier load, pool has to outlive the load
+	void loadAsync(const std::vector<std::string> &paths, ThreadPool &pool, const MipOptions &mips = MipOptions());
+	// GL thread, once per frame after loadAsync(); returns how many layers it uploaded or
+	// handed to the streamer
+	uint32_t update();
+	// every array has all its layers
+	bool ready() const { return pendingArrays == 0; }
+	void release();
+
+	const Layer &layer(size_t image) const { return layers[image]; }
+	size_t arrayCount() const { return arrays.size(); }
+	GLuint array(size_t index) const { return arrays[index].texture; }
+	// what to bind for an array: itself once all its layers are in, else the placeholder
+	GLuint texture(size_t index) const { return arrays[index].complete ? arrays[index].texture : placeholderTexture; }
+	const Stats &stats() const { return counters; }
+
+	// without a GL context (benchmarks) nothing is uploaded and arrays are numbered from 1
+	void setUploadToGL(bool upload) { uploadToGL = upload; }
+	// nullptr: glTexSubImage3D straight from the decoded pixels in update()
+	void setStreamer(TextureStreamer *textureStreamer) { streamer = textureStreamer; }
+	void setPlaceholder(uint8_t r, uint8_t g, uint8_t b, uint8_t a) { placeholder[0] = r; placeholder[1] = g; placeholder[2] = b; placeholder[3] = a; }
+
+private:
+	struct Image
+	{
+		unsigned char *pixels;
+		int w, h;              // 0 x 0 when it can't be read
+		MipChain mips;
+	};
+
+	struct Array
+	{
+		GLuint texture;
+		int pending;           // layers not uploaded or handed to the streamer yet
+		bool complete;         // every layer is in the texture
+	};
+
+	struct Job
+	{
+		size_t image;
+		std::string path;
+		int w, h;              // from the header
+		MipOptions mipOptions;
+		unsigned char *pixels; // RGBA, the placeholder color when decoding failed
+		MipChain *mips;
+		double decodeMs;
+		const char *failure;   // decode_image_failure() is per thread, kept from the worker
+	};
+
+	void createArrays(const std::vector<Image> &images);
+	void uploadLayer(GLuint texture, int layer, const unsigned char *pixels, int w, int h, const MipChain &mips);
+	void startDecodes();
+	size_t uploadJob(Job &job);
+
+	std::vector<Array> arrays;
+	std::vector<Layer> layers;
+	Stats counters;
+	bool uploadToGL;
+
+	ThreadPool *pool;            // of the last loadAsync()
+	size_t maxDecoded;
+	size_t uploadBudget;
+	TextureStreamer *streamer;
+	GLuint placeholderTexture;
+	uint8_t placeholder[4];
+	size_t pendingArrays;
+
+	std::deque<Job> waiting;     // not handed to the pool yet, GL thread only
+	size_t inFlight;             // decoding or decoded, GL thread only
+
+	std::mutex mutex;
+	std::condition_variable decodedReady;
+	std::deque<Job> decoded;     // guarded by mutex
+	size_t decoding;             // guarded by mutex
+};
+
+
+TextureArrays::TextureArrays(size_t maxDecoded, size_t uploadBudget)
+	: maxDecoded(std::max<size_t>(maxDecoded, 1)), uploadBudget(uploadBudget)
+{
+	counters = Stats();
+	uploadToGL = true;
+	pool = nullptr;
+	streamer = nullptr;
+	placeholderTexture = 0;
+	setPlaceholder(128, 128, 128, 255);
+	pendingArrays = 0;
+	inFlight = 0;
+	decoding = 0;
+}
+
+TextureArrays::~TextureArrays()
+{
+	release();
+}
+
+void TextureArrays::release()
+{
+	// the decodes still running write into this object
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		decodedReady.wait(lock, [this] { return decoding == 0; });
+		for (Job &job : decoded)
+		{
+			stbi_image_free(job.pixels);
+			delete job.mips;
+		}
+		decoded.clear();
+	}
+	waiting.clear();
+	inFlight = 0;
+
+	if (uploadToGL)
+	{
+		for (Array &a : arrays)
+		{
+			if (streamer)
+				streamer->cancel(a.texture);
+			glDeleteTextures(1, &a.texture);
+		}
+		if (placeholderTexture)
+			glDeleteTextures(1, &placeholderTexture);
+	}
+	placeholderTexture = 0;
+	arrays.clear();
+	layers.clear();
+	pendingArrays = 0;
+}
+
+void TextureArrays::createArrays(const std::vector<Image> &images)
+{
+	GLint maxLayers = 256; // the GL 3.3 minimum
+	if (uploadToGL)
+		glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+	// sizes in the order they first appear, each group's images in path order
+	layers.assign(images.size(), Layer{ 0, -1, 0, 0, 0 });
+	std::vector<bool> grouped(images.size(), false);
+	for (size_t first = 0; first < images.size(); ++first)
+	{
+		int w = images[first].w, h = images[first].h;
+		if (grouped[first] || w == 0)
+			continue;
+		GLsizei count = 0;
+		for (size_t i = first; i < images.size() && count < maxLayers; ++i)
+		{
+			if (grouped[i] || images[i].w != w || images[i].h != h)
+				continue;
+			grouped[i] = true;
+			layers[i] = Layer{ 0, (int)arrays.size(), (int)count++, w, h };
+		}
+
+		// storage for the whole chain generate_mips makes
+		size_t bytes = (size_t)w * h * 4;
+		GLint levels = 0;
+		for (int lw = w, lh = h; lw > 1 || lh > 1; ++levels)
+		{
+			lw = mip_size(lw);
+			lh = mip_size(lh);
+			bytes += (size_t)lw * lh * 4;
+		}
+		counters.bytes += bytes * count;
+
+		GLuint texture = (GLuint)arrays.size() + 1;
+		if (uploadToGL)
+		{
+			glGenTextures(1, &texture);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+			for (GLint level = 0, lw = w, lh = h; level <= levels; ++level, lw = mip_size(lw), lh = mip_size(lh))
+				glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, lw, lh, count, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		}
+		for (Layer &l : layers)
+			if (l.array == (int)arrays.size())
+				l.texture = texture;
+		arrays.push_back(Array{ texture, (int)count, false });
+	}
+	counters.arrays = arrays.size();
+	pendingArrays = arrays.size();
+}
+
+// level 0 and the mip chain of one layer, straight from the CPU
+void TextureArrays::uploadLayer(GLuint texture, int layer, const unsigned char *pixels, int w, int h, const MipChain &mips)
+{
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, w, h, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	for (const MipLevel &m : mips.levels)
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, m.level, 0, 0, layer, m.width, m.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, mips.data(m));
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+size_t TextureArrays::load(const std::vector<std::string> &paths, const MipOptions &mips, ThreadPool *pool)
+{
+	release();
+	counters = Stats();
+	counters.images = paths.size();
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<Image> images(paths.size());
+	auto decode = [&](size_t begin, size_t end, int) {
+		for (size_t i = begin; i < end; ++i)
+		{
+			Image &image = images[i];
+			int channels;
+			image.pixels = decode_image(paths[i].c_str(), &image.w, &image.h, &channels, 4);
+			if (image.pixels)
+			{
+				generate_mips(image.pixels, image.w, image.h, mips, image.mips);
+			}
+			else
+			{
+				fprintf(stderr, "Can't load image: %s (%s)\n", paths[i].c_str(), decode_image_failure());
+				image.w = image.h = 0;
+			}
+		}
+	};
+	if (pool)
+		pool->parallelFor(images.size(), decode);
+	else
+		decode(0, images.size(), 0);
+	auto decoded = std::chrono::steady_clock::now();
+	counters.decodeMs = std::chrono::duration<double, std::milli>(decoded - start).count();
+
+	createArrays(images);
+
+	size_t loaded = 0;
+	for (size_t i = 0; i < images.size(); ++i)
+	{
+		if (images[i].pixels)
+		{
+			if (uploadToGL)
+				uploadLayer(layers[i].texture, layers[i].layer, images[i].pixels, images[i].w, images[i].h, images[i].mips);
+			loaded++;
+		}
+		else
+		{
+			counters.failed++;
+		}
+		stbi_image_free(images[i].pixels);
+	}
+	for (Array &a : arrays)
+	{
+		a.pending = 0;
+		a.complete = true;
+	}
+	pendingArrays = 0;
+	counters.uploadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - decoded).count();
+	return loaded;
+}
+
+void TextureArrays::loadAsync(const std::vector<std::string> &paths, ThreadPool &threadPool, const MipOptions &mips)
+{
+	release();
+	counters = Stats();
+	counters.images = paths.size();
+	pool = &threadPool;
+
+	// the sizes from the headers, from a mounted asset pack or the file like decode_image
+	std::vector<Image> images(paths.size());
+	for (size_t i = 0; i < paths.size(); ++i)
+	{
+		Image &image = images[i];
+		int channels;
+		AssetData file;
+		image.pixels = nullptr;
+		if (!open_asset(paths[i].c_str(), file) || !stbi_info_from_memory(file.data(), (int)file.size(), &image.w, &image.h, &channels))
+		{
+			fprintf(stderr, "Can't load image: %s (%s)\n", paths[i].c_str(), file.data() ? stbi_failure_reason() : "can't open file");
+			counters.failed++;
+			image.w = image.h = 0;
+		}
+	}
+	createArrays(images);
+
+	if (uploadToGL && !arrays.empty())
+	{
+		glGenTextures(1, &placeholderTexture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, placeholderTexture);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, 1, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+
+	for (size_t i = 0; i < paths.size(); ++i)
+	{
+		if (layers[i].array < 0)
+			continue;
+		Job job = Job();
+		job.image = i;
+		job.path = paths[i];
+		job.w = images[i].w;
+		job.h = images[i].h;
+		job.mipOptions = mips;
+		waiting.push_back(std::move(job));
+	}
+	startDecodes();
+}
+
+void TextureArrays::startDecodes()
+{
+	while (!waiting.empty() && inFlight < maxDecoded)
+	{
+		Job *job = new Job(std::move(waiting.front()));
+		waiting.pop_front();
+		inFlight++;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			decoding++;
+		}
+
+		pool->submit([this, job] {
+			auto start = std::chrono::steady_clock::now();
+			int w, h, channels;
+			job->pixels = decode_image(job->path.c_str(), &w, &h, &channels, 4);
+			job->failure = job->pixels ? nullptr : decode_image_failure();
+			if (job->pixels && (w != job->w || h != job->h))
+			{
+				stbi_image_free(job->pixels);
+				job->pixels = nullptr;
+				job->failure = "size differs from the header";
+			}
+			if (!job->pixels)
+			{
+				// the layer is in the array already, it gets the placeholder color
+				job->pixels = (unsigned char *)malloc((size_t)job->w * job->h * 4);
+				for (size_t i = 0; i < (size_t)job->w * job->h; ++i)
+					memcpy(job->pixels + i * 4, placeholder, 4);
+			}
+			job->mips = new MipChain();
+			generate_mips(job->pixels, job->w, job->h, job->mipOptions, *job->mips);
+			job->decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			decoded.push_back(std::move(*job));
+			delete job;
+			decoding--;
+			decodedReady.notify_all();
+		});
+	}
+}
+
+size_t TextureArrays::uploadJob(Job &job)
+{
+	inFlight--;
+	counters.decodeMs += job.decodeMs;
+	if (job.failure)
+	{
+		fprintf(stderr, "Can't load image: %s (%s)\n", job.path.c_str(), job.failure);
+		counters.failed++;
+	}
+
+	const Layer &l = layers[job.image];
+	size_t bytes = (size_t)job.w * job.h * 4 + job.mips->bytes();
+	auto start = std::chrono::steady_clock::now();
+	if (uploadToGL && streamer)
+	{
+		// the streamer owns both from here
+		streamer->uploadLayer(l.texture, l.layer, job.pixels, job.w, job.h, 4, stbi_image_free, job.mips);
+	}
+	else
+	{
+		if (uploadToGL)
+			uploadLayer(l.texture, l.layer, job.pixels, job.w, job.h, *job.mips);
+		stbi_image_free(job.pixels);
+		delete job.mips;
+	}
+	counters.uploadMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	arrays[l.array].pending--;
+	return bytes;
+}
+
+uint32_t TextureArrays::update()
+{
+	uint32_t uploads = 0;
+	size_t bytes = 0;
+	while (uploads == 0 || bytes < uploadBudget)
+	{
+		Job job;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (decoded.empty())
+				break;
+			job = std::move(decoded.front());
+			decoded.pop_front();
+		}
+		bytes += uploadJob(job);
+		uploads++;
+		startDecodes();
+	}
+
+	// an array is shown once its last layer is out of the streamer
+	for (Array &a : arrays)
+	{
+		if (a.complete || a.pending > 0 || (uploadToGL && streamer && streamer->streaming(a.texture)))
+			continue;
+		a.complete = true;
+		pendingArrays--;
+	}
+	return uploads;
+}
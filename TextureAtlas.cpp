@@ -0,0 +1,477 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ImageDecoder.cpp"
+#include "MipGenerator.cpp"
+#include "ThreadPool.cpp"
+
+// Rectangles packed into a fixed size page with the MaxRects algorithm (Jylanki, "A
+// Thousand Ways to Pack the Bin"): the free space is kept as the list of maximal free
+// rectangles, which may overlap. A rectangle goes into the free one the heuristic picks,
+// then every free rectangle it overlaps is split into the up to four maximal ones around
+// it and those contained in another are dropped. No rotation, a sprite's UVs stay axis
+// aligned. CPU only.
+//
+// BottomLeft puts each rectangle as high up as it fits, then leftmost, which keeps the
+// used part of a page compact (TextureAtlas shrinks pages to it). BestShortSideFit picks
+// the free rectangle the new one leaves the shortest side of, which fills full pages
+// about as well but scatters small rectangles over the whole page.
+class MaxRectsPacker
+{
+public:
+	struct Rect
+	{
+		int x, y, w, h;
+	};
+
+	enum class Heuristic
+	{
+		BottomLeft,
+		BestShortSideFit,
+	};
+
+	MaxRectsPacker(int width = 0, int height = 0, Heuristic heuristic = Heuristic::BottomLeft) { reset(width, height, heuristic); }
+
+	void reset(int width, int height, Heuristic heuristic = Heuristic::BottomLeft);
+	// false when there is no room for w x h
+	bool insert(int w, int h, Rect &out);
+
+	int width() const { return pageWidth; }
+	int height() const { return pageHeight; }
+	size_t usedArea() const { return used; }
+	// used area / page area
+	double occupancy() const { return pageWidth && pageHeight ? (double)used / ((double)pageWidth * pageHeight) : 0.0; }
+	size_t freeRectCount() const { return freeRects.size(); }
+
+private:
+	void place(const Rect &rect);
+
+	static bool contains(const Rect &outer, const Rect &inner)
+	{
+		return inner.x >= outer.x && inner.y >= outer.y && inner.x + inner.w <= outer.x + outer.w && inner.y + inner.h <= outer.y + outer.h;
+	}
+
+	int pageWidth, pageHeight;
+	Heuristic rule;
+	size_t used;
+	std::vector<Rect> freeRects;
+	std::vector<Rect> split;
+};
+
+
+void MaxRectsPacker::reset(int width, int height, Heuristic heuristic)
+{
+	pageWidth = width;
+	pageHeight = height;
+	rule = heuristic;
+	used = 0;
+	freeRects.clear();
+	if (width > 0 && height > 0)
+		freeRects.push_back({ 0, 0, width, height });
+}
+
+bool MaxRectsPacker::insert(int w, int h, Rect &out)
+{
+	// lowest score wins, the second one breaks ties
+	int bestScore = INT_MAX, bestTie = INT_MAX;
+	const Rect *best = nullptr;
+	for (const Rect &free : freeRects)
+	{
+		if (free.w < w || free.h < h)
+			continue;
+		int score, tie;
+		if (rule == Heuristic::BottomLeft)
+		{
+			score = free.y + h;
+			tie = free.x;
+		}
+		else
+		{
+			int leftoverX = free.w - w, leftoverY = free.h - h;
+			score = std::min(leftoverX, leftoverY);
+			tie = std::max(leftoverX, leftoverY);
+		}
+		if (score < bestScore || (score == bestScore && tie < bestTie))
+		{
+			bestScore = score;
+			bestTie = tie;
+			best = &free;
+		}
+	}
+	if (!best)
+		return false;
+
+	out = { best->x, best->y, w, h };
+	place(out);
+	used += (size_t)w * h;
+	return true;
+}
+
+void MaxRectsPacker::place(const Rect &rect)
+{
+	// free rectangles rect doesn't touch stay as they are, the others are replaced by
+	// what is left of them on each side of rect, each as tall or wide as they were
+	size_t kept = 0;
+	split.clear();
+	for (const Rect &free : freeRects)
+	{
+		if (rect.x >= free.x + free.w || rect.x + rect.w <= free.x || rect.y >= free.y + free.h || rect.y + rect.h <= free.y)
+		{
+			freeRects[kept++] = free;
+			continue;
+		}
+		if (rect.x > free.x)
+			split.push_back({ free.x, free.y, rect.x - free.x, free.h });
+		if (rect.x + rect.w < free.x + free.w)
+			split.push_back({ rect.x + rect.w, free.y, free.x + free.w - (rect.x + rect.w), free.h });
+		if (rect.y > free.y)
+			split.push_back({ free.x, free.y, free.w, rect.y - free.y });
+		if (rect.y + rect.h < free.y + free.h)
+			split.push_back({ free.x, rect.y + rect.h, free.w, free.y + free.h - (rect.y + rect.h) });
+	}
+	freeRects.resize(kept);
+
+	// the untouched ones were maximal and a new one lies inside its old one, so only the
+	// new ones can be redundant: inside an untouched one or another new one (of two equal
+	// ones the later is kept)
+	for (size_t i = 0; i < split.size(); ++i)
+	{
+		bool redundant = false;
+		for (size_t j = 0; j < kept && !redundant; ++j)
+			redundant = contains(freeRects[j], split[i]);
+		for (size_t j = 0; j < split.size() && !redundant; ++j)
+			redundant = j != i && contains(split[j], split[i]) && (j > i || !contains(split[i], split[j]));
+		if (!redundant)
+			freeRects.push_back(split[i]);
+	}
+}
+
+// Small images (UI sprites, icons) packed into shared RGBA8 pages, so everything drawn
+// from them can go in one batch with one texture (SpriteBatch.cpp) instead of a bind and
+// a draw per image.
+//
+// Sprites are added by path or as pixels, build() decodes the files (on a ThreadPool when
+// given), packs the largest first with MaxRectsPacker (bottom left) into pageSize x
+// pageSize pages, opening a new page when one is full, and shrinks each page to the power
+// of two that holds what was put in it. Every sprite gets padding pixels around it filled
+// with its own edge texels, so bilinear filtering at its edge and the first mip levels
+// never sample a neighbour. Mips stop at the level where the padding is one texel (log2
+// of padding).
+//
+//   TextureAtlas atlas(2048, 4);
+//   int circle = atlas.add("../res/textures/shoot2.png");
+//   atlas.build();
+//   const TextureAtlas::Sprite &s = atlas.sprite(circle);   // s.page, s.uv (u0, v0, u1, v1)
+class TextureAtlas
+{
+public:
+	struct Sprite
+	{
+		int page;               // -1 when it couldn't be read or is larger than a page
+		int x, y;               // of the image in the page, without the padding
+		int width, height;
+		glm::vec4 uv;           // u0, v0, u1, v1; v0 is the image's first row
+	};
+
+	struct Stats
+	{
+		size_t sprites;
+		size_t failed;
+		size_t pages;
+		size_t spriteArea;      // texels of the images
+		size_t paddedArea;      // with their padding
+		size_t pageArea;        // texels of all pages
+		double decodeMs;
+		double packMs;
+		double composeMs;       // copying, extruding, mips and uploads
+
+		// how much of the pages the images fill
+		double efficiency() const { return pageArea ? (double)spriteArea / pageArea : 0.0; }
+	};
+
+	TextureAtlas(int pageSize = 2048, int padding = 4);
+	~TextureAtlas();
+
+	TextureAtlas(const TextureAtlas &) = delete;
+	TextureAtlas &operator=(const TextureAtlas &) = delete;
+
+	// before build(), return the sprite's index
+	int add(const std::string &path);
+	int add(const uint8_t *rgba, int w, int h);
+
+	// packs everything added so far, replacing the pages of an earlier build(); returns
+	// how many sprites were packed
+	size_t build(ThreadPool *pool = nullptr);
+	void release();
+
+	size_t spriteCount() const { return sprites.size(); }
+	const Sprite &sprite(int index) const { return sprites[index]; }
+	size_t pageCount() const { return pages.size(); }
+	GLuint page(size_t index) const { return pages[index].texture; }
+	int pageWidth(size_t index) const { return pages[index].width; }
+	int pageHeight(size_t index) const { return pages[index].height; }
+	// the page's level 0, kept only when not uploading to GL
+	const uint8_t *pagePixels(size_t index) const { return pages[index].pixels.data(); }
+	int padding() const { return border; }
+	const Stats &stats() const { return counters; }
+
+	// without a GL context (benchmarks) pages stay in memory and get no texture
+	void setUploadToGL(bool upload) { uploadToGL = upload; }
+
+private:
+	struct Source
+	{
+		std::string path;               // empty when added as pixels
+		std::vector<uint8_t> pixels;
+		int w, h;
+	};
+
+	struct Page
+	{
+		GLuint texture;
+		int width, height;
+		std::vector<uint8_t> pixels;
+		MaxRectsPacker packer;
+	};
+
+	void compose(Page &page, const std::vector<int> &members);
+
+	// levels whose texels still fit in the padding
+	int maxMipLevel() const
+	{
+		int level = 0;
+		while ((2 << level) <= border)
+			level++;
+		return level;
+	}
+	// a sprite with its padding, rounded up to a texel of the last mip level so every
+	// sprite starts on one and its mips are filtered like they would be on their own
+	int cellSize(int size) const
+	{
+		int align = 1 << maxMipLevel();
+		return (size + 2 * border + align - 1) / align * align;
+	}
+
+	int pageSize, border;
+	std::vector<Source> sources;
+	std::vector<Sprite> sprites;
+	std::vector<Page> pages;
+	Stats counters;
+	bool uploadToGL;
+};
+
+
+TextureAtlas::TextureAtlas(int pageSize, int padding)
+	: pageSize(pageSize), border(padding)
+{
+	counters = Stats();
+	uploadToGL = true;
+}
+
+TextureAtlas::~TextureAtlas()
+{
+	release();
+}
+
+void TextureAtlas::release()
+{
+	for (Page &page : pages)
+		if (page.texture && uploadToGL)
+			glDeleteTextures(1, &page.texture);
+	pages.clear();
+}
+
+int TextureAtlas::add(const std::string &path)
+{
+	sources.push_back({ path, {}, 0, 0 });
+	sprites.push_back(Sprite{ -1, 0, 0, 0, 0, glm::vec4(0.0f) });
+	return (int)sprites.size() - 1;
+}
+
+int TextureAtlas::add(const uint8_t *rgba, int w, int h)
+{
+	sources.push_back({ std::string(), std::vector<uint8_t>(rgba, rgba + (size_t)w * h * 4), w, h });
+	sprites.push_back(Sprite{ -1, 0, 0, 0, 0, glm::vec4(0.0f) });
+	return (int)sprites.size() - 1;
+}
+
+size_t TextureAtlas::build(ThreadPool *pool)
+{
+	release();
+	counters = Stats();
+	counters.sprites = sources.size();
+
+	auto start = std::chrono::steady_clock::now();
+	auto decode = [&](size_t begin, size_t end, int) {
+		for (size_t i = begin; i < end; ++i)
+		{
+			Source &source = sources[i];
+			if (source.path.empty() || !source.pixels.empty())
+				continue;
+			int channels;
+			unsigned char *pixels = decode_image(source.path.c_str(), &source.w, &source.h, &channels, 4);
+			if (!pixels)
+			{
+				fprintf(stderr, "Can't load image: %s (%s)\n", source.path.c_str(), decode_image_failure());
+				continue;
+			}
+			source.pixels.assign(pixels, pixels + (size_t)source.w * source.h * 4);
+			stbi_image_free(pixels);
+		}
+	};
+	if (pool)
+		pool->parallelFor(sources.size(), decode);
+	else
+		decode(0, sources.size(), 0);
+	auto decoded = std::chrono::steady_clock::now();
+	counters.decodeMs = std::chrono::duration<double, std::milli>(decoded - start).count();
+
+	// longest side first, then the larger area: the big ones shape the free space best
+	std::vector<int> order;
+	for (size_t i = 0; i < sources.size(); ++i)
+	{
+		sprites[i].page = -1;
+		if (!sources[i].pixels.empty())
+			order.push_back((int)i);
+	}
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+		const Source &sa = sources[a], &sb = sources[b];
+		int longA = std::max(sa.w, sa.h), longB = std::max(sb.w, sb.h);
+		if (longA != longB)
+			return longA > longB;
+		return (size_t)sa.w * sa.h > (size_t)sb.w * sb.h;
+	});
+
+	std::vector<std::vector<int>> members;
+	for (int index : order)
+	{
+		const Source &source = sources[index];
+		int w = cellSize(source.w), h = cellSize(source.h);
+		MaxRectsPacker::Rect rect;
+		size_t p = 0;
+		for (; p < pages.size(); ++p)
+			if (pages[p].packer.insert(w, h, rect))
+				break;
+		if (p == pages.size())
+		{
+			Page page;
+			page.texture = 0;
+			page.width = page.height = 0;
+			page.packer.reset(pageSize, pageSize);
+			if (!page.packer.insert(w, h, rect))
+			{
+				fprintf(stderr, "Atlas: %dx%d sprite %s doesn't fit a %d page\n", source.w, source.h, source.path.c_str(), pageSize);
+				continue;
+			}
+			pages.push_back(std::move(page));
+			members.emplace_back();
+		}
+
+		Sprite &sprite = sprites[index];
+		sprite.page = (int)p;
+		sprite.x = rect.x + border;
+		sprite.y = rect.y + border;
+		sprite.width = source.w;
+		sprite.height = source.h;
+		members[p].push_back(index);
+		counters.spriteArea += (size_t)source.w * source.h;
+		counters.paddedArea += (size_t)w * h;
+	}
+	auto packed = std::chrono::steady_clock::now();
+	counters.packMs = std::chrono::duration<double, std::milli>(packed - decoded).count();
+
+	for (size_t p = 0; p < pages.size(); ++p)
+	{
+		compose(pages[p], members[p]);
+		counters.pageArea += (size_t)pages[p].width * pages[p].height;
+	}
+	counters.pages = pages.size();
+	counters.failed = sources.size() - order.size();
+	for (int index : order)
+		if (sprites[index].page < 0)
+			counters.failed++;
+	counters.composeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - packed).count();
+
+	// the decoded files are in the pages now, a later build() decodes them again
+	for (Source &source : sources)
+		if (!source.path.empty())
+			std::vector<uint8_t>().swap(source.pixels);
+	return counters.sprites - counters.failed;
+}
+
+void TextureAtlas::compose(Page &page, const std::vector<int> &members)
+{
+	// the smallest power of two that holds the page's sprites
+	int usedW = 1, usedH = 1;
+	for (int index : members)
+	{
+		usedW = std::max(usedW, sprites[index].x - border + cellSize(sprites[index].width));
+		usedH = std::max(usedH, sprites[index].y - border + cellSize(sprites[index].height));
+	}
+	page.width = page.height = 1;
+	while (page.width < usedW)
+		page.width *= 2;
+	while (page.height < usedH)
+		page.height *= 2;
+	page.pixels.assign((size_t)page.width * page.height * 4, 0);
+
+	for (int index : members)
+	{
+		Sprite &sprite = sprites[index];
+		const Source &source = sources[index];
+		sprite.uv = glm::vec4((float)sprite.x / page.width, (float)sprite.y / page.height,
+		                      (float)(sprite.x + sprite.width) / page.width, (float)(sprite.y + sprite.height) / page.height);
+
+		// each row with its first and last texel repeated to the ends of the cell, the first
+		// and last rows repeated above and below
+		int right = cellSize(source.w) - border - source.w;
+		for (int y = -border; y < cellSize(source.h) - border; ++y)
+		{
+			const uint8_t *src = source.pixels.data() + (size_t)std::min(std::max(y, 0), source.h - 1) * source.w * 4;
+			uint8_t *dst = page.pixels.data() + ((size_t)(sprite.y + y) * page.width + sprite.x - border) * 4;
+			for (int x = 0; x < border; ++x)
+				memcpy(dst + x * 4, src, 4);
+			memcpy(dst + border * 4, src, (size_t)source.w * 4);
+			for (int x = 0; x < right; ++x)
+				memcpy(dst + (border + source.w + x) * 4, src + (source.w - 1) * 4, 4);
+		}
+	}
+
+	if (!uploadToGL)
+		return;
+
+	int maxLevel = maxMipLevel();
+	MipOptions options;
+	options.premultiplyAlpha = true;
+	MipChain chain;
+	if (maxLevel > 0)
+		generate_mips(page.pixels.data(), page.width, page.height, options, chain);
+
+	glGenTextures(1, &page.texture);
+	glBindTexture(GL_TEXTURE_2D, page.texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, page.width, page.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, page.pixels.data());
+	for (const MipLevel &level : chain.levels)
+		if (level.level <= maxLevel)
+			glTexImage2D(GL_TEXTURE_2D, level.level, GL_RGBA8, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, chain.data(level));
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, maxLevel);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, maxLevel > 0 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	std::vector<uint8_t>().swap(page.pixels);
+}
@@ -0,0 +1,103 @@
+// Offline texture baker: decodes images (ImageDecoder.cpp) and writes them as .qtex
+// (BakedTexture.cpp) with the full mip chain, optionally BC1/BC3 compressed, so the
+// programs upload them without decoding or glGenerateMipmap.
+//
+//   TextureBake <rgba|bc1|bc3|auto> [--linear] <output dir> <images...>
+//   TextureBake auto ../res/baked ../res/textures/*.png ../res/textures/pool/*.ppm
+//
+// auto picks BC1 for opaque images and BC3 for ones with alpha. Mips are filtered in
+// linear light (MipGenerator.cpp) unless --linear says the data isn't sRGB (normal maps,
+// masks); images with alpha are filtered with alpha weighting.
+
+#include "UploadImage.cpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+static bool hasAlpha(const uint8_t *rgba, size_t texels)
+{
+    for (size_t i = 0; i < texels; ++i)
+        if (rgba[i * 4 + 3] != 255)
+            return true;
+    return false;
+}
+
+static std::string bakedPath(const std::string &dir, const std::string &image)
+{
+    size_t slash = image.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? image : image.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos)
+        name.resize(dot);
+    return dir + "/" + name + ".qtex";
+}
+
+int main(int argc, char **argv)
+{
+    bool linear = argc > 2 && strcmp(argv[2], "--linear") == 0;
+    int first = linear ? 3 : 2;
+    if (argc < first + 2)
+    {
+        fprintf(stderr, "usage: TextureBake <rgba|bc1|bc3|auto> [--linear] <output dir> <images...>\n");
+        return 1;
+    }
+    const char *outputDir = argv[first];
+
+    const char *mode = argv[1];
+    if (strcmp(mode, "rgba") && strcmp(mode, "bc1") && strcmp(mode, "bc3") && strcmp(mode, "auto"))
+    {
+        fprintf(stderr, "unknown format: %s\n", mode);
+        return 1;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(outputDir, error);
+
+    int failed = 0;
+    for (int i = first + 1; i < argc; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        int w, h, channels;
+        uint8_t *rgba = decode_image(argv[i], &w, &h, &channels, 4);
+        if (!rgba)
+        {
+            fprintf(stderr, "Can't load image: %s (%s)\n", argv[i], decode_image_failure());
+            failed++;
+            continue;
+        }
+
+        MipOptions mips;
+        mips.srgb = !linear;
+        mips.premultiplyAlpha = hasAlpha(rgba, (size_t)w * h);
+
+        BakedFormat format = BakedFormat::RGBA8;
+        if (strcmp(mode, "bc1") == 0)
+            format = BakedFormat::BC1;
+        else if (strcmp(mode, "bc3") == 0)
+            format = BakedFormat::BC3;
+        else if (strcmp(mode, "auto") == 0)
+            format = mips.premultiplyAlpha ? BakedFormat::BC3 : BakedFormat::BC1;
+
+        std::vector<uint8_t> file;
+        bake_texture(rgba, w, h, format, file, mips);
+        stbi_image_free(rgba);
+
+        std::string out = bakedPath(outputDir, argv[i]);
+        if (!save_baked_texture(out.c_str(), file))
+        {
+            fprintf(stderr, "Can't write %s\n", out.c_str());
+            failed++;
+            continue;
+        }
+
+        static const char *names[] = { "RGBA8", "BC1", "BC3" };
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        printf("%-48s %5dx%-5d %-5s %2u mips %9.1f KB %8.1f ms\n", out.c_str(), w, h, names[(int)format],
+               ((const BakedTextureHeader*)file.data())->mipCount, file.size() / 1024.0, ms);
+    }
+    return failed ? 1 : 0;
+}
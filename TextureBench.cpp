@@ -0,0 +1,751 @@
+// Headless CPU benchmarks for texture loading (TextureLoader.cpp, TextureCache.cpp,
+// BakedTexture.cpp, CompressedTexture.cpp, MipGenerator.cpp, ImageDecoder.cpp, AssetPack.cpp, UploadImage.cpp,
+// TextureAtlas.cpp). No window or GL context is created, everything
+// runs with setUploadToGL(false).
+// Run from the build directory like the demos, the images are under ../res/textures.
+
+#include "TextureLoader.cpp"
+#include "TextureCache.cpp"
+#include "BakedTexture.cpp"
+#include "CompressedTexture.cpp"
+#include "TextureAtlas.cpp"
+#include "TextureArray.cpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// what BasicGeometryMesh loads at startup: the pool balls into a texture array, the rest
+// through the TextureLoader, all decoded on its pool while the first frames draw
+static std::vector<std::string> demoTextures()
+{
+    std::vector<std::string> paths = {
+        "../res/textures/PresentA_ALB.png",
+        "../res/textures/NumGrid_ALB.png",
+    };
+    for (int i = 1; i <= 15; ++i)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "../res/textures/pool/pool_%02d.ppm", i);
+        paths.push_back(path);
+    }
+    paths.push_back("../res/textures/shoot2.png");
+    paths.push_back("../res/textures/rect_round_corner2.png");
+    paths.push_back("../res/textures/Exclamation_Mark.png");
+    return paths;
+}
+
+// frameMs of render work per frame, slept so the decoding threads get the cores like
+// they would while the GPU is busy
+void benchAsyncLoad(double frameMs)
+{
+    std::vector<std::string> paths = demoTextures();
+    printf("== texture loading: %zu images, %.1f ms frames, %u hardware threads ==\n", paths.size(), frameMs, std::thread::hardware_concurrency());
+    printf("%-10s %16s %14s %8s %18s\n", "threads", "first frame ms", "all loaded ms", "frames", "max uploads/frame");
+
+    // the old way: every stbi_load before the first frame
+    {
+        auto start = std::chrono::steady_clock::now();
+        size_t bytes = 0;
+        for (const std::string &path : paths)
+        {
+            int w, h, channels;
+            unsigned char *pixels = stbi_load(path.c_str(), &w, &h, &channels, 0);
+            if (pixels)
+                bytes += (size_t)w * h * channels;
+            stbi_image_free(pixels);
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        printf("%-10s %16.1f %14.1f %8d %18zu  (%.1f MB decoded)\n", "serial", ms, ms, 1, paths.size(), bytes / 1048576.0);
+    }
+
+    const int threadCounts[] = { 1, 2, 4, 8 };
+    for (int threads : threadCounts)
+    {
+        auto start = std::chrono::steady_clock::now();
+        ThreadPool pool(threads);
+        TextureLoader loader(pool);
+        loader.setUploadToGL(false);
+        TextureArrays balls;
+        balls.setUploadToGL(false);
+        std::vector<std::string> ballPaths;
+        for (const std::string &path : paths)
+        {
+            if (path.find("/pool/") != std::string::npos)
+                ballPaths.push_back(path);
+            else
+                loader.load(path.c_str());
+        }
+        balls.loadAsync(ballPaths, pool);
+
+        double firstFrameMs = 0.0;
+        int frames = 0;
+        uint32_t maxUploads = 0;
+        while (!loader.done() || !balls.ready())
+        {
+            loader.update();
+            uint32_t layers = balls.update();
+            maxUploads = std::max(maxUploads, loader.frameStats().uploads + layers);
+            std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(frameMs));
+            if (frames++ == 0)
+                firstFrameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        double loadedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        const TextureLoader::Stats &st = loader.totals();
+        printf("%-10d %16.1f %14.1f %8d %18u  (%.1f ms decoding in total, %zu failed)\n", threads, firstFrameMs,
+               loadedMs, frames, maxUploads, st.decodeMs + balls.stats().decodeMs, st.failed + balls.stats().failed);
+    }
+    printf("\n");
+}
+
+// scenes of the demos loaded one after the other, each holding handles only to its own
+// textures, against decoding every texture a scene asks for
+void benchTextureCache(size_t budgetMB, int rounds)
+{
+    std::vector<std::vector<std::string>> scenes;
+    scenes.push_back(demoTextures());
+    scenes.back().push_back("../res/textures/PresentA_ALB.png");   // the crate texture on a second object
+    scenes.push_back({ "../res/textures/pool/pool_01.ppm", "../res/textures/PresentA_ALB.png" });
+    scenes.push_back({ "../res/textures/shoot.png", "../res/textures/shoot2.png" });
+    scenes.push_back({ "../res/textures/PresentB_ALB.png", "../res/textures/PresentC_ALB.png", "../res/textures/PresentD_ALB.png",
+                       "../res/textures/checker.bmp", "../res/textures/crate.bmp", "../res/textures/shoot2.png" });
+
+    printf("== texture cache: %zu scenes x %d rounds, %zu MB budget ==\n", scenes.size(), rounds, budgetMB);
+
+    double uncachedMs = 0.0;
+    size_t acquires = 0;
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < rounds; ++round)
+            for (const std::vector<std::string> &scene : scenes)
+                for (const std::string &path : scene)
+                {
+                    int w, h, channels;
+                    stbi_image_free(stbi_load(path.c_str(), &w, &h, &channels, 0));
+                    acquires++;
+                }
+        uncachedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    TextureCache cache(budgetMB << 20);
+    cache.setUploadToGL(false);
+    size_t peakResident = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round)
+    {
+        for (const std::vector<std::string> &scene : scenes)
+        {
+            std::vector<TextureCache::Handle> handles;
+            for (const std::string &path : scene)
+                handles.push_back(cache.acquire(path.c_str()));
+            peakResident = std::max(peakResident, cache.stats().bytesResident);
+        }
+    }
+    double cachedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    const TextureCache::Stats &st = cache.stats();
+    printf("%-22s %12s %10s\n", "path", "ms", "decodes");
+    printf("%-22s %12.1f %10zu\n", "decode every acquire", uncachedMs, acquires);
+    printf("%-22s %12.1f %10llu  (%.1fx)\n", "TextureCache", cachedMs, (unsigned long long)st.misses, uncachedMs / cachedMs);
+    printf("%llu hits (%.1f%%), %llu evictions, %zu textures / %.1f MB resident at the end, %.1f MB at peak\n\n",
+           (unsigned long long)st.hits, 100.0 * st.hits / acquires, (unsigned long long)st.evictions, st.entries,
+           st.bytesResident / 1048576.0, peakResident / 1048576.0);
+}
+
+// every image of res/textures, as stb_image decodes it against the baked .qtex files
+// (RGBA8 and BC1/BC3) mapped and copied out like a glTexImage2D would. Cold runs drop the
+// files from the OS cache first. The GL side (upload, glGenerateMipmap for the decoded
+// images) isn't included.
+void benchBakedLoad()
+{
+    std::vector<std::string> images;
+    for (const char *dir : { "../res/textures", "../res/textures/pool" })
+        for (const auto &entry : std::filesystem::directory_iterator(dir))
+        {
+            std::string ext = entry.path().extension().string();
+            if (ext == ".png" || ext == ".ppm" || ext == ".bmp")
+                images.push_back(entry.path().string());
+        }
+    std::sort(images.begin(), images.end());
+
+    // bake both variants once
+    const char *bakedDirs[2] = { "baked_rgba", "baked_bc" };
+    std::vector<std::string> baked[2];
+    double bakeMs[2] = { 0.0, 0.0 };
+    size_t sourceBytes = 0, bakedBytes[2] = { 0, 0 };
+    for (int variant = 0; variant < 2; ++variant)
+    {
+        std::filesystem::create_directories(bakedDirs[variant]);
+        for (const std::string &image : images)
+        {
+            auto start = std::chrono::steady_clock::now();
+            int w, h, channels;
+            uint8_t *rgba = stbi_load(image.c_str(), &w, &h, &channels, 4);
+            if (!rgba)
+                continue;
+
+            BakedFormat format = BakedFormat::RGBA8;
+            if (variant == 1)
+            {
+                format = BakedFormat::BC1;
+                for (size_t i = 0; i < (size_t)w * h && format == BakedFormat::BC1; ++i)
+                    if (rgba[i * 4 + 3] != 255)
+                        format = BakedFormat::BC3;
+            }
+            MipOptions mips;
+            for (size_t i = 0; i < (size_t)w * h && !mips.premultiplyAlpha; ++i)
+                mips.premultiplyAlpha = rgba[i * 4 + 3] != 255;
+            std::vector<uint8_t> file;
+            bake_texture(rgba, w, h, format, file, mips);
+            stbi_image_free(rgba);
+
+            std::string out = std::string(bakedDirs[variant]) + "/" + std::filesystem::path(image).stem().string() + ".qtex";
+            save_baked_texture(out.c_str(), file);
+            baked[variant].push_back(out);
+            bakedBytes[variant] += file.size();
+            if (variant == 0)
+                sourceBytes += std::filesystem::file_size(image);
+            bakeMs[variant] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+
+    printf("== baked textures: %zu images from res/textures, %.1f MB of files ==\n", images.size(), sourceBytes / 1048576.0);
+    printf("bake: RGBA8 %.0f ms -> %.1f MB, BC1/BC3 %.0f ms -> %.1f MB (full mip chains)\n",
+           bakeMs[0], bakedBytes[0] / 1048576.0, bakeMs[1], bakedBytes[1] / 1048576.0);
+    printf("%-26s %12s %12s %14s\n", "path", "cold ms", "warm ms", "MB to upload");
+
+    std::vector<uint8_t> upload;
+    auto loadDecoded = [&](size_t &bytes) {
+        for (const std::string &image : images)
+        {
+            int w, h, channels;
+            uint8_t *pixels = stbi_load(image.c_str(), &w, &h, &channels, 0);
+            bytes += (size_t)w * h * channels;
+            stbi_image_free(pixels);
+        }
+    };
+    auto loadBaked = [&](const std::vector<std::string> &files, size_t &bytes) {
+        for (const std::string &file : files)
+        {
+            BakedTexture texture;
+            if (!open_baked_texture(file.c_str(), texture))
+                continue;
+            for (uint32_t mip = 0; mip < texture.header->mipCount; ++mip)
+            {
+                const BakedMip &m = texture.header->mips[mip];
+                upload.resize(std::max<size_t>(upload.size(), m.size));
+                memcpy(upload.data(), texture.file.data() + m.offset, m.size);
+                bytes += m.size;
+            }
+        }
+    };
+
+    for (int path = 0; path < 3; ++path)
+    {
+        const std::vector<std::string> &files = path == 0 ? images : baked[path - 1];
+        double ms[2];
+        size_t bytes = 0;
+        for (int run = 0; run < 2; ++run)
+        {
+            if (run == 0)
+                for (const std::string &file : files)
+                    MappedFile::dropFromCache(file.c_str());
+
+            bytes = 0;
+            auto start = std::chrono::steady_clock::now();
+            if (path == 0)
+                loadDecoded(bytes);
+            else
+                loadBaked(files, bytes);
+            ms[run] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        static const char *names[3] = { "stbi_load (no mips)", ".qtex RGBA8 + mips", ".qtex BC1/BC3 + mips" };
+        printf("%-26s %12.1f %12.1f %14.1f\n", names[path], ms[0], ms[1], bytes / 1048576.0);
+    }
+    printf("\n");
+}
+
+// the CPU BCn decoder CompressedTexture falls back on: the SIMD path against the scalar
+// reference on the shipped DDS and on images compressed with compress_bc_image, which
+// also checks that both decode every block the same
+void benchBcDecode(int rounds)
+{
+    struct Source
+    {
+        std::string name;
+        BcFormat format;
+        int w, h;
+        std::vector<uint8_t> blocks;
+    };
+    std::vector<Source> sources;
+
+    CompressedTexture dds;
+    if (open_compressed_texture("../res/textures/BathroomFloor_ALB.dds", dds))
+        sources.push_back({ "BathroomFloor_ALB.dds", dds.format, (int)dds.width, (int)dds.height,
+                            std::vector<uint8_t>(dds.mips[0].data, dds.mips[0].data + dds.mips[0].size) });
+
+    const char *images[][2] = { { "../res/textures/PresentA_ALB.png", "BC1" }, { "../res/textures/shoot2.png", "BC3" } };
+    for (const auto &image : images)
+    {
+        int w, h, channels;
+        uint8_t *rgba = stbi_load(image[0], &w, &h, &channels, 4);
+        if (!rgba)
+            continue;
+        bool bc3 = strcmp(image[1], "BC3") == 0;
+        sources.push_back({ std::filesystem::path(image[0]).filename().string(), bc3 ? BcFormat::BC3 : BcFormat::BC1, w, h, {} });
+        compress_bc_image(rgba, w, h, bc3, sources.back().blocks);
+        stbi_image_free(rgba);
+    }
+
+    static const char *formatNames[] = { "BC1", "BC2", "BC3", "BC4", "BC5" };
+#if defined(__SSSE3__)
+    const char *simd = "SSSE3";
+#elif defined(BC_DECODE_SSE2)
+    const char *simd = "SSE2";
+#else
+    const char *simd = "none";
+#endif
+    printf("== BCn decode: %d rounds, SIMD path %s ==\n", rounds, simd);
+    printf("%-24s %-4s %11s %14s %14s %9s %10s\n", "image", "fmt", "size", "scalar MB/s", "SIMD MB/s", "speedup", "identical");
+    for (const Source &source : sources)
+    {
+        size_t bytes = (size_t)source.w * source.h * 4;
+        std::vector<uint8_t> scalar(bytes), simdOut(bytes);
+
+        double ms[2];
+        for (int path = 0; path < 2; ++path)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (int round = 0; round < rounds; ++round)
+            {
+                if (path == 0)
+                    decode_bc_image_scalar(source.format, source.blocks.data(), source.w, source.h, scalar.data());
+                else
+                    decode_bc_image(source.format, source.blocks.data(), source.w, source.h, simdOut.data());
+            }
+            ms[path] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        char size[32];
+        snprintf(size, sizeof(size), "%dx%d", source.w, source.h);
+        double mb = bytes * (double)rounds / 1048576.0;
+        printf("%-24s %-4s %11s %14.0f %14.0f %8.1fx %10s\n", source.name.c_str(), formatNames[(int)source.format], size,
+               mb / (ms[0] / 1000.0), mb / (ms[1] / 1000.0), ms[0] / ms[1], scalar == simdOut ? "yes" : "NO");
+    }
+    printf("\n");
+}
+
+// mip chains of the demo textures built on the CPU: the scalar reference, the SIMD path
+// and the SIMD path over a ThreadPool, for the byte average glGenerateMipmap does, sRGB
+// correct filtering and sRGB with alpha weighting. Also how far the byte average is off
+// the sRGB correct levels.
+void benchMipGeneration(int rounds)
+{
+    struct Image
+    {
+        uint8_t *rgba;
+        int w, h;
+    };
+    std::vector<Image> images;
+    size_t sourceBytes = 0;
+    for (const std::string &path : demoTextures())
+    {
+        Image image;
+        int channels;
+        image.rgba = stbi_load(path.c_str(), &image.w, &image.h, &channels, 4);
+        if (!image.rgba)
+            continue;
+        images.push_back(image);
+        sourceBytes += (size_t)image.w * image.h * 4;
+    }
+
+#if defined(__AVX2__)
+    const char *simd = "AVX2";
+#elif defined(MIP_SSE2)
+    const char *simd = "SSE2";
+#else
+    const char *simd = "none";
+#endif
+    ThreadPool pool;
+    printf("== CPU mipmaps: %zu images, %.1f MB, %d rounds, SIMD path %s, %d pool threads + caller ==\n",
+           images.size(), sourceBytes / 1048576.0, rounds, simd, pool.threadCount());
+    printf("%-22s %12s %12s %12s %9s %10s\n", "filter", "scalar ms", "SIMD ms", "pool ms", "speedup", "identical");
+
+    struct Mode
+    {
+        const char *name;
+        MipOptions options;
+    };
+    const Mode modes[] = {
+        { "byte average", { false, false } },
+        { "sRGB", { true, false } },
+        { "sRGB + alpha weight", { true, true } },
+    };
+
+    std::vector<MipChain> reference(images.size()), chains(images.size()), gamma(images.size());
+    for (const Mode &mode : modes)
+    {
+        double ms[3];
+        for (int path = 0; path < 3; ++path)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (int round = 0; round < rounds; ++round)
+                for (size_t i = 0; i < images.size(); ++i)
+                    generate_mips(images[i].rgba, images[i].w, images[i].h, mode.options, path == 0 ? reference[i] : chains[i],
+                                  path == 2 ? &pool : nullptr, path == 0);
+            ms[path] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / rounds;
+        }
+
+        bool identical = true;
+        for (size_t i = 0; i < images.size(); ++i)
+            identical = identical && reference[i].pixels == chains[i].pixels;
+        printf("%-22s %12.1f %12.1f %12.1f %8.1fx %10s\n", mode.name, ms[0], ms[1], ms[2], ms[0] / std::min(ms[1], ms[2]), identical ? "yes" : "NO");
+
+        if (!mode.options.srgb)
+            gamma.swap(chains);
+    }
+
+    // chains now holds the last mode, sRGB with alpha weighting
+    double difference = 0.0;
+    size_t count = 0;
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        for (size_t b = 0; b < gamma[i].pixels.size(); ++b)
+            if ((b & 3) != 3)
+                difference += (double)chains[i].pixels[b] - gamma[i].pixels[b];
+        count += gamma[i].pixels.size() / 4 * 3;
+    }
+    printf("byte average is %.2f levels darker than sRGB on average over the mip levels\n\n", difference / count);
+
+    for (Image &image : images)
+        stbi_image_free(image.rgba);
+}
+
+// every image under res/textures, from memory so only decoding is timed, stbi_load against
+// decode_image per format, MB/s of decoded pixels
+void benchImageDecode(int rounds)
+{
+    struct Format
+    {
+        std::string extension;
+        std::vector<std::vector<uint8_t>> files;
+        size_t pixelBytes = 0;
+        double stbMs = 0.0, ms = 0.0;
+        bool identical = true;
+    };
+    std::vector<Format> formats;
+    for (const auto &entry : std::filesystem::recursive_directory_iterator("../res/textures"))
+    {
+        std::string extension = entry.path().extension().string();
+        if (!entry.is_regular_file() || extension == ".dds" || extension == ".ktx")
+            continue;
+        MappedFile file;
+        if (!file.open(entry.path().string().c_str()))
+            continue;
+        auto format = std::find_if(formats.begin(), formats.end(), [&](const Format &f) { return f.extension == extension; });
+        if (format == formats.end())
+        {
+            formats.push_back(Format());
+            format = formats.end() - 1;
+            format->extension = extension;
+        }
+        format->files.emplace_back(file.data(), file.data() + file.size());
+    }
+
+    printf("== image decoding: %d rounds, from memory ==\n", rounds);
+    printf("%-8s %6s %10s %12s %10s %12s %9s %10s\n", "format", "files", "stb ms", "stb MB/s", "ms", "MB/s", "speedup", "identical");
+    for (Format &format : formats)
+    {
+        for (int path = 0; path < 2; ++path)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (int round = 0; round < rounds; ++round)
+            {
+                for (const std::vector<uint8_t> &file : format.files)
+                {
+                    int w, h, channels;
+                    unsigned char *pixels = path == 0 ? stbi_load_from_memory(file.data(), (int)file.size(), &w, &h, &channels, 0)
+                                                      : decode_image_memory(file.data(), file.size(), &w, &h, &channels, 0);
+                    if (pixels && path == 0 && round == 0)
+                        format.pixelBytes += (size_t)w * h * channels;
+                    stbi_image_free(pixels);
+                }
+            }
+            (path == 0 ? format.stbMs : format.ms) = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / rounds;
+        }
+
+        // same pixels as stb_image, as stored and as RGBA
+        for (const std::vector<uint8_t> &file : format.files)
+        {
+            for (int desired : { 0, 4 })
+            {
+                int w, h, channels, ownW = 0, ownH = 0, ownChannels = 0;
+                unsigned char *reference = stbi_load_from_memory(file.data(), (int)file.size(), &w, &h, &channels, desired);
+                unsigned char *pixels = decode_image_memory(file.data(), file.size(), &ownW, &ownH, &ownChannels, desired);
+                format.identical = format.identical && reference && pixels && w == ownW && h == ownH && channels == ownChannels &&
+                                   memcmp(reference, pixels, (size_t)w * h * (desired ? desired : channels)) == 0;
+                stbi_image_free(reference);
+                stbi_image_free(pixels);
+            }
+        }
+
+        double megabytes = format.pixelBytes / 1048576.0;
+        printf("%-8s %6zu %10.1f %12.1f %10.1f %12.1f %8.2fx %10s\n", format.extension.c_str(), format.files.size(), format.stbMs,
+               megabytes / (format.stbMs / 1000.0), format.ms, megabytes / (format.ms / 1000.0), format.stbMs / format.ms,
+               format.identical ? "yes" : "NO");
+    }
+    printf("\n");
+}
+
+// startup I/O from loose files against asset packs (stored, LZ4), cold (dropped from the
+// page cache) and warm: every file under res/ and shaders/ read through open_asset, then
+// the demo's textures decoded through decode_image
+void benchAssetPack()
+{
+    std::vector<AssetPackSource> sources;
+    for (const char *root : { "../res", "../shaders" })
+        for (const auto &entry : std::filesystem::recursive_directory_iterator(root))
+            if (entry.is_regular_file() && entry.file_size() > 0 && entry.path().extension() != ".qpak")
+                sources.push_back({ asset_name(entry.path().generic_string().c_str()), entry.path().string() });
+
+    const char *packs[2] = { "bench_assets.qpak", "bench_assets_lz4.qpak" };
+    AssetPackStats stats[2];
+    for (int i = 0; i < 2; ++i)
+        write_asset_pack(packs[i], sources, i == 1, &stats[i]);
+
+    printf("== asset packs: %zu files, %.1f MB; pack %.1f MB, LZ4 pack %.1f MB (%zu entries compressed) ==\n", sources.size(),
+           stats[0].rawBytes / 1048576.0, stats[0].packBytes / 1048576.0, stats[1].packBytes / 1048576.0, stats[1].compressed);
+    printf("%-18s %14s %14s %16s %16s\n", "source", "read cold ms", "read warm ms", "decode cold ms", "decode warm ms");
+
+    std::vector<std::string> textures = demoTextures();
+    for (int config = 0; config < 3; ++config)
+    {
+        unmount_asset_packs();
+        if (config > 0 && !mount_asset_pack(packs[config - 1]))
+            continue;
+
+        double ms[2][2];
+        for (int phase = 0; phase < 2; ++phase)
+        {
+            for (int run = 0; run < 2; ++run)
+            {
+                if (run == 0)
+                {
+                    // the mapping keeps the pack's pages, remount after dropping them
+                    unmount_asset_packs();
+                    for (const AssetPackSource &source : sources)
+                        MappedFile::dropFromCache(source.path.c_str());
+                    for (const char *pack : packs)
+                        MappedFile::dropFromCache(pack);
+                    if (config > 0)
+                        mount_asset_pack(packs[config - 1]);
+                }
+
+                auto start = std::chrono::steady_clock::now();
+                if (phase == 0)
+                {
+                    uint32_t sum = 0;
+                    for (const AssetPackSource &source : sources)
+                    {
+                        AssetData data;
+                        if (!open_asset(source.path.c_str(), data))
+                            continue;
+                        for (size_t b = 0; b < data.size(); b += 4096)
+                            sum += data.data()[b];
+                    }
+                    if (sum == 1)
+                        printf(" ");
+                }
+                else
+                {
+                    for (const std::string &path : textures)
+                    {
+                        int w, h, channels;
+                        stbi_image_free(decode_image(path.c_str(), &w, &h, &channels, 0));
+                    }
+                }
+                ms[phase][run] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            }
+        }
+        static const char *names[3] = { "loose files", ".qpak stored", ".qpak LZ4" };
+        printf("%-18s %14.1f %14.1f %16.1f %16.1f\n", names[config], ms[0][0], ms[0][1], ms[1][0], ms[1][1]);
+    }
+    unmount_asset_packs();
+    for (const char *pack : packs)
+        std::filesystem::remove(pack);
+    printf("\n");
+}
+
+// rows of rectangles, tallest first: the baseline MaxRects is measured against. Returns
+// the pages used, the last one counted up to its lowest row.
+static double shelfPack(std::vector<MaxRectsPacker::Rect> rects, int pageSize)
+{
+    std::sort(rects.begin(), rects.end(), [](const MaxRectsPacker::Rect &a, const MaxRectsPacker::Rect &b) { return a.h > b.h; });
+    size_t pages = 1;
+    int x = 0, y = 0, rowHeight = 0;
+    for (const MaxRectsPacker::Rect &r : rects)
+    {
+        if (x + r.w > pageSize)
+        {
+            x = 0;
+            y += rowHeight;
+            rowHeight = 0;
+        }
+        if (y + r.h > pageSize)
+        {
+            pages++;
+            x = y = 0;
+        }
+        x += r.w;
+        rowHeight = std::max(rowHeight, r.h);
+    }
+    return pages - 1 + (double)(y + rowHeight) / pageSize;
+}
+
+// packing efficiency: the UI images through TextureAtlas (checked texel by texel,
+// padding included), then random sets through MaxRectsPacker against shelf packing
+void benchAtlasPacking()
+{
+    const char *ui[] = {
+        "../res/textures/shoot.png", "../res/textures/shoot2.png", "../res/textures/circle.png",
+        "../res/textures/rect_round_corner.png", "../res/textures/rect_round_corner2.png",
+        "../res/textures/Exclamation_Mark.png",
+    };
+    printf("== texture atlas: UI images, 2048 pages ==\n");
+    printf("%8s %8s %6s %12s %12s %10s %10s %10s\n", "padding", "sprites", "pages", "page size", "efficiency", "pack ms", "build ms", "correct");
+    for (int padding : { 0, 2, 4, 8 })
+    {
+        TextureAtlas atlas(2048, padding);
+        atlas.setUploadToGL(false);
+        for (const char *path : ui)
+            atlas.add(path);
+        auto start = std::chrono::steady_clock::now();
+        atlas.build();
+        double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        // every image and its extruded edges where the atlas says, no two padded rects overlapping
+        bool correct = atlas.stats().failed == 0;
+        for (size_t i = 0; i < atlas.spriteCount() && correct; ++i)
+        {
+            const TextureAtlas::Sprite &s = atlas.sprite((int)i);
+            int w, h, channels;
+            unsigned char *pixels = decode_image(ui[i], &w, &h, &channels, 4);
+            const uint8_t *page = atlas.pagePixels(s.page);
+            int pageW = atlas.pageWidth(s.page);
+            correct = pixels && w == s.width && h == s.height && s.x >= padding && s.y >= padding &&
+                      s.x + w + padding <= pageW && s.y + h + padding <= atlas.pageHeight(s.page) &&
+                      s.uv.x * pageW == (float)s.x && s.uv.z * pageW == (float)(s.x + w);
+            for (int y = -padding; y < h + padding && correct; ++y)
+                for (int x = -padding; x < w + padding && correct; ++x)
+                {
+                    const unsigned char *src = pixels + ((size_t)std::min(std::max(y, 0), h - 1) * w + std::min(std::max(x, 0), w - 1)) * 4;
+                    correct = memcmp(page + ((size_t)(s.y + y) * pageW + s.x + x) * 4, src, 4) == 0;
+                }
+            for (size_t j = 0; j < i && correct; ++j)
+            {
+                const TextureAtlas::Sprite &o = atlas.sprite((int)j);
+                correct = o.page != s.page || s.x + s.width + padding <= o.x - padding || o.x + o.width + padding <= s.x - padding ||
+                          s.y + s.height + padding <= o.y - padding || o.y + o.height + padding <= s.y - padding;
+            }
+            stbi_image_free(pixels);
+        }
+
+        const TextureAtlas::Stats &st = atlas.stats();
+        char pageSize[32];
+        snprintf(pageSize, sizeof(pageSize), "%dx%d", atlas.pageWidth(0), atlas.pageHeight(0));
+        printf("%8d %8zu %6zu %12s %11.1f%% %10.3f %10.1f %10s\n", padding, st.sprites - st.failed, st.pages, pageSize,
+               st.efficiency() * 100.0, st.packMs, buildMs, correct ? "yes" : "NO");
+    }
+
+    struct Set
+    {
+        const char *name;
+        int count, minW, maxW, minH, maxH;
+        bool square;
+    };
+    const Set sets[] = {
+        { "icons 16-64",    600, 16, 64, 16, 64, true },
+        { "glyphs",         2000, 4, 40, 10, 48, false },
+        { "mixed 8-160",    800, 8, 160, 8, 160, false },
+        { "panels 32-400",  120, 32, 400, 32, 400, false },
+    };
+    const int pageSize = 1024;
+    printf("\n== MaxRects against shelf packing: random sets, %d pages, 2 texels padding, the last page up to its lowest rect ==\n", pageSize);
+    printf("%-16s %6s %20s %20s %20s %12s\n", "set", "rects", "shelf pages / eff", "bottom left", "best short side", "us/insert");
+    std::mt19937 rng(11);
+    for (const Set &set : sets)
+    {
+        std::uniform_int_distribution<int> width(set.minW, set.maxW), height(set.minH, set.maxH);
+        std::vector<MaxRectsPacker::Rect> rects(set.count);
+        size_t area = 0;
+        for (MaxRectsPacker::Rect &r : rects)
+        {
+            r.x = r.y = 0;
+            r.w = width(rng) + 4;
+            r.h = set.square ? r.w : height(rng) + 4;
+            area += (size_t)(r.w - 4) * (r.h - 4);
+        }
+
+        // as TextureAtlas orders them
+        std::vector<MaxRectsPacker::Rect> sorted(rects);
+        std::stable_sort(sorted.begin(), sorted.end(), [](const MaxRectsPacker::Rect &a, const MaxRectsPacker::Rect &b) {
+            return std::max(a.w, a.h) != std::max(b.w, b.h) ? std::max(a.w, a.h) > std::max(b.w, b.h) : a.w * a.h > b.w * b.h;
+        });
+        double maxRectsPages[2], us = 0.0;
+        for (int heuristic = 0; heuristic < 2; ++heuristic)
+        {
+            auto start = std::chrono::steady_clock::now();
+            std::vector<MaxRectsPacker> pages;
+            std::vector<int> bottom;
+            for (const MaxRectsPacker::Rect &r : sorted)
+            {
+                MaxRectsPacker::Rect placed;
+                size_t p = 0;
+                while (p < pages.size() && !pages[p].insert(r.w, r.h, placed))
+                    ++p;
+                if (p == pages.size())
+                {
+                    pages.emplace_back(pageSize, pageSize, heuristic == 0 ? MaxRectsPacker::Heuristic::BottomLeft
+                                                                          : MaxRectsPacker::Heuristic::BestShortSideFit);
+                    bottom.push_back(0);
+                    pages.back().insert(r.w, r.h, placed);
+                }
+                bottom[p] = std::max(bottom[p], placed.y + placed.h);
+            }
+            if (heuristic == 0)
+                us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / set.count;
+            maxRectsPages[heuristic] = pages.size() - 1 + (double)bottom.back() / pageSize;
+        }
+
+        double shelfPages = shelfPack(rects, pageSize);
+        double pageArea = (double)pageSize * pageSize;
+        printf("%-16s %6d %12.2f %6.1f%% %12.2f %6.1f%% %12.2f %6.1f%% %12.2f\n", set.name, set.count,
+               shelfPages, area / (shelfPages * pageArea) * 100.0, maxRectsPages[0], area / (maxRectsPages[0] * pageArea) * 100.0,
+               maxRectsPages[1], area / (maxRectsPages[1] * pageArea) * 100.0, us);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    // TextureBench [frame ms]
+    double frameMs = argc > 1 ? std::atof(argv[1]) : 16.0;
+
+    benchAsyncLoad(frameMs);
+    benchTextureCache(512, 3);
+    benchTextureCache(64, 3);
+    benchBakedLoad();
+    benchBcDecode(20);
+    benchMipGeneration(5);
+    benchImageDecode(5);
+    benchAssetPack();
+    benchAtlasPacking();
+    return 0;
+}
@@ -0,0 +1,352 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "UploadImage.cpp"
+#include "TextureLoader.cpp"
+
+// Textures shared by file, so an image used by several objects or demos is decoded and
+// uploaded once.
+//
+// acquire() keys the texture by canonical path plus sampler parameters and returns a
+// refcounted Handle; the texture stays alive while any handle to it does. Released
+// textures stay resident on an LRU list and come back as hits, until the resident bytes
+// go over the budget, then the least recently released ones are deleted. Textures with
+// handles are never evicted, so the budget can be exceeded by what is in use.
+//
+// Sizes come from the file header (stbi_info) as RGBA8 with a full mip chain, which is
+// what UploadImage and TextureLoader create, so the accounting works before an async load
+// has finished. With a TextureLoader the texture shows its placeholder until then,
+// without one acquire() decodes and uploads on the spot. Files that can't be decoded are
+// not cached: acquire() returns an empty handle, or, when the loader reports the failure
+// later, trim() drops the entry and its handles go to texture 0.
+//
+//   TextureCache cache(256 << 20, &loader);
+//   TextureCache::Handle crate = cache.acquire("../res/textures/PresentA_ALB.png");
+//   glBindTexture(GL_TEXTURE_2D, crate.id());
+class TextureCache
+{
+	struct Entry;
+
+public:
+	struct Sampler
+	{
+		GLint wrapS     = GL_REPEAT;
+		GLint wrapT     = GL_REPEAT;
+		GLint minFilter = GL_LINEAR;
+		GLint magFilter = GL_LINEAR;
+	};
+
+	struct Stats
+	{
+		uint64_t hits;
+		uint64_t misses;       // decoded and uploaded
+		uint64_t failed;       // files that couldn't be read
+		uint64_t evictions;
+		size_t   entries;
+		size_t   bytesResident;
+		size_t   bytesInUse;   // of textures with handles
+	};
+
+	// shares one texture; copying adds a reference, destroying releases it
+	class Handle
+	{
+	public:
+		Handle() : cache(nullptr), entry(nullptr) {}
+		Handle(const Handle &other) : cache(other.cache), entry(other.entry) { if (entry) cache->addRef(entry); }
+		Handle(Handle &&other) : cache(other.cache), entry(other.entry) { other.entry = nullptr; }
+		~Handle() { reset(); }
+
+		Handle &operator=(Handle other)
+		{
+			std::swap(cache, other.cache);
+			std::swap(entry, other.entry);
+			return *this;
+		}
+
+		void reset()
+		{
+			if (entry)
+				cache->release(entry);
+			entry = nullptr;
+		}
+
+		GLuint id() const { return entry ? entry->texture : 0; }
+		size_t bytes() const { return entry ? entry->bytes : 0; }
+		explicit operator bool() const { return entry != nullptr; }
+
+	private:
+		friend class TextureCache;
+		Handle(TextureCache *cache, Entry *entry) : cache(cache), entry(entry) {}
+
+		TextureCache *cache;
+		Entry *entry;
+	};
+
+	// loader nullptr: acquire() loads synchronously
+	explicit TextureCache(size_t budgetBytes = 256 << 20, TextureLoader *loader = nullptr);
+	// handles must not outlive the cache
+	~TextureCache();
+
+	TextureCache(const TextureCache &) = delete;
+	TextureCache &operator=(const TextureCache &) = delete;
+
+	// an empty handle when the file can't be read
+	Handle acquire(const char *path, const Sampler &sampler);
+	Handle acquire(const char *path) { return acquire(path, Sampler()); }
+
+	// evicts released textures until the budget holds
+	void setBudget(size_t budgetBytes) { budget = budgetBytes; trim(); }
+	size_t budgetBytes() const { return budget; }
+	// acquire() and releasing trim too, but nothing is evicted while the loader is busy;
+	// call once a frame when using one
+	void trim();
+
+	// false: no GL calls, textures are 0, for the benchmarks without a context
+	void setUploadToGL(bool upload) { uploadToGL = upload; }
+
+	const Stats &stats() const { return counters; }
+
+private:
+	struct Entry
+	{
+		std::string key;
+		std::string path;                // as given to the loader
+		GLuint texture;
+		size_t bytes;
+		int refs;
+		bool released;                   // on the unused list
+		bool failed;                     // out of entries, deleted by the last release
+		std::list<Entry*>::iterator lru;
+	};
+
+	static std::string makeKey(const char *path, const Sampler &sampler);
+	static size_t imageBytes(int w, int h);
+
+	void addRef(Entry *entry);
+	void release(Entry *entry);
+	void destroy(Entry *entry);
+	void dropFailedLoads();
+
+	size_t budget;
+	TextureLoader *loader;
+	bool uploadToGL;
+
+	std::unordered_map<std::string, std::unique_ptr<Entry>> entries;
+	std::list<Entry*> unused;          // released textures, most recently released first
+	Stats counters;
+};
+
+
+TextureCache::TextureCache(size_t budgetBytes, TextureLoader *loader)
+	: budget(budgetBytes), loader(loader)
+{
+	uploadToGL = true;
+	counters = Stats();
+}
+
+TextureCache::~TextureCache()
+{
+	for (auto &it : entries)
+		destroy(it.second.get());
+}
+
+std::string TextureCache::makeKey(const char *path, const Sampler &sampler)
+{
+	// "../res/x.png" and "res/x.png" from another directory are the same file
+	std::error_code error;
+	std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+	std::string key = error ? std::string(path) : canonical.generic_string();
+
+	char params[64];
+	snprintf(params, sizeof(params), "|%x|%x|%x|%x", sampler.wrapS, sampler.wrapT, sampler.minFilter, sampler.magFilter);
+	return key + params;
+}
+
+size_t TextureCache::imageBytes(int w, int h)
+{
+	// RGBA8 level 0 plus the mip chain
+	size_t bytes = 0;
+	for (;;)
+	{
+		bytes += (size_t)w * h * 4;
+		if (w == 1 && h == 1)
+			return bytes;
+		w = std::max(w / 2, 1);
+		h = std::max(h / 2, 1);
+	}
+}
+
+TextureCache::Handle TextureCache::acquire(const char *path, const Sampler &sampler)
+{
+	std::string key = makeKey(path, sampler);
+
+	auto found = entries.find(key);
+	if (found != entries.end())
+	{
+		counters.hits++;
+		addRef(found->second.get());
+		return Handle(this, found->second.get());
+	}
+
+	// from a mounted asset pack or the file, like decode_image
+	int w, h, channels;
+	AssetData file;
+	if (!open_asset(path, file) || !stbi_info_from_memory(file.data(), (int)file.size(), &w, &h, &channels))
+	{
+		fprintf(stderr, "Can't load image: %s (%s)\n", path, file.data() ? stbi_failure_reason() : "can't open file");
+		counters.failed++;
+		return Handle();
+	}
+
+	std::unique_ptr<Entry> entry(new Entry());
+	entry->key = key;
+	entry->path = path;
+	entry->texture = 0;
+	entry->bytes = imageBytes(w, h);
+	entry->refs = 0;
+	entry->released = false;
+	entry->failed = false;
+
+	if (loader)
+	{
+		entry->texture = loader->load(path);
+	}
+	else
+	{
+		unsigned char *pixels = decode_image(path, &w, &h, &channels, 0);
+		if (!pixels)
+		{
+			fprintf(stderr, "Can't load image: %s (%s)\n", path, decode_image_failure());
+			counters.failed++;
+			return Handle();
+		}
+		if (uploadToGL)
+		{
+			glGenTextures(1, &entry->texture);
+			UploadImagePixels(entry->texture, pixels, w, h, channels);
+		}
+		stbi_image_free(pixels);
+	}
+
+	if (entry->texture)
+	{
+		glBindTexture(GL_TEXTURE_2D, entry->texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, sampler.wrapS);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, sampler.wrapT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, sampler.minFilter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, sampler.magFilter);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	counters.misses++;
+	counters.entries++;
+	counters.bytesResident += entry->bytes;
+
+	Entry *e = entry.get();
+	entries.emplace(key, std::move(entry));
+	addRef(e);
+
+	// making room for it can only evict released textures
+	trim();
+	return Handle(this, e);
+}
+
+void TextureCache::addRef(Entry *entry)
+{
+	if (entry->refs++ == 0)
+	{
+		counters.bytesInUse += entry->bytes;
+		if (entry->released)
+			unused.erase(entry->lru);
+		entry->released = false;
+	}
+}
+
+void TextureCache::release(Entry *entry)
+{
+	if (--entry->refs > 0)
+		return;
+
+	counters.bytesInUse -= entry->bytes;
+	if (entry->failed)
+	{
+		delete entry;
+		return;
+	}
+	unused.push_front(entry);
+	entry->lru = unused.begin();
+	entry->released = true;
+	trim();
+}
+
+void TextureCache::trim()
+{
+	if (loader)
+		dropFailedLoads();
+
+	// a deleted name could be reused before the loader writes the image into it
+	if (loader && !loader->idle())
+		return;
+
+	while (counters.bytesResident > budget && !unused.empty())
+	{
+		Entry *victim = unused.back();
+		unused.pop_back();
+		victim->released = false;
+
+		counters.evictions++;
+		counters.entries--;
+		counters.bytesResident -= victim->bytes;
+		// the key lives in the entry erase() deletes
+		std::string key = victim->key;
+		destroy(victim);
+		entries.erase(key);
+	}
+}
+
+void TextureCache::dropFailedLoads()
+{
+	for (const TextureLoader::Failure &failure : loader->takeFailures())
+	{
+		// without GL every texture is 0, the path tells them apart
+		for (auto it = entries.begin(); it != entries.end(); )
+		{
+			Entry *entry = it->second.get();
+			if (entry->texture != failure.texture || entry->path != failure.path)
+			{
+				++it;
+				continue;
+			}
+
+			counters.failed++;
+			counters.entries--;
+			counters.bytesResident -= entry->bytes;
+			destroy(entry);
+			if (entry->released)
+				unused.erase(entry->lru);
+			if (entry->refs > 0)
+			{
+				// the handles still point at it
+				entry->failed = true;
+				it->second.release();
+			}
+			it = entries.erase(it);
+		}
+	}
+}
+
+void TextureCache::destroy(Entry *entry)
+{
+	if (entry->texture && uploadToGL)
+		glDeleteTextures(1, &entry->texture);
+	entry->texture = 0;
+}
@@ -0,0 +1,307 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "UploadImage.cpp"
+#include "ThreadPool.cpp"
+#include "TextureStreamer.cpp"
+#include "MipGenerator.cpp"
+
+// Loads image files into GL textures without stalling the render thread.
+//
+// load() returns a texture name right away. Until the image arrives the texture holds a
+// 1x1 placeholder texel, so it can be bound and drawn from the first frame; the real
+// pixels later go into the same name. Files are decoded (ImageDecoder.cpp) on a ThreadPool,
+// at most maxDecoded images are decoding or waiting for upload at any time, which bounds
+// the memory held by decoded pixels. update() on the GL thread uploads decoded images in
+// the order they finish, up to uploadBudget bytes per call (always at least one image)
+// so a burst of loads doesn't turn into one long frame, and starts the next decodes.
+// With setStreamer() the pixels are handed to a TextureStreamer instead, which spreads
+// them over frames through PBOs (call its update() every frame too). With
+// setCpuMipmaps() the decoding threads also build the mip chain (MipGenerator.cpp), so
+// the GL thread uploads levels instead of running glGenerateMipmap.
+//
+//   ThreadPool pool;
+//   TextureLoader loader(pool);
+//   GLuint tex = loader.load("../res/textures/PresentA_ALB.png");
+//   each frame: loader.update(); draw with tex
+class TextureLoader
+{
+public:
+	struct Stats
+	{
+		uint32_t requested;
+		uint32_t uploaded;     // or handed to the streamer
+		uint32_t failed;       // couldn't be decoded, they keep the placeholder
+		size_t   uploadBytes;
+		double   decodeMs;     // summed over the decoding threads, with the CPU mipmaps
+		double   uploadMs;     // GL thread
+	};
+
+	struct FrameStats
+	{
+		uint32_t uploads;
+		size_t   uploadBytes;
+		double   uploadMs;
+	};
+
+	struct Failure
+	{
+		GLuint texture;        // as load() returned it, still holding the placeholder
+		std::string path;
+	};
+
+	TextureLoader(ThreadPool &pool, size_t maxDecoded = 4, size_t uploadBudget = 8 << 20);
+	~TextureLoader();
+
+	TextureLoader(const TextureLoader &) = delete;
+	TextureLoader &operator=(const TextureLoader &) = delete;
+
+	// GL thread. The texture shows the placeholder until an update() uploads the image.
+	GLuint load(const char *path);
+	// GL thread, once per frame
+	void update();
+	// GL thread, blocks until every image so far is uploaded
+	void finish();
+
+	bool done() const { return stats.uploaded + stats.failed == stats.requested; }
+	// done() and the streamer has every row, no texture is waiting for pixels
+	bool idle() const { return done() && (!streamer || streamer->idle()); }
+	// ms from the first load() to the last upload, while done()
+	double loadMs() const { return std::chrono::duration<double, std::milli>(lastUpload - firstLoad).count(); }
+
+	// false: no GL calls, textures are 0, for the benchmarks without a context
+	void setUploadToGL(bool upload) { uploadToGL = upload; }
+	// nullptr: glTexImage2D straight from the decoded pixels
+	void setStreamer(TextureStreamer *textureStreamer) { streamer = textureStreamer; }
+	void setPlaceholder(uint8_t r, uint8_t g, uint8_t b, uint8_t a) { placeholder[0] = r; placeholder[1] = g; placeholder[2] = b; placeholder[3] = a; }
+	// for the loads after the call; images are then decoded to RGBA
+	void setCpuMipmaps(bool enable, const MipOptions &options = MipOptions()) { cpuMips = enable; mipOptions = options; }
+
+	const Stats &totals() const { return stats; }
+	// the loads that failed since the last call
+	std::vector<Failure> takeFailures() { std::vector<Failure> taken; taken.swap(failures); return taken; }
+	// uploads of the last update()
+	const FrameStats &frameStats() const { return lastFrame; }
+
+private:
+	struct Job
+	{
+		std::string path;
+		GLuint texture;
+		unsigned char *pixels; // decode_image, nullptr when decoding failed
+		int w, h, channels;
+		MipOptions mipOptions;
+		MipChain *mips;        // with setCpuMipmaps
+		double decodeMs;
+		const char *failure;   // decode_image_failure() is per thread, kept from the worker
+	};
+
+	void startDecodes();
+	void uploadJob(Job &job);
+
+	ThreadPool &pool;
+	size_t maxDecoded;
+	size_t uploadBudget;
+	bool uploadToGL;
+	TextureStreamer *streamer;
+	uint8_t placeholder[4];
+	bool cpuMips;
+	MipOptions mipOptions;
+
+	std::deque<Job> waiting;     // not handed to the pool yet, GL thread only
+	size_t inFlight;             // decoding or decoded, GL thread only
+
+	std::mutex mutex;
+	std::condition_variable decodedReady;
+	std::deque<Job> decoded;     // guarded by mutex
+	size_t decoding;             // guarded by mutex
+
+	std::vector<Failure> failures; // GL thread
+
+	Stats stats;
+	FrameStats lastFrame;
+	std::chrono::steady_clock::time_point firstLoad, lastUpload;
+};
+
+
+TextureLoader::TextureLoader(ThreadPool &pool, size_t maxDecoded, size_t uploadBudget)
+	: pool(pool), maxDecoded(std::max<size_t>(maxDecoded, 1)), uploadBudget(uploadBudget)
+{
+	uploadToGL = true;
+	streamer = nullptr;
+	setPlaceholder(128, 128, 128, 255);
+	cpuMips = false;
+	inFlight = 0;
+	decoding = 0;
+	stats = Stats();
+	lastFrame = FrameStats();
+}
+
+TextureLoader::~TextureLoader()
+{
+	// the tasks still running write into this object
+	std::unique_lock<std::mutex> lock(mutex);
+	decodedReady.wait(lock, [this] { return decoding == 0; });
+	for (Job &job : decoded)
+	{
+		stbi_image_free(job.pixels);
+		delete job.mips;
+	}
+	for (Job &job : waiting)
+		delete job.mips;
+}
+
+GLuint TextureLoader::load(const char *path)
+{
+	if (stats.requested == 0)
+		firstLoad = std::chrono::steady_clock::now();
+	stats.requested++;
+
+	Job job = Job();
+	job.path = path;
+	job.mipOptions = mipOptions;
+	if (cpuMips)
+		job.mips = new MipChain();
+	if (uploadToGL)
+	{
+		glGenTextures(1, &job.texture);
+		glBindTexture(GL_TEXTURE_2D, job.texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	GLuint texture = job.texture;
+	waiting.push_back(std::move(job));
+	startDecodes();
+	return texture;
+}
+
+void TextureLoader::startDecodes()
+{
+	while (!waiting.empty() && inFlight < maxDecoded)
+	{
+		Job *job = new Job(std::move(waiting.front()));
+		waiting.pop_front();
+		inFlight++;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			decoding++;
+		}
+
+		pool.submit([this, job] {
+			auto start = std::chrono::steady_clock::now();
+			job->pixels = decode_image(job->path.c_str(), &job->w, &job->h, &job->channels, job->mips ? 4 : 0);
+			job->failure = job->pixels ? nullptr : decode_image_failure();
+			if (job->mips && job->pixels)
+			{
+				job->channels = 4;
+				generate_mips(job->pixels, job->w, job->h, job->mipOptions, *job->mips);
+			}
+			job->decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			decoded.push_back(std::move(*job));
+			delete job;
+			decoding--;
+			decodedReady.notify_all();
+		});
+	}
+}
+
+void TextureLoader::uploadJob(Job &job)
+{
+	inFlight--;
+	stats.decodeMs += job.decodeMs;
+	if (!job.pixels)
+	{
+		fprintf(stderr, "Can't load image: %s (%s)\n", job.path.c_str(), job.failure);
+		stats.failed++;
+		failures.push_back({ job.texture, job.path });
+		delete job.mips;
+	}
+	else
+	{
+		size_t bytes = (size_t)job.w * job.h * job.channels + (job.mips ? job.mips->bytes() : 0);
+		auto start = std::chrono::steady_clock::now();
+		if (uploadToGL && streamer)
+		{
+			// the streamer owns both from here
+			streamer->upload(job.texture, job.pixels, job.w, job.h, job.channels, stbi_image_free, job.mips);
+			job.mips = nullptr;
+		}
+		else if (uploadToGL)
+		{
+			UploadImagePixels(job.texture, job.pixels, job.w, job.h, job.channels, job.mips);
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (!uploadToGL || !streamer)
+			stbi_image_free(job.pixels);
+		delete job.mips;
+
+		stats.uploaded++;
+		stats.uploadBytes += bytes;
+		stats.uploadMs += ms;
+		lastFrame.uploads++;
+		lastFrame.uploadBytes += bytes;
+		lastFrame.uploadMs += ms;
+	}
+
+	if (done())
+		lastUpload = std::chrono::steady_clock::now();
+}
+
+void TextureLoader::update()
+{
+	lastFrame = FrameStats();
+
+	while (lastFrame.uploads == 0 || lastFrame.uploadBytes < uploadBudget)
+	{
+		Job job;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (decoded.empty())
+				break;
+			job = std::move(decoded.front());
+			decoded.pop_front();
+		}
+		uploadJob(job);
+		startDecodes();
+	}
+	startDecodes();
+}
+
+void TextureLoader::finish()
+{
+	FrameStats frame = FrameStats();
+	while (!done())
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			decodedReady.wait(lock, [this] { return !decoded.empty(); });
+			job = std::move(decoded.front());
+			decoded.pop_front();
+		}
+		lastFrame = FrameStats();
+		uploadJob(job);
+		frame.uploads += lastFrame.uploads;
+		frame.uploadBytes += lastFrame.uploadBytes;
+		frame.uploadMs += lastFrame.uploadMs;
+		startDecodes();
+	}
+	lastFrame = frame;
+}
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <cstring>
+#include <deque>
+
+#include "StreamBuffer.cpp"
+#include "MipGenerator.cpp"
+
+// Texture uploads staged through pixel unpack buffers and spread over frames.
+//
+// upload() only allocates the texture storage and queues the image. update(), once per
+// frame on the GL thread, copies as many rows as fit the frame's staging region into a
+// StreamBuffer (persistently mapped where supported, so that is the PBO pool: one region
+// per frame in flight) and issues glTexSubImage2D from it, so the driver reads the pixels
+// asynchronously instead of copying them inside glTexImage2D. Images larger than a region
+// arrive in row chunks over several frames; rows not streamed yet are undefined. Mipmaps
+// are generated when the last row is in, or, for images handed over with a MipChain made
+// on the CPU, its levels stream after the image the same way. Layers of a
+// GL_TEXTURE_2D_ARRAY (TextureArray.cpp) stream the same way into storage the caller made.
+//
+// Stalls are the fence waits of the StreamBuffer (a region still read by the GPU when it
+// comes round again) plus the CPU time of the glTexSubImage2D calls themselves.
+//
+//   TextureStreamer streamer(4 << 20);
+//   streamer.upload(texture, pixels, w, h, 4, stbi_image_free);
+//   each frame: streamer.update();
+class TextureStreamer
+{
+public:
+	struct FrameStats
+	{
+		size_t   uploadBytes;
+		uint32_t chunks;         // glTexSubImage2D calls
+		uint32_t completed;      // images whose last row went up
+		double   fenceWaitMs;    // waiting for a staging region
+		double   submitMs;       // memcpy into the region and glTexSubImage2D
+	};
+
+	explicit TextureStreamer(GLsizeiptr bytesPerFrame = 4 << 20);
+	~TextureStreamer();
+
+	TextureStreamer(const TextureStreamer &) = delete;
+	TextureStreamer &operator=(const TextureStreamer &) = delete;
+
+	// respecifies texture as w x h RGBA8 and queues the pixels (1 to 4 channels, rows
+	// tightly packed, one row has to fit bytesPerFrame). release, when given, is called
+	// with pixels once they are copied. mips (RGBA pixels only) is taken over and deleted
+	// once streamed.
+	void upload(GLuint texture, unsigned char *pixels, int w, int h, int channels, void (*release)(void *) = nullptr,
+	            MipChain *mips = nullptr);
+	// the same into layer of a GL_TEXTURE_2D_ARRAY that already has w x h storage for every
+	// level of mips; no glGenerateMipmap, the levels have to come in mips
+	void uploadLayer(GLuint arrayTexture, int layer, unsigned char *pixels, int w, int h, int channels,
+	                 void (*release)(void *) = nullptr, MipChain *mips = nullptr);
+	// drops what is queued for texture, before deleting it
+	void cancel(GLuint texture);
+	// GL thread, once per frame
+	void update();
+
+	bool idle() const { return queue.empty(); }
+	// texture still has rows queued
+	bool streaming(GLuint texture) const;
+	size_t queuedBytes() const;
+
+	const FrameStats &frameStats() const { return lastStats; }
+	const StreamBuffer &stream() const { return staging; }
+
+private:
+	struct Job
+	{
+		GLuint texture;
+		unsigned char *pixels;   // level 0, nullptr once released
+		int w, h, channels;      // of the level streaming
+		int nextRow;
+		void (*release)(void *);
+		MipChain *mips;
+		int level;
+		int layer;               // of a GL_TEXTURE_2D_ARRAY, -1 for a GL_TEXTURE_2D
+
+		const unsigned char *levelPixels() const { return level == 0 ? pixels : mips->data(mips->levels[level - 1]); }
+	};
+
+	static void releasePixels(Job &job);
+
+	static const GLsizeiptr kChunkAlignment = 16;
+
+	StreamBuffer staging;
+	std::deque<Job> queue;
+	FrameStats lastStats;
+};
+
+
+TextureStreamer::TextureStreamer(GLsizeiptr bytesPerFrame)
+	: staging(bytesPerFrame)
+{
+	lastStats = FrameStats();
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	for (Job &job : queue)
+		releasePixels(job);
+}
+
+void TextureStreamer::releasePixels(Job &job)
+{
+	if (job.release && job.pixels)
+		job.release(job.pixels);
+	job.pixels = nullptr;
+	delete job.mips;
+	job.mips = nullptr;
+}
+
+void TextureStreamer::upload(GLuint texture, unsigned char *pixels, int w, int h, int channels, void (*release)(void *),
+                             MipChain *mips)
+{
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	if (mips)
+	{
+		for (const MipLevel &level : mips->levels)
+			glTexImage2D(GL_TEXTURE_2D, level.level, GL_RGBA, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	queue.push_back({ texture, pixels, w, h, channels, 0, release, mips, 0, -1 });
+}
+
+void TextureStreamer::uploadLayer(GLuint arrayTexture, int layer, unsigned char *pixels, int w, int h, int channels,
+                                  void (*release)(void *), MipChain *mips)
+{
+	queue.push_back({ arrayTexture, pixels, w, h, channels, 0, release, mips, 0, layer });
+}
+
+void TextureStreamer::cancel(GLuint texture)
+{
+	for (auto it = queue.begin(); it != queue.end(); )
+	{
+		if (it->texture == texture)
+		{
+			releasePixels(*it);
+			it = queue.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+bool TextureStreamer::streaming(GLuint texture) const
+{
+	for (const Job &job : queue)
+		if (job.texture == texture)
+			return true;
+	return false;
+}
+
+size_t TextureStreamer::queuedBytes() const
+{
+	size_t bytes = 0;
+	for (const Job &job : queue)
+	{
+		bytes += (size_t)(job.h - job.nextRow) * job.w * job.channels;
+		if (job.mips)
+		{
+			for (size_t level = job.level; level < job.mips->levels.size(); ++level)
+				bytes += (size_t)job.mips->levels[level].width * job.mips->levels[level].height * 4;
+		}
+	}
+	return bytes;
+}
+
+void TextureStreamer::update()
+{
+	FrameStats stats = FrameStats();
+	if (queue.empty())
+	{
+		lastStats = stats;
+		return;
+	}
+
+	staging.beginFrame();
+	stats.fenceWaitMs = staging.frameStats().waitMs;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	GLsizeiptr used = 0;
+	while (!queue.empty())
+	{
+		Job &job = queue.front();
+		GLsizeiptr rowBytes = (GLsizeiptr)job.w * job.channels;
+		GLsizeiptr space = staging.capacityPerFrame() - (used + kChunkAlignment - 1) / kChunkAlignment * kChunkAlignment;
+		int rows = (int)std::min<GLsizeiptr>(job.h - job.nextRow, space / rowBytes);
+		if (rows <= 0 && used == 0)
+		{
+			fprintf(stderr, "TextureStreamer: a %d px row doesn't fit %lld bytes per frame\n", job.w, (long long)staging.capacityPerFrame());
+			releasePixels(job);
+			queue.pop_front();
+			continue;
+		}
+		if (rows <= 0)
+			break;
+
+		GLintptr offset;
+		GLsizeiptr bytes = rows * rowBytes;
+		void *dst = staging.allocate(bytes, kChunkAlignment, offset);
+		if (!dst)
+			break;
+		used = (used + kChunkAlignment - 1) / kChunkAlignment * kChunkAlignment + bytes;
+		memcpy(dst, job.levelPixels() + job.nextRow * rowBytes, bytes);
+		staging.commit();
+
+		static const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+		if (job.layer < 0)
+		{
+			glBindTexture(GL_TEXTURE_2D, job.texture);
+			glTexSubImage2D(GL_TEXTURE_2D, job.level, 0, job.nextRow, job.w, rows, formats[job.channels - 1], GL_UNSIGNED_BYTE, (const void*)offset);
+		}
+		else
+		{
+			glBindTexture(GL_TEXTURE_2D_ARRAY, job.texture);
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, job.level, 0, job.nextRow, job.layer, job.w, rows, 1, formats[job.channels - 1], GL_UNSIGNED_BYTE, (const void*)offset);
+		}
+
+		job.nextRow += rows;
+		stats.uploadBytes += bytes;
+		stats.chunks++;
+
+		if (job.nextRow == job.h && job.mips && job.level < (int)job.mips->levels.size())
+		{
+			// on to the next CPU made level
+			const MipLevel &next = job.mips->levels[job.level];
+			if (job.level == 0 && job.release)
+				job.release(job.pixels);
+			job.pixels = nullptr;
+			job.level++;
+			job.w = next.width;
+			job.h = next.height;
+			job.nextRow = 0;
+		}
+		else if (job.nextRow == job.h)
+		{
+			if (!job.mips && job.layer < 0)
+				glGenerateMipmap(GL_TEXTURE_2D);
+			releasePixels(job);
+			queue.pop_front();
+			stats.completed++;
+		}
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	staging.endFrame();
+
+	stats.submitMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	lastStats = stats;
+}
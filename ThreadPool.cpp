@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running queued tasks.
+//
+// parallelFor() splits an index range into chunks that the workers and the calling
+// thread take from a shared counter, and returns when all are done. workerIndex() tells
+// a task which thread runs it: 0..threadCount()-1 for the workers, threadCount() for
+// any other thread, so per thread scratch can be an array of threadCount() + 1.
+//
+//   ThreadPool pool(4);
+//   pool.parallelFor(count, [&](size_t begin, size_t end, int worker) { ... });
+class ThreadPool
+{
+public:
+	// 0 threads: one per hardware thread, minus the caller
+	explicit ThreadPool(int threads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	int threadCount() const { return (int)workers.size(); }
+	static int workerIndex();
+
+	void submit(std::function<void()> task);
+	// blocks until the queue is empty and no task is running
+	void wait();
+
+	// fn(begin, end, worker) over [0, count) in chunks of grain indices. Not from inside
+	// a task: it waits for tasks that would need the thread it blocks.
+	void parallelFor(size_t count, const std::function<void(size_t, size_t, int)> &fn, size_t grain = 1);
+
+private:
+	void run(int index);
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable taskReady;
+	std::condition_variable idle;
+	int busy;
+	bool stopping;
+
+	static thread_local int currentWorker;
+};
+
+
+thread_local int ThreadPool::currentWorker = -1;
+
+ThreadPool::ThreadPool(int threads)
+{
+	if (threads <= 0)
+		threads = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+
+	busy = 0;
+	stopping = false;
+	for (int i = 0; i < threads; ++i)
+		workers.emplace_back(&ThreadPool::run, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	taskReady.notify_all();
+	for (std::thread &worker : workers)
+		worker.join();
+}
+
+int ThreadPool::workerIndex()
+{
+	return currentWorker;
+}
+
+void ThreadPool::run(int index)
+{
+	currentWorker = index;
+
+	for (;;)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			taskReady.wait(lock, [this] { return stopping || !tasks.empty(); });
+			if (tasks.empty())
+				return;
+
+			task = std::move(tasks.front());
+			tasks.pop_front();
+			busy++;
+		}
+
+		task();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			busy--;
+			if (busy == 0 && tasks.empty())
+				idle.notify_all();
+		}
+	}
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	taskReady.notify_one();
+}
+
+void ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this] { return busy == 0 && tasks.empty(); });
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t, size_t, int)> &fn, size_t grain)
+{
+	if (count == 0)
+		return;
+	grain = std::max<size_t>(grain, 1);
+
+	std::atomic<size_t> next(0);
+	auto work = [&](int worker) {
+		for (;;)
+		{
+			size_t begin = next.fetch_add(grain);
+			if (begin >= count)
+				return;
+			fn(begin, std::min(begin + grain, count), worker);
+		}
+	};
+
+	// only as many helpers as there are chunks beyond the caller's first
+	size_t chunks = (count + grain - 1) / grain;
+	int helpers = (int)std::min<size_t>(workers.size(), chunks - 1);
+
+	std::mutex doneMutex;
+	std::condition_variable doneCondition;
+	int running = helpers;
+
+	for (int i = 0; i < helpers; ++i)
+	{
+		submit([&] {
+			work(currentWorker);
+
+			std::lock_guard<std::mutex> lock(doneMutex);
+			if (--running == 0)
+				doneCondition.notify_one();
+		});
+	}
+
+	work(currentWorker >= 0 ? currentWorker : threadCount());
+
+	std::unique_lock<std::mutex> lock(doneMutex);
+	doneCondition.wait(lock, [&] { return running == 0; });
+}
@@ -2,16 +2,69 @@
 
 
 #include <stdint.h>
+#include <stdexcept>
 #include <glad/gl.h>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb/stb_image.h>
+#include <cstring>
+
+#include "BakedTexture.cpp"
+#include "CompressedTexture.cpp"
+#include "ImageDecoder.cpp"
+#include "MipGenerator.cpp"
+
+// (re)specifies ImageId from decoded pixels, also used by TextureLoader on images decoded
+// on other threads. Sampler parameters are left as they are. The levels below come from
+// mips when given (generate_mips on RGBA pixels), otherwise from glGenerateMipmap.
+void UploadImagePixels(uint32_t ImageId, const unsigned char *bytes, int imgWidth, int imgHeight, int numColCh,
+                       const MipChain *mips = nullptr)
+{
+        glBindTexture(GL_TEXTURE_2D, ImageId);
+
+         GLenum format;
+
+        if (numColCh == 1)
+        {
+            format = GL_RED;
+        } else if (numColCh == 3)
+        {
+            format = GL_RGB;
+        } else if (numColCh == 4)
+        {
+            format = GL_RGBA;
+        } else
+        {
+            throw std::invalid_argument("Automatic Texture type recognition failed");
+        }
+
+        // rows of 1 and 3 channel images aren't 4 byte aligned in general
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imgWidth, imgHeight, 0, format, GL_UNSIGNED_BYTE, bytes);
+        if (mips)
+        {
+            for (const MipLevel &level : mips->levels)
+                glTexImage2D(GL_TEXTURE_2D, level.level, GL_RGBA, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, mips->data(level));
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        // glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, imgWidth, imgHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, bytes);
+        if (!mips)
+            glGenerateMipmap(GL_TEXTURE_2D);
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+}
 
 uint32_t UploadImage(const char *ImgSrc, bool repeat = false)
 {
+        // baked offline with every mip level, nothing to decode
+        size_t length = strlen(ImgSrc);
+        if (length > 5 && strcmp(ImgSrc + length - 5, ".qtex") == 0)
+            return UploadBakedTexture(ImgSrc);
+        // block compressed, which stb_image can't read
+        if (length > 4 && (strcmp(ImgSrc + length - 4, ".dds") == 0 || strcmp(ImgSrc + length - 4, ".ktx") == 0))
+            return UploadCompressedTexture(ImgSrc);
+
         uint32_t ImageId;
         int imgWidth, imgHeight, numColCh;
-        unsigned char *bytes = stbi_load(ImgSrc, &imgWidth, &imgHeight, &numColCh, 0);
+        unsigned char *bytes = decode_image(ImgSrc, &imgWidth, &imgHeight, &numColCh, 0);
 
         glGenTextures(1, &ImageId);
         glBindTexture(GL_TEXTURE_2D, ImageId);
@@ -54,27 +107,7 @@ uint32_t UploadImage(const char *ImgSrc, bool repeat = false)
         // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
         // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
 
-         GLenum format;
-
-        if (numColCh == 1)
-        {
-            format = GL_RED;
-        } else if (numColCh == 3)
-        {
-            format = GL_RGB;
-        } else if (numColCh == 4)
-        {
-            format = GL_RGBA;
-        } else
-        {
-            throw std::invalid_argument("Automatic Texture type recognition failed");
-        }
-
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imgWidth, imgHeight, 0, format, GL_UNSIGNED_BYTE, bytes);
-        // glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, imgWidth, imgHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, bytes);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glBindTexture(GL_TEXTURE_2D, 0);
+        UploadImagePixels(ImageId, bytes, imgWidth, imgHeight, numColCh);
         stbi_image_free(bytes);
 
         return ImageId;
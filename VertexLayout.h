@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+
+// Vertex layouts understood by GLMeshData::createGLObjects.
+// SeparateFloat is the original two-stream layout (float3 pos + float2 uv, 20 bytes).
+// The interleaved layouts store one 12 byte vertex: pos as 3 x half or 3 x snorm16
+// (+1 pad) normalized by a per-mesh scale/bias, uv as 2 x unorm16 also normalized
+// per mesh. Decode with positionDecode() folded into the model matrix and
+// uvDecode() passed to the vertex shader.
+enum class VertexLayout
+{
+	SeparateFloat,
+	InterleavedHalf,
+	InterleavedSnorm16,
+};
+
+struct PackedVertex
+{
+	uint16_t pos[4];
+	uint16_t uv[2];
+};
+static_assert(sizeof(PackedVertex) == 12, "PackedVertex must stay 12 bytes");
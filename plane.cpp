@@ -17,6 +17,8 @@
 #include <sstream>
 #include <iostream>
 
+#include "AssetPack.cpp"
+
 struct ViewUniforms {
 	glm::mat4 view;
 	glm::mat4 proj;
@@ -97,33 +99,12 @@ GLuint compileShader(GLenum type, const char *source)
 
 GLuint createProgram(const char *vert, const char *frag)
 {
-	std::string vertexCode;
-	std::string fragmentCode;
-	std::ifstream vShaderFile;
-	std::ifstream fShaderFile;
-	// ensure ifstream objects can throw exceptions:
-	vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-	fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-	try 
-        {
-            // open files
-            vShaderFile.open(vert);
-            fShaderFile.open(frag);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-			vertexCode = vShaderStream.str();
-			fragmentCode = fShaderStream.str();
-        }
-        catch (std::ifstream::failure& e)
-        {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
-        }
+	// from a mounted asset pack (AssetPack.cpp) or the files
+	AssetData vertexSource, fragmentSource;
+	if (!open_asset(vert, vertexSource) || !open_asset(frag, fragmentSource))
+		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << (vertexSource.data() ? frag : vert) << std::endl;
+	std::string vertexCode((const char *)vertexSource.data(), vertexSource.size());
+	std::string fragmentCode((const char *)fragmentSource.data(), fragmentSource.size());
     GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexCode.c_str());
     GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentCode.c_str());
 
@@ -159,6 +140,9 @@ int main(void)
 	GLuint vertex_buffer, vertex_shader, fragment_shader, program;
 	GLint mvp_location, vpos_location, vcol_location;
 
+	// res/ and shaders/ from one mapped file when the pack is built (AssetPackBuild.cpp)
+	mount_asset_pack("../res/resources.qpak");
+
 	glfwSetErrorCallback(error_callback);
 
 	if (!glfwInit())